@@ -0,0 +1,292 @@
+#include "AssetPack.h"
+#include "Compression.h"
+#include "JobQueue.h"
+
+#include <memory>
+
+// ========================================================
+// AssetPack
+// ========================================================
+
+AssetPack::AssetPack()
+{
+}
+
+AssetPack::~AssetPack()
+{
+	unmount();
+}
+
+// open() hands out uncompressed entries in place as aligned and zero padded,
+// so a pack where they aren't must not mount. Offset and size are already
+// known to be inside the file.
+static bool valid_uncompressed_entry(const PakEntry& rEntry, u64 fileSize)
+{
+	return rEntry.storedSize == rEntry.size
+		&& rEntry.offset % kPakEntryAlignment == 0
+		&& kPakTailPadding <= fileSize - rEntry.offset - rEntry.storedSize;
+}
+
+bool AssetPack::mount(const char* pFilename, JobPool* pDecompressPool)
+{
+	ASSERT(!is_mounted());
+
+	if (!map_file(pFilename, m_view, 8, 0))
+	{
+		return false;
+	}
+
+	// Validate everything we'll index into later.
+	const u64 kFileSize = m_view.size;
+	const PakHeader* pHeader = reinterpret_cast<const PakHeader*>(m_view.pData);
+	bool bValid = kFileSize >= sizeof(PakHeader)
+		&& pHeader->magic == kPakMagic
+		&& pHeader->version == kPakVersion
+		&& pHeader->chunkSize > 0
+		&& pHeader->indexOffset <= kFileSize
+		&& (pHeader->indexOffset % 8) == 0
+		&& static_cast<u64>(pHeader->numEntries) * sizeof(PakEntry) <= kFileSize - pHeader->indexOffset
+		&& pHeader->namesOffset <= kFileSize;
+
+	if (bValid)
+	{
+		const PakEntry* pEntries = reinterpret_cast<const PakEntry*>(m_view.pData + pHeader->indexOffset);
+		for (u32 i = 0; i < pHeader->numEntries && bValid; ++i)
+		{
+			const PakEntry& e = pEntries[i];
+			bValid = e.offset <= kFileSize
+				&& e.storedSize <= kFileSize - e.offset
+				&& static_cast<u64>(e.nameOffset) + e.nameLength <= kFileSize - pHeader->namesOffset
+				&& (e.codec == kPakCodecNone ? valid_uncompressed_entry(e, kFileSize)
+					: (e.chunkTableOffset <= kFileSize
+						&& static_cast<u64>(e.numChunks) * sizeof(PakChunk) <= kFileSize - e.chunkTableOffset
+						&& static_cast<u64>(e.numChunks) * pHeader->chunkSize >= e.size));
+		}
+	}
+
+	if (!bValid)
+	{
+		errorF("AssetPack : %s is not a valid pack file.", pFilename);
+		unmap_file(m_view);
+		return false;
+	}
+
+	m_filename = pFilename;
+	m_pDecompressPool = pDecompressPool;
+	m_pHeader = pHeader;
+	m_pEntries = reinterpret_cast<const PakEntry*>(m_view.pData + pHeader->indexOffset);
+	m_pNames = reinterpret_cast<const char*>(m_view.pData + pHeader->namesOffset);
+	return true;
+}
+
+void AssetPack::unmount()
+{
+	if (is_mounted())
+	{
+		unmap_file(m_view);
+		m_pHeader = nullptr;
+		m_pEntries = nullptr;
+		m_pNames = nullptr;
+		m_filename.clear();
+	}
+}
+
+const PakEntry* AssetPack::find(const char* pName) const
+{
+	if (!is_mounted())
+	{
+		return nullptr;
+	}
+
+	const std::string name = pak_normalise_name(pName);
+	const u64 hash = pak_hash_name(name);
+
+	const PakEntry* pEnd = m_pEntries + m_pHeader->numEntries;
+	const PakEntry* pFound = std::lower_bound(m_pEntries, pEnd, hash,
+		[](const PakEntry& e, u64 h) { return e.nameHash < h; });
+
+	if (pFound == pEnd || pFound->nameHash != hash)
+	{
+		return nullptr;
+	}
+
+	// Guard against hash collisions with names that aren't in the pack.
+	if (pFound->nameLength != name.size() || memcmp(m_pNames + pFound->nameOffset, name.data(), name.size()) != 0)
+	{
+		return nullptr;
+	}
+	return pFound;
+}
+
+bool AssetPack::open(const PakEntry& rEntry, FileView& rViewOut, const u32 kAlignment, const u32 kZeroPadding) const
+{
+	ASSERT(is_mounted());
+	ASSERT(rViewOut.pData == nullptr); // View is already in use.
+
+	const memtype_t* pStored = m_view.pData + rEntry.offset;
+
+	// Uncompressed entries are already aligned and zero padded in the pack.
+	if (rEntry.codec == kPakCodecNone && kAlignment <= kPakEntryAlignment && kZeroPadding <= kPakTailPadding)
+	{
+		rViewOut = FileView();
+		rViewOut.pData = pStored;
+		rViewOut.size = rEntry.size;
+		return true;
+	}
+
+	if (rEntry.codec != kPakCodecNone && rEntry.codec != kPakCodecLZ4)
+	{
+		errorF("AssetPack : unsupported codec %u in %s", rEntry.codec, m_filename.c_str());
+		return false;
+	}
+
+	ASSERT(rEntry.size + kZeroPadding <= SIZE_MAX);
+	memtype_t* pCopy = (memtype_t*)_aligned_malloc(static_cast<size_t>(rEntry.size + kZeroPadding), kAlignment ? kAlignment : 1);
+	ASSERT(pCopy);
+
+	bool bSuccess = true;
+	if (rEntry.codec == kPakCodecNone)
+	{
+		memcpy(pCopy, pStored, static_cast<size_t>(rEntry.size));
+	}
+	else
+	{
+		const PakChunk* pChunks = reinterpret_cast<const PakChunk*>(m_view.pData + rEntry.chunkTableOffset);
+		const u32 kChunkSize = m_pHeader->chunkSize;
+
+		// Chunk start offsets are a running sum of the stored sizes.
+		std::vector<u64> chunkOffsets(rEntry.numChunks + 1);
+		chunkOffsets[0] = 0;
+		for (u32 i = 0; i < rEntry.numChunks; ++i)
+		{
+			chunkOffsets[i + 1] = chunkOffsets[i] + pChunks[i].storedSize;
+		}
+
+		if (chunkOffsets[rEntry.numChunks] != rEntry.storedSize)
+		{
+			bSuccess = false;
+		}
+		else
+		{
+			std::atomic<bool> bFailed(false);
+			auto decompressChunks = [&](u32 begin, u32 end)
+			{
+				for (u32 i = begin; i < end; ++i)
+				{
+					const u64 dstOffset = static_cast<u64>(i) * kChunkSize;
+					if (dstOffset >= rEntry.size)
+					{
+						bFailed = true;
+						return;
+					}
+					const u32 dstSize = static_cast<u32>(std::min<u64>(kChunkSize, rEntry.size - dstOffset));
+					const memtype_t* pSrc = pStored + chunkOffsets[i];
+
+					if (pChunks[i].flags & kPakChunkRaw)
+					{
+						if (pChunks[i].storedSize != dstSize)
+						{
+							bFailed = true;
+							return;
+						}
+						memcpy(pCopy + dstOffset, pSrc, dstSize);
+					}
+					else if (!lz4_decompress(pSrc, pChunks[i].storedSize, pCopy + dstOffset, dstSize))
+					{
+						bFailed = true;
+						return;
+					}
+				}
+			};
+
+			if (m_pDecompressPool && rEntry.numChunks > 1)
+			{
+				m_pDecompressPool->parallelFor(rEntry.numChunks, 1, decompressChunks);
+			}
+			else
+			{
+				decompressChunks(0, rEntry.numChunks);
+			}
+			bSuccess = !bFailed;
+		}
+	}
+
+	if (!bSuccess)
+	{
+		errorF("AssetPack : corrupt entry '%.*s' in %s", rEntry.nameLength, m_pNames + rEntry.nameOffset, m_filename.c_str());
+		_aligned_free(pCopy);
+		return false;
+	}
+
+	if (kZeroPadding > 0)
+	{
+		memset(pCopy + rEntry.size, 0, kZeroPadding);
+	}
+
+	rViewOut = FileView();
+	rViewOut.pData = pCopy;
+	rViewOut.size = rEntry.size;
+	rViewOut.pCopy = pCopy;
+	return true;
+}
+
+// ========================================================
+// Virtual file access.
+// Packs are mounted at startup before any loading threads run,
+// so lookups don't need a lock.
+// ========================================================
+
+static std::vector<std::unique_ptr<AssetPack>> s_mountedPacks;
+
+bool mount_asset_pack(const char* pFilename, JobPool* pDecompressPool)
+{
+	std::unique_ptr<AssetPack> pPack(new AssetPack());
+	if (!pPack->mount(pFilename, pDecompressPool))
+	{
+		return false;
+	}
+
+	debugF("Mounted asset pack %s\n", pFilename);
+	s_mountedPacks.push_back(std::move(pPack));
+	return true;
+}
+
+void unmount_asset_packs()
+{
+	s_mountedPacks.clear();
+}
+
+static const PakEntry* find_in_packs(const char* pName, const AssetPack** ppPackOut)
+{
+	// Most recently mounted wins.
+	for (auto it = s_mountedPacks.rbegin(); it != s_mountedPacks.rend(); ++it)
+	{
+		if (const PakEntry* pEntry = (*it)->find(pName))
+		{
+			*ppPackOut = it->get();
+			return pEntry;
+		}
+	}
+	return nullptr;
+}
+
+bool asset_in_packs(const char* pName)
+{
+	const AssetPack* pPack = nullptr;
+	return find_in_packs(pName, &pPack) != nullptr;
+}
+
+bool open_asset(const char* pName, FileView& rViewOut, const u32 kAlignment, const u32 kZeroPadding)
+{
+	const AssetPack* pPack = nullptr;
+	if (const PakEntry* pEntry = find_in_packs(pName, &pPack))
+	{
+		return pPack->open(*pEntry, rViewOut, kAlignment, kZeroPadding);
+	}
+	return map_file(pName, rViewOut, kAlignment, kZeroPadding);
+}
+
+void close_asset(FileView& rView)
+{
+	unmap_file(rView);
+}
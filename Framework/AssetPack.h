@@ -0,0 +1,66 @@
+#pragma once
+
+#include "CommonHeader.h"
+#include "Framework.h"
+#include "AssetPackFormat.h"
+
+class JobPool;
+
+//================================================================================
+// AssetPack
+// A mounted .pak file, see AssetPackFormat.h for the layout.
+// The whole pack is memory mapped, uncompressed entries are handed out as
+// zero-copy views into the mapping and compressed entries are decompressed
+// chunk by chunk across the job pool.
+//================================================================================
+class AssetPack
+{
+public:
+	AssetPack();
+	~AssetPack();
+
+	bool mount(const char* pFilename, JobPool* pDecompressPool);
+	void unmount();
+
+	bool is_mounted() const { return m_pHeader != nullptr; }
+	const char* filename() const { return m_filename.c_str(); }
+
+	// Binary search the index, returns null if the name is not in this pack.
+	const PakEntry* find(const char* pName) const;
+
+	// Open an entry as a view, release it with unmap_file (or close_asset).
+	bool open(const PakEntry& rEntry, FileView& rViewOut, const u32 kAlignment, const u32 kZeroPadding) const;
+
+private:
+	AssetPack(const AssetPack&) = delete;
+	AssetPack& operator=(const AssetPack&) = delete;
+
+	std::string m_filename;
+	FileView m_view;
+	JobPool* m_pDecompressPool = nullptr;
+
+	const PakHeader* m_pHeader = nullptr;
+	const PakEntry* m_pEntries = nullptr;
+	const char* m_pNames = nullptr;
+};
+
+//================================================================================
+// Virtual file access.
+// Asset loaders go through these so files can come from a mounted pack
+// or loose on disk without the caller knowing which.
+//================================================================================
+
+// Mount a pack, later mounts take priority. Returns false if the pack can't be opened.
+bool mount_asset_pack(const char* pFilename, JobPool* pDecompressPool);
+
+// Release all mounted packs.
+void unmount_asset_packs();
+
+// True if the name is found in any mounted pack.
+bool asset_in_packs(const char* pName);
+
+// Open an asset from the mounted packs, falling back to a mapped loose file.
+bool open_asset(const char* pName, FileView& rViewOut, const u32 kAlignment, const u32 kZeroPadding);
+
+// Release a view returned by open_asset.
+void close_asset(FileView& rView);
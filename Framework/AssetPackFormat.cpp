@@ -0,0 +1,252 @@
+#include "AssetPackFormat.h"
+#include "Compression.h"
+
+#include <fstream>
+
+std::string pak_normalise_name(const char* pName)
+{
+	std::string name(pName);
+	for (char& c : name)
+	{
+		if (c == '\\')
+		{
+			c = '/';
+		}
+		else if (c >= 'A' && c <= 'Z')
+		{
+			c = c - 'A' + 'a';
+		}
+	}
+
+	// Drop any leading "./"
+	while (name.size() >= 2 && name[0] == '.' && name[1] == '/')
+	{
+		name.erase(0, 2);
+	}
+	return name;
+}
+
+u64 pak_hash_name(const std::string& rNormalisedName)
+{
+	u64 hash = 14695981039346656037ull;
+	for (char c : rNormalisedName)
+	{
+		hash ^= static_cast<u8>(c);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// ========================================================
+// PakWriter
+// ========================================================
+
+static u64 align_up(u64 value, u64 alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static bool read_whole_file(const char* pPath, std::vector<u8>& rDataOut)
+{
+	std::ifstream file(pPath, std::ios::binary);
+	if (!file.good())
+	{
+		return false;
+	}
+
+	file.seekg(0, std::ios::end);
+	const u64 length = static_cast<u64>(file.tellg());
+	file.seekg(0, std::ios::beg);
+
+	rDataOut.resize(static_cast<size_t>(length));
+	if (length > 0)
+	{
+		file.read(reinterpret_cast<char*>(rDataOut.data()), length);
+	}
+	return file.good() || length == 0;
+}
+
+static void write_zeros(std::ofstream& rFile, u64 count)
+{
+	static const char zeros[4096] = {};
+	while (count > 0)
+	{
+		const u64 n = std::min<u64>(count, sizeof(zeros));
+		rFile.write(zeros, n);
+		count -= n;
+	}
+}
+
+void PakWriter::add_file(const char* pSourcePath, const char* pPackName)
+{
+	Input input;
+	input.sourcePath = pSourcePath;
+	input.name = pak_normalise_name(pPackName);
+	m_inputs.push_back(input);
+}
+
+bool PakWriter::write(const char* pOutputPath, const Options& rOptions)
+{
+	ASSERT(rOptions.chunkSize > 0);
+
+	if (rOptions.codec != kPakCodecNone && rOptions.codec != kPakCodecLZ4)
+	{
+		errorF("PakWriter : codec %u is not supported.", rOptions.codec);
+		return false;
+	}
+
+	m_stats = {};
+
+	std::ofstream file(pOutputPath, std::ios::binary | std::ios::trunc);
+	if (!file.good())
+	{
+		errorF("PakWriter : could not create %s", pOutputPath);
+		return false;
+	}
+
+	std::vector<PakEntry> entries;
+	std::vector<std::vector<PakChunk>> chunkTables;
+	std::string names;
+
+	// Header is rewritten once we know where everything is.
+	PakHeader header = {};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	u64 offset = sizeof(header);
+
+	std::vector<u8> data;
+	std::vector<u8> stored;
+	std::vector<u8> scratch(lz4_compress_bound(rOptions.chunkSize));
+
+	for (const Input& rInput : m_inputs)
+	{
+		if (!read_whole_file(rInput.sourcePath.c_str(), data))
+		{
+			errorF("PakWriter : could not read %s", rInput.sourcePath.c_str());
+			return false;
+		}
+
+		PakEntry entry = {};
+		entry.nameHash = pak_hash_name(rInput.name);
+		entry.size = data.size();
+		entry.codec = kPakCodecNone;
+		entry.nameOffset = static_cast<u32>(names.size());
+		entry.nameLength = static_cast<u32>(rInput.name.size());
+		names += rInput.name;
+
+		std::vector<PakChunk> chunks;
+
+		// Try compressing chunk by chunk.
+		if (rOptions.codec == kPakCodecLZ4 && !data.empty())
+		{
+			stored.clear();
+			for (u64 chunkStart = 0; chunkStart < data.size(); chunkStart += rOptions.chunkSize)
+			{
+				const u32 chunkSize = static_cast<u32>(std::min<u64>(rOptions.chunkSize, data.size() - chunkStart));
+				const u32 compressedSize = lz4_compress(&data[chunkStart], chunkSize, scratch.data(), static_cast<u32>(scratch.size()));
+
+				PakChunk chunk = {};
+				if (compressedSize > 0 && compressedSize < chunkSize)
+				{
+					chunk.storedSize = compressedSize;
+					stored.insert(stored.end(), scratch.begin(), scratch.begin() + compressedSize);
+				}
+				else
+				{
+					chunk.storedSize = chunkSize;
+					chunk.flags = kPakChunkRaw;
+					stored.insert(stored.end(), data.begin() + chunkStart, data.begin() + chunkStart + chunkSize);
+				}
+				chunks.push_back(chunk);
+			}
+
+			const u64 saving = data.size() - std::min<u64>(stored.size(), data.size());
+			if (saving * 100 >= data.size() * rOptions.minSavingPercent && saving > 0)
+			{
+				entry.codec = kPakCodecLZ4;
+				entry.numChunks = static_cast<u32>(chunks.size());
+			}
+			else
+			{
+				chunks.clear();
+			}
+		}
+
+		const std::vector<u8>& rPayload = entry.codec == kPakCodecNone ? data : stored;
+
+		// Entries start on an aligned boundary.
+		const u64 entryOffset = align_up(offset, kPakEntryAlignment);
+		write_zeros(file, entryOffset - offset);
+
+		entry.offset = entryOffset;
+		entry.storedSize = rPayload.size();
+		if (!rPayload.empty())
+		{
+			file.write(reinterpret_cast<const char*>(rPayload.data()), rPayload.size());
+		}
+
+		// Guarantee some zeros after every entry so mapped views can be used as padded buffers.
+		write_zeros(file, kPakTailPadding);
+		offset = entryOffset + entry.storedSize + kPakTailPadding;
+
+		m_stats.numEntries++;
+		m_stats.numCompressed += entry.codec != kPakCodecNone ? 1 : 0;
+		m_stats.totalSize += entry.size;
+		m_stats.totalStored += entry.storedSize;
+
+		entries.push_back(entry);
+		chunkTables.push_back(chunks);
+	}
+
+	// Chunk tables.
+	write_zeros(file, align_up(offset, 8) - offset);
+	offset = align_up(offset, 8);
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		if (chunkTables[i].empty())
+		{
+			continue;
+		}
+		entries[i].chunkTableOffset = offset;
+		const u64 tableBytes = chunkTables[i].size() * sizeof(PakChunk);
+		file.write(reinterpret_cast<const char*>(chunkTables[i].data()), tableBytes);
+		offset += tableBytes;
+	}
+
+	// Names.
+	header.namesOffset = offset;
+	file.write(names.data(), names.size());
+	offset += names.size();
+
+	// Sorted index.
+	std::sort(entries.begin(), entries.end(), [](const PakEntry& a, const PakEntry& b) { return a.nameHash < b.nameHash; });
+	for (size_t i = 1; i < entries.size(); ++i)
+	{
+		if (entries[i].nameHash == entries[i - 1].nameHash)
+		{
+			const std::string nameA = names.substr(entries[i - 1].nameOffset, entries[i - 1].nameLength);
+			const std::string nameB = names.substr(entries[i].nameOffset, entries[i].nameLength);
+			errorF("PakWriter : duplicate or colliding names '%s' and '%s'", nameA.c_str(), nameB.c_str());
+			return false;
+		}
+	}
+
+	write_zeros(file, align_up(offset, 8) - offset);
+	offset = align_up(offset, 8);
+	header.indexOffset = offset;
+	file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(PakEntry));
+
+	// Now fill in the header.
+	header.magic = kPakMagic;
+	header.version = kPakVersion;
+	header.numEntries = static_cast<u32>(entries.size());
+	header.chunkSize = rOptions.chunkSize;
+	file.seekp(0, std::ios::beg);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	if (!file.good())
+	{
+		errorF("PakWriter : failed writing %s", pOutputPath);
+		return false;
+	}
+	return true;
+}
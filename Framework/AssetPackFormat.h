@@ -0,0 +1,118 @@
+#pragma once
+
+#include "CoreTypes.h"
+
+#include <string>
+#include <vector>
+
+//================================================================================
+// Asset pack (.pak) file format.
+// Platform independent so the packer tool builds anywhere.
+//
+// Layout:
+//   PakHeader
+//   entry data, each entry starts on a kPakEntryAlignment boundary and is
+//   followed by at least kPakTailPadding zero bytes.
+//   chunk tables for compressed entries
+//   name strings
+//   PakEntry index, sorted by name hash for binary search.
+//
+// Compressed entries are split into independent chunks of PakHeader::chunkSize
+// uncompressed bytes so they can be decompressed in parallel.
+//================================================================================
+
+constexpr u32 kPakMagic = 0x314B4150; // 'PAK1'
+constexpr u32 kPakVersion = 1;
+constexpr u32 kPakEntryAlignment = 4 * 1024;
+constexpr u32 kPakTailPadding = 64;
+constexpr u32 kPakDefaultChunkSize = 64 * 1024;
+
+enum PakCodec : u32
+{
+	kPakCodecNone = 0,
+	kPakCodecLZ4 = 1,
+	kPakCodecZstd = 2, // Reserved, no decoder is built in.
+};
+
+struct PakHeader
+{
+	u32 magic;
+	u32 version;
+	u32 numEntries;
+	u32 chunkSize;
+	u64 indexOffset;
+	u64 namesOffset;
+};
+
+struct PakEntry
+{
+	u64 nameHash;
+	u64 offset;				// Start of the stored data.
+	u64 size;				// Uncompressed size.
+	u64 storedSize;			// Bytes used in the pak.
+	u64 chunkTableOffset;	// PakChunk[numChunks] for compressed entries.
+	u32 numChunks;
+	u32 codec;				// PakCodec
+	u32 nameOffset;			// Offset into the name block, used to check for hash collisions.
+	u32 nameLength;
+};
+
+// Stored size of each chunk, the chunk offsets are the running sum from PakEntry::offset.
+// Chunks that did not compress are stored raw and flagged.
+struct PakChunk
+{
+	u32 storedSize;
+	u32 flags;
+};
+
+constexpr u32 kPakChunkRaw = 1;
+
+static_assert(sizeof(PakHeader) == 32, "PakHeader layout changed");
+static_assert(sizeof(PakEntry) == 56, "PakEntry layout changed");
+static_assert(sizeof(PakChunk) == 8, "PakChunk layout changed");
+
+// Names are stored lower case with forward slashes so lookups match
+// regardless of how the path was spelled on disk.
+std::string pak_normalise_name(const char* pName);
+
+// FNV-1a hash of a normalised name.
+u64 pak_hash_name(const std::string& rNormalisedName);
+
+//================================================================================
+// PakWriter
+// Builds a pack file from a list of files.
+//================================================================================
+class PakWriter
+{
+public:
+	struct Options
+	{
+		PakCodec codec = kPakCodecNone;
+		u32 chunkSize = kPakDefaultChunkSize;
+		u32 minSavingPercent = 5; // Store raw if compression saves less than this.
+	};
+
+	// Add a file to the pack. pSourcePath is read from disk, pPackName is the lookup name.
+	void add_file(const char* pSourcePath, const char* pPackName);
+
+	// Write the pack, returns false on any error (reported with errorF).
+	bool write(const char* pOutputPath, const Options& rOptions);
+
+	struct Stats
+	{
+		u32 numEntries;
+		u32 numCompressed;
+		u64 totalSize;
+		u64 totalStored;
+	};
+	const Stats& stats() const { return m_stats; }
+
+private:
+	struct Input
+	{
+		std::string sourcePath;
+		std::string name;
+	};
+	std::vector<Input> m_inputs;
+	Stats m_stats = {};
+};
@@ -0,0 +1,254 @@
+#include "BindingTable.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Stands for "unknown" in the bound arrays, never a real object.
+template<typename T>
+static T* unknown_binding()
+{
+	return reinterpret_cast<T*>(~uintptr_t(0));
+}
+
+// ========================================================
+// RecordingBindingDevice
+// ========================================================
+
+RecordingBindingDevice::RecordingBindingDevice()
+{
+	memset(m_bound, 0, sizeof(m_bound));
+}
+
+void RecordingBindingDevice::set_shader_resources(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11ShaderResourceView* const* ppViews)
+{
+	record(kShaderResource, stage, startSlot, count, reinterpret_cast<const void* const*>(ppViews));
+}
+
+void RecordingBindingDevice::set_samplers(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11SamplerState* const* ppSamplers)
+{
+	record(kSampler, stage, startSlot, count, reinterpret_cast<const void* const*>(ppSamplers));
+}
+
+void RecordingBindingDevice::set_constant_buffers(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11Buffer* const* ppBuffers)
+{
+	record(kConstantBuffer, stage, startSlot, count, reinterpret_cast<const void* const*>(ppBuffers));
+}
+
+void RecordingBindingDevice::record(Kind kind, ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, const void* const* ppObjects)
+{
+	ASSERT(startSlot + count <= kMaxSlots);
+
+	memcpy(&m_bound[kind][stage][startSlot], ppObjects, count * sizeof(void*));
+	m_calls.push_back({ kind, stage, startSlot, count });
+}
+
+u32 RecordingBindingDevice::num_calls(Kind kind) const
+{
+	u32 count = 0;
+	for (const Call& rCall : m_calls)
+	{
+		count += rCall.kind == kind ? 1 : 0;
+	}
+	return count;
+}
+
+// ========================================================
+// BindingTable
+// ========================================================
+
+BindingTable::BindingTable()
+{
+	// Nothing has been set, and the device starts with everything unbound.
+	memset(m_views, 0, sizeof(m_views));
+	memset(m_samplers, 0, sizeof(m_samplers));
+	memset(m_buffers, 0, sizeof(m_buffers));
+}
+
+void BindingTable::init(BindingDevice* pDevice)
+{
+	m_pDevice = pDevice;
+}
+
+template<typename T, u32 kSlots>
+void BindingTable::set_range(SlotRange<T, kSlots>& rRange, u32 startSlot, u32 count, T* const* ppObjects)
+{
+	ASSERT(startSlot + count <= kSlots);
+
+	m_stats.bindsRequested += count;
+	for (u32 i = 0; i < count; ++i)
+	{
+		const u32 slot = startSlot + i;
+		rRange.pending[slot] = ppObjects[i];
+		m_stats.bindsSkipped += ppObjects[i] == rRange.bound[slot] ? 1 : 0;
+	}
+
+	if (rRange.dirtyBegin == rRange.dirtyEnd)
+	{
+		rRange.dirtyBegin = startSlot;
+		rRange.dirtyEnd = startSlot + count;
+	}
+	else
+	{
+		rRange.dirtyBegin = std::min(rRange.dirtyBegin, startSlot);
+		rRange.dirtyEnd = std::max(rRange.dirtyEnd, startSlot + count);
+	}
+	rRange.used = std::max(rRange.used, startSlot + count);
+}
+
+template<typename T, u32 kSlots>
+bool BindingTable::take_dirty(SlotRange<T, kSlots>& rRange, u32& rBegin, u32& rEnd)
+{
+	u32 begin = rRange.dirtyBegin;
+	u32 end = rRange.dirtyEnd;
+	rRange.dirtyBegin = rRange.dirtyEnd = 0;
+
+	// Trim slots that ended up holding what is already bound.
+	while (begin < end && rRange.pending[begin] == rRange.bound[begin])
+	{
+		++begin;
+	}
+	while (end > begin && rRange.pending[end - 1] == rRange.bound[end - 1])
+	{
+		--end;
+	}
+	if (begin == end)
+	{
+		return false;
+	}
+
+	memcpy(&rRange.bound[begin], &rRange.pending[begin], (end - begin) * sizeof(T*));
+	rBegin = begin;
+	rEnd = end;
+	return true;
+}
+
+template<typename T, u32 kSlots>
+void BindingTable::invalidate_range(SlotRange<T, kSlots>& rRange)
+{
+	for (u32 slot = 0; slot < rRange.used; ++slot)
+	{
+		rRange.bound[slot] = unknown_binding<T>();
+	}
+	rRange.dirtyBegin = 0;
+	rRange.dirtyEnd = rRange.used;
+}
+
+void BindingTable::set_shader_resource(ShaderStage::ShaderStageEnum stage, u32 slot, ID3D11ShaderResourceView* pView)
+{
+	set_range(m_views[stage], slot, 1, &pView);
+}
+
+void BindingTable::set_shader_resources(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11ShaderResourceView* const* ppViews)
+{
+	set_range(m_views[stage], startSlot, count, ppViews);
+}
+
+void BindingTable::set_sampler(ShaderStage::ShaderStageEnum stage, u32 slot, ID3D11SamplerState* pSampler)
+{
+	set_range(m_samplers[stage], slot, 1, &pSampler);
+}
+
+void BindingTable::set_samplers(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11SamplerState* const* ppSamplers)
+{
+	set_range(m_samplers[stage], startSlot, count, ppSamplers);
+}
+
+void BindingTable::set_constant_buffer(ShaderStage::ShaderStageEnum stage, u32 slot, ID3D11Buffer* pBuffer)
+{
+	set_range(m_buffers[stage], slot, 1, &pBuffer);
+}
+
+void BindingTable::set_constant_buffers(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11Buffer* const* ppBuffers)
+{
+	set_range(m_buffers[stage], startSlot, count, ppBuffers);
+}
+
+void BindingTable::flush()
+{
+	ASSERT(m_pDevice);
+
+	for (u32 i = 0; i < ShaderStage::kMaxStages; ++i)
+	{
+		const ShaderStage::ShaderStageEnum stage = static_cast<ShaderStage::ShaderStageEnum>(i);
+		u32 begin, end;
+
+		if (take_dirty(m_views[i], begin, end))
+		{
+			m_pDevice->set_shader_resources(stage, begin, end - begin, &m_views[i].pending[begin]);
+			++m_stats.calls;
+			m_stats.slotsWritten += end - begin;
+		}
+		if (take_dirty(m_samplers[i], begin, end))
+		{
+			m_pDevice->set_samplers(stage, begin, end - begin, &m_samplers[i].pending[begin]);
+			++m_stats.calls;
+			m_stats.slotsWritten += end - begin;
+		}
+		if (take_dirty(m_buffers[i], begin, end))
+		{
+			m_pDevice->set_constant_buffers(stage, begin, end - begin, &m_buffers[i].pending[begin]);
+			++m_stats.calls;
+			m_stats.slotsWritten += end - begin;
+		}
+	}
+}
+
+void BindingTable::invalidate()
+{
+	for (u32 i = 0; i < ShaderStage::kMaxStages; ++i)
+	{
+		invalidate_range(m_views[i]);
+		invalidate_range(m_samplers[i]);
+		invalidate_range(m_buffers[i]);
+	}
+}
+
+#if defined(_WIN32)
+
+// ========================================================
+// D3D11BindingDevice
+// ========================================================
+
+void D3D11BindingDevice::set_shader_resources(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11ShaderResourceView* const* ppViews)
+{
+	switch (stage)
+	{
+	case ShaderStage::kVertex:   m_pContext->VSSetShaderResources(startSlot, count, ppViews); break;
+	case ShaderStage::kHull:     m_pContext->HSSetShaderResources(startSlot, count, ppViews); break;
+	case ShaderStage::kDomain:   m_pContext->DSSetShaderResources(startSlot, count, ppViews); break;
+	case ShaderStage::kGeometry: m_pContext->GSSetShaderResources(startSlot, count, ppViews); break;
+	case ShaderStage::kPixel:    m_pContext->PSSetShaderResources(startSlot, count, ppViews); break;
+	case ShaderStage::kCompute:  m_pContext->CSSetShaderResources(startSlot, count, ppViews); break;
+	default: break;
+	}
+}
+
+void D3D11BindingDevice::set_samplers(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11SamplerState* const* ppSamplers)
+{
+	switch (stage)
+	{
+	case ShaderStage::kVertex:   m_pContext->VSSetSamplers(startSlot, count, ppSamplers); break;
+	case ShaderStage::kHull:     m_pContext->HSSetSamplers(startSlot, count, ppSamplers); break;
+	case ShaderStage::kDomain:   m_pContext->DSSetSamplers(startSlot, count, ppSamplers); break;
+	case ShaderStage::kGeometry: m_pContext->GSSetSamplers(startSlot, count, ppSamplers); break;
+	case ShaderStage::kPixel:    m_pContext->PSSetSamplers(startSlot, count, ppSamplers); break;
+	case ShaderStage::kCompute:  m_pContext->CSSetSamplers(startSlot, count, ppSamplers); break;
+	default: break;
+	}
+}
+
+void D3D11BindingDevice::set_constant_buffers(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11Buffer* const* ppBuffers)
+{
+	switch (stage)
+	{
+	case ShaderStage::kVertex:   m_pContext->VSSetConstantBuffers(startSlot, count, ppBuffers); break;
+	case ShaderStage::kHull:     m_pContext->HSSetConstantBuffers(startSlot, count, ppBuffers); break;
+	case ShaderStage::kDomain:   m_pContext->DSSetConstantBuffers(startSlot, count, ppBuffers); break;
+	case ShaderStage::kGeometry: m_pContext->GSSetConstantBuffers(startSlot, count, ppBuffers); break;
+	case ShaderStage::kPixel:    m_pContext->PSSetConstantBuffers(startSlot, count, ppBuffers); break;
+	case ShaderStage::kCompute:  m_pContext->CSSetConstantBuffers(startSlot, count, ppBuffers); break;
+	default: break;
+	}
+}
+
+#endif
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "CoreTypes.h"
+#include "ShaderStage.h"
+
+#include <vector>
+
+// Only pointers to these are used here.
+struct ID3D11ShaderResourceView;
+struct ID3D11SamplerState;
+struct ID3D11Buffer;
+struct ID3D11DeviceContext;
+
+// ========================================================
+// BindingDevice
+// Where a BindingTable sends its ranged bind calls.
+// D3D11BindingDevice forwards to a device context,
+// RecordingBindingDevice counts calls so they can be checked
+// without a GPU. Platform independent apart from the D3D11 device.
+// ========================================================
+class BindingDevice
+{
+public:
+	virtual ~BindingDevice() {}
+
+	virtual void set_shader_resources(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11ShaderResourceView* const* ppViews) = 0;
+	virtual void set_samplers(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11SamplerState* const* ppSamplers) = 0;
+	virtual void set_constant_buffers(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11Buffer* const* ppBuffers) = 0;
+};
+
+// Stand-in device that keeps what would be bound and counts the calls.
+class RecordingBindingDevice : public BindingDevice
+{
+public:
+	enum Kind
+	{
+		kShaderResource,
+		kSampler,
+		kConstantBuffer,
+
+		kNumKinds
+	};
+
+	struct Call
+	{
+		Kind kind;
+		ShaderStage::ShaderStageEnum stage;
+		u32 startSlot;
+		u32 count;
+	};
+
+	static const u32 kMaxSlots = 128;	// D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT
+
+	RecordingBindingDevice();
+
+	void set_shader_resources(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11ShaderResourceView* const* ppViews) override;
+	void set_samplers(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11SamplerState* const* ppSamplers) override;
+	void set_constant_buffers(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11Buffer* const* ppBuffers) override;
+
+	// What a shader in the stage would see.
+	const void* bound(Kind kind, ShaderStage::ShaderStageEnum stage, u32 slot) const { return m_bound[kind][stage][slot]; }
+
+	// Calls since the last clear_calls(), e.g. one frame.
+	const std::vector<Call>& calls() const { return m_calls; }
+	u32 num_calls(Kind kind) const;
+	void clear_calls() { m_calls.clear(); }
+
+private:
+	void record(Kind kind, ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, const void* const* ppObjects);
+
+	const void* m_bound[kNumKinds][ShaderStage::kMaxStages][kMaxSlots];
+	std::vector<Call> m_calls;
+};
+
+// ========================================================
+// BindingTable
+// Collects shader resources, samplers and constant buffers per stage
+// and applies them in flush(), with one ranged call per stage and kind.
+// Slots that already hold the same object are not sent again, so
+// binding the same texture before every draw costs nothing.
+//
+// Anything that binds behind the table's back (debug draw, ClearState,
+// a render target that unbinds its SRV) must be followed by invalidate().
+// ========================================================
+class BindingTable
+{
+public:
+	static const u32 kMaxShaderResources = 32;
+	static const u32 kMaxSamplers = 16;			// D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT
+	static const u32 kMaxConstantBuffers = 14;	// D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT
+
+	struct Stats
+	{
+		u32 calls;			// Ranged *Set* calls issued.
+		u32 slotsWritten;	// Slots covered by those calls.
+		u32 bindsRequested;	// set_* slots asked for.
+		u32 bindsSkipped;	// Requested slots that were already bound.
+	};
+
+	BindingTable();
+
+	void init(BindingDevice* pDevice);
+
+	void set_shader_resource(ShaderStage::ShaderStageEnum stage, u32 slot, ID3D11ShaderResourceView* pView);
+	void set_shader_resources(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11ShaderResourceView* const* ppViews);
+	void set_sampler(ShaderStage::ShaderStageEnum stage, u32 slot, ID3D11SamplerState* pSampler);
+	void set_samplers(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11SamplerState* const* ppSamplers);
+	void set_constant_buffer(ShaderStage::ShaderStageEnum stage, u32 slot, ID3D11Buffer* pBuffer);
+	void set_constant_buffers(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11Buffer* const* ppBuffers);
+
+	// Send everything that changed since the last flush, call before each draw or dispatch.
+	void flush();
+
+	// Forget what the device holds, every slot that was ever set is sent again on the next flush.
+	void invalidate();
+
+	Stats stats() const { return m_stats; }
+	void reset_stats() { m_stats = {}; }
+
+private:
+	// Wanted and bound objects of one kind in one stage.
+	template<typename T, u32 kSlots>
+	struct SlotRange
+	{
+		T* pending[kSlots];
+		T* bound[kSlots];
+		u32 dirtyBegin;
+		u32 dirtyEnd;
+		u32 used;			// One past the highest slot ever set.
+	};
+
+	template<typename T, u32 kSlots>
+	void set_range(SlotRange<T, kSlots>& rRange, u32 startSlot, u32 count, T* const* ppObjects);
+
+	// Returns the slots to send as [begin, end), empty if nothing changed.
+	template<typename T, u32 kSlots>
+	bool take_dirty(SlotRange<T, kSlots>& rRange, u32& rBegin, u32& rEnd);
+
+	template<typename T, u32 kSlots>
+	void invalidate_range(SlotRange<T, kSlots>& rRange);
+
+	BindingDevice* m_pDevice = nullptr;
+	SlotRange<ID3D11ShaderResourceView, kMaxShaderResources> m_views[ShaderStage::kMaxStages];
+	SlotRange<ID3D11SamplerState, kMaxSamplers> m_samplers[ShaderStage::kMaxStages];
+	SlotRange<ID3D11Buffer, kMaxConstantBuffers> m_buffers[ShaderStage::kMaxStages];
+	Stats m_stats = {};
+};
+
+#if defined(_WIN32)
+
+#include <d3d11.h>
+
+// Sends the ranged calls to a device context.
+class D3D11BindingDevice : public BindingDevice
+{
+public:
+	explicit D3D11BindingDevice(ID3D11DeviceContext* pContext = nullptr) : m_pContext(pContext) {}
+
+	void set_context(ID3D11DeviceContext* pContext) { m_pContext = pContext; }
+
+	void set_shader_resources(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11ShaderResourceView* const* ppViews) override;
+	void set_samplers(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11SamplerState* const* ppSamplers) override;
+	void set_constant_buffers(ShaderStage::ShaderStageEnum stage, u32 startSlot, u32 count, ID3D11Buffer* const* ppBuffers) override;
+
+private:
+	ID3D11DeviceContext* m_pContext;
+};
+
+static_assert(RecordingBindingDevice::kMaxSlots == D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT, "Slot counts must match D3D11");
+static_assert(BindingTable::kMaxSamplers == D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT, "Slot counts must match D3D11");
+static_assert(BindingTable::kMaxConstantBuffers == D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, "Slot counts must match D3D11");
+
+#endif
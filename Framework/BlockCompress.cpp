@@ -0,0 +1,1066 @@
+#include "BlockCompress.h"
+#include "JobQueue.h"
+
+#include <cstdlib>
+#include <mutex>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+	#define BC_USE_SSE 1
+	#include <emmintrin.h>
+#else
+	#define BC_USE_SSE 0
+#endif
+
+// ========================================================
+// Four lane float maths.
+// Blocks are stored as channel planes so one register holds
+// the same channel of four pixels.
+// ========================================================
+
+#if BC_USE_SSE
+
+struct F4
+{
+	__m128 v;
+};
+
+static inline F4 f4_set1(f32 a) { return { _mm_set1_ps(a) }; }
+static inline F4 f4_load(const f32* p) { return { _mm_load_ps(p) }; }
+static inline void f4_store(f32* p, F4 a) { _mm_store_ps(p, a.v); }
+static inline F4 f4_add(F4 a, F4 b) { return { _mm_add_ps(a.v, b.v) }; }
+static inline F4 f4_sub(F4 a, F4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+static inline F4 f4_mul(F4 a, F4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+static inline F4 f4_min(F4 a, F4 b) { return { _mm_min_ps(a.v, b.v) }; }
+static inline F4 f4_max(F4 a, F4 b) { return { _mm_max_ps(a.v, b.v) }; }
+static inline F4 f4_less(F4 a, F4 b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+
+// mask ? a : b
+static inline F4 f4_select(F4 mask, F4 a, F4 b) { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+
+#else
+
+struct F4
+{
+	f32 v[4];
+};
+
+static inline F4 f4_set1(f32 a) { return { { a, a, a, a } }; }
+static inline F4 f4_load(const f32* p) { return { { p[0], p[1], p[2], p[3] } }; }
+static inline void f4_store(f32* p, F4 a) { p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; p[3] = a.v[3]; }
+static inline F4 f4_add(F4 a, F4 b) { return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; }
+static inline F4 f4_sub(F4 a, F4 b) { return { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } }; }
+static inline F4 f4_mul(F4 a, F4 b) { return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }; }
+static inline F4 f4_min(F4 a, F4 b) { return { { std::min(a.v[0], b.v[0]), std::min(a.v[1], b.v[1]), std::min(a.v[2], b.v[2]), std::min(a.v[3], b.v[3]) } }; }
+static inline F4 f4_max(F4 a, F4 b) { return { { std::max(a.v[0], b.v[0]), std::max(a.v[1], b.v[1]), std::max(a.v[2], b.v[2]), std::max(a.v[3], b.v[3]) } }; }
+static inline F4 f4_less(F4 a, F4 b) { return { { a.v[0] < b.v[0] ? 1.0f : 0.0f, a.v[1] < b.v[1] ? 1.0f : 0.0f, a.v[2] < b.v[2] ? 1.0f : 0.0f, a.v[3] < b.v[3] ? 1.0f : 0.0f } }; }
+
+static inline F4 f4_select(F4 mask, F4 a, F4 b)
+{
+	return { { mask.v[0] != 0.0f ? a.v[0] : b.v[0], mask.v[1] != 0.0f ? a.v[1] : b.v[1],
+		mask.v[2] != 0.0f ? a.v[2] : b.v[2], mask.v[3] != 0.0f ? a.v[3] : b.v[3] } };
+}
+
+#endif
+
+static inline f32 f4_sum(F4 a)
+{
+	alignas(16) f32 lanes[4];
+	f4_store(lanes, a);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+// ========================================================
+// Blocks.
+// ========================================================
+
+struct Block
+{
+	alignas(16) f32 channel[4][16];	// RGBA planes, 0..255.
+};
+
+// An RGBA palette, unused channels are ignored.
+struct Palette
+{
+	f32 entry[16][4];
+	u32 numEntries;
+};
+
+// Load a 4x4 block, clamping reads at the right and bottom edges.
+static void gather_block(const TextureSubresource& rSrc, u32 slice, u32 blockX, u32 blockY, bool bBgra, bool bOpaque, Block& rOut)
+{
+	const memtype_t* pSlice = rSrc.pData + static_cast<u64>(slice) * rSrc.slicePitch;
+	const u32 red = bBgra ? 2 : 0;
+	const u32 blue = bBgra ? 0 : 2;
+
+	for (u32 y = 0; y < 4; ++y)
+	{
+		const u32 sy = std::min(blockY * 4 + y, rSrc.height - 1);
+		const memtype_t* pRow = pSlice + static_cast<u64>(sy) * rSrc.rowPitch;
+		for (u32 x = 0; x < 4; ++x)
+		{
+			const memtype_t* pPixel = pRow + std::min(blockX * 4 + x, rSrc.width - 1) * 4;
+			const u32 i = y * 4 + x;
+			rOut.channel[0][i] = pPixel[red];
+			rOut.channel[1][i] = pPixel[1];
+			rOut.channel[2][i] = pPixel[blue];
+			rOut.channel[3][i] = bOpaque ? 255.0f : pPixel[3];
+		}
+	}
+}
+
+// Pick the nearest palette entry for each pixel over channels [first, first + count).
+// Returns the total squared error.
+static f32 fit_indices(const Block& rBlock, u32 first, u32 count, const Palette& rPalette, u8* pIndicesOut)
+{
+	f32 total = 0.0f;
+	for (u32 group = 0; group < 16; group += 4)
+	{
+		F4 pixel[4];
+		for (u32 c = 0; c < count; ++c)
+		{
+			pixel[c] = f4_load(&rBlock.channel[first + c][group]);
+		}
+
+		F4 bestError = f4_set1(1e30f);
+		F4 bestIndex = f4_set1(0.0f);
+		for (u32 e = 0; e < rPalette.numEntries; ++e)
+		{
+			F4 error = f4_set1(0.0f);
+			for (u32 c = 0; c < count; ++c)
+			{
+				const F4 d = f4_sub(pixel[c], f4_set1(rPalette.entry[e][first + c]));
+				error = f4_add(error, f4_mul(d, d));
+			}
+			const F4 better = f4_less(error, bestError);
+			bestError = f4_select(better, error, bestError);
+			bestIndex = f4_select(better, f4_set1(static_cast<f32>(e)), bestIndex);
+		}
+
+		alignas(16) f32 indices[4];
+		f4_store(indices, bestIndex);
+		for (u32 i = 0; i < 4; ++i)
+		{
+			pIndicesOut[group + i] = static_cast<u8>(indices[i]);
+		}
+		total += f4_sum(bestError);
+	}
+	return total;
+}
+
+// Endpoints at either end of the principal axis of the block's colours.
+static void principal_endpoints(const Block& rBlock, u32 first, u32 count, f32* pLowOut, f32* pHighOut)
+{
+	f32 mean[4] = {};
+	f32 axis[4] = {};
+	for (u32 c = 0; c < count; ++c)
+	{
+		const F4 a = f4_load(&rBlock.channel[first + c][0]);
+		const F4 b = f4_load(&rBlock.channel[first + c][4]);
+		const F4 d = f4_load(&rBlock.channel[first + c][8]);
+		const F4 e = f4_load(&rBlock.channel[first + c][12]);
+		mean[c] = f4_sum(f4_add(f4_add(a, b), f4_add(d, e))) / 16.0f;
+
+		// The extent makes a good starting guess for the power iteration.
+		alignas(16) f32 lo[4];
+		alignas(16) f32 hi[4];
+		f4_store(lo, f4_min(f4_min(a, b), f4_min(d, e)));
+		f4_store(hi, f4_max(f4_max(a, b), f4_max(d, e)));
+		axis[c] = std::max(std::max(hi[0], hi[1]), std::max(hi[2], hi[3])) - std::min(std::min(lo[0], lo[1]), std::min(lo[2], lo[3]));
+	}
+
+	// Covariance, upper triangle mirrored.
+	f32 cov[4][4] = {};
+	F4 centred[4][4];
+	for (u32 c = 0; c < count; ++c)
+	{
+		for (u32 g = 0; g < 4; ++g)
+		{
+			centred[c][g] = f4_sub(f4_load(&rBlock.channel[first + c][g * 4]), f4_set1(mean[c]));
+		}
+	}
+	for (u32 i = 0; i < count; ++i)
+	{
+		for (u32 j = i; j < count; ++j)
+		{
+			F4 sum = f4_set1(0.0f);
+			for (u32 g = 0; g < 4; ++g)
+			{
+				sum = f4_add(sum, f4_mul(centred[i][g], centred[j][g]));
+			}
+			cov[i][j] = cov[j][i] = f4_sum(sum);
+		}
+	}
+
+	for (u32 iteration = 0; iteration < 8; ++iteration)
+	{
+		f32 next[4] = {};
+		f32 length = 0.0f;
+		for (u32 i = 0; i < count; ++i)
+		{
+			for (u32 j = 0; j < count; ++j)
+			{
+				next[i] += cov[i][j] * axis[j];
+			}
+			length = std::max(length, fabsf(next[i]));
+		}
+		if (length < 1e-6f)
+		{
+			break;
+		}
+		for (u32 i = 0; i < count; ++i)
+		{
+			axis[i] = next[i] / length;
+		}
+	}
+
+	f32 axisLengthSq = 0.0f;
+	for (u32 c = 0; c < count; ++c)
+	{
+		axisLengthSq += axis[c] * axis[c];
+	}
+
+	// Flat block, both ends sit on the mean.
+	if (axisLengthSq < 1e-12f)
+	{
+		for (u32 c = 0; c < count; ++c)
+		{
+			pLowOut[c] = pHighOut[c] = mean[c];
+		}
+		return;
+	}
+
+	F4 tMin = f4_set1(1e30f);
+	F4 tMax = f4_set1(-1e30f);
+	for (u32 g = 0; g < 4; ++g)
+	{
+		F4 t = f4_set1(0.0f);
+		for (u32 c = 0; c < count; ++c)
+		{
+			t = f4_add(t, f4_mul(centred[c][g], f4_set1(axis[c] / axisLengthSq)));
+		}
+		tMin = f4_min(tMin, t);
+		tMax = f4_max(tMax, t);
+	}
+
+	alignas(16) f32 lo[4];
+	alignas(16) f32 hi[4];
+	f4_store(lo, tMin);
+	f4_store(hi, tMax);
+	const f32 low = std::min(std::min(lo[0], lo[1]), std::min(lo[2], lo[3]));
+	const f32 high = std::max(std::max(hi[0], hi[1]), std::max(hi[2], hi[3]));
+
+	for (u32 c = 0; c < count; ++c)
+	{
+		pLowOut[c] = mean[c] + axis[c] * low;
+		pHighOut[c] = mean[c] + axis[c] * high;
+	}
+}
+
+// Least squares endpoints for fixed indices, weights[i] is how far entry i is from a towards b.
+// Returns false when the indices don't constrain both ends.
+static bool refine_endpoints(const Block& rBlock, u32 first, u32 count, const u8* pIndices, const f32* pWeights, f32* pAOut, f32* pBOut)
+{
+	f32 aa = 0.0f;
+	f32 ab = 0.0f;
+	f32 bb = 0.0f;
+	f32 xa[4] = {};
+	f32 xb[4] = {};
+	for (u32 i = 0; i < 16; ++i)
+	{
+		const f32 wb = pWeights[pIndices[i]];
+		const f32 wa = 1.0f - wb;
+		aa += wa * wa;
+		ab += wa * wb;
+		bb += wb * wb;
+		for (u32 c = 0; c < count; ++c)
+		{
+			xa[c] += wa * rBlock.channel[first + c][i];
+			xb[c] += wb * rBlock.channel[first + c][i];
+		}
+	}
+
+	const f32 det = aa * bb - ab * ab;
+	if (fabsf(det) < 1e-6f)
+	{
+		return false;
+	}
+
+	for (u32 c = 0; c < count; ++c)
+	{
+		pAOut[c] = std::min(std::max((bb * xa[c] - ab * xb[c]) / det, 0.0f), 255.0f);
+		pBOut[c] = std::min(std::max((aa * xb[c] - ab * xa[c]) / det, 0.0f), 255.0f);
+	}
+	return true;
+}
+
+static inline u32 quantise(f32 value, u32 maxValue)
+{
+	const f32 scaled = value * maxValue / 255.0f + 0.5f;
+	return static_cast<u32>(std::min(std::max(scaled, 0.0f), static_cast<f32>(maxValue)));
+}
+
+// ========================================================
+// BC1.
+// ========================================================
+
+static inline u32 expand5(u32 v) { return (v << 3) | (v >> 2); }
+static inline u32 expand6(u32 v) { return (v << 2) | (v >> 4); }
+static inline u32 bc1_lerp(u32 a, u32 b) { return (2 * a + b + 1) / 3; }
+
+// Endpoint pairs whose 1/3 point best matches each 8 bit value, so flat
+// blocks come out exact instead of snapping to the nearest 565 colour.
+struct SingleColourTables
+{
+	u8 pair5[256][2];
+	u8 pair6[256][2];
+
+	SingleColourTables()
+	{
+		build(pair5, 31, expand5);
+		build(pair6, 63, expand6);
+	}
+
+	static void build(u8 (*pTable)[2], u32 maxValue, u32 (*expand)(u32))
+	{
+		for (u32 v = 0; v < 256; ++v)
+		{
+			s32 bestError = 256;
+			for (u32 a = 0; a <= maxValue; ++a)
+			{
+				for (u32 b = 0; b <= maxValue; ++b)
+				{
+					const s32 error = std::abs(static_cast<s32>(bc1_lerp(expand(a), expand(b))) - static_cast<s32>(v));
+					if (error < bestError)
+					{
+						bestError = error;
+						pTable[v][0] = static_cast<u8>(a);
+						pTable[v][1] = static_cast<u8>(b);
+					}
+				}
+			}
+		}
+	}
+};
+
+static const SingleColourTables& single_colour_tables()
+{
+	static const SingleColourTables s_tables;
+	return s_tables;
+}
+
+static inline u16 pack565(u32 r, u32 g, u32 b) { return static_cast<u16>((r << 11) | (g << 5) | b); }
+
+static void bc1_palette(u16 c0, u16 c1, Palette& rOut)
+{
+	const u32 e0[3] = { expand5(c0 >> 11), expand6((c0 >> 5) & 63), expand5(c0 & 31) };
+	const u32 e1[3] = { expand5(c1 >> 11), expand6((c1 >> 5) & 63), expand5(c1 & 31) };
+
+	for (u32 c = 0; c < 3; ++c)
+	{
+		rOut.entry[0][c] = static_cast<f32>(e0[c]);
+		rOut.entry[1][c] = static_cast<f32>(e1[c]);
+		if (c0 > c1)
+		{
+			rOut.entry[2][c] = static_cast<f32>(bc1_lerp(e0[c], e1[c]));
+			rOut.entry[3][c] = static_cast<f32>(bc1_lerp(e1[c], e0[c]));
+		}
+		else
+		{
+			rOut.entry[2][c] = static_cast<f32>((e0[c] + e1[c]) / 2);
+			rOut.entry[3][c] = 0.0f;
+		}
+	}
+	for (u32 e = 0; e < 4; ++e)
+	{
+		rOut.entry[e][3] = 255.0f;
+	}
+	rOut.numEntries = 4;
+}
+
+static void bc1_write(u16 c0, u16 c1, const u8* pIndices, memtype_t* pOut)
+{
+	// The four colour mode needs c0 > c1.
+	u8 indices[16];
+	if (c0 < c1)
+	{
+		static const u8 s_swap[4] = { 1, 0, 3, 2 };
+		std::swap(c0, c1);
+		for (u32 i = 0; i < 16; ++i)
+		{
+			indices[i] = s_swap[pIndices[i]];
+		}
+	}
+	else if (c0 == c1)
+	{
+		memset(indices, 0, sizeof(indices));
+	}
+	else
+	{
+		memcpy(indices, pIndices, sizeof(indices));
+	}
+
+	u32 bits = 0;
+	for (u32 i = 0; i < 16; ++i)
+	{
+		bits |= static_cast<u32>(indices[i]) << (i * 2);
+	}
+	memcpy(pOut + 0, &c0, 2);
+	memcpy(pOut + 2, &c1, 2);
+	memcpy(pOut + 4, &bits, 4);
+}
+
+static void bc1_encode(const Block& rBlock, memtype_t* pOut)
+{
+	f32 low[4];
+	f32 high[4];
+	principal_endpoints(rBlock, 0, 3, low, high);
+
+	u8 indices[16];
+	Palette palette;
+
+	bool bFlat = true;
+	for (u32 c = 0; c < 3 && bFlat; ++c)
+	{
+		for (u32 i = 1; i < 16 && bFlat; ++i)
+		{
+			bFlat = rBlock.channel[c][i] == rBlock.channel[c][0];
+		}
+	}
+	if (bFlat)
+	{
+		const SingleColourTables& rTables = single_colour_tables();
+		const u32 r = static_cast<u32>(rBlock.channel[0][0]);
+		const u32 g = static_cast<u32>(rBlock.channel[1][0]);
+		const u32 b = static_cast<u32>(rBlock.channel[2][0]);
+		const u16 c0 = pack565(rTables.pair5[r][0], rTables.pair6[g][0], rTables.pair5[b][0]);
+		const u16 c1 = pack565(rTables.pair5[r][1], rTables.pair6[g][1], rTables.pair5[b][1]);
+		memset(indices, 2, sizeof(indices));
+		bc1_write(c0, c1, indices, pOut);
+		return;
+	}
+
+	// Pull the ends in a little, the extremes are rarely worth a whole palette entry.
+	for (u32 c = 0; c < 3; ++c)
+	{
+		const f32 inset = (high[c] - low[c]) / 16.0f;
+		low[c] += inset;
+		high[c] -= inset;
+	}
+
+	// Entry i of the four colour palette as a weight from c0 towards c1.
+	static const f32 s_weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+	f32 bestError = 1e30f;
+	u16 bestC0 = 0;
+	u16 bestC1 = 0;
+	u8 bestIndices[16];
+	for (u32 iteration = 0; iteration < 3; ++iteration)
+	{
+		u16 c0 = pack565(quantise(high[0], 31), quantise(high[1], 63), quantise(high[2], 31));
+		u16 c1 = pack565(quantise(low[0], 31), quantise(low[1], 63), quantise(low[2], 31));
+		if (c0 < c1)
+		{
+			std::swap(c0, c1);
+		}
+		else if (c0 == c1)
+		{
+			// Equal ends would select the three colour mode.
+			if (c1 > 0) { --c1; } else { ++c0; }
+		}
+
+		bc1_palette(c0, c1, palette);
+		const f32 error = fit_indices(rBlock, 0, 3, palette, indices);
+		if (error < bestError)
+		{
+			bestError = error;
+			bestC0 = c0;
+			bestC1 = c1;
+			memcpy(bestIndices, indices, sizeof(indices));
+		}
+
+		if (error == 0.0f || !refine_endpoints(rBlock, 0, 3, indices, s_weights, high, low))
+		{
+			break;
+		}
+	}
+
+	bc1_write(bestC0, bestC1, bestIndices, pOut);
+}
+
+static void bc1_decode(const memtype_t* pBlock, Block& rOut)
+{
+	u16 c0;
+	u16 c1;
+	u32 bits;
+	memcpy(&c0, pBlock + 0, 2);
+	memcpy(&c1, pBlock + 2, 2);
+	memcpy(&bits, pBlock + 4, 4);
+
+	Palette palette;
+	bc1_palette(c0, c1, palette);
+	for (u32 i = 0; i < 16; ++i)
+	{
+		const u32 index = (bits >> (i * 2)) & 3;
+		for (u32 c = 0; c < 4; ++c)
+		{
+			rOut.channel[c][i] = palette.entry[index][c];
+		}
+	}
+}
+
+// ========================================================
+// BC4, and BC5 as two of them.
+// ========================================================
+
+static void bc4_palette(u32 r0, u32 r1, u32 channel, Palette& rOut)
+{
+	rOut.entry[0][channel] = static_cast<f32>(r0);
+	rOut.entry[1][channel] = static_cast<f32>(r1);
+	if (r0 > r1)
+	{
+		for (u32 i = 1; i < 7; ++i)
+		{
+			rOut.entry[i + 1][channel] = static_cast<f32>(((7 - i) * r0 + i * r1 + 3) / 7);
+		}
+	}
+	else
+	{
+		for (u32 i = 1; i < 5; ++i)
+		{
+			rOut.entry[i + 1][channel] = static_cast<f32>(((5 - i) * r0 + i * r1 + 2) / 5);
+		}
+		rOut.entry[6][channel] = 0.0f;
+		rOut.entry[7][channel] = 255.0f;
+	}
+	rOut.numEntries = 8;
+}
+
+static void bc4_write(u32 r0, u32 r1, const u8* pIndices, memtype_t* pOut)
+{
+	u64 bits = 0;
+	for (u32 i = 0; i < 16; ++i)
+	{
+		bits |= static_cast<u64>(pIndices[i]) << (i * 3);
+	}
+	pOut[0] = static_cast<memtype_t>(r0);
+	pOut[1] = static_cast<memtype_t>(r1);
+	for (u32 i = 0; i < 6; ++i)
+	{
+		pOut[2 + i] = static_cast<memtype_t>(bits >> (i * 8));
+	}
+}
+
+static void bc4_encode(const Block& rBlock, u32 channel, memtype_t* pOut)
+{
+	const f32* pValues = rBlock.channel[channel];
+
+	u32 low = 255;
+	u32 high = 0;
+	u32 innerLow = 255;
+	u32 innerHigh = 0;
+	for (u32 i = 0; i < 16; ++i)
+	{
+		const u32 v = static_cast<u32>(pValues[i]);
+		low = std::min(low, v);
+		high = std::max(high, v);
+		if (v != 0 && v != 255)
+		{
+			innerLow = std::min(innerLow, v);
+			innerHigh = std::max(innerHigh, v);
+		}
+	}
+
+	// Eight interpolated values across the range.
+	Palette palette;
+	u8 indices[16];
+	bc4_palette(high, low, channel, palette);
+	const f32 error = fit_indices(rBlock, channel, 1, palette, indices);
+	if (error == 0.0f || (low != 0 && high != 255))
+	{
+		bc4_write(high, low, indices, pOut);
+		return;
+	}
+
+	// Six values between the inner extremes plus exact 0 and 255, better for masks.
+	if (innerLow > innerHigh)
+	{
+		innerLow = innerHigh = 0;
+	}
+	u8 innerIndices[16];
+	bc4_palette(innerLow, innerHigh, channel, palette);
+	const f32 innerError = fit_indices(rBlock, channel, 1, palette, innerIndices);
+	if (innerError < error)
+	{
+		bc4_write(innerLow, innerHigh, innerIndices, pOut);
+	}
+	else
+	{
+		bc4_write(high, low, indices, pOut);
+	}
+}
+
+static void bc4_decode(const memtype_t* pBlock, u32 channel, Block& rOut)
+{
+	u64 bits = 0;
+	for (u32 i = 0; i < 6; ++i)
+	{
+		bits |= static_cast<u64>(pBlock[2 + i]) << (i * 8);
+	}
+
+	Palette palette;
+	bc4_palette(pBlock[0], pBlock[1], channel, palette);
+	for (u32 i = 0; i < 16; ++i)
+	{
+		rOut.channel[channel][i] = palette.entry[(bits >> (i * 3)) & 7][channel];
+	}
+}
+
+// ========================================================
+// BC7 mode 6.
+// One subset, 7 bit RGBA endpoints with a shared low bit each
+// and 4 bit indices. Good for smooth colour and alpha alike.
+// ========================================================
+
+static const u32 kBc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct Bc7Endpoint
+{
+	u32 value[4];	// 7 bits per channel.
+	u32 pBit;
+};
+
+static inline u32 bc7_unquantise(const Bc7Endpoint& rEndpoint, u32 c)
+{
+	return (rEndpoint.value[c] << 1) | rEndpoint.pBit;
+}
+
+// Choose the shared bit that keeps the endpoint closest to the ideal colour.
+static Bc7Endpoint bc7_quantise(const f32* pColour)
+{
+	Bc7Endpoint best = {};
+	f32 bestError = 1e30f;
+	for (u32 p = 0; p < 2; ++p)
+	{
+		Bc7Endpoint candidate;
+		candidate.pBit = p;
+		f32 error = 0.0f;
+		for (u32 c = 0; c < 4; ++c)
+		{
+			const f32 scaled = (pColour[c] - p) * 0.5f + 0.5f;
+			candidate.value[c] = static_cast<u32>(std::min(std::max(scaled, 0.0f), 127.0f));
+			const f32 d = static_cast<f32>(bc7_unquantise(candidate, c)) - pColour[c];
+			error += d * d;
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			best = candidate;
+		}
+	}
+	return best;
+}
+
+static void bc7_palette(const Bc7Endpoint& rA, const Bc7Endpoint& rB, Palette& rOut)
+{
+	for (u32 c = 0; c < 4; ++c)
+	{
+		const u32 a = bc7_unquantise(rA, c);
+		const u32 b = bc7_unquantise(rB, c);
+		for (u32 i = 0; i < 16; ++i)
+		{
+			rOut.entry[i][c] = static_cast<f32>(((64 - kBc7Weights4[i]) * a + kBc7Weights4[i] * b + 32) >> 6);
+		}
+	}
+	rOut.numEntries = 16;
+}
+
+// Little endian bit stream for the 128 bit block.
+struct BitWriter
+{
+	u64 word[2] = {};
+	u32 position = 0;
+
+	void write(u64 value, u32 numBits)
+	{
+		const u32 index = position >> 6;
+		const u32 shift = position & 63;
+		word[index] |= value << shift;
+		if (shift + numBits > 64)
+		{
+			word[index + 1] |= value >> (64 - shift);
+		}
+		position += numBits;
+	}
+};
+
+struct BitReader
+{
+	u64 word[2];
+	u32 position = 0;
+
+	u32 read(u32 numBits)
+	{
+		const u32 index = position >> 6;
+		const u32 shift = position & 63;
+		u64 value = word[index] >> shift;
+		if (shift + numBits > 64)
+		{
+			value |= word[index + 1] << (64 - shift);
+		}
+		position += numBits;
+		return static_cast<u32>(value & ((1ull << numBits) - 1));
+	}
+};
+
+static void bc7_write(Bc7Endpoint a, Bc7Endpoint b, const u8* pIndices, memtype_t* pOut)
+{
+	// The top bit of the first index is implied zero.
+	u8 indices[16];
+	if (pIndices[0] & 8)
+	{
+		std::swap(a, b);
+		for (u32 i = 0; i < 16; ++i)
+		{
+			indices[i] = static_cast<u8>(15 - pIndices[i]);
+		}
+	}
+	else
+	{
+		memcpy(indices, pIndices, sizeof(indices));
+	}
+
+	BitWriter writer;
+	writer.write(1 << 6, 7);
+	for (u32 c = 0; c < 4; ++c)
+	{
+		writer.write(a.value[c], 7);
+		writer.write(b.value[c], 7);
+	}
+	writer.write(a.pBit, 1);
+	writer.write(b.pBit, 1);
+	writer.write(indices[0], 3);
+	for (u32 i = 1; i < 16; ++i)
+	{
+		writer.write(indices[i], 4);
+	}
+	ASSERT(writer.position == 128);
+	memcpy(pOut, writer.word, 16);
+}
+
+static void bc7_encode(const Block& rBlock, memtype_t* pOut)
+{
+	f32 low[4];
+	f32 high[4];
+	principal_endpoints(rBlock, 0, 4, low, high);
+
+	static const f32 s_weights[16] =
+	{
+		0 / 64.0f, 4 / 64.0f, 9 / 64.0f, 13 / 64.0f, 17 / 64.0f, 21 / 64.0f, 26 / 64.0f, 30 / 64.0f,
+		34 / 64.0f, 38 / 64.0f, 43 / 64.0f, 47 / 64.0f, 51 / 64.0f, 55 / 64.0f, 60 / 64.0f, 64 / 64.0f,
+	};
+
+	Palette palette;
+	u8 indices[16];
+	f32 bestError = 1e30f;
+	Bc7Endpoint bestA = {};
+	Bc7Endpoint bestB = {};
+	u8 bestIndices[16];
+	for (u32 iteration = 0; iteration < 3; ++iteration)
+	{
+		const Bc7Endpoint a = bc7_quantise(low);
+		const Bc7Endpoint b = bc7_quantise(high);
+		bc7_palette(a, b, palette);
+		const f32 error = fit_indices(rBlock, 0, 4, palette, indices);
+		if (error < bestError)
+		{
+			bestError = error;
+			bestA = a;
+			bestB = b;
+			memcpy(bestIndices, indices, sizeof(indices));
+		}
+
+		if (error == 0.0f || !refine_endpoints(rBlock, 0, 4, indices, s_weights, low, high))
+		{
+			break;
+		}
+	}
+
+	bc7_write(bestA, bestB, bestIndices, pOut);
+}
+
+// Only reads the mode written above, enough to measure the result.
+static void bc7_decode(const memtype_t* pBlock, Block& rOut)
+{
+	BitReader reader;
+	memcpy(reader.word, pBlock, 16);
+	const u32 mode = reader.read(7);
+	ASSERT(mode == (1 << 6));
+	(void)mode;
+
+	Bc7Endpoint a;
+	Bc7Endpoint b;
+	for (u32 c = 0; c < 4; ++c)
+	{
+		a.value[c] = reader.read(7);
+		b.value[c] = reader.read(7);
+	}
+	a.pBit = reader.read(1);
+	b.pBit = reader.read(1);
+
+	Palette palette;
+	bc7_palette(a, b, palette);
+	for (u32 i = 0; i < 16; ++i)
+	{
+		const u32 index = reader.read(i == 0 ? 3 : 4);
+		for (u32 c = 0; c < 4; ++c)
+		{
+			rOut.channel[c][i] = palette.entry[index][c];
+		}
+	}
+}
+
+// ========================================================
+// Textures.
+// ========================================================
+
+f64 BlockCompressStats::psnr() const
+{
+	if (numValues == 0)
+	{
+		return 0.0;
+	}
+	const f64 mse = squaredError / numValues;
+	return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+bool block_compress_supported(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Channels of the source each format keeps.
+static void format_channels(DXGI_FORMAT format, u32* pFirstOut, u32* pCountOut)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+		*pFirstOut = 0; *pCountOut = 3; break;
+	case DXGI_FORMAT_BC4_UNORM:
+		*pFirstOut = 0; *pCountOut = 1; break;
+	case DXGI_FORMAT_BC5_UNORM:
+		*pFirstOut = 0; *pCountOut = 2; break;
+	default:
+		*pFirstOut = 0; *pCountOut = 4; break;
+	}
+}
+
+static void encode_block(DXGI_FORMAT format, const Block& rBlock, memtype_t* pOut)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+		bc1_encode(rBlock, pOut);
+		break;
+	case DXGI_FORMAT_BC4_UNORM:
+		bc4_encode(rBlock, 0, pOut);
+		break;
+	case DXGI_FORMAT_BC5_UNORM:
+		bc4_encode(rBlock, 0, pOut);
+		bc4_encode(rBlock, 1, pOut + 8);
+		break;
+	default:
+		bc7_encode(rBlock, pOut);
+		break;
+	}
+}
+
+static void decode_block(DXGI_FORMAT format, const memtype_t* pBlock, Block& rOut)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+		bc1_decode(pBlock, rOut);
+		break;
+	case DXGI_FORMAT_BC4_UNORM:
+		bc4_decode(pBlock, 0, rOut);
+		break;
+	case DXGI_FORMAT_BC5_UNORM:
+		bc4_decode(pBlock, 0, rOut);
+		bc4_decode(pBlock + 8, 1, rOut);
+		break;
+	default:
+		bc7_decode(pBlock, rOut);
+		break;
+	}
+}
+
+// One row of blocks in one slice of a subresource, the unit of parallel work.
+struct BlockRow
+{
+	u32 subresource;
+	u32 slice;
+	u32 blockY;
+};
+
+bool compress_texture(const TextureData& rSource, DXGI_FORMAT format, TextureBuffer& rOut,
+	JobPool* pPool, BlockCompressStats* pStatsOut, const char** pErrorOut)
+{
+	const char* pError = nullptr;
+	bool bBgra = false;
+	bool bOpaque = false;
+	switch (rSource.format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		break;
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		bBgra = true;
+		break;
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+		bBgra = true;
+		bOpaque = true;
+		break;
+	default:
+		pError = "source must be 8 bit RGBA or BGRA";
+		break;
+	}
+	if (!pError && !block_compress_supported(format))
+	{
+		pError = "unsupported block format";
+	}
+	if (pError)
+	{
+		if (pErrorOut)
+		{
+			*pErrorOut = pError;
+		}
+		return false;
+	}
+
+	// Same layout as the source with every subresource 16 byte aligned.
+	TextureData& rTexture = rOut.texture;
+	rTexture = rSource;
+	rTexture.format = format;
+
+	std::vector<BlockRow> rows;
+	std::vector<u64> offsets;
+	u64 totalBytes = 0;
+	for (u32 s = 0; s < rSource.subresources.size(); ++s)
+	{
+		const TextureSubresource& rSrc = rSource.subresources[s];
+		u64 numBytes = 0;
+		u64 rowBytes = 0;
+		u64 numRows = 0;
+		texture_surface_info(rSrc.width, rSrc.height, format, &numBytes, &rowBytes, &numRows);
+
+		TextureSubresource& rDst = rTexture.subresources[s];
+		rDst.rowPitch = static_cast<u32>(rowBytes);
+		rDst.slicePitch = static_cast<u32>(numBytes);
+		rDst.numRows = static_cast<u32>(numRows);
+		offsets.push_back(totalBytes);
+		totalBytes += (numBytes * rSrc.depth + 15) & ~15ull;
+
+		for (u32 z = 0; z < rSrc.depth; ++z)
+		{
+			for (u32 y = 0; y < numRows; ++y)
+			{
+				rows.push_back({ s, z, y });
+			}
+		}
+	}
+
+	rOut.storage.resize(static_cast<size_t>(totalBytes));
+	for (u32 s = 0; s < rTexture.subresources.size(); ++s)
+	{
+		rTexture.subresources[s].pData = rOut.storage.data() + offsets[s];
+	}
+
+	std::mutex statsMutex;
+	JobPool::RangeJob job = [&](u32 begin, u32 end)
+	{
+		const u32 blockBytes = texture_format_bits_per_pixel(format) * 2;	// 16 pixels per block.
+		u32 first = 0;
+		u32 count = 0;
+		format_channels(format, &first, &count);
+
+		BlockCompressStats stats;
+		Block block;
+		Block decoded;
+		for (u32 r = begin; r < end; ++r)
+		{
+			const BlockRow& rRow = rows[r];
+			const TextureSubresource& rSrc = rSource.subresources[rRow.subresource];
+			const TextureSubresource& rDst = rTexture.subresources[rRow.subresource];
+			memtype_t* pDst = rOut.storage.data() + (rDst.pData - rOut.storage.data())
+				+ static_cast<u64>(rRow.slice) * rDst.slicePitch + static_cast<u64>(rRow.blockY) * rDst.rowPitch;
+
+			const u32 blocksWide = (rSrc.width + 3) / 4;
+			for (u32 x = 0; x < blocksWide; ++x)
+			{
+				gather_block(rSrc, rRow.slice, x, rRow.blockY, bBgra, bOpaque, block);
+				encode_block(format, block, pDst + x * blockBytes);
+
+				if (pStatsOut)
+				{
+					// Only the pixels inside the image count towards the error.
+					decode_block(format, pDst + x * blockBytes, decoded);
+					const u32 w = std::min(4u, rSrc.width - x * 4);
+					const u32 h = std::min(4u, rSrc.height - rRow.blockY * 4);
+					for (u32 c = first; c < first + count; ++c)
+					{
+						for (u32 py = 0; py < h; ++py)
+						{
+							for (u32 px = 0; px < w; ++px)
+							{
+								const f64 d = decoded.channel[c][py * 4 + px] - block.channel[c][py * 4 + px];
+								stats.squaredError += d * d;
+							}
+						}
+					}
+					stats.numValues += w * h * count;
+				}
+			}
+		}
+
+		if (pStatsOut)
+		{
+			std::lock_guard<std::mutex> lock(statsMutex);
+			pStatsOut->squaredError += stats.squaredError;
+			pStatsOut->numValues += stats.numValues;
+		}
+	};
+
+	if (pStatsOut)
+	{
+		*pStatsOut = BlockCompressStats();
+	}
+
+	const u32 numRows = static_cast<u32>(rows.size());
+	if (pPool)
+	{
+		// Aim for a few hundred blocks per job.
+		const u32 blocksWide = std::max((rSource.width + 3) / 4, 1u);
+		pPool->parallelFor(numRows, std::max(1u, 256 / blocksWide), job);
+	}
+	else
+	{
+		job(0, numRows);
+	}
+	return true;
+}
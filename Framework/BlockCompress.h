@@ -0,0 +1,37 @@
+#pragma once
+
+#include "CoreTypes.h"
+#include "TextureData.h"
+
+class JobPool;
+
+//================================================================================
+// CPU block compression.
+// Platform independent encoders for the BCn formats a D3D11 renderer needs:
+//   BC1 - RGB, 4 bits per pixel. Colour maps without alpha.
+//   BC4 - One channel, 4 bits per pixel. Masks, roughness, height.
+//   BC5 - Two channels, 8 bits per pixel. Normal maps (XY).
+//   BC7 - RGBA, 8 bits per pixel. Single subset mode 6 only, the fast mode.
+// The 16 pixels of a block are evaluated four at a time with SSE and rows of
+// blocks are spread across the job pool.
+//================================================================================
+
+// Squared error of the decoded result against the source, over the channels the format stores.
+struct BlockCompressStats
+{
+	f64 squaredError = 0.0;
+	u64 numValues = 0;
+
+	// Peak signal to noise ratio in dB, higher is better.
+	f64 psnr() const;
+};
+
+// True for the formats compress_texture can produce.
+bool block_compress_supported(DXGI_FORMAT format);
+
+// Compress every subresource of an 8 bit RGBA or BGRA texture.
+// Edge blocks of sizes that aren't a multiple of 4 repeat the last row and column.
+// pPool may be null to run on the calling thread, pStatsOut may be null to skip measuring.
+// Returns false for unsupported formats, pErrorOut gets a short reason.
+bool compress_texture(const TextureData& rSource, DXGI_FORMAT format, TextureBuffer& rOut,
+	JobPool* pPool = nullptr, BlockCompressStats* pStatsOut = nullptr, const char** pErrorOut = nullptr);
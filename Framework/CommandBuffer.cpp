@@ -0,0 +1,381 @@
+#include "CommandBuffer.h"
+
+// ========================================================
+// NullCommandDevice
+// ========================================================
+
+void* NullCommandDevice::map_discard(ID3D11Buffer*, u32 bytes)
+{
+	if (m_scratch.size() < bytes)
+	{
+		m_scratch.resize(bytes);
+	}
+	return m_scratch.data();
+}
+
+// ========================================================
+// RecordingCommandDevice
+// Commands start 16 byte aligned, so buffer data in the
+// stream can be written through any type.
+// ========================================================
+
+namespace
+{
+	// Padding is spelled out so every byte of the stream is written, streams compare equal.
+	struct TargetsArgs
+	{
+		u32 count;
+		u32 padding;
+		ID3D11DepthStencilView* pDepth;
+		ID3D11RenderTargetView* pTargets[CommandDevice::kMaxRenderTargets];
+	};
+
+	struct UnorderedAccessArgs
+	{
+		u32 startSlot;
+		u32 count;
+		ID3D11UnorderedAccessView* pViews[CommandDevice::kMaxUnorderedAccessViews];
+	};
+
+	struct ClearTargetArgs
+	{
+		ID3D11RenderTargetView* pTarget;
+		f32 colour[4];
+	};
+
+	struct ClearDepthArgs
+	{
+		ID3D11DepthStencilView* pDepth;
+		u32 flags;
+		f32 depth;
+		u32 stencil;
+		u32 padding;
+	};
+
+	// The data follows, padded to 16 bytes after the header.
+	struct UpdateArgs
+	{
+		u64 buffer;		// ID3D11Buffer*, the same size on 32 and 64 bit.
+		u32 bytes;
+		u32 padding[3];
+	};
+
+	struct DrawArgs
+	{
+		u32 count;
+		u32 instanceCount;
+		u32 start;
+		s32 baseVertex;
+		u32 startInstance;
+	};
+
+	struct DispatchArgs
+	{
+		u32 groups[3];
+	};
+
+	inline u32 align16(size_t bytes)
+	{
+		return static_cast<u32>((bytes + 15) & ~size_t(15));
+	}
+}
+
+u8* RecordingCommandDevice::append(CommandKind kind, u32 bytes)
+{
+	ASSERT(!m_pMapped);	// Nothing can be recorded between map_discard() and unmap().
+
+	const u32 argsBytes = align16(sizeof(Header) + bytes) - sizeof(Header);
+	const size_t offset = m_stream.size();
+	m_stream.resize(offset + sizeof(Header) + argsBytes);
+
+	const Header header = { static_cast<u16>(kind), 0, argsBytes };
+	memcpy(m_stream.data() + offset, &header, sizeof(Header));
+	++m_calls[kind];
+	return m_stream.data() + offset + sizeof(Header);
+}
+
+void RecordingCommandDevice::set_render_targets(u32 count, ID3D11RenderTargetView* const* ppTargets, ID3D11DepthStencilView* pDepth)
+{
+	ASSERT(count <= kMaxRenderTargets);
+	TargetsArgs args = { count, 0, pDepth, {} };
+	for (u32 i = 0; i < count; ++i)
+	{
+		args.pTargets[i] = ppTargets[i];
+	}
+	memcpy(append(kCommandSetRenderTargets, sizeof(args)), &args, sizeof(args));
+}
+
+void RecordingCommandDevice::set_viewport(const Viewport& viewport)
+{
+	memcpy(append(kCommandSetViewport, sizeof(viewport)), &viewport, sizeof(viewport));
+}
+
+void RecordingCommandDevice::set_unordered_access_views(u32 startSlot, u32 count, ID3D11UnorderedAccessView* const* ppViews)
+{
+	ASSERT(count <= kMaxUnorderedAccessViews);
+	UnorderedAccessArgs args = { startSlot, count, {} };
+	for (u32 i = 0; i < count; ++i)
+	{
+		args.pViews[i] = ppViews[i];
+	}
+	memcpy(append(kCommandSetUnorderedAccessViews, sizeof(args)), &args, sizeof(args));
+}
+
+void RecordingCommandDevice::clear_render_target(ID3D11RenderTargetView* pTarget, const f32 colour[4])
+{
+	const ClearTargetArgs args = { pTarget, { colour[0], colour[1], colour[2], colour[3] } };
+	memcpy(append(kCommandClearRenderTarget, sizeof(args)), &args, sizeof(args));
+}
+
+void RecordingCommandDevice::clear_depth_stencil(ID3D11DepthStencilView* pDepth, u32 flags, f32 depth, u8 stencil)
+{
+	const ClearDepthArgs args = { pDepth, flags, depth, stencil, 0 };
+	memcpy(append(kCommandClearDepthStencil, sizeof(args)), &args, sizeof(args));
+}
+
+void* RecordingCommandDevice::map_discard(ID3D11Buffer* pBuffer, u32 bytes)
+{
+	static_assert((sizeof(Header) + sizeof(UpdateArgs)) % 16 == 0, "Buffer data must stay 16 byte aligned");
+
+	const UpdateArgs args = { reinterpret_cast<uintptr_t>(pBuffer), bytes, {} };
+	u8* pArgs = append(kCommandUpdateBuffer, sizeof(args) + bytes);
+	memcpy(pArgs, &args, sizeof(args));
+
+	m_pMapped = pBuffer;
+	return pArgs + sizeof(args);
+}
+
+void RecordingCommandDevice::unmap(ID3D11Buffer* pBuffer)
+{
+	ASSERT(m_pMapped == pBuffer);
+	m_pMapped = nullptr;
+}
+
+void RecordingCommandDevice::draw(u32 vertexCount, u32 startVertex)
+{
+	const DrawArgs args = { vertexCount, 1, startVertex, 0, 0 };
+	memcpy(append(kCommandDraw, sizeof(args)), &args, sizeof(args));
+}
+
+void RecordingCommandDevice::draw_indexed(u32 indexCount, u32 startIndex, s32 baseVertex)
+{
+	const DrawArgs args = { indexCount, 1, startIndex, baseVertex, 0 };
+	memcpy(append(kCommandDrawIndexed, sizeof(args)), &args, sizeof(args));
+}
+
+void RecordingCommandDevice::draw_instanced(u32 vertexCount, u32 instanceCount, u32 startVertex, u32 startInstance)
+{
+	const DrawArgs args = { vertexCount, instanceCount, startVertex, 0, startInstance };
+	memcpy(append(kCommandDrawInstanced, sizeof(args)), &args, sizeof(args));
+}
+
+void RecordingCommandDevice::draw_indexed_instanced(u32 indexCount, u32 instanceCount, u32 startIndex, s32 baseVertex, u32 startInstance)
+{
+	const DrawArgs args = { indexCount, instanceCount, startIndex, baseVertex, startInstance };
+	memcpy(append(kCommandDrawIndexedInstanced, sizeof(args)), &args, sizeof(args));
+}
+
+void RecordingCommandDevice::dispatch(u32 groupsX, u32 groupsY, u32 groupsZ)
+{
+	const DispatchArgs args = { { groupsX, groupsY, groupsZ } };
+	memcpy(append(kCommandDispatch, sizeof(args)), &args, sizeof(args));
+}
+
+u32 RecordingCommandDevice::num_calls() const
+{
+	u32 total = 0;
+	for (u32 calls : m_calls)
+	{
+		total += calls;
+	}
+	return total;
+}
+
+u32 RecordingCommandDevice::num_draws() const
+{
+	return m_calls[kCommandDraw] + m_calls[kCommandDrawIndexed] + m_calls[kCommandDrawInstanced] + m_calls[kCommandDrawIndexedInstanced];
+}
+
+void RecordingCommandDevice::clear_calls()
+{
+	ASSERT(!m_pMapped);
+	m_stream.clear();
+	memset(m_calls, 0, sizeof(m_calls));
+}
+
+void RecordingCommandDevice::replay(CommandDevice& rDevice) const
+{
+	ASSERT(!m_pMapped);
+
+	size_t offset = 0;
+	while (offset < m_stream.size())
+	{
+		Header header;
+		memcpy(&header, m_stream.data() + offset, sizeof(Header));
+		const u8* pArgs = m_stream.data() + offset + sizeof(Header);
+		offset += sizeof(Header) + header.bytes;
+
+		switch (header.kind)
+		{
+		case kCommandSetRenderTargets:
+		{
+			TargetsArgs args;
+			memcpy(&args, pArgs, sizeof(args));
+			rDevice.set_render_targets(args.count, args.pTargets, args.pDepth);
+			break;
+		}
+		case kCommandSetViewport:
+		{
+			Viewport viewport;
+			memcpy(&viewport, pArgs, sizeof(viewport));
+			rDevice.set_viewport(viewport);
+			break;
+		}
+		case kCommandSetUnorderedAccessViews:
+		{
+			UnorderedAccessArgs args;
+			memcpy(&args, pArgs, sizeof(args));
+			rDevice.set_unordered_access_views(args.startSlot, args.count, args.pViews);
+			break;
+		}
+		case kCommandClearRenderTarget:
+		{
+			ClearTargetArgs args;
+			memcpy(&args, pArgs, sizeof(args));
+			rDevice.clear_render_target(args.pTarget, args.colour);
+			break;
+		}
+		case kCommandClearDepthStencil:
+		{
+			ClearDepthArgs args;
+			memcpy(&args, pArgs, sizeof(args));
+			rDevice.clear_depth_stencil(args.pDepth, args.flags, args.depth, static_cast<u8>(args.stencil));
+			break;
+		}
+		case kCommandUpdateBuffer:
+		{
+			UpdateArgs args;
+			memcpy(&args, pArgs, sizeof(args));
+			ID3D11Buffer* pBuffer = reinterpret_cast<ID3D11Buffer*>(static_cast<uintptr_t>(args.buffer));
+			void* pData = rDevice.map_discard(pBuffer, args.bytes);
+			if (pData)
+			{
+				memcpy(pData, pArgs + sizeof(args), args.bytes);
+				rDevice.unmap(pBuffer);
+			}
+			break;
+		}
+		case kCommandDraw:
+		case kCommandDrawIndexed:
+		case kCommandDrawInstanced:
+		case kCommandDrawIndexedInstanced:
+		{
+			DrawArgs args;
+			memcpy(&args, pArgs, sizeof(args));
+			if (header.kind == kCommandDraw)
+			{
+				rDevice.draw(args.count, args.start);
+			}
+			else if (header.kind == kCommandDrawIndexed)
+			{
+				rDevice.draw_indexed(args.count, args.start, args.baseVertex);
+			}
+			else if (header.kind == kCommandDrawInstanced)
+			{
+				rDevice.draw_instanced(args.count, args.instanceCount, args.start, args.startInstance);
+			}
+			else
+			{
+				rDevice.draw_indexed_instanced(args.count, args.instanceCount, args.start, args.baseVertex, args.startInstance);
+			}
+			break;
+		}
+		case kCommandDispatch:
+		{
+			DispatchArgs args;
+			memcpy(&args, pArgs, sizeof(args));
+			rDevice.dispatch(args.groups[0], args.groups[1], args.groups[2]);
+			break;
+		}
+		default:
+			panicF("RecordingCommandDevice : unknown command %u in the stream", header.kind);
+			return;
+		}
+	}
+}
+
+// ========================================================
+// CommandBuffer
+// ========================================================
+
+void CommandBuffer::update_buffer(ID3D11Buffer* pBuffer, const void* pData, u32 bytes)
+{
+	void* pMapped = map_discard(pBuffer, bytes);
+	if (pMapped)
+	{
+		memcpy(pMapped, pData, bytes);
+		m_pDevice->unmap(pBuffer);
+	}
+}
+
+void* CommandBuffer::map_discard(ID3D11Buffer* pBuffer, u32 bytes)
+{
+	++m_stats.bufferUpdates;
+	m_stats.bytesUpdated += bytes;
+	return m_pDevice->map_discard(pBuffer, bytes);
+}
+
+void CommandBuffer::draw(u32 vertexCount, u32 startVertex)
+{
+	++m_stats.draws;
+	m_pDevice->draw(vertexCount, startVertex);
+}
+
+void CommandBuffer::draw_indexed(u32 indexCount, u32 startIndex, s32 baseVertex)
+{
+	++m_stats.draws;
+	m_pDevice->draw_indexed(indexCount, startIndex, baseVertex);
+}
+
+void CommandBuffer::draw_instanced(u32 vertexCount, u32 instanceCount, u32 startVertex, u32 startInstance)
+{
+	++m_stats.draws;
+	m_pDevice->draw_instanced(vertexCount, instanceCount, startVertex, startInstance);
+}
+
+void CommandBuffer::draw_indexed_instanced(u32 indexCount, u32 instanceCount, u32 startIndex, s32 baseVertex, u32 startInstance)
+{
+	++m_stats.draws;
+	m_pDevice->draw_indexed_instanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void CommandBuffer::dispatch(u32 groupsX, u32 groupsY, u32 groupsZ)
+{
+	++m_stats.dispatches;
+	m_pDevice->dispatch(groupsX, groupsY, groupsZ);
+}
+
+#if defined(_WIN32)
+
+// ========================================================
+// D3D11CommandDevice
+// ========================================================
+
+void D3D11CommandDevice::set_viewport(const Viewport& viewport)
+{
+	const D3D11_VIEWPORT vp = { viewport.x, viewport.y, viewport.width, viewport.height, viewport.minDepth, viewport.maxDepth };
+	m_pContext->RSSetViewports(1, &vp);
+}
+
+void* D3D11CommandDevice::map_discard(ID3D11Buffer* pBuffer, u32 bytes)
+{
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(m_pContext->Map(pBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+	{
+		errorF("D3D11CommandDevice : failed to map a %u byte buffer", bytes);
+		return nullptr;
+	}
+	return mapped.pData;
+}
+
+#endif
@@ -0,0 +1,247 @@
+#pragma once
+
+#include "CoreTypes.h"
+
+#include <vector>
+
+struct ID3D11RenderTargetView;
+struct ID3D11DepthStencilView;
+struct ID3D11UnorderedAccessView;
+struct ID3D11Buffer;
+
+//================================================================================
+// CommandBuffer
+// The draws, clears, targets and buffer writes of a frame, sent to a
+// CommandDevice instead of straight to a device context. Binds and pipeline
+// state already go through BindingTable and StateCache with devices of their
+// own, this covers the rest of ID3D11DeviceContext that rendering uses.
+//
+// Backends:
+//  - D3D11CommandDevice sends to a device context.
+//  - NullCommandDevice drops everything, for timing the CPU side alone.
+//  - RecordingCommandDevice serializes every command into a byte stream that
+//    can be counted, compared or replayed into another device.
+//
+// Platform independent, the D3D11 objects are only passed through.
+//================================================================================
+
+enum CommandKind : u16
+{
+	kCommandSetRenderTargets,
+	kCommandSetViewport,
+	kCommandSetUnorderedAccessViews,
+	kCommandClearRenderTarget,
+	kCommandClearDepthStencil,
+	kCommandUpdateBuffer,
+	kCommandDraw,
+	kCommandDrawIndexed,
+	kCommandDrawInstanced,
+	kCommandDrawIndexedInstanced,
+	kCommandDispatch,
+
+	kNumCommandKinds
+};
+
+// Same values as D3D11_CLEAR_FLAG.
+enum ClearFlags : u32
+{
+	kClearDepth = 1 << 0,
+	kClearStencil = 1 << 1,
+};
+
+struct Viewport
+{
+	f32 x;
+	f32 y;
+	f32 width;
+	f32 height;
+	f32 minDepth;
+	f32 maxDepth;
+};
+
+// ========================================================
+// CommandDevice
+// ========================================================
+class CommandDevice
+{
+public:
+	static const u32 kMaxRenderTargets = 8;
+	static const u32 kMaxUnorderedAccessViews = 8;
+
+	virtual ~CommandDevice() {}
+
+	virtual void set_render_targets(u32 count, ID3D11RenderTargetView* const* ppTargets, ID3D11DepthStencilView* pDepth) = 0;
+	virtual void set_viewport(const Viewport& viewport) = 0;
+	virtual void set_unordered_access_views(u32 startSlot, u32 count, ID3D11UnorderedAccessView* const* ppViews) = 0;	// Compute stage.
+	virtual void clear_render_target(ID3D11RenderTargetView* pTarget, const f32 colour[4]) = 0;
+	virtual void clear_depth_stencil(ID3D11DepthStencilView* pDepth, u32 flags, f32 depth, u8 stencil) = 0;
+
+	// Replace the whole contents of a dynamic buffer. The memory is write only
+	// and only valid until unmap().
+	virtual void* map_discard(ID3D11Buffer* pBuffer, u32 bytes) = 0;
+	virtual void unmap(ID3D11Buffer* pBuffer) = 0;
+
+	virtual void draw(u32 vertexCount, u32 startVertex) = 0;
+	virtual void draw_indexed(u32 indexCount, u32 startIndex, s32 baseVertex) = 0;
+	virtual void draw_instanced(u32 vertexCount, u32 instanceCount, u32 startVertex, u32 startInstance) = 0;
+	virtual void draw_indexed_instanced(u32 indexCount, u32 instanceCount, u32 startIndex, s32 baseVertex, u32 startInstance) = 0;
+	virtual void dispatch(u32 groupsX, u32 groupsY, u32 groupsZ) = 0;
+};
+
+// Drops every command. Maps hand out scratch memory.
+class NullCommandDevice : public CommandDevice
+{
+public:
+	void set_render_targets(u32, ID3D11RenderTargetView* const*, ID3D11DepthStencilView*) override {}
+	void set_viewport(const Viewport&) override {}
+	void set_unordered_access_views(u32, u32, ID3D11UnorderedAccessView* const*) override {}
+	void clear_render_target(ID3D11RenderTargetView*, const f32[4]) override {}
+	void clear_depth_stencil(ID3D11DepthStencilView*, u32, f32, u8) override {}
+	void* map_discard(ID3D11Buffer*, u32 bytes) override;
+	void unmap(ID3D11Buffer*) override {}
+	void draw(u32, u32) override {}
+	void draw_indexed(u32, u32, s32) override {}
+	void draw_instanced(u32, u32, u32, u32) override {}
+	void draw_indexed_instanced(u32, u32, u32, s32, u32) override {}
+	void dispatch(u32, u32, u32) override {}
+
+private:
+	std::vector<u8> m_scratch;
+};
+
+// Serializes each command as a header then its arguments. Buffer writes are
+// kept in the stream, objects are kept as pointers, so replay() is only
+// meaningful while they are alive.
+class RecordingCommandDevice : public CommandDevice
+{
+public:
+	RecordingCommandDevice() { clear_calls(); }
+
+	void set_render_targets(u32 count, ID3D11RenderTargetView* const* ppTargets, ID3D11DepthStencilView* pDepth) override;
+	void set_viewport(const Viewport& viewport) override;
+	void set_unordered_access_views(u32 startSlot, u32 count, ID3D11UnorderedAccessView* const* ppViews) override;
+	void clear_render_target(ID3D11RenderTargetView* pTarget, const f32 colour[4]) override;
+	void clear_depth_stencil(ID3D11DepthStencilView* pDepth, u32 flags, f32 depth, u8 stencil) override;
+	void* map_discard(ID3D11Buffer* pBuffer, u32 bytes) override;
+	void unmap(ID3D11Buffer* pBuffer) override;
+	void draw(u32 vertexCount, u32 startVertex) override;
+	void draw_indexed(u32 indexCount, u32 startIndex, s32 baseVertex) override;
+	void draw_instanced(u32 vertexCount, u32 instanceCount, u32 startVertex, u32 startInstance) override;
+	void draw_indexed_instanced(u32 indexCount, u32 instanceCount, u32 startIndex, s32 baseVertex, u32 startInstance) override;
+	void dispatch(u32 groupsX, u32 groupsY, u32 groupsZ) override;
+
+	// The commands since the last clear_calls().
+	const std::vector<u8>& stream() const { return m_stream; }
+	u32 num_calls(CommandKind kind) const { return m_calls[kind]; }
+	u32 num_calls() const;
+	u32 num_draws() const;
+	void clear_calls();
+
+	// Send the recorded commands to another device, in order.
+	void replay(CommandDevice& rDevice) const;
+
+private:
+	struct Header
+	{
+		u16 kind;
+		u16 pad;
+		u32 bytes;		// Of the arguments after the header.
+	};
+
+	// Appends a command, returns where its arguments go.
+	u8* append(CommandKind kind, u32 bytes);
+
+	std::vector<u8> m_stream;
+	u32 m_calls[kNumCommandKinds];
+
+	ID3D11Buffer* m_pMapped = nullptr;	// The open map_discard().
+};
+
+// ========================================================
+// CommandBuffer
+// Front end of a CommandDevice, counts what the frame did.
+// Binds still need a BindingTable flush() before each draw.
+// ========================================================
+class CommandBuffer
+{
+public:
+	struct Stats
+	{
+		u32 draws;
+		u32 dispatches;
+		u32 bufferUpdates;
+		u32 bytesUpdated;
+	};
+
+	CommandBuffer() {}
+
+	void init(CommandDevice* pDevice) { m_pDevice = pDevice; }
+
+	CommandDevice& device() const { return *m_pDevice; }
+
+	void set_render_targets(u32 count, ID3D11RenderTargetView* const* ppTargets, ID3D11DepthStencilView* pDepth) { m_pDevice->set_render_targets(count, ppTargets, pDepth); }
+	void set_render_target(ID3D11RenderTargetView* pTarget, ID3D11DepthStencilView* pDepth) { m_pDevice->set_render_targets(pTarget ? 1 : 0, &pTarget, pDepth); }
+	void set_viewport(const Viewport& viewport) { m_pDevice->set_viewport(viewport); }
+	void set_unordered_access_views(u32 startSlot, u32 count, ID3D11UnorderedAccessView* const* ppViews) { m_pDevice->set_unordered_access_views(startSlot, count, ppViews); }
+	void clear_render_target(ID3D11RenderTargetView* pTarget, const f32 colour[4]) { m_pDevice->clear_render_target(pTarget, colour); }
+	void clear_depth_stencil(ID3D11DepthStencilView* pDepth, u32 flags, f32 depth, u8 stencil) { m_pDevice->clear_depth_stencil(pDepth, flags, depth, stencil); }
+
+	// Write bytes to the start of a dynamic buffer, the rest of it is undefined after.
+	void update_buffer(ID3D11Buffer* pBuffer, const void* pData, u32 bytes);
+
+	template<typename BufferType>
+	void update_buffer(ID3D11Buffer* pBuffer, const BufferType& rData) { update_buffer(pBuffer, &rData, sizeof(BufferType)); }
+
+	void* map_discard(ID3D11Buffer* pBuffer, u32 bytes);
+	void unmap(ID3D11Buffer* pBuffer) { m_pDevice->unmap(pBuffer); }
+
+	void draw(u32 vertexCount, u32 startVertex);
+	void draw_indexed(u32 indexCount, u32 startIndex, s32 baseVertex);
+	void draw_instanced(u32 vertexCount, u32 instanceCount, u32 startVertex, u32 startInstance);
+	void draw_indexed_instanced(u32 indexCount, u32 instanceCount, u32 startIndex, s32 baseVertex, u32 startInstance);
+	void dispatch(u32 groupsX, u32 groupsY, u32 groupsZ);
+
+	const Stats& stats() const { return m_stats; }
+	void reset_stats() { m_stats = {}; }
+
+private:
+	CommandDevice* m_pDevice = nullptr;
+	Stats m_stats = {};
+};
+
+#if defined(_WIN32)
+
+#include <d3d11.h>
+
+// Sends the commands to a device context.
+class D3D11CommandDevice : public CommandDevice
+{
+public:
+	explicit D3D11CommandDevice(ID3D11DeviceContext* pContext = nullptr) : m_pContext(pContext) {}
+
+	void set_context(ID3D11DeviceContext* pContext) { m_pContext = pContext; }
+
+	void set_render_targets(u32 count, ID3D11RenderTargetView* const* ppTargets, ID3D11DepthStencilView* pDepth) override { m_pContext->OMSetRenderTargets(count, ppTargets, pDepth); }
+	void set_viewport(const Viewport& viewport) override;
+	void set_unordered_access_views(u32 startSlot, u32 count, ID3D11UnorderedAccessView* const* ppViews) override { m_pContext->CSSetUnorderedAccessViews(startSlot, count, ppViews, nullptr); }
+	void clear_render_target(ID3D11RenderTargetView* pTarget, const f32 colour[4]) override { m_pContext->ClearRenderTargetView(pTarget, colour); }
+	void clear_depth_stencil(ID3D11DepthStencilView* pDepth, u32 flags, f32 depth, u8 stencil) override { m_pContext->ClearDepthStencilView(pDepth, flags, depth, stencil); }
+	void* map_discard(ID3D11Buffer* pBuffer, u32 bytes) override;
+	void unmap(ID3D11Buffer* pBuffer) override { m_pContext->Unmap(pBuffer, 0); }
+	void draw(u32 vertexCount, u32 startVertex) override { m_pContext->Draw(vertexCount, startVertex); }
+	void draw_indexed(u32 indexCount, u32 startIndex, s32 baseVertex) override { m_pContext->DrawIndexed(indexCount, startIndex, baseVertex); }
+	void draw_instanced(u32 vertexCount, u32 instanceCount, u32 startVertex, u32 startInstance) override
+	{
+		m_pContext->DrawInstanced(vertexCount, instanceCount, startVertex, startInstance);
+	}
+	void draw_indexed_instanced(u32 indexCount, u32 instanceCount, u32 startIndex, s32 baseVertex, u32 startInstance) override
+	{
+		m_pContext->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+	}
+	void dispatch(u32 groupsX, u32 groupsY, u32 groupsZ) override { m_pContext->Dispatch(groupsX, groupsY, groupsZ); }
+
+private:
+	ID3D11DeviceContext* m_pContext;
+};
+
+#endif
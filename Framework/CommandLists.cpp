@@ -0,0 +1,249 @@
+#include "CommandLists.h"
+#include "JobQueue.h"
+
+// ========================================================
+// RecordingCommandListDevice
+// ========================================================
+
+RecordingCommandListDevice::RecordingCommandListDevice(u32 numContexts)
+	: m_contexts(numContexts)
+{
+	for (u32 context = 0; context < numContexts; ++context)
+	{
+		m_contexts[context].context = { context, nullptr, nullptr, nullptr, nullptr, nullptr };
+		m_contexts[context].bRecording = false;
+	}
+}
+
+void RecordingCommandListDevice::begin(u32 numLists)
+{
+	m_lists.assign(numLists, std::vector<u32>());
+}
+
+void RecordingCommandListDevice::start(u32 context)
+{
+	Context& rContext = m_contexts[context];
+	if (rContext.bRecording)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_overlaps;
+	}
+	rContext.bRecording = true;
+}
+
+void RecordingCommandListDevice::finish(u32 context, u32 list)
+{
+	Context& rContext = m_contexts[context];
+	ASSERT(rContext.bRecording && list < m_lists.size());
+
+	m_lists[list].swap(rContext.pending);
+	rContext.pending.clear();
+	rContext.bRecording = false;
+}
+
+void RecordingCommandListDevice::execute(u32 list)
+{
+	m_executed.insert(m_executed.end(), m_lists[list].begin(), m_lists[list].end());
+	m_lists[list].clear();
+	++m_executes;
+}
+
+void RecordingCommandListDevice::record(u32 context, u32 value)
+{
+	ASSERT(m_contexts[context].bRecording);
+	m_contexts[context].pending.push_back(value);
+}
+
+// ========================================================
+// CommandRecorder
+// ========================================================
+
+void CommandRecorder::init(CommandListDevice* pDevice, JobPool* pPool)
+{
+	m_pDevice = pDevice;
+	m_pPool = pPool;
+
+	// Each thread recording at once needs its own context, the caller helps with the chunks too.
+	ASSERT(!pPool || pDevice->num_contexts() >= pPool->numWorkers() + 1);
+
+	m_freeContexts.clear();
+	for (u32 context = pDevice->num_contexts(); context > 0; --context)
+	{
+		m_freeContexts.push_back(context - 1);
+	}
+}
+
+u32 CommandRecorder::acquire_context()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	ASSERT(!m_freeContexts.empty());
+	const u32 context = m_freeContexts.back();
+	m_freeContexts.pop_back();
+	return context;
+}
+
+void CommandRecorder::release_context(u32 context)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_freeContexts.push_back(context);
+}
+
+void CommandRecorder::record(u32 numChunks, const RecordFn& record)
+{
+	ASSERT(m_pDevice);
+
+	if (numChunks == 0)
+	{
+		return;
+	}
+
+	m_pDevice->begin(numChunks);
+
+	// A chunk holds its context from start to finish, the list it fills is its own.
+	auto recordChunks = [this, &record](u32 begin, u32 end)
+	{
+		for (u32 chunk = begin; chunk < end; ++chunk)
+		{
+			const u32 context = acquire_context();
+			m_pDevice->start(context);
+			record(chunk, m_pDevice->context(context));
+			m_pDevice->finish(context, chunk);
+			release_context(context);
+		}
+	};
+
+	if (m_pPool)
+	{
+		m_pPool->parallelFor(numChunks, 1, recordChunks);
+	}
+	else
+	{
+		recordChunks(0, numChunks);
+	}
+
+	// parallelFor has waited for every chunk, play them back in order.
+	for (u32 chunk = 0; chunk < numChunks; ++chunk)
+	{
+		m_pDevice->execute(chunk);
+	}
+	m_pDevice->end();
+
+	++m_stats.records;
+	m_stats.chunks += numChunks;
+}
+
+#if defined(_WIN32)
+
+// ========================================================
+// D3D11CommandListDevice
+// ========================================================
+
+void D3D11CommandListDevice::init(ID3D11Device* pDevice, ID3D11DeviceContext* pImmediate, u32 numContexts,
+	BindingTable* pImmediateBindings, StateCache* pImmediateStateCache)
+{
+	m_pImmediate = pImmediate;
+	m_pImmediateBindings = pImmediateBindings;
+	m_pImmediateStateCache = pImmediateStateCache;
+
+	// The runtime emulates command lists where the driver can't build them, it still works but records nothing in parallel.
+	D3D11_FEATURE_DATA_THREADING threading = {};
+	if (SUCCEEDED(pDevice->CheckFeatureSupport(D3D11_FEATURE_THREADING, &threading, sizeof(threading))) && !threading.DriverCommandLists)
+	{
+		debugF("D3D11CommandListDevice : driver command lists unsupported, the runtime will emulate them");
+	}
+
+	m_contexts.clear();
+	for (u32 index = 0; index < numContexts; ++index)
+	{
+		std::unique_ptr<Context> pContext(new Context());
+		if (FAILED(pDevice->CreateDeferredContext(0, pContext->deferred.GetAddressOf())))
+		{
+			panicF("D3D11CommandListDevice : failed to create deferred context %u", index);
+		}
+
+		ID3D11DeviceContext* pDeferred = pContext->deferred.Get();
+		pContext->bindingDevice.set_context(pDeferred);
+		pContext->bindings.init(&pContext->bindingDevice);
+		pContext->pipelineDevice.set_context(pDeferred);
+		pContext->stateCache.init(&pContext->pipelineDevice);
+		pContext->constantDevice.init(pDevice, pDeferred);
+		pContext->constants.init(&pContext->constantDevice);
+		pContext->commandDevice.set_context(pDeferred);
+		pContext->commands.init(&pContext->commandDevice);
+		pContext->context = { index, pDeferred, &pContext->commands, &pContext->bindings, &pContext->stateCache, &pContext->constants };
+		m_contexts.push_back(std::move(pContext));
+	}
+}
+
+void D3D11CommandListDevice::begin(u32 numLists)
+{
+	m_lists.clear();
+	m_lists.resize(numLists);
+
+	// What the chunks draw into, as the caller left it.
+	release_output_state();
+	m_pImmediate->OMGetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, m_output.pTargets, &m_output.pDepth);
+	m_output.numViewports = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+	m_pImmediate->RSGetViewports(&m_output.numViewports, m_output.viewports);
+	m_pImmediate->OMGetDepthStencilState(&m_output.pDepthState, &m_output.stencilRef);
+	m_pImmediate->OMGetBlendState(&m_output.pBlendState, m_output.blendFactor, &m_output.sampleMask);
+	m_pImmediate->RSGetState(&m_output.pRasterizerState);
+}
+
+void D3D11CommandListDevice::start(u32 context)
+{
+	apply_output_state(m_contexts[context]->deferred.Get(), m_output);
+}
+
+void D3D11CommandListDevice::finish(u32 context, u32 list)
+{
+	Context& rContext = *m_contexts[context];
+	if (FAILED(rContext.deferred->FinishCommandList(FALSE, m_lists[list].GetAddressOf())))
+	{
+		panicF("D3D11CommandListDevice : failed to finish command list %u", list);
+	}
+
+	// Finishing resets the deferred context to default state.
+	rContext.bindings.invalidate();
+	rContext.stateCache.invalidate();
+}
+
+void D3D11CommandListDevice::execute(u32 list)
+{
+	m_pImmediate->ExecuteCommandList(m_lists[list].Get(), FALSE);
+	m_lists[list].Reset();
+}
+
+void D3D11CommandListDevice::end()
+{
+	// Executing without restoring left the immediate context at default state.
+	apply_output_state(m_pImmediate, m_output);
+	release_output_state();
+	m_pImmediateBindings->invalidate();
+	m_pImmediateStateCache->invalidate();
+}
+
+void D3D11CommandListDevice::apply_output_state(ID3D11DeviceContext* pContext, const OutputState& state)
+{
+	pContext->OMSetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, state.pTargets, state.pDepth);
+	pContext->RSSetViewports(state.numViewports, state.viewports);
+	pContext->OMSetDepthStencilState(state.pDepthState, state.stencilRef);
+	pContext->OMSetBlendState(state.pBlendState, state.blendFactor, state.sampleMask);
+	pContext->RSSetState(state.pRasterizerState);
+}
+
+// The Get* calls add a reference to everything they return.
+void D3D11CommandListDevice::release_output_state()
+{
+	for (ID3D11RenderTargetView*& rTarget : m_output.pTargets)
+	{
+		SAFE_RELEASE(rTarget);
+	}
+	SAFE_RELEASE(m_output.pDepth);
+	SAFE_RELEASE(m_output.pDepthState);
+	SAFE_RELEASE(m_output.pBlendState);
+	SAFE_RELEASE(m_output.pRasterizerState);
+	m_output = {};
+}
+
+#endif
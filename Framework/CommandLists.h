@@ -0,0 +1,233 @@
+#pragma once
+
+#include "CoreTypes.h"
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+class JobPool;
+class BindingTable;
+class StateCache;
+class ConstantRing;
+class CommandBuffer;
+struct ID3D11DeviceContext;
+
+//================================================================================
+// Command lists
+// Draws recorded on several threads at once, each thread into its own
+// context, then played back on the immediate context in a fixed order.
+//
+// CommandRecorder splits the work into chunks and records them across the job
+// pool. Each chunk gets a context no other thread is using and is closed into
+// its own list, the lists are then executed in chunk order, whatever order
+// the workers finished them in. So the result is the same as recording the
+// chunks one after the other on the immediate context.
+//
+// Platform independent, the contexts come from a CommandListDevice.
+// D3D11CommandListDevice uses deferred contexts, RecordingCommandListDevice
+// records plain values on the CPU so the ordering can be checked headless.
+//================================================================================
+
+// What a chunk records with. Only valid on the thread recording the chunk.
+struct RecordingContext
+{
+	u32 index;
+	ID3D11DeviceContext* pContext;	// Deferred context, null for the CPU stand-in.
+	CommandBuffer* pCommands;		// Draws and clears for pContext.
+	BindingTable* pBindings;		// Binds for pContext.
+	StateCache* pStateCache;		// Pipeline state for pContext.
+	ConstantRing* pConstants;		// Per draw constants for pContext.
+};
+
+// ========================================================
+// CommandListDevice
+// Per frame: begin(), then for each chunk start() and
+// finish() on a worker, then execute() each list in order
+// and end() on the calling thread.
+// ========================================================
+class CommandListDevice
+{
+public:
+	virtual ~CommandListDevice() {}
+
+	// Contexts that can record at the same time.
+	virtual u32 num_contexts() const = 0;
+	virtual RecordingContext& context(u32 context) = 0;
+
+	// Make room for numLists lists, before any recording.
+	virtual void begin(u32 numLists) = 0;
+
+	// Set the context up to record a chunk.
+	virtual void start(u32 context) = 0;
+
+	// Close what the context recorded into list, the context is then free for another chunk.
+	virtual void finish(u32 context, u32 list) = 0;
+
+	// Play the list on the immediate context and free it.
+	virtual void execute(u32 list) = 0;
+
+	// After the last execute().
+	virtual void end() = 0;
+};
+
+// Stand-in device whose contexts record values, executing a list appends them to executed().
+class RecordingCommandListDevice : public CommandListDevice
+{
+public:
+	explicit RecordingCommandListDevice(u32 numContexts);
+
+	u32 num_contexts() const override { return static_cast<u32>(m_contexts.size()); }
+	RecordingContext& context(u32 context) override { return m_contexts[context].context; }
+
+	void begin(u32 numLists) override;
+	void start(u32 context) override;
+	void finish(u32 context, u32 list) override;
+	void execute(u32 list) override;
+	void end() override {}
+
+	// Record a value on a context, call from the chunk's record function.
+	void record(u32 context, u32 value);
+
+	const std::vector<u32>& executed() const { return m_executed; }
+
+	// Chunks that started on a context already recording one, should always be 0.
+	u32 num_overlaps() const { return m_overlaps; }
+	u32 num_executes() const { return m_executes; }
+	void clear_calls() { m_executed.clear(); m_overlaps = 0; m_executes = 0; }
+
+private:
+	struct Context
+	{
+		RecordingContext context;
+		std::vector<u32> pending;
+		bool bRecording;
+	};
+
+	std::vector<Context> m_contexts;
+	std::vector<std::vector<u32>> m_lists;
+	std::vector<u32> m_executed;
+	std::mutex m_mutex;		// Guards m_overlaps, starts can race.
+	u32 m_overlaps = 0;
+	u32 m_executes = 0;
+};
+
+// ========================================================
+// CommandRecorder
+// ========================================================
+class CommandRecorder
+{
+public:
+	typedef std::function<void(u32 chunk, RecordingContext& rContext)> RecordFn;
+
+	struct Stats
+	{
+		u32 records;	// record() calls.
+		u32 chunks;		// Recorded and executed.
+	};
+
+	CommandRecorder() {}
+
+	// pPool may be null to record every chunk on the calling thread.
+	void init(CommandListDevice* pDevice, JobPool* pPool);
+
+	// Record numChunks chunks across the pool, then execute them in chunk order.
+	// Needs no more threads recording at once than the device has contexts, so
+	// only one record() at a time. Returns once every list has been executed.
+	void record(u32 numChunks, const RecordFn& record);
+
+	u32 num_contexts() const { return m_pDevice->num_contexts(); }
+
+	const Stats& stats() const { return m_stats; }
+	void reset_stats() { m_stats = {}; }
+
+private:
+	CommandRecorder(const CommandRecorder&) = delete;
+	CommandRecorder& operator=(const CommandRecorder&) = delete;
+
+	u32 acquire_context();
+	void release_context(u32 context);
+
+	CommandListDevice* m_pDevice = nullptr;
+	JobPool* m_pPool = nullptr;
+
+	std::mutex m_mutex;					// Guards m_freeContexts.
+	std::vector<u32> m_freeContexts;
+
+	Stats m_stats = {};
+};
+
+#if defined(_WIN32)
+
+#include "BindingTable.h"
+#include "StateCache.h"
+#include "ConstantRing.h"
+#include "CommandBuffer.h"
+
+#include <memory>
+
+// One deferred context per recording thread, each with its own binding table,
+// state cache, constant ring and command buffer. Chunks start with the immediate context's
+// render targets, viewports and output merger and rasterizer state as they
+// were at begin(). Lists are executed without keeping the immediate context's
+// state, so end() puts that state back and invalidates the immediate caches.
+class D3D11CommandListDevice : public CommandListDevice
+{
+public:
+	D3D11CommandListDevice() {}
+	~D3D11CommandListDevice() { release_output_state(); }
+
+	void init(ID3D11Device* pDevice, ID3D11DeviceContext* pImmediate, u32 numContexts,
+		BindingTable* pImmediateBindings, StateCache* pImmediateStateCache);
+
+	u32 num_contexts() const override { return static_cast<u32>(m_contexts.size()); }
+	RecordingContext& context(u32 context) override { return m_contexts[context]->context; }
+
+	void begin(u32 numLists) override;
+	void start(u32 context) override;
+	void finish(u32 context, u32 list) override;
+	void execute(u32 list) override;
+	void end() override;
+
+private:
+	struct Context
+	{
+		RecordingContext context;
+		ComPtr<ID3D11DeviceContext> deferred;
+		D3D11BindingDevice bindingDevice;
+		BindingTable bindings;
+		D3D11PipelineDevice pipelineDevice;
+		StateCache stateCache;
+		D3D11ConstantDevice constantDevice;
+		ConstantRing constants;
+		D3D11CommandDevice commandDevice;
+		CommandBuffer commands;
+	};
+
+	// Immediate context state shared with the chunks.
+	struct OutputState
+	{
+		ID3D11RenderTargetView* pTargets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+		ID3D11DepthStencilView* pDepth;
+		D3D11_VIEWPORT viewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+		UINT numViewports;
+		ID3D11DepthStencilState* pDepthState;
+		UINT stencilRef;
+		ID3D11BlendState* pBlendState;
+		FLOAT blendFactor[4];
+		UINT sampleMask;
+		ID3D11RasterizerState* pRasterizerState;
+	};
+
+	void release_output_state();
+	static void apply_output_state(ID3D11DeviceContext* pContext, const OutputState& state);
+
+	ID3D11DeviceContext* m_pImmediate = nullptr;
+	BindingTable* m_pImmediateBindings = nullptr;
+	StateCache* m_pImmediateStateCache = nullptr;
+	std::vector<std::unique_ptr<Context>> m_contexts;
+	std::vector<ComPtr<ID3D11CommandList>> m_lists;
+	OutputState m_output = {};
+};
+
+#endif
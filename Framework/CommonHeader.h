@@ -1,20 +1,9 @@
 #pragma once
 
 //////////////////////////////////////////////////////////////////////////
-// Common C/C++ headers from the standard
+// Platform independent types, assertions and debug printing.
 //////////////////////////////////////////////////////////////////////////
-
-#include <cstdint>
-#include <cassert>
-#include <cmath>
-#include <cstdarg>
-#include <cstddef>
-#include <cstdio>
-#include <cstring>
-
-
-#include <algorithm>
-#include <functional>
+#include "CoreTypes.h"
 
 //////////////////////////////////////////////////////////////////////////
 // Common Windows and directX Headers
@@ -57,32 +46,9 @@ using Microsoft::WRL::ComPtr;
 #include "imgui/imgui.h"
 
 //////////////////////////////////////////////////////////////////////////
-// Common game industry typedefs
-//  * Very compact when used in expressions.
-//  * Express the size in bytes.
+// Maths typedefs
 //////////////////////////////////////////////////////////////////////////
 
-// Unsigned
-using u8 = uint8_t;
-using u16 = uint16_t;
-using u32 = uint32_t;
-using u64 = uint64_t;
-
-// Signed
-using s8 = int8_t;
-using s16 = int16_t;
-using s32 = int32_t;
-using s64 = int64_t;
-
-// Floating point
-using f32 = float;
-using f64 = double;
-
-// Memory
-using memtype_t = u8;
-constexpr u64 KB = 1024;
-constexpr u64 MB = 1024 * KB;
-
 // Vector maths.
 using v2 = DirectX::SimpleMath::Vector2;
 using v3 = DirectX::SimpleMath::Vector3;
@@ -91,28 +57,9 @@ using m4x4 = DirectX::SimpleMath::Matrix;
 using m3x3 = DirectX::XMFLOAT3X3;
 using quat = DirectX::SimpleMath::Quaternion;
 
-//////////////////////////////////////////////////////////////////////////
-// Useful assertion macro
-//////////////////////////////////////////////////////////////////////////
-
-#define ASSERT(x) if(!(x)){ __debugbreak(); }
-
+// Release a COM object if set.
 #define SAFE_RELEASE(ptr) if(ptr){ ptr->Release(); }
 
-// ========================================================
-// Debug printing functions
-// ========================================================
-
-// Prints error to standard error stream.
-void errorF(const char * format, ...);
-
-// Printf to message box and abort
-void panicF(const char * format, ...);
-
-// Printf to console and debug output.
-void debugF(const char * format, ...);
-
-
 // ========================================================
 // Frequently used maths
 // ========================================================
@@ -0,0 +1,205 @@
+#include "Compression.h"
+
+// ========================================================
+// LZ4 block format constants.
+// See : https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+// ========================================================
+
+static const u32 kMinMatch = 4;
+static const u32 kLastLiterals = 5;	// The last 5 bytes are always literals.
+static const u32 kMatchSafeEnd = 12;	// A match can't start within 12 bytes of the end.
+static const u32 kMaxOffset = 65535;
+
+static const u32 kHashLog = 12;
+static const u32 kHashSize = 1u << kHashLog;
+
+static inline u32 read_u32(const u8* p)
+{
+	u32 v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline u32 hash_sequence(u32 sequence)
+{
+	return (sequence * 2654435761u) >> (32 - kHashLog);
+}
+
+// Writes a length using the 255 continuation byte scheme.
+static inline u8* write_length(u8* pOut, u32 length)
+{
+	while (length >= 255)
+	{
+		*pOut++ = 255;
+		length -= 255;
+	}
+	*pOut++ = static_cast<u8>(length);
+	return pOut;
+}
+
+u32 lz4_compress_bound(const u32 kSrcSize)
+{
+	return kSrcSize + kSrcSize / 255 + 16;
+}
+
+u32 lz4_compress(const u8* pSrc, const u32 kSrcSize, u8* pDst, const u32 kDstCapacity)
+{
+	if (kDstCapacity < lz4_compress_bound(kSrcSize))
+	{
+		return 0;
+	}
+
+	u32 hashTable[kHashSize];
+	memset(hashTable, 0xFF, sizeof(hashTable));
+
+	u8* pOut = pDst;
+	u32 anchor = 0; // Start of pending literals.
+	u32 pos = 0;
+
+	// Greedy match search, only where there is room for a legal match.
+	if (kSrcSize > kMatchSafeEnd)
+	{
+		const u32 kMatchLimit = kSrcSize - kMatchSafeEnd;
+		const u32 kMatchEnd = kSrcSize - kLastLiterals;
+
+		while (pos < kMatchLimit)
+		{
+			const u32 sequence = read_u32(pSrc + pos);
+			const u32 h = hash_sequence(sequence);
+			const u32 candidate = hashTable[h];
+			hashTable[h] = pos;
+
+			if (candidate == 0xFFFFFFFF || pos - candidate > kMaxOffset || read_u32(pSrc + candidate) != sequence)
+			{
+				++pos;
+				continue;
+			}
+
+			// Extend the match forwards, stopping short of the literal tail.
+			u32 matchLength = kMinMatch;
+			while (pos + matchLength < kMatchEnd && pSrc[candidate + matchLength] == pSrc[pos + matchLength])
+			{
+				++matchLength;
+			}
+
+			// Token, literals, offset, match length.
+			const u32 literalLength = pos - anchor;
+			u8* pToken = pOut++;
+			*pToken = static_cast<u8>(std::min(literalLength, 15u) << 4);
+			if (literalLength >= 15)
+			{
+				pOut = write_length(pOut, literalLength - 15);
+			}
+			memcpy(pOut, pSrc + anchor, literalLength);
+			pOut += literalLength;
+
+			const u32 offset = pos - candidate;
+			*pOut++ = static_cast<u8>(offset & 0xFF);
+			*pOut++ = static_cast<u8>(offset >> 8);
+
+			const u32 extraMatch = matchLength - kMinMatch;
+			*pToken |= static_cast<u8>(std::min(extraMatch, 15u));
+			if (extraMatch >= 15)
+			{
+				pOut = write_length(pOut, extraMatch - 15);
+			}
+
+			pos += matchLength;
+			anchor = pos;
+		}
+	}
+
+	// Final literal run.
+	const u32 literalLength = kSrcSize - anchor;
+	*pOut++ = static_cast<u8>(std::min(literalLength, 15u) << 4);
+	if (literalLength >= 15)
+	{
+		pOut = write_length(pOut, literalLength - 15);
+	}
+	memcpy(pOut, pSrc + anchor, literalLength);
+	pOut += literalLength;
+
+	return static_cast<u32>(pOut - pDst);
+}
+
+bool lz4_decompress(const u8* pSrc, const u32 kSrcSize, u8* pDst, const u32 kDstSize)
+{
+	const u8* pIn = pSrc;
+	const u8* const pInEnd = pSrc + kSrcSize;
+	u8* pOut = pDst;
+	u8* const pOutEnd = pDst + kDstSize;
+
+	while (pIn < pInEnd)
+	{
+		const u8 token = *pIn++;
+
+		// Literals.
+		u32 literalLength = token >> 4;
+		if (literalLength == 15)
+		{
+			u8 b;
+			do
+			{
+				if (pIn >= pInEnd) { return false; }
+				b = *pIn++;
+				literalLength += b;
+			} while (b == 255);
+		}
+		if (literalLength > static_cast<u64>(pInEnd - pIn) || literalLength > static_cast<u64>(pOutEnd - pOut))
+		{
+			return false;
+		}
+		memcpy(pOut, pIn, literalLength);
+		pIn += literalLength;
+		pOut += literalLength;
+
+		// The last sequence has no match.
+		if (pIn == pInEnd)
+		{
+			break;
+		}
+
+		// Match.
+		if (pInEnd - pIn < 2) { return false; }
+		const u32 offset = pIn[0] | (pIn[1] << 8);
+		pIn += 2;
+		if (offset == 0 || offset > static_cast<u64>(pOut - pDst))
+		{
+			return false;
+		}
+
+		u32 matchLength = token & 15;
+		if (matchLength == 15)
+		{
+			u8 b;
+			do
+			{
+				if (pIn >= pInEnd) { return false; }
+				b = *pIn++;
+				matchLength += b;
+			} while (b == 255);
+		}
+		matchLength += kMinMatch;
+		if (matchLength > static_cast<u64>(pOutEnd - pOut))
+		{
+			return false;
+		}
+
+		// Matches may overlap the output so copy forwards byte by byte when they do.
+		const u8* pMatch = pOut - offset;
+		if (offset >= matchLength)
+		{
+			memcpy(pOut, pMatch, matchLength);
+			pOut += matchLength;
+		}
+		else
+		{
+			for (u32 i = 0; i < matchLength; ++i)
+			{
+				*pOut++ = *pMatch++;
+			}
+		}
+	}
+
+	return pOut == pOutEnd;
+}
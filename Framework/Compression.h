@@ -0,0 +1,19 @@
+#pragma once
+
+#include "CoreTypes.h"
+
+//================================================================================
+// LZ4 block compression.
+// Implements the standard LZ4 block format (no frame header) so data can be
+// exchanged with the reference lz4 tools. Platform independent.
+//================================================================================
+
+// Worst case compressed size for an input of kSrcSize bytes.
+u32 lz4_compress_bound(const u32 kSrcSize);
+
+// Compress a block, returns the compressed size or 0 if it did not fit in kDstCapacity.
+u32 lz4_compress(const u8* pSrc, const u32 kSrcSize, u8* pDst, const u32 kDstCapacity);
+
+// Decompress a block into exactly kDstSize bytes.
+// Returns false if the input is malformed or does not decode to kDstSize bytes.
+bool lz4_decompress(const u8* pSrc, const u32 kSrcSize, u8* pDst, const u32 kDstSize);
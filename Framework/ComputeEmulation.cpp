@@ -0,0 +1,35 @@
+#include "ComputeEmulation.h"
+#include "JobQueue.h"
+
+#include <vector>
+
+void emulate_dispatch(u32 groupsX, u32 groupsY, u32 groupSharedBytes, const ComputeGroupKernel& kernel, JobPool* pPool)
+{
+	const u32 numGroups = groupsX * groupsY;
+
+	JobPool::RangeJob job = [&](u32 begin, u32 end)
+	{
+		// One block per range, like a core reusing its groupshared memory.
+		std::vector<u8> groupShared(groupSharedBytes ? groupSharedBytes : 1);
+
+		ComputeGroup group;
+		group.pGroupShared = groupShared.data();
+		for (u32 i = begin; i < end; ++i)
+		{
+			group.x = i % groupsX;
+			group.y = i / groupsX;
+			kernel(group);
+		}
+	};
+
+	if (pPool)
+	{
+		// A few ranges per worker keeps them busy when groups take uneven time.
+		const u32 numRanges = (pPool->numWorkers() + 1) * 4;
+		pPool->parallelFor(numGroups, compute_group_count(numGroups, numRanges), job);
+	}
+	else
+	{
+		job(0, numGroups);
+	}
+}
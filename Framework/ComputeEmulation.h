@@ -0,0 +1,32 @@
+#pragma once
+
+#include "CoreTypes.h"
+
+#include <functional>
+
+class JobPool;
+
+//================================================================================
+// CPU emulation of a 2D compute dispatch.
+// Platform independent.
+//
+// Thread groups are spread across the job pool. A group runs its own threads:
+// the kernel loops over them once per phase, where the shader would call
+// GroupMemoryBarrierWithGroupSync between phases, so groupshared data written
+// in one phase can be read by any thread of the group in the next.
+// Groups may run in any order and in parallel, like on a GPU.
+//================================================================================
+
+struct ComputeGroup
+{
+	u32 x, y;				// SV_GroupID.
+	void* pGroupShared;		// groupSharedBytes of scratch, not cleared between groups.
+};
+
+typedef std::function<void(const ComputeGroup& group)> ComputeGroupKernel;
+
+// Groups needed to cover size items with groupSize threads each.
+inline u32 compute_group_count(u32 size, u32 groupSize) { return (size + groupSize - 1) / groupSize; }
+
+// Run groupsX * groupsY groups. pPool may be null to run on the calling thread.
+void emulate_dispatch(u32 groupsX, u32 groupsY, u32 groupSharedBytes, const ComputeGroupKernel& kernel, JobPool* pPool = nullptr);
@@ -0,0 +1,217 @@
+#include "ConstantRing.h"
+
+// ========================================================
+// RecordingConstantDevice
+// ========================================================
+
+void RecordingConstantDevice::upload(const void* pData, u32 bytes)
+{
+	ASSERT(bytes <= m_capacity);
+	m_data.assign(static_cast<const u8*>(pData), static_cast<const u8*>(pData) + bytes);
+	++m_uploads;
+}
+
+// ========================================================
+// ConstantRing
+// ========================================================
+
+ConstantRing::ConstantRing()
+{
+}
+
+void ConstantRing::init(ConstantDevice* pDevice, u32 initialBytes)
+{
+	m_pDevice = pDevice;
+	m_capacity = (initialBytes + kAlignment - 1) & ~(kAlignment - 1);
+	m_pDevice->reserve(m_capacity);
+	m_data.reserve(m_capacity);
+	m_data.clear();
+	m_batch = 0;
+	m_bUploaded = false;
+}
+
+ConstantSlice ConstantRing::allocate(const void* pData, u32 size)
+{
+	ASSERT(m_pDevice && size > 0);
+
+	if (m_bUploaded)
+	{
+		m_data.clear();
+		++m_batch;
+		m_bUploaded = false;
+	}
+
+	const u32 offset = static_cast<u32>(m_data.size());
+	const u32 alignedSize = (size + kAlignment - 1) & ~(kAlignment - 1);
+	m_data.resize(offset + alignedSize);
+	memcpy(m_data.data() + offset, pData, size);
+	memset(m_data.data() + offset + size, 0, alignedSize - size);
+
+	++m_stats.slices;
+	m_stats.bytes += alignedSize;
+	return { offset, alignedSize, m_batch };
+}
+
+void ConstantRing::upload()
+{
+	ASSERT(m_pDevice);
+
+	if (m_bUploaded || m_data.empty())
+	{
+		return;
+	}
+
+	const u32 bytes = static_cast<u32>(m_data.size());
+	if (bytes > m_capacity)
+	{
+		while (m_capacity < bytes)
+		{
+			m_capacity *= 2;
+		}
+		m_pDevice->reserve(m_capacity);
+	}
+
+	m_pDevice->upload(m_data.data(), bytes);
+	m_bUploaded = true;
+	++m_stats.uploads;
+}
+
+void ConstantRing::bind(ShaderStage::ShaderStageEnum stage, u32 slot, const ConstantSlice& slice)
+{
+	// Only the last uploaded batch is on the GPU.
+	ASSERT(m_bUploaded && slice.batch == m_batch);
+
+	m_pDevice->bind(stage, slot, slice.offset, slice.size);
+	++m_stats.binds;
+}
+
+#if defined(_WIN32)
+
+// ========================================================
+// D3D11ConstantDevice
+// ========================================================
+
+void D3D11ConstantDevice::init(ID3D11Device* pDevice, ID3D11DeviceContext* pContext, bool bForceCopy)
+{
+	m_pDevice = pDevice;
+	m_pContext = pContext;
+	m_pContext1.Reset();
+
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	if (!bForceCopy
+		&& SUCCEEDED(pDevice->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options)))
+		&& options.ConstantBufferOffsetting)
+	{
+		pContext->QueryInterface(__uuidof(ID3D11DeviceContext1), reinterpret_cast<void**>(m_pContext1.GetAddressOf()));
+	}
+
+	if (!m_pContext1)
+	{
+		debugF("D3D11ConstantDevice : constant buffer offsets unsupported, copying slices instead");
+	}
+}
+
+void D3D11ConstantDevice::reserve(u32 bytes)
+{
+	if (m_buffer && bytes <= m_bytes)
+	{
+		return;
+	}
+
+	// With offsets the large buffer is bound directly, otherwise it is only copied from.
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = bytes;
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = m_pContext1 ? D3D11_BIND_CONSTANT_BUFFER : D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+	m_buffer.Reset();
+	if (FAILED(m_pDevice->CreateBuffer(&desc, nullptr, m_buffer.GetAddressOf())))
+	{
+		panicF("D3D11ConstantDevice : failed to create a %u byte constant buffer", bytes);
+	}
+	m_bytes = bytes;
+}
+
+void D3D11ConstantDevice::upload(const void* pData, u32 bytes)
+{
+	ASSERT(bytes <= m_bytes);
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(m_pContext->Map(m_buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+	{
+		panicF("D3D11ConstantDevice : failed to map the constant buffer");
+	}
+	memcpy(mapped.pData, pData, bytes);
+	m_pContext->Unmap(m_buffer.Get(), 0);
+
+	// The slot copies are of the previous contents.
+	for (SlotCopy& rSlot : m_slots)
+	{
+		rSlot.offset = ~0u;
+	}
+}
+
+void D3D11ConstantDevice::bind(ShaderStage::ShaderStageEnum stage, u32 slot, u32 offset, u32 size)
+{
+	ASSERT(slot < kMaxSlots && offset + size <= m_bytes);
+
+	ID3D11Buffer* pBuffer = m_buffer.Get();
+
+	if (m_pContext1)
+	{
+		// Offsets and sizes are in 16 byte constants.
+		const UINT firstConstant = offset / 16;
+		const UINT numConstants = size / 16;
+		switch (stage)
+		{
+		case ShaderStage::kVertex:   m_pContext1->VSSetConstantBuffers1(slot, 1, &pBuffer, &firstConstant, &numConstants); break;
+		case ShaderStage::kHull:     m_pContext1->HSSetConstantBuffers1(slot, 1, &pBuffer, &firstConstant, &numConstants); break;
+		case ShaderStage::kDomain:   m_pContext1->DSSetConstantBuffers1(slot, 1, &pBuffer, &firstConstant, &numConstants); break;
+		case ShaderStage::kGeometry: m_pContext1->GSSetConstantBuffers1(slot, 1, &pBuffer, &firstConstant, &numConstants); break;
+		case ShaderStage::kPixel:    m_pContext1->PSSetConstantBuffers1(slot, 1, &pBuffer, &firstConstant, &numConstants); break;
+		case ShaderStage::kCompute:  m_pContext1->CSSetConstantBuffers1(slot, 1, &pBuffer, &firstConstant, &numConstants); break;
+		default: break;
+		}
+		return;
+	}
+
+	// Fallback, copy the slice into the slot's own buffer on the GPU. Stages
+	// sharing a slot share the buffer, binding the same slice to VS and PS copies once.
+	SlotCopy& rSlot = m_slots[slot];
+	if (!rSlot.buffer || rSlot.bytes < size)
+	{
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = size;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+		rSlot.buffer.Reset();
+		if (FAILED(m_pDevice->CreateBuffer(&desc, nullptr, rSlot.buffer.GetAddressOf())))
+		{
+			panicF("D3D11ConstantDevice : failed to create a %u byte slot buffer", size);
+		}
+		rSlot.bytes = size;
+		rSlot.offset = ~0u;
+	}
+	if (rSlot.offset != offset)
+	{
+		const D3D11_BOX box = { offset, 0, 0, offset + size, 1, 1 };
+		m_pContext->CopySubresourceRegion(rSlot.buffer.Get(), 0, 0, 0, 0, m_buffer.Get(), 0, &box);
+		rSlot.offset = offset;
+	}
+
+	pBuffer = rSlot.buffer.Get();
+	switch (stage)
+	{
+	case ShaderStage::kVertex:   m_pContext->VSSetConstantBuffers(slot, 1, &pBuffer); break;
+	case ShaderStage::kHull:     m_pContext->HSSetConstantBuffers(slot, 1, &pBuffer); break;
+	case ShaderStage::kDomain:   m_pContext->DSSetConstantBuffers(slot, 1, &pBuffer); break;
+	case ShaderStage::kGeometry: m_pContext->GSSetConstantBuffers(slot, 1, &pBuffer); break;
+	case ShaderStage::kPixel:    m_pContext->PSSetConstantBuffers(slot, 1, &pBuffer); break;
+	case ShaderStage::kCompute:  m_pContext->CSSetConstantBuffers(slot, 1, &pBuffer); break;
+	default: break;
+	}
+}
+
+#endif
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "CoreTypes.h"
+#include "ShaderStage.h"
+
+#include <vector>
+
+//================================================================================
+// ConstantRing
+// Linear allocator for per-draw constant data. Draws allocate() their
+// constants as they are recorded, upload() writes the whole batch with one
+// Map(WRITE_DISCARD) of a single large buffer, and each draw then bind()s
+// its slice by offset. Maps go from one per draw to one per batch.
+//
+// The driver renames the buffer on every discard, so slices bound before the
+// next upload() keep their data on the GPU; the memory cycles like a ring
+// without the app fencing anything. Slices can only be bound until the next
+// upload(), allocating again after an upload starts a new batch.
+//
+// Slices are 256 byte aligned, the granularity of the D3D11.1
+// *SetConstantBuffers1 offsets. Where offset binding isn't supported the
+// D3D11 device falls back to copying each slice out of the large buffer into
+// a small constant buffer on the GPU, still with one map per batch.
+//
+// Platform independent, the buffer calls go to a ConstantDevice.
+// RecordingConstantDevice counts them so the batching can be checked without D3D.
+// Binds go straight to the device, don't set the same slots through a BindingTable.
+//================================================================================
+
+struct ConstantSlice
+{
+	u32 offset;		// Bytes into the batch.
+	u32 size;		// Bytes, a multiple of the alignment.
+	u32 batch;
+};
+
+// ========================================================
+// ConstantDevice
+// Owns the large buffer.
+// ========================================================
+class ConstantDevice
+{
+public:
+	virtual ~ConstantDevice() {}
+
+	// Make the buffer at least this big, its contents may be lost.
+	virtual void reserve(u32 bytes) = 0;
+
+	// Replace the contents, one discarding map.
+	virtual void upload(const void* pData, u32 bytes) = 0;
+
+	// Bind bytes [offset, offset + size) as the constant buffer in slot.
+	virtual void bind(ShaderStage::ShaderStageEnum stage, u32 slot, u32 offset, u32 size) = 0;
+};
+
+// Stand-in device that keeps the uploaded data and counts the calls.
+class RecordingConstantDevice : public ConstantDevice
+{
+public:
+	struct Bind
+	{
+		ShaderStage::ShaderStageEnum stage;
+		u32 slot;
+		u32 offset;
+		u32 size;
+	};
+
+	void reserve(u32 bytes) override { m_capacity = bytes > m_capacity ? bytes : m_capacity; ++m_reserves; }
+	void upload(const void* pData, u32 bytes) override;
+	void bind(ShaderStage::ShaderStageEnum stage, u32 slot, u32 offset, u32 size) override { m_binds.push_back({ stage, slot, offset, size }); }
+
+	u32 capacity() const { return m_capacity; }
+	const std::vector<u8>& data() const { return m_data; }
+
+	u32 num_reserves() const { return m_reserves; }
+	u32 num_uploads() const { return m_uploads; }
+	const std::vector<Bind>& binds() const { return m_binds; }
+	void clear_calls() { m_reserves = 0; m_uploads = 0; m_binds.clear(); }
+
+private:
+	u32 m_capacity = 0;
+	std::vector<u8> m_data;
+	u32 m_reserves = 0;
+	u32 m_uploads = 0;
+	std::vector<Bind> m_binds;
+};
+
+// ========================================================
+// ConstantRing
+// ========================================================
+class ConstantRing
+{
+public:
+	static const u32 kAlignment = 256;
+
+	struct Stats
+	{
+		u32 slices;		// Allocated.
+		u32 bytes;		// Allocated, with alignment.
+		u32 uploads;	// Maps.
+		u32 binds;
+	};
+
+	ConstantRing();
+
+	// initialBytes is the buffer created up front, it doubles when a batch needs more.
+	void init(ConstantDevice* pDevice, u32 initialBytes = 64 * 1024);
+
+	// Copy size bytes of constants into the current batch.
+	ConstantSlice allocate(const void* pData, u32 size);
+
+	template<typename ConstantBufferType>
+	ConstantSlice allocate(const ConstantBufferType& rData) { return allocate(&rData, sizeof(ConstantBufferType)); }
+
+	// Send the batch to the GPU, before the first bind() of its slices.
+	void upload();
+
+	// Bind a slice of the last uploaded batch.
+	void bind(ShaderStage::ShaderStageEnum stage, u32 slot, const ConstantSlice& slice);
+
+	u32 capacity() const { return m_capacity; }
+
+	const Stats& stats() const { return m_stats; }
+	void reset_stats() { m_stats = {}; }
+
+private:
+	ConstantDevice* m_pDevice = nullptr;
+	u32 m_capacity = 0;
+
+	std::vector<u8> m_data;		// The batch being allocated.
+	u32 m_batch = 0;			// Of m_data.
+	bool m_bUploaded = false;	// m_data has been sent, the next allocate() starts a new batch.
+
+	Stats m_stats = {};
+};
+
+#if defined(_WIN32)
+
+#include <d3d11_1.h>
+#include <wrl.h>
+
+// Binds by offset with ID3D11DeviceContext1 where the driver supports it,
+// otherwise copies slices into small per-slot constant buffers.
+class D3D11ConstantDevice : public ConstantDevice
+{
+public:
+	D3D11ConstantDevice() {}
+
+	// bForceCopy uses the fallback even where offsets are supported.
+	void init(ID3D11Device* pDevice, ID3D11DeviceContext* pContext, bool bForceCopy = false);
+
+	bool binds_by_offset() const { return m_pContext1 != nullptr; }
+
+	void reserve(u32 bytes) override;
+	void upload(const void* pData, u32 bytes) override;
+	void bind(ShaderStage::ShaderStageEnum stage, u32 slot, u32 offset, u32 size) override;
+
+private:
+	static const u32 kMaxSlots = D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT;
+
+	// Fallback buffer of one slot and the slice last copied into it.
+	struct SlotCopy
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+		u32 bytes = 0;
+		u32 offset = ~0u;
+	};
+
+	ID3D11Device* m_pDevice = nullptr;
+	ID3D11DeviceContext* m_pContext = nullptr;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> m_pContext1;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_buffer;
+	u32 m_bytes = 0;
+	SlotCopy m_slots[kMaxSlots];
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "CoreTypes.h"
+
+#include <cstdlib>
+
+#if defined(_WIN32)
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#endif
+
+//================================================================================
+// Debug print functions.
+//================================================================================
+
+void errorF(const char * format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vfprintf(stderr, format, args);
+	va_end(args);
+
+	// Default newline and flush (like std::endl)
+	std::fputc('\n', stderr);
+	std::fflush(stderr);
+}
+
+void panicF(const char * format, ...)
+{
+	va_list args;
+	char buffer[2048] = { '\0' };
+
+	va_start(args, format);
+	std::vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+#if defined(_WIN32)
+	MessageBoxA(nullptr, buffer, "Fatal Error", MB_OK);
+#else
+	std::fprintf(stderr, "Fatal Error : %s\n", buffer);
+#endif
+	std::abort();
+}
+
+void debugF(const char * format, ...)
+{
+	va_list args;
+	char buffer[2048] = { '\0' };
+
+	va_start(args, format);
+	std::vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+#if defined(_WIN32)
+	OutputDebugString(buffer);
+#else
+	std::fputs(buffer, stdout);
+#endif
+}
+
+//================================================================================
+// Hashing.
+//================================================================================
+
+u64 hash_bytes(const void* pData, u64 size, u64 hash)
+{
+	const u64 kPrime = 1099511628211ull;
+	const memtype_t* pBytes = static_cast<const memtype_t*>(pData);
+
+	// Whole words first, the tail is folded in a byte at a time.
+	u64 i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		u64 word;
+		memcpy(&word, pBytes + i, sizeof(word));
+		hash = (hash ^ word) * kPrime;
+	}
+	for (; i < size; ++i)
+	{
+		hash = (hash ^ pBytes[i]) * kPrime;
+	}
+	return hash;
+}
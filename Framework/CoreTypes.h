@@ -0,0 +1,83 @@
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////
+// Core types shared by the framework and the command line tools.
+// This header must stay free of Windows and DirectX headers so
+// anything built only on it compiles on any platform.
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+// Common C/C++ headers from the standard
+//////////////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+#include <cassert>
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+
+#include <algorithm>
+#include <functional>
+
+//////////////////////////////////////////////////////////////////////////
+// Common game industry typedefs
+//  * Very compact when used in expressions.
+//  * Express the size in bytes.
+//////////////////////////////////////////////////////////////////////////
+
+// Unsigned
+using u8 = uint8_t;
+using u16 = uint16_t;
+using u32 = uint32_t;
+using u64 = uint64_t;
+
+// Signed
+using s8 = int8_t;
+using s16 = int16_t;
+using s32 = int32_t;
+using s64 = int64_t;
+
+// Floating point
+using f32 = float;
+using f64 = double;
+
+// Memory
+using memtype_t = u8;
+constexpr u64 KB = 1024;
+constexpr u64 MB = 1024 * KB;
+
+//////////////////////////////////////////////////////////////////////////
+// Useful assertion macro
+//////////////////////////////////////////////////////////////////////////
+
+#if defined(_MSC_VER)
+	#define ASSERT(x) if(!(x)){ __debugbreak(); }
+#else
+	#define ASSERT(x) if(!(x)){ __builtin_trap(); }
+#endif
+
+// ========================================================
+// Debug printing functions
+// ========================================================
+
+// Prints error to standard error stream.
+void errorF(const char * format, ...);
+
+// Printf to message box and abort
+void panicF(const char * format, ...);
+
+// Printf to console and debug output.
+void debugF(const char * format, ...);
+
+// ========================================================
+// Hashing
+// ========================================================
+
+constexpr u64 kHashSeed = 14695981039346656037ull;
+
+// FNV-1a over 64 bit words, fine for cache keys but not for anything adversarial.
+// Chain calls by passing the previous result as the seed.
+u64 hash_bytes(const void* pData, u64 size, u64 hash = kHashSeed);
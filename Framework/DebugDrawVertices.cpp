@@ -0,0 +1,94 @@
+#include "DebugDrawVertices.h"
+
+void expand_debug_points(const dd::DrawVertex* pPoints, u32 count, const f32 right[3], const f32 up[3], DebugDrawVertex* pVerticesOut)
+{
+	static const u32 kCorners[kDebugDrawVerticesPerPoint] = { 0, 1, 2, 2, 3, 0 };
+
+	DebugDrawVertex* pVertex = pVerticesOut;
+	for (u32 p = 0; p < count; ++p)
+	{
+		const auto& rPoint = pPoints[p].point;
+		const f32 halfSize = rPoint.size * kDebugDrawPointScale * 0.5f;
+		const f32 origin[3] = { rPoint.x, rPoint.y, rPoint.z };
+
+		// Corners counter clockwise from the top right.
+		const f32 signX[4] = { 1.f, -1.f, -1.f, 1.f };
+		const f32 signY[4] = { 1.f, 1.f, -1.f, -1.f };
+		f32 corners[4][3];
+		for (u32 c = 0; c < 4; ++c)
+		{
+			for (u32 axis = 0; axis < 3; ++axis)
+			{
+				corners[c][axis] = origin[axis] + halfSize * (signX[c] * right[axis] + signY[c] * up[axis]);
+			}
+		}
+
+		for (u32 c : kCorners)
+		{
+			pVertex->pos[0] = corners[c][0];
+			pVertex->pos[1] = corners[c][1];
+			pVertex->pos[2] = corners[c][2];
+			pVertex->pos[3] = 1.0f;
+
+			pVertex->uv[0] = 0.0f;
+			pVertex->uv[1] = 0.0f;
+			pVertex->uv[2] = 0.0f;
+			pVertex->uv[3] = 0.0f;
+
+			pVertex->colour[0] = rPoint.r;
+			pVertex->colour[1] = rPoint.g;
+			pVertex->colour[2] = rPoint.b;
+			pVertex->colour[3] = 1.0f;
+
+			++pVertex;
+		}
+	}
+}
+
+void copy_debug_lines(const dd::DrawVertex* pLines, u32 count, DebugDrawVertex* pVerticesOut)
+{
+	for (u32 v = 0; v < count; ++v)
+	{
+		const auto& rLine = pLines[v].line;
+		DebugDrawVertex& rVertex = pVerticesOut[v];
+
+		rVertex.pos[0] = rLine.x;
+		rVertex.pos[1] = rLine.y;
+		rVertex.pos[2] = rLine.z;
+		rVertex.pos[3] = 1.0f;
+
+		rVertex.uv[0] = 0.0f;
+		rVertex.uv[1] = 0.0f;
+		rVertex.uv[2] = 0.0f;
+		rVertex.uv[3] = 0.0f;
+
+		rVertex.colour[0] = rLine.r;
+		rVertex.colour[1] = rLine.g;
+		rVertex.colour[2] = rLine.b;
+		rVertex.colour[3] = 1.0f;
+	}
+}
+
+void copy_debug_glyphs(const dd::DrawVertex* pGlyphs, u32 count, DebugDrawVertex* pVerticesOut)
+{
+	for (u32 v = 0; v < count; ++v)
+	{
+		const auto& rGlyph = pGlyphs[v].glyph;
+		DebugDrawVertex& rVertex = pVerticesOut[v];
+
+		rVertex.pos[0] = rGlyph.x;
+		rVertex.pos[1] = rGlyph.y;
+		rVertex.pos[2] = 0.0f;
+		rVertex.pos[3] = 1.0f;
+
+		rVertex.uv[0] = rGlyph.u;
+		rVertex.uv[1] = rGlyph.v;
+		rVertex.uv[2] = 0.0f;
+		rVertex.uv[3] = 0.0f;
+
+		rVertex.colour[0] = rGlyph.r;
+		rVertex.colour[1] = rGlyph.g;
+		rVertex.colour[2] = rGlyph.b;
+		rVertex.colour[3] = 1.0f;
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "CoreTypes.h"
+
+// The header's implementation half has no guard, so only include it if
+// CommonHeader.h hasn't already.
+#ifndef DEBUG_DRAW_HPP
+#ifndef DEBUG_DRAW_EXPLICIT_CONTEXT
+#define DEBUG_DRAW_EXPLICIT_CONTEXT
+#endif
+#include "debug_draw/debug_draw.hpp"
+#endif
+
+//================================================================================
+// Debug draw vertices
+// The queued points, lines and glyphs debug_draw hands the render interface,
+// written out as the vertices the debug draw shaders read.
+// Platform independent, the D3D11 render interface writes straight into its
+// mapped vertex buffers.
+//================================================================================
+
+// Same layout as the shaders' input, three aligned float4s.
+struct alignas(16) DebugDrawVertex
+{
+	f32 pos[4];
+	f32 uv[4];
+	f32 colour[4];
+};
+
+// Points are drawn as quads facing the camera, two triangles each.
+static const u32 kDebugDrawVerticesPerPoint = 6;
+
+// Scales debug_draw's point sizes, which are in pixels for GL point sprites,
+// to world units for the quads.
+static const f32 kDebugDrawPointScale = 0.01f;
+
+// Writes count * kDebugDrawVerticesPerPoint vertices. right and up are the camera's axes.
+void expand_debug_points(const dd::DrawVertex* pPoints, u32 count, const f32 right[3], const f32 up[3], DebugDrawVertex* pVerticesOut);
+
+// One vertex for each of count, lines in pairs and glyphs in screen space.
+void copy_debug_lines(const dd::DrawVertex* pLines, u32 count, DebugDrawVertex* pVerticesOut);
+void copy_debug_glyphs(const dd::DrawVertex* pGlyphs, u32 count, DebugDrawVertex* pVerticesOut);
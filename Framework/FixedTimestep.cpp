@@ -0,0 +1,47 @@
+#include "FixedTimestep.h"
+
+// ========================================================
+// FixedTimestep
+// ========================================================
+
+void FixedTimestep::set_rate_hz(f64 hz)
+{
+	ASSERT(hz > 0.0);
+
+	// Keep the same fraction of a step, so alpha doesn't jump.
+	const f64 fraction = m_accumulator / m_stepSeconds;
+	m_stepSeconds = 1.0 / hz;
+	m_accumulator = fraction * m_stepSeconds;
+}
+
+u32 FixedTimestep::advance(f64 elapsedSeconds)
+{
+	m_accumulator += elapsedSeconds > 0.0 ? elapsedSeconds : 0.0;
+
+	u32 steps = static_cast<u32>(m_accumulator / m_stepSeconds);
+	if (steps > m_maxSteps)
+	{
+		// Too far behind to catch up, drop the time the extra steps would have covered.
+		const f64 dropped = (steps - m_maxSteps) * m_stepSeconds;
+		m_droppedSeconds += dropped;
+		m_accumulator -= dropped;
+		steps = m_maxSteps;
+	}
+
+	m_accumulator -= steps * m_stepSeconds;
+	if (m_accumulator < 0.0)
+	{
+		m_accumulator = 0.0;
+	}
+	m_time += steps * m_stepSeconds;
+	m_steps += steps;
+	return steps;
+}
+
+void FixedTimestep::reset()
+{
+	m_accumulator = 0.0;
+	m_time = 0.0;
+	m_steps = 0;
+	m_droppedSeconds = 0.0;
+}
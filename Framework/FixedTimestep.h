@@ -0,0 +1,251 @@
+#pragma once
+
+#include "CoreTypes.h"
+#include "JobQueue.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+//================================================================================
+// Fixed timestep
+// Runs a simulation in steps of a fixed length whatever the frame rate, so it
+// behaves the same at 30 or 300 frames a second and in headless runs.
+//
+// FixedTimestep is the accumulator. Each frame adds the time that passed and
+// takes as many whole steps as that covers, the rest carries over to the next
+// frame. The frame then draws alpha() of the way from the state before the
+// last step to the state after it, so motion is smooth when the frame and
+// step rates don't line up.
+//
+// FixedStepSimulation keeps the states and runs the steps, either in
+// begin_frame() or as a job on a JobPool. On the pool the steps a frame
+// starts run while the main thread renders it, and are shown the frame
+// after: update and render submission overlap at the cost of a frame of
+// latency. Render reads previous() and current(), which no step writes
+// until the next begin_frame().
+//
+// Platform independent.
+//================================================================================
+
+// ========================================================
+// FixedTimestep
+// ========================================================
+class FixedTimestep
+{
+public:
+	FixedTimestep() {}
+
+	// Steps a second, 60 by default.
+	void set_rate_hz(f64 hz);
+	f64 rate_hz() const { return 1.0 / m_stepSeconds; }
+	f64 step_seconds() const { return m_stepSeconds; }
+
+	// Most steps one frame takes, 8 by default. A frame slower than that
+	// drops the rest of its time instead of falling further behind.
+	void set_max_steps(u32 steps) { m_maxSteps = steps ? steps : 1; }
+	u32 max_steps() const { return m_maxSteps; }
+
+	// Add the time since the last frame, returns the steps to take.
+	u32 advance(f64 elapsedSeconds);
+
+	// How far the frame is past the last step, in steps, 0 to 1.
+	f32 alpha() const { return static_cast<f32>(m_accumulator / m_stepSeconds); }
+
+	// Simulated time, the steps taken so far.
+	f64 time() const { return m_time; }
+	u64 steps() const { return m_steps; }
+	f64 dropped_seconds() const { return m_droppedSeconds; }
+
+	void reset();
+
+private:
+	f64 m_stepSeconds = 1.0 / 60.0;
+	u32 m_maxSteps = 8;
+	f64 m_accumulator = 0.0;
+	f64 m_time = 0.0;
+	u64 m_steps = 0;
+	f64 m_droppedSeconds = 0.0;
+};
+
+// ========================================================
+// FixedStepSimulation
+// ========================================================
+template <typename State>
+class FixedStepSimulation
+{
+public:
+	// One step of dt seconds from previous into next. next holds an older
+	// state, write all of it. On the pool this runs on a worker, it must only
+	// touch the states and what it owns.
+	typedef std::function<void(const State& previous, State& next, f32 dt)> StepFn;
+
+	FixedStepSimulation() {}
+	~FixedStepSimulation() { sync(); }
+
+	// pJobPool may be null to run the steps in begin_frame().
+	void init(const State& initial, StepFn step, JobPool* pJobPool = nullptr)
+	{
+		m_step = std::move(step);
+		m_pJobPool = pJobPool;
+		reset(initial);
+	}
+
+	// Once a frame on the main thread, with the time since the last.
+	void begin_frame(f64 elapsedSeconds)
+	{
+		sync();
+
+		// On the pool the states shown are a frame behind, and so is their alpha.
+		m_alpha = m_pJobPool ? m_nextAlpha : 0.f;
+
+		const u32 steps = m_timestep.advance(elapsedSeconds);
+		const f32 dt = static_cast<f32>(m_timestep.step_seconds());
+		m_nextAlpha = m_timestep.alpha();
+		m_frameSteps = steps;
+		if (steps == 0)
+		{
+			if (!m_pJobPool)
+			{
+				m_alpha = m_nextAlpha;
+			}
+			return;
+		}
+
+		if (!m_pJobPool)
+		{
+			run_steps(steps, dt);
+			show_steps();
+			m_alpha = m_nextAlpha;
+			return;
+		}
+
+		m_bInFlight = true;
+		m_bRunning = true;
+		m_pJobPool->pushJob([this, steps, dt]()
+		{
+			run_steps(steps, dt);
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bRunning = false;
+			m_done.notify_all();
+		});
+	}
+
+	// Wait for the steps in flight and show them.
+	void sync()
+	{
+		if (!m_bInFlight)
+		{
+			return;
+		}
+
+		{
+			PROFILE_SCOPE("Wait for fixed steps");
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_done.wait(lock, [this]() { return !m_bRunning; });
+		}
+		show_steps();
+		m_bInFlight = false;
+	}
+
+	// Both states become state, e.g. to jump without interpolating.
+	void reset(const State& state)
+	{
+		sync();
+		for (State& rSlot : m_slots)
+		{
+			rSlot = state;
+		}
+		m_previous = 0;
+		m_current = 1;
+		m_alpha = 0.f;
+		m_nextAlpha = 0.f;
+	}
+
+	// Run the steps on the pool, or in begin_frame() with null. Waits for the steps in flight.
+	void set_job_pool(JobPool* pJobPool)
+	{
+		sync();
+		m_pJobPool = pJobPool;
+	}
+	bool threaded() const { return m_pJobPool != nullptr; }
+
+	FixedTimestep& timestep() { return m_timestep; }
+	const FixedTimestep& timestep() const { return m_timestep; }
+
+	// The states to draw this frame, alpha() of the way from previous to current.
+	const State& previous() const { return m_slots[m_previous]; }
+	const State& current() const { return m_slots[m_current]; }
+	f32 alpha() const { return m_alpha; }
+
+	// Steps begin_frame() started last and how long the last steps run took.
+	u32 frame_steps() const { return m_frameSteps; }
+	f64 steps_ms() const { return m_stepsMs; }
+
+private:
+	FixedStepSimulation(const FixedStepSimulation&) = delete;
+	FixedStepSimulation& operator=(const FixedStepSimulation&) = delete;
+
+	// Steps go into the two slots render isn't reading, turn about, starting from current.
+	void run_steps(u32 steps, f32 dt)
+	{
+		PROFILE_SCOPE("Fixed steps");
+		const auto start = std::chrono::steady_clock::now();
+
+		u32 free[2];
+		u32 numFree = 0;
+		for (u32 slot = 0; slot < kNumSlots; ++slot)
+		{
+			if (slot != m_previous && slot != m_current)
+			{
+				free[numFree++] = slot;
+			}
+		}
+
+		u32 from = m_current;
+		u32 before = m_current;
+		for (u32 step = 0; step < steps; ++step)
+		{
+			const u32 to = free[step & 1];
+			m_step(m_slots[from], m_slots[to], dt);
+			before = from;
+			from = to;
+		}
+		m_stepsPrevious = before;
+		m_stepsCurrent = from;
+
+		m_runMs = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void show_steps()
+	{
+		m_previous = m_stepsPrevious;
+		m_current = m_stepsCurrent;
+		m_stepsMs = m_runMs;
+	}
+
+	static const u32 kNumSlots = 4;
+
+	StepFn m_step;
+	JobPool* m_pJobPool = nullptr;
+	FixedTimestep m_timestep;
+
+	State m_slots[kNumSlots];
+	u32 m_previous = 0;			// Slots render reads.
+	u32 m_current = 1;
+	u32 m_stepsPrevious = 0;	// Slots the last steps ended on, shown by show_steps().
+	u32 m_stepsCurrent = 1;
+	f64 m_runMs = 0.0;
+	f32 m_alpha = 0.f;
+	f32 m_nextAlpha = 0.f;
+	u32 m_frameSteps = 0;
+	f64 m_stepsMs = 0.0;
+
+	bool m_bInFlight = false;	// Main thread only.
+	bool m_bRunning = false;	// Under m_mutex.
+	std::mutex m_mutex;
+	std::condition_variable m_done;
+};
@@ -0,0 +1,240 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#if defined(_WIN32)
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+	#include <timeapi.h>
+	#pragma comment(lib, "winmm")
+#endif
+
+static const char* const kPacingModeNames[kNumPacingModes] = { "vsync", "uncapped", "fixed", "low-latency" };
+
+const char* pacing_mode_name(PacingMode mode)
+{
+	return mode < kNumPacingModes ? kPacingModeNames[mode] : "unknown";
+}
+
+bool parse_pacing_mode(const char* pName, PacingMode& rModeOut)
+{
+	for (u32 mode = 0; mode < kNumPacingModes; ++mode)
+	{
+		if (strcmp(pName, kPacingModeNames[mode]) == 0)
+		{
+			rModeOut = static_cast<PacingMode>(mode);
+			return true;
+		}
+	}
+	return false;
+}
+
+// ========================================================
+// SystemPacingClock
+// ========================================================
+
+SystemPacingClock::SystemPacingClock()
+{
+#if defined(_WIN32)
+	timeBeginPeriod(1);
+#endif
+}
+
+SystemPacingClock::~SystemPacingClock()
+{
+#if defined(_WIN32)
+	timeEndPeriod(1);
+#endif
+}
+
+u64 SystemPacingClock::now_ns()
+{
+	return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void SystemPacingClock::sleep_ns(u64 ns)
+{
+	std::this_thread::sleep_for(std::chrono::nanoseconds(ns));
+}
+
+// ========================================================
+// FramePacer
+// ========================================================
+
+void FramePacer::init(PacingClock* pClock)
+{
+	ASSERT(pClock);
+	m_pClock = pClock;
+	m_intervalMs.reserve(kHistory);
+	m_latencyMs.reserve(kHistory);
+	m_waitMs.reserve(kHistory);
+}
+
+void FramePacer::set_mode(PacingMode mode)
+{
+	ASSERT(mode < kNumPacingModes);
+	m_mode = mode;
+	m_bScheduled = false;
+}
+
+void FramePacer::set_target_hz(f64 hz)
+{
+	ASSERT(hz > 0.0);
+	m_periodNs = std::max<u64>(static_cast<u64>(1e9 / hz), 1);
+	m_bScheduled = false;
+}
+
+u64 FramePacer::lead_ns() const
+{
+	return m_mode == kPacingLowLatency ? predicted_frame_ns() + m_marginNs : 0;
+}
+
+u64 FramePacer::predicted_frame_ns() const
+{
+	const u32 count = m_recent < kPredictFrames ? m_recent : kPredictFrames;
+	u64 slowest = 0;
+	for (u32 frame = 0; frame < count; ++frame)
+	{
+		slowest = std::max(slowest, m_recentNs[frame]);
+	}
+	return slowest;
+}
+
+void FramePacer::wait_until(u64 deadlineNs)
+{
+	for (;;)
+	{
+		const u64 now = m_pClock->now_ns();
+		if (now >= deadlineNs)
+		{
+			return;
+		}
+
+		// Spin the last stretch, a sleep might not wake in time.
+		const u64 remaining = deadlineNs - now;
+		if (remaining > m_spinNs)
+		{
+			m_pClock->sleep_ns(remaining - m_spinNs);
+		}
+	}
+}
+
+void FramePacer::record(std::vector<f64>& rHistory, u32 count, f64 value)
+{
+	if (rHistory.size() < kHistory)
+	{
+		rHistory.push_back(value);
+	}
+	else
+	{
+		rHistory[count % kHistory] = value;
+	}
+}
+
+void FramePacer::wait_for_frame()
+{
+	ASSERT(m_pClock);
+	ASSERT(!m_bInFrame);
+
+	const u64 now = m_pClock->now_ns();
+
+	if (m_mode == kPacingFixedRate || m_mode == kPacingLowLatency)
+	{
+		const u64 leadNs = lead_ns();
+		if (!m_bScheduled)
+		{
+			m_dueNs = now + leadNs;
+			m_bScheduled = true;
+		}
+
+		u64 startNs = m_dueNs > leadNs ? m_dueNs - leadNs : 0;
+		if (now > startNs)
+		{
+			// Too late for whole periods, move on to the next it can make.
+			const u64 lateNs = now - startNs;
+			const u64 missed = lateNs / m_periodNs;
+			m_dueNs += missed * m_periodNs;
+			m_skipped += static_cast<u32>(missed);
+			if (lateNs > kLateNs)
+			{
+				++m_late;
+			}
+			startNs = now;
+		}
+
+		wait_until(startNs);
+		m_dueNs += m_periodNs;
+	}
+
+	m_frameStartNs = m_pClock->now_ns();
+	record(m_waitMs, m_frames, (m_frameStartNs - now) * 1e-6);
+	if (m_frames > 0)
+	{
+		record(m_intervalMs, m_frames - 1, (m_frameStartNs - m_lastStartNs) * 1e-6);
+	}
+	m_lastStartNs = m_frameStartNs;
+	++m_frames;
+	m_bInFrame = true;
+}
+
+void FramePacer::end_frame()
+{
+	if (!m_bInFrame)
+	{
+		return;
+	}
+
+	const u64 latencyNs = m_pClock->now_ns() - m_frameStartNs;
+	record(m_latencyMs, m_ended++, latencyNs * 1e-6);
+	m_recentNs[m_recent++ % kPredictFrames] = latencyNs;
+	m_bInFrame = false;
+}
+
+FramePacingStats FramePacer::stats() const
+{
+	FramePacingStats stats = {};
+
+	FrameTimings timings;
+	timings.reserve(kHistory);
+	for (f64 ms : m_intervalMs)
+	{
+		timings.add(ms);
+	}
+	stats.interval = timings.summarize();
+
+	timings.clear();
+	for (f64 ms : m_latencyMs)
+	{
+		timings.add(ms);
+	}
+	stats.latency = timings.summarize();
+
+	for (f64 ms : m_waitMs)
+	{
+		stats.waitMs += ms;
+	}
+	stats.waitMs = m_waitMs.empty() ? 0.0 : stats.waitMs / m_waitMs.size();
+	stats.late = m_late;
+	stats.skipped = m_skipped;
+	return stats;
+}
+
+void FramePacer::reset_stats()
+{
+	m_frames = 0;
+	m_ended = 0;
+	m_intervalMs.clear();
+	m_latencyMs.clear();
+	m_waitMs.clear();
+	m_late = 0;
+	m_skipped = 0;
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "CoreTypes.h"
+#include "FrameTimings.h"
+
+#include <vector>
+
+//================================================================================
+// FramePacer
+// Decides when each frame starts, so frames come out at an even rate or with
+// as little time as possible between reading input and presenting.
+//
+//  kPacingVsync       Present waits for the display, the pacer never waits.
+//  kPacingUncapped    Nothing waits, frames go as fast as they can.
+//  kPacingFixedRate   Frames start target_hz() times a second.
+//  kPacingLowLatency  Frames are due target_hz() times a second and start as
+//                     late as they can and still be done in time, so input
+//                     is read just before it's needed.
+//
+// Low latency predicts a frame's time from the slowest of the last few and
+// starts that long, plus a margin, before the frame is due.
+//
+// Waits sleep until close to the start then spin the rest, the OS can wake a
+// sleep a millisecond or more late but a spin is exact. Frames that start
+// late keep to the same cadence, the ones they can no longer make are
+// skipped rather than caught up.
+//
+// Per frame: wait_for_frame() before reading input, end_frame() once Present
+// has returned. The pacer keeps the interval between frame starts, which is
+// what the viewer sees the frame times vary by, and the latency from the
+// start to Present returning, over the last kHistory frames.
+//
+// Platform independent, time comes from a PacingClock. SystemPacingClock is
+// the real one, ManualPacingClock only moves when it's read, slept on or
+// advanced so the pacing can be checked headless.
+//================================================================================
+
+enum PacingMode : u32
+{
+	kPacingVsync,
+	kPacingUncapped,
+	kPacingFixedRate,
+	kPacingLowLatency,
+
+	kNumPacingModes
+};
+
+// "vsync", "uncapped", "fixed" and "low-latency".
+const char* pacing_mode_name(PacingMode mode);
+
+// False if pName isn't one of pacing_mode_name()'s.
+bool parse_pacing_mode(const char* pName, PacingMode& rModeOut);
+
+// ========================================================
+// PacingClock
+// ========================================================
+class PacingClock
+{
+public:
+	virtual ~PacingClock() {}
+
+	virtual u64 now_ns() = 0;
+
+	// Sleep about ns, may wake late.
+	virtual void sleep_ns(u64 ns) = 0;
+};
+
+// steady_clock and the OS sleep. On Windows the timer resolution is raised
+// to 1 ms while the clock exists, sleeps would otherwise wake up to 15.6 ms late.
+class SystemPacingClock : public PacingClock
+{
+public:
+	SystemPacingClock();
+	~SystemPacingClock();
+
+	u64 now_ns() override;
+	void sleep_ns(u64 ns) override;
+
+private:
+	SystemPacingClock(const SystemPacingClock&) = delete;
+	SystemPacingClock& operator=(const SystemPacingClock&) = delete;
+};
+
+// Time moves readCostNs on every now_ns(), so spins end, and by the time
+// asked plus oversleepNs on every sleep_ns(). advance() stands in for the
+// frame's own work.
+class ManualPacingClock : public PacingClock
+{
+public:
+	explicit ManualPacingClock(u64 oversleepNs = 0, u64 readCostNs = 1000)
+		: m_oversleepNs(oversleepNs)
+		, m_readCostNs(readCostNs)
+	{}
+
+	u64 now_ns() override { m_now += m_readCostNs; return m_now; }
+	void sleep_ns(u64 ns) override { m_now += ns + m_oversleepNs; ++m_sleeps; }
+
+	void advance(u64 ns) { m_now += ns; }
+
+	u64 time() const { return m_now; }
+	u32 num_sleeps() const { return m_sleeps; }
+
+private:
+	u64 m_now = 0;
+	u64 m_oversleepNs;
+	u64 m_readCostNs;
+	u32 m_sleeps = 0;
+};
+
+// ========================================================
+// FramePacer
+// ========================================================
+
+struct FramePacingStats
+{
+	FrameTimeSummary interval;	// Between frame starts.
+	FrameTimeSummary latency;	// Frame start to Present returning.
+	f64 waitMs;					// Mean time waiting for the frame start.
+	u32 late;					// Frames that started over kLateNs after they were due to.
+	u32 skipped;				// Deadlines passed over by late frames.
+};
+
+class FramePacer
+{
+public:
+	static const u32 kHistory = 256;
+	static const u32 kPredictFrames = 8;
+	static const u64 kLateNs = 500000;
+
+	FramePacer() {}
+
+	void init(PacingClock* pClock);
+
+	void set_mode(PacingMode mode);
+	PacingMode mode() const { return m_mode; }
+
+	// Rate of the fixed and low latency modes.
+	void set_target_hz(f64 hz);
+	f64 target_hz() const { return 1e9 / m_periodNs; }
+
+	// Sleeps end this long before the start and spin the rest, 2 ms by default.
+	void set_spin_ns(u64 ns) { m_spinNs = ns; }
+	u64 spin_ns() const { return m_spinNs; }
+
+	// Low latency starts this much earlier than the prediction needs, 0.5 ms by default.
+	void set_latency_margin_ns(u64 ns) { m_marginNs = ns; }
+	u64 latency_margin_ns() const { return m_marginNs; }
+
+	// For Present, 1 to wait for vsync, 0 when the pacer sets the rate.
+	u32 sync_interval() const { return m_mode == kPacingVsync ? 1 : 0; }
+
+	// Wait for the next frame to start, read input after.
+	void wait_for_frame();
+
+	// After Present returns.
+	void end_frame();
+
+	// Low latency's guess at the next frame's start to Present, 0 before any.
+	u64 predicted_frame_ns() const;
+
+	// Over the last kHistory frames.
+	FramePacingStats stats() const;
+	void reset_stats();
+
+private:
+	FramePacer(const FramePacer&) = delete;
+	FramePacer& operator=(const FramePacer&) = delete;
+
+	// Sleep then spin until the clock reads deadlineNs or later.
+	void wait_until(u64 deadlineNs);
+
+	// How long before the frame is due it starts.
+	u64 lead_ns() const;
+
+	static void record(std::vector<f64>& rHistory, u32 count, f64 value);
+
+	PacingClock* m_pClock = nullptr;
+	PacingMode m_mode = kPacingVsync;
+	u64 m_periodNs = 1000000000 / 60;
+	u64 m_spinNs = 2000000;
+	u64 m_marginNs = 500000;
+
+	bool m_bScheduled = false;	// m_dueNs is set, false until the first paced frame.
+	u64 m_dueNs = 0;			// When the next frame is due, its start or its Present.
+	u64 m_frameStartNs = 0;
+	u64 m_lastStartNs = 0;
+	bool m_bInFrame = false;
+
+	u32 m_frames = 0;			// Started since reset_stats().
+	u32 m_ended = 0;
+	std::vector<f64> m_intervalMs;
+	std::vector<f64> m_latencyMs;
+	std::vector<f64> m_waitMs;
+	u64 m_recentNs[kPredictFrames] = {};	// Start to Present of the last frames, for the prediction.
+	u32 m_recent = 0;
+	u32 m_late = 0;
+	u32 m_skipped = 0;
+};
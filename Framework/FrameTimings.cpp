@@ -0,0 +1,71 @@
+#include "FrameTimings.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+// Nearest rank, the smallest time at least fraction of the frames are within.
+static f64 percentile(const std::vector<f64>& sorted, f64 fraction)
+{
+	const size_t rank = static_cast<size_t>(fraction * sorted.size() + 0.999999);
+	return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+FrameTimeSummary FrameTimings::summarize() const
+{
+	FrameTimeSummary summary = {};
+	if (m_times.empty())
+	{
+		return summary;
+	}
+
+	std::vector<f64> sorted(m_times);
+	std::sort(sorted.begin(), sorted.end());
+
+	for (f64 ms : sorted)
+	{
+		summary.totalMs += ms;
+	}
+	summary.frames = count();
+	summary.minMs = sorted.front();
+	summary.meanMs = summary.totalMs / sorted.size();
+	f64 variance = 0.0;
+	for (f64 ms : sorted)
+	{
+		variance += (ms - summary.meanMs) * (ms - summary.meanMs);
+	}
+	summary.stdDevMs = std::sqrt(variance / sorted.size());
+	summary.medianMs = percentile(sorted, 0.5);
+	summary.p95Ms = percentile(sorted, 0.95);
+	summary.p99Ms = percentile(sorted, 0.99);
+	summary.maxMs = sorted.back();
+	return summary;
+}
+
+bool FrameTimings::write_report(const char* pPath, const char* pTitle) const
+{
+	std::ofstream out(pPath, std::ios::trunc);
+	if (!out)
+	{
+		errorF("FrameTimings : can't write report %s", pPath);
+		return false;
+	}
+
+	const FrameTimeSummary summary = summarize();
+	char line[256];
+	out << "# " << pTitle << "\n";
+	std::snprintf(line, sizeof(line), "# frames %u, total %.3f ms\n", summary.frames, summary.totalMs);
+	out << line;
+	std::snprintf(line, sizeof(line), "# min %.3f, mean %.3f, std dev %.3f, median %.3f, p95 %.3f, p99 %.3f, max %.3f ms\n",
+		summary.minMs, summary.meanMs, summary.stdDevMs, summary.medianMs, summary.p95Ms, summary.p99Ms, summary.maxMs);
+	out << line;
+	out << "frame,ms\n";
+	for (u32 frame = 0; frame < count(); ++frame)
+	{
+		std::snprintf(line, sizeof(line), "%u,%.4f\n", frame, m_times[frame]);
+		out << line;
+	}
+
+	return static_cast<bool>(out);
+}
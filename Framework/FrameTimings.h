@@ -0,0 +1,49 @@
+#pragma once
+
+#include "CoreTypes.h"
+
+#include <vector>
+
+//================================================================================
+// Frame timings
+// The time of each frame of a run, summarized into the numbers a regression
+// run compares: the mean, the spread and the tail percentiles, not just the
+// average fps.
+// Platform independent.
+//================================================================================
+
+struct FrameTimeSummary
+{
+	u32 frames;
+	f64 totalMs;
+	f64 minMs;
+	f64 meanMs;
+	f64 stdDevMs;	// How much the frames vary around the mean.
+	f64 medianMs;
+	f64 p95Ms;		// 95% of frames took this long or less.
+	f64 p99Ms;
+	f64 maxMs;
+};
+
+class FrameTimings
+{
+public:
+	FrameTimings() {}
+
+	void reserve(u32 frames) { m_times.reserve(frames); }
+	void add(f64 ms) { m_times.push_back(ms); }
+	void clear() { m_times.clear(); }
+
+	u32 count() const { return static_cast<u32>(m_times.size()); }
+	const std::vector<f64>& times() const { return m_times; }
+
+	// All zero when there are no frames.
+	FrameTimeSummary summarize() const;
+
+	// Write the summary as # comment lines then one "frame,ms" row per frame.
+	// Returns false if the file can't be written.
+	bool write_report(const char* pPath, const char* pTitle) const;
+
+private:
+	std::vector<f64> m_times;
+};
@@ -10,11 +10,32 @@
 #define DEBUG_DRAW_IMPLEMENTATION
 #include "Framework.h"
 #include "ShaderSet.h"
+#include "JobQueue.h"
+#include "IoService.h"
+#include "AssetPack.h"
+#include "BindingTable.h"
+#include "StateCache.h"
+#include "ShaderCache.h"
+#include "ShaderReloader.h"
+#include "ConstantRing.h"
+#include "CommandLists.h"
+#include "CommandBuffer.h"
+#include "FrameTimings.h"
+#include "Profiler.h"
+#include "ProfilerView.h"
+#include "GpuTimer.h"
+#include "FramePacer.h"
+#include "FixedTimestep.h"
+#include "DebugDrawVertices.h"
 
 #include <cstdlib>
 #include <tuple>
 #include <chrono>
 #include <fstream>
+#include <thread>
+#include <memory>
+#include <string>
+#include <algorithm>
 
 // ========================================================
 // IMGUI
@@ -63,47 +84,6 @@ v2 getMousePosition()
 	return v2(mouse.lastPosX, mouse.lastPosY);
 }
 
-//================================================================================
-// Debug print functions.
-//================================================================================
-
-void errorF(const char * format, ...)
-{
-	va_list args;
-	va_start(args, format);
-	std::vfprintf(stderr, format, args);
-	va_end(args);
-
-	// Default newline and flush (like std::endl)
-	std::fputc('\n', stderr);
-	std::fflush(stderr);
-}
-
-void panicF(const char * format, ...)
-{
-	va_list args;
-	char buffer[2048] = { '\0' };
-
-	va_start(args, format);
-	std::vsnprintf(buffer, sizeof(buffer), format, args);
-	va_end(args);
-
-	MessageBoxA(nullptr, buffer, "Fatal Error", MB_OK);
-	std::abort();
-}
-
-void debugF(const char * format, ...)
-{
-	va_list args;
-	char buffer[2048] = { '\0' };
-
-	va_start(args, format);
-	std::vsnprintf(buffer, sizeof(buffer), format, args);
-	va_end(args);
-
-	OutputDebugString(buffer);
-}
-
 // ========================================================
 // Window
 // ========================================================
@@ -142,6 +122,9 @@ public:
 		bool bKeepGoing = true;
 		while (bKeepGoing)
 		{
+			// Before the messages, so the frame reads the newest input.
+			onWaitForFrame();
+
 			while(PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
 			{
 				TranslateMessage(&msg);
@@ -156,6 +139,7 @@ public:
 		}
 	}
 
+	virtual void onWaitForFrame() {}
 	virtual void onRender() = 0;
 
 
@@ -240,6 +224,7 @@ private:
 		case WM_KEYDOWN:
 			if (wParam == VK_RETURN) { keys.showGrid = !keys.showGrid; }
 			if (wParam == VK_SPACE) { keys.showLabels = !keys.showLabels; }
+			if (wParam == VK_F1) { keys.showProfiler = !keys.showProfiler; }
 			return 0;
 
 		case WM_INPUT:
@@ -305,14 +290,14 @@ int Window::s_width = 1024;
 int Window::s_height = 768;
 
 // ========================================================
-// RenderWindowD3D11
+// RenderDeviceD3D11
+// The device, the target frames are drawn into and its depth buffer.
 // ========================================================
 
-class RenderWindowD3D11 : public Window
+class RenderDeviceD3D11
 {
 public:
 
-	ComPtr<IDXGISwapChain>         m_pSwapChain;
 	ComPtr<ID3D11Device>           m_pD3DDevice;
 	ComPtr<ID3D11DeviceContext>    m_pDeviceContext;
 	ComPtr<ID3D11Texture2D>		   m_pDepthStencil;
@@ -321,72 +306,15 @@ public:
 	ComPtr<ID3D11DepthStencilState> m_pDepthStencilState;
 
 	std::function<void()>          m_pRenderCallback;
-	std::function<void(u32, u32)>  m_pResizeCallback;
-
-	RenderWindowD3D11(HINSTANCE hInstance, int nCmdShow, const char* pTitleString)
-		: Window(hInstance, nCmdShow, pTitleString)
-	{
-		initD3D();
-	}
-
-	void onRender() override
-	{
-		const float clearColor[] = { 0, 0, 0, 0.f };
-		m_pDeviceContext->ClearRenderTargetView(m_pRenderTargetView.Get(), clearColor);
 
-		m_pDeviceContext->ClearDepthStencilView(m_pDepthStencilView.Get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.f, 0);
+	virtual ~RenderDeviceD3D11() {}
 
-		if (m_pRenderCallback)
-		{
-			m_pRenderCallback();
-		}	
-		m_pSwapChain->Present(1, 0); // use VSYNC
-	}
+protected:
 
-	void onResize() override
-	{
-		HRESULT hr;
-
-		// Obtaini the new client rectangle.
-		RECT clientRect;
-		GetClientRect(m_hWnd, &clientRect);
-		UINT width = clientRect.right - clientRect.left;
-		UINT height = clientRect.bottom - clientRect.top;
-
-		// Pass this to the rest of the app.
-		s_width = width;
-		s_height = height;
-
-		// Release all outstanding references to the swap chain's buffers.
-		m_pDeviceContext->OMSetRenderTargets(0, 0, 0);
-		m_pRenderTargetView.Reset();
-
-		// Release depth buffer
-		m_pDepthStencilView.Reset();
-		m_pDepthStencil.Reset();
-
-
-		// Preserve the existing buffer count and format.
-		// Automatically choose the width and height to match the client rect for HWNDs.
-		hr = m_pSwapChain->ResizeBuffers(0, 0, 0, DXGI_FORMAT_UNKNOWN, 0);
-		if (FAILED(hr))
-		{
-			panicF("Failed to ResizeBuffers.");
-		}
-
-		// Now setup all the views and bind the target.
-		SetupRenderTarget(width, height);
-
-		m_pResizeCallback(width, height);
-	}
-
-private:
-
-	void initD3D()
+	// Create the device, and the swap chain too when pSwapDesc is given.
+	void initDevice(const DXGI_SWAP_CHAIN_DESC* pSwapDesc, IDXGISwapChain** ppSwapChain)
 	{
 		UINT createDeviceFlags = 0;
-		const UINT width = Window::s_width;
-		const UINT height = Window::s_height;
 
 		// If the project is in a debug build, enable debugging via SDK Layers with this flag.
 #if defined(DEBUG) || defined(_DEBUG)
@@ -410,20 +338,6 @@ private:
 		};
 		const UINT numFeatureLevels = ARRAYSIZE(featureLevels);
 
-		DXGI_SWAP_CHAIN_DESC sd = { 0 };
-		sd.BufferCount = 2;
-		sd.BufferDesc.Width = width;
-		sd.BufferDesc.Height = height;
-		sd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-		sd.BufferDesc.RefreshRate.Numerator = 60;
-		sd.BufferDesc.RefreshRate.Denominator = 1;
-		sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-		sd.OutputWindow = m_hWnd;
-		sd.SampleDesc.Count = 1;
-		sd.SampleDesc.Quality = 0;
-		sd.Windowed = true;
-		sd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
-
 		HRESULT hr;
 		D3D_FEATURE_LEVEL featureLevel = D3D_FEATURE_LEVEL_11_0;
 
@@ -433,7 +347,7 @@ private:
 			auto driverType = driverTypes[driverTypeIndex];
 			hr = D3D11CreateDeviceAndSwapChain(nullptr, driverType, nullptr, createDeviceFlags,
 				featureLevels, numFeatureLevels, D3D11_SDK_VERSION,
-				&sd, m_pSwapChain.GetAddressOf(), m_pD3DDevice.GetAddressOf(),
+				pSwapDesc, ppSwapChain, m_pD3DDevice.GetAddressOf(),
 				&featureLevel, m_pDeviceContext.GetAddressOf());
 
 			if (hr == E_INVALIDARG)
@@ -441,7 +355,7 @@ private:
 				// DirectX 11.0 platforms will not recognize D3D_FEATURE_LEVEL_11_1 so we need to retry without it
 				hr = D3D11CreateDeviceAndSwapChain(nullptr, driverType, nullptr, createDeviceFlags,
 					&featureLevels[1], numFeatureLevels - 1,
-					D3D11_SDK_VERSION, &sd, m_pSwapChain.GetAddressOf(),
+					D3D11_SDK_VERSION, pSwapDesc, ppSwapChain,
 					m_pD3DDevice.GetAddressOf(), &featureLevel,
 					m_pDeviceContext.GetAddressOf());
 			}
@@ -456,26 +370,14 @@ private:
 		{
 			panicF("Failed to create D3D device or swap chain!");
 		}
-
-		// Now setup all the views and bind the target.
-		SetupRenderTarget(width, height);
-
 	}
 
-	void SetupRenderTarget(const UINT width, const UINT height)
+	// Views for the colour target and a matching depth buffer, bound with a full size viewport.
+	void SetupViews(ID3D11Texture2D* pColourTarget, const UINT width, const UINT height)
 	{
 		HRESULT hr;
 
-		// Create a render target view for the framebuffer:
-		ID3D11Texture2D * backBuffer = nullptr;
-		hr = m_pSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&backBuffer);
-		if (FAILED(hr))
-		{
-			panicF("Failed to get framebuffer from swap chain!");
-		}
-
-		hr = m_pD3DDevice->CreateRenderTargetView(backBuffer, NULL, m_pRenderTargetView.GetAddressOf());
-		backBuffer->Release();
+		hr = m_pD3DDevice->CreateRenderTargetView(pColourTarget, NULL, m_pRenderTargetView.GetAddressOf());
 		if (FAILED(hr))
 		{
 			panicF("Failed to create Render Target View for framebuffer!");
@@ -498,7 +400,6 @@ private:
 		vp.TopLeftY = 0;
 		m_pDeviceContext->RSSetViewports(1, &vp);
 
-
 		// setup the depth stencil state.
 		D3D11_DEPTH_STENCIL_DESC dsDesc;
 
@@ -529,6 +430,16 @@ private:
 		m_pDeviceContext->OMSetDepthStencilState(m_pDepthStencilState.Get(), 0);
 	}
 
+	void ClearTargets()
+	{
+		const float clearColor[] = { 0, 0, 0, 0.f };
+		m_pDeviceContext->ClearRenderTargetView(m_pRenderTargetView.Get(), clearColor);
+
+		m_pDeviceContext->ClearDepthStencilView(m_pDepthStencilView.Get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.f, 0);
+	}
+
+private:
+
 	void CreateDepthBuffer(const UINT width, const UINT height)
 	{
 		HRESULT hr;
@@ -558,9 +469,240 @@ private:
 			panicF("Failed to create Depth Stencil View for framebuffer!");
 		}
 	}
+};
 
+// ========================================================
+// RenderWindowD3D11
+// ========================================================
+
+class RenderWindowD3D11 : public Window, public RenderDeviceD3D11
+{
+public:
+
+	ComPtr<IDXGISwapChain>         m_pSwapChain;
+
+	std::function<void(u32, u32)>  m_pResizeCallback;
+
+	// Sets when frames start and how Present syncs, vsync when null.
+	FramePacer*                    m_pPacer = nullptr;
+
+	RenderWindowD3D11(HINSTANCE hInstance, int nCmdShow, const char* pTitleString)
+		: Window(hInstance, nCmdShow, pTitleString)
+	{
+		initD3D();
+	}
+
+	void onRender() override
+	{
+		// Close the last frame, its Present included, before this one starts.
+		profiler_end_frame();
+		PROFILE_SCOPE("Frame");
+
+		ClearTargets();
+
+		if (m_pRenderCallback)
+		{
+			m_pRenderCallback();
+		}
+
+		PROFILE_SCOPE("Present");
+		m_pSwapChain->Present(m_pPacer ? m_pPacer->sync_interval() : 1, 0);
+
+		if (m_pPacer)
+		{
+			m_pPacer->end_frame();
+		}
+	}
+
+	void onWaitForFrame() override
+	{
+		if (!m_pPacer)
+		{
+			return;
+		}
+
+		// Low latency keeps one frame queued instead of DXGI's default three,
+		// or a frame started just in time would still wait behind the others.
+		const bool bLowLatency = m_pPacer->mode() == kPacingLowLatency;
+		if (bLowLatency != m_bLowLatencyQueue)
+		{
+			ComPtr<IDXGIDevice1> pDxgiDevice;
+			if (SUCCEEDED(m_pD3DDevice.As(&pDxgiDevice)))
+			{
+				pDxgiDevice->SetMaximumFrameLatency(bLowLatency ? 1 : 3);
+			}
+			m_bLowLatencyQueue = bLowLatency;
+		}
+
+		PROFILE_SCOPE("Pacing wait");
+		m_pPacer->wait_for_frame();
+	}
+
+	void onResize() override
+	{
+		HRESULT hr;
+
+		// Obtaini the new client rectangle.
+		RECT clientRect;
+		GetClientRect(m_hWnd, &clientRect);
+		UINT width = clientRect.right - clientRect.left;
+		UINT height = clientRect.bottom - clientRect.top;
+
+		// Pass this to the rest of the app.
+		s_width = width;
+		s_height = height;
+
+		// Release all outstanding references to the swap chain's buffers.
+		m_pDeviceContext->OMSetRenderTargets(0, 0, 0);
+		m_pRenderTargetView.Reset();
+
+		// Release depth buffer
+		m_pDepthStencilView.Reset();
+		m_pDepthStencil.Reset();
+
+
+		// Preserve the existing buffer count and format.
+		// Automatically choose the width and height to match the client rect for HWNDs.
+		hr = m_pSwapChain->ResizeBuffers(0, 0, 0, DXGI_FORMAT_UNKNOWN, 0);
+		if (FAILED(hr))
+		{
+			panicF("Failed to ResizeBuffers.");
+		}
+
+		// Now setup all the views and bind the target.
+		SetupRenderTarget(width, height);
+
+		m_pResizeCallback(width, height);
+	}
+
+private:
+
+	void initD3D()
+	{
+		const UINT width = Window::s_width;
+		const UINT height = Window::s_height;
+
+		DXGI_SWAP_CHAIN_DESC sd = { 0 };
+		sd.BufferCount = 2;
+		sd.BufferDesc.Width = width;
+		sd.BufferDesc.Height = height;
+		sd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		sd.BufferDesc.RefreshRate.Numerator = 60;
+		sd.BufferDesc.RefreshRate.Denominator = 1;
+		sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+		sd.OutputWindow = m_hWnd;
+		sd.SampleDesc.Count = 1;
+		sd.SampleDesc.Quality = 0;
+		sd.Windowed = true;
+		sd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
+
+		initDevice(&sd, m_pSwapChain.GetAddressOf());
+
+		// Now setup all the views and bind the target.
+		SetupRenderTarget(width, height);
+
+	}
+
+	void SetupRenderTarget(const UINT width, const UINT height)
+	{
+		HRESULT hr;
+
+		// Create a render target view for the framebuffer:
+		ID3D11Texture2D * backBuffer = nullptr;
+		hr = m_pSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&backBuffer);
+		if (FAILED(hr))
+		{
+			panicF("Failed to get framebuffer from swap chain!");
+		}
+
+		SetupViews(backBuffer, width, height);
+		backBuffer->Release();
+	}
+
+	bool m_bLowLatencyQueue = false;	// The device's frame latency is set to 1.
 };
 
+// ========================================================
+// HeadlessRenderD3D11
+// Draws into an off-screen texture, no window and nothing
+// presented, so frames run as fast as they are submitted.
+// ========================================================
+
+class HeadlessRenderD3D11 : public RenderDeviceD3D11
+{
+public:
+
+	ComPtr<ID3D11Texture2D>        m_pColourTarget;
+
+	HeadlessRenderD3D11(const UINT width, const UINT height)
+	{
+		initDevice(nullptr, nullptr);
+
+		// Same format as the swap chain would have.
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = width;
+		desc.Height = height;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+		if (FAILED(m_pD3DDevice->CreateTexture2D(&desc, nullptr, m_pColourTarget.GetAddressOf())))
+		{
+			panicF("Failed to create off-screen render target!");
+		}
+
+		SetupViews(m_pColourTarget.Get(), width, height);
+
+		D3D11_QUERY_DESC queryDesc = { D3D11_QUERY_EVENT, 0 };
+		for (ComPtr<ID3D11Query>& rQuery : m_frameQueries)
+		{
+			if (FAILED(m_pD3DDevice->CreateQuery(&queryDesc, rQuery.GetAddressOf())))
+			{
+				panicF("Failed to create frame query!");
+			}
+		}
+	}
+
+	// Runs a whole frame and closes it in the profiler.
+	void renderFrame()
+	{
+		{
+			PROFILE_SCOPE("Frame");
+
+			ClearTargets();
+
+			if (m_pRenderCallback)
+			{
+				m_pRenderCallback();
+			}
+
+			// Nothing presents, so nothing stops the CPU queueing frames without end.
+			// Wait for the frame kMaxFramesInFlight back, as a flip chain would.
+			ID3D11Query* pQuery = m_frameQueries[m_frame % kMaxFramesInFlight].Get();
+			if (m_frame >= kMaxFramesInFlight)
+			{
+				PROFILE_SCOPE("Wait for GPU");
+				while (m_pDeviceContext->GetData(pQuery, nullptr, 0, 0) == S_FALSE)
+				{
+					std::this_thread::yield();
+				}
+			}
+			m_pDeviceContext->End(pQuery);
+			m_pDeviceContext->Flush();
+			++m_frame;
+		}
+		profiler_end_frame();
+	}
+
+private:
+
+	static const u32 kMaxFramesInFlight = 3;
+
+	ComPtr<ID3D11Query> m_frameQueries[kMaxFramesInFlight];
+	u32 m_frame = 0;
+};
 
 
 // ========================================================
@@ -688,24 +830,7 @@ public:
 		}
 
 		// Copy into mapped buffer:
-		auto * verts = static_cast<Vertex *>(mapInfo.pData);
-		for (int v = 0; v < count; ++v)
-		{
-			verts[v].pos.x = glyphs[v].glyph.x;
-			verts[v].pos.y = glyphs[v].glyph.y;
-			verts[v].pos.z = 0.0f;
-			verts[v].pos.w = 1.0f;
-
-			verts[v].uv.x = glyphs[v].glyph.u;
-			verts[v].uv.y = glyphs[v].glyph.v;
-			verts[v].uv.z = 0.0f;
-			verts[v].uv.w = 0.0f;
-
-			verts[v].color.x = glyphs[v].glyph.r;
-			verts[v].color.y = glyphs[v].glyph.g;
-			verts[v].color.z = glyphs[v].glyph.b;
-			verts[v].color.w = 1.0f;
-		}
+		copy_debug_glyphs(glyphs, static_cast<u32>(count), static_cast<Vertex *>(mapInfo.pData));
 
 		// Unmap and draw:
 		deviceContext->Unmap(glyphVertexBuffer.Get(), 0);
@@ -730,11 +855,7 @@ public:
 
 		// Emulating points as billboarded quads, so each point will use 6 vertexes.
 		// D3D11 doesn't support "point sprites" like OpenGL (gl_PointSize).
-		const int maxVerts = DEBUG_DRAW_VERTEX_BUFFER_SIZE / 6;
-
-		// OpenGL point size scaling produces gigantic points with the billboarding fallback.
-		// This is some arbitrary down-scaling factor to more or less match the OpenGL samples.
-		const float D3DPointSpriteScalingFactor = 0.01f;
+		const int maxVerts = DEBUG_DRAW_VERTEX_BUFFER_SIZE / static_cast<int>(kDebugDrawVerticesPerPoint);
 
 		ASSERT(points != nullptr);
 		ASSERT(count > 0 && count <= maxVerts);
@@ -746,42 +867,10 @@ public:
 			panicF("Failed to map vertex buffer!");
 		}
 
-		const int numVerts = count * 6;
-		const int indexes[6] = { 0, 1, 2, 2, 3, 0 };
-
-		int v = 0;
-		auto * verts = static_cast<Vertex *>(mapInfo.pData);
+		const int numVerts = count * static_cast<int>(kDebugDrawVerticesPerPoint);
 
 		// Expand each point into a quad:
-		for (int p = 0; p < count; ++p)
-		{
-			const float ptSize = points[p].point.size * D3DPointSpriteScalingFactor;
-			const v3 halfWidth = (ptSize * 0.5f) * camRight; // X
-			const v3 halfHeigh = (ptSize * 0.5f) * camUp;    // Y
-			const v3 origin = v3{ points[p].point.x, points[p].point.y, points[p].point.z };
-
-			v3 corners[4];
-			corners[0] = origin + halfWidth + halfHeigh;
-			corners[1] = origin - halfWidth + halfHeigh;
-			corners[2] = origin - halfWidth - halfHeigh;
-			corners[3] = origin + halfWidth - halfHeigh;
-
-			for (int i : indexes)
-			{
-				verts[v].pos.x = corners[i].x;
-				verts[v].pos.y = corners[i].y;
-				verts[v].pos.z = corners[i].z;
-				verts[v].pos.w = 1.0f;
-
-				verts[v].color.x = points[p].point.r;
-				verts[v].color.y = points[p].point.g;
-				verts[v].color.z = points[p].point.b;
-				verts[v].color.w = 1.0f;
-
-				++v;
-			}
-		}
-		ASSERT(v == numVerts);
+		expand_debug_points(points, static_cast<u32>(count), &camRight.x, &camUp.x, static_cast<Vertex *>(mapInfo.pData));
 
 		// Unmap and draw:
 		deviceContext->Unmap(pointVertexBuffer.Get(), 0);
@@ -805,19 +894,7 @@ public:
 		}
 
 		// Copy into mapped buffer:
-		auto * verts = static_cast<Vertex *>(mapInfo.pData);
-		for (int v = 0; v < count; ++v)
-		{
-			verts[v].pos.x = lines[v].line.x;
-			verts[v].pos.y = lines[v].line.y;
-			verts[v].pos.z = lines[v].line.z;
-			verts[v].pos.w = 1.0f;
-
-			verts[v].color.x = lines[v].line.r;
-			verts[v].color.y = lines[v].line.g;
-			verts[v].color.z = lines[v].line.b;
-			verts[v].color.w = 1.0f;
-		}
+		copy_debug_lines(lines, static_cast<u32>(count), static_cast<Vertex *>(mapInfo.pData));
 
 		// Unmap and draw:
 		deviceContext->Unmap(lineVertexBuffer.Get(), 0);
@@ -844,12 +921,8 @@ private:
 		DirectX::XMFLOAT4 screenDimensions = { float(Window::s_width), float(Window::s_height), 0.0f, 0.0f };
 	};
 
-	struct Vertex
-	{
-		DirectX::XMFLOAT4A pos;   // 3D position
-		DirectX::XMFLOAT4A uv;    // Texture coordinates
-		DirectX::XMFLOAT4A color; // RGBA float
-	};
+	// 3D position, texture coordinates and RGBA float colour.
+	using Vertex = DebugDrawVertex;
 
 	struct TextureImpl : public dd::OpaqueTextureType
 	{
@@ -1182,6 +1255,152 @@ static void inputUpdate(const Window & win)
 	mouse.rightButtonDown = testKeyPressed(VK_RBUTTON);
 }
 
+// ========================================================
+// Camera movement
+// Keyboard movement goes in fixed steps, so how far a key
+// moves the camera doesn't depend on the frame rate. The
+// camera is drawn between its last two steps.
+// ========================================================
+
+static const f64 kCameraStepHz = 120.0;
+
+struct CameraMotion
+{
+	FixedTimestep steps;
+	v3 stepEyes[2];		// Before and after the last step.
+	v3 shownEye;		// Where the last frame drew it, the app moved it if it isn't there now.
+};
+
+static void update_camera_motion(CameraMotion& rMotion, f32 seconds)
+{
+	if (camera.eye != rMotion.shownEye)
+	{
+		rMotion.stepEyes[0] = camera.eye;
+		rMotion.stepEyes[1] = camera.eye;
+	}
+	camera.eye = rMotion.stepEyes[1];
+
+	const u32 steps = rMotion.steps.advance(seconds);
+	const f32 stepSeconds = static_cast<f32>(rMotion.steps.step_seconds());
+	for (u32 step = 0; step < steps; ++step)
+	{
+		rMotion.stepEyes[0] = camera.eye;
+		if (mouse.rightButtonDown)
+		{
+			camera.checkKeyboardMovement(stepSeconds);
+		}
+	}
+	rMotion.stepEyes[1] = camera.eye;
+
+	camera.eye = v3::Lerp(rMotion.stepEyes[0], rMotion.stepEyes[1], rMotion.steps.alpha());
+	rMotion.shownEye = camera.eye;
+}
+
+// ========================================================
+// Headless runs
+// -headless runs the app without a window for a fixed number
+// of frames as fast as they go, then writes a frame time
+// report. Every frame steps the same fixed time with no
+// input, so runs are comparable for performance regressions.
+//
+//  -frames=N              frames to run, 1000 by default.
+//  -fixed-dt=S            seconds per frame step, 1/60 by default.
+//  -null-commands         drop draws, clears and buffer writes,
+//                         to time the CPU side alone.
+//  -frame-report=PATH     frame_times.csv by default.
+//  -profile-capture=PATH  also write every frame's profiler
+//                         scopes to a Chrome trace.
+// ========================================================
+
+struct HeadlessOptions
+{
+	bool bEnabled;
+	bool bNullCommands;
+	u32 frames;
+	f32 deltaSeconds;
+	std::string reportPath;
+	std::string capturePath;	// Empty for no profiler capture.
+};
+
+// The text after "name=" on the command line, up to the next space. Null if the option isn't there.
+static const char* command_line_value(const char* pCommandLine, const char* pName, std::string& rValueOut)
+{
+	const char* pOption = strstr(pCommandLine, pName);
+	if (!pOption || pOption[strlen(pName)] != '=')
+	{
+		return nullptr;
+	}
+
+	const char* pValue = pOption + strlen(pName) + 1;
+	rValueOut.assign(pValue, pValue + strcspn(pValue, " \t"));
+	return rValueOut.c_str();
+}
+
+static HeadlessOptions parse_headless_options(const char* pCommandLine)
+{
+	HeadlessOptions options;
+	options.bEnabled = strstr(pCommandLine, "-headless") != nullptr;
+	options.bNullCommands = strstr(pCommandLine, "-null-commands") != nullptr;
+	options.frames = 1000;
+	options.deltaSeconds = 1.f / 60.f;
+	options.reportPath = "frame_times.csv";
+
+	std::string value;
+	if (command_line_value(pCommandLine, "-frames", value))
+	{
+		options.frames = std::max(1, atoi(value.c_str()));
+	}
+	if (command_line_value(pCommandLine, "-fixed-dt", value))
+	{
+		options.deltaSeconds = static_cast<f32>(atof(value.c_str()));
+	}
+	if (command_line_value(pCommandLine, "-frame-report", value))
+	{
+		options.reportPath = value;
+	}
+	if (command_line_value(pCommandLine, "-profile-capture", value))
+	{
+		options.capturePath = value;
+	}
+	return options;
+}
+
+// ========================================================
+// Frame pacing
+// When the window's frames start, see FramePacer.h. The
+// profiler window (F1) shows the pacing and can change it.
+//
+//  -pacing=MODE       vsync by default, uncapped, fixed or
+//                     low-latency.
+//  -target-hz=N       rate of fixed and low-latency, 60 by
+//                     default.
+// ========================================================
+
+static void parse_pacing_options(const char* pCommandLine, FramePacer& rPacer)
+{
+	std::string value;
+	if (command_line_value(pCommandLine, "-pacing", value))
+	{
+		PacingMode mode = kPacingVsync;
+		if (parse_pacing_mode(value.c_str(), mode))
+		{
+			rPacer.set_mode(mode);
+		}
+		else
+		{
+			errorF("Unknown pacing mode %s, using vsync", value.c_str());
+		}
+	}
+	if (command_line_value(pCommandLine, "-target-hz", value))
+	{
+		const f64 hz = atof(value.c_str());
+		if (hz > 0.0)
+		{
+			rPacer.set_target_hz(hz);
+		}
+	}
+}
+
 // ========================================================
 // Main entry point for the framework.. 
 // called directly from winmain.
@@ -1189,9 +1408,53 @@ static void inputUpdate(const Window & win)
 
 int framework_main(FrameworkApp& rApp, const char* pTitleString, HINSTANCE hInstance, int nCmdShow)
 {
+	profiler_set_thread_name("Main");
+
+	// Worker threads and async file reads shared by the app.
+	JobPool jobPool;
+	jobPool.launch();
+
+	IoService ioService;
+	ioService.init(&jobPool);
+
+	// Mount the packed assets before anything loads, loose files are used if there is no pack.
+	mount_asset_pack("Assets/Assets.pak", &jobPool);
+
+	// Build time precompile, fills the shader cache without opening a window.
+	if (strstr(GetCommandLineA(), "-precompile-shaders"))
+	{
+		const bool bOk = rApp.on_precompile_shaders();
+		const ShaderCacheStats stats = shader_cache_stats();
+		debugF("Shaders precompiled : %u compiled (%.0f ms), %u up to date\n", stats.compiles, stats.compileMs, stats.diskHits + stats.memoryHits);
+		return bOk ? 0 : 1;
+	}
+
+	const HeadlessOptions headless = parse_headless_options(GetCommandLineA());
+
+	// Headless frames are never paced, they run as fast as they go.
+	SystemPacingClock pacingClock;
+	FramePacer pacer;
+	pacer.init(&pacingClock);
+	parse_pacing_options(GetCommandLineA(), pacer);
+
+	// A window presenting at the pacer's rate, or an off-screen target for headless runs.
+	std::unique_ptr<RenderWindowD3D11> pRenderWindow;
+	std::unique_ptr<HeadlessRenderD3D11> pHeadlessRender;
+	RenderDeviceD3D11* pRenderDevice = nullptr;
+	if (headless.bEnabled)
+	{
+		pHeadlessRender.reset(new HeadlessRenderD3D11(Window::s_width, Window::s_height));
+		pRenderDevice = pHeadlessRender.get();
+	}
+	else
+	{
+		pRenderWindow.reset(new RenderWindowD3D11(hInstance, nCmdShow, pTitleString));
+		pRenderWindow->m_pPacer = &pacer;
+		pRenderDevice = pRenderWindow.get();
+	}
+	RenderDeviceD3D11& renderDevice = *pRenderDevice;
 
-	RenderWindowD3D11 renderWindow(hInstance, nCmdShow, pTitleString);
-	RenderInterfaceD3D11 renderInterface(renderWindow.m_pD3DDevice, renderWindow.m_pDeviceContext);
+	RenderInterfaceD3D11 renderInterface(renderDevice.m_pD3DDevice, renderDevice.m_pDeviceContext);
 
 
 	// Initialise the debug drawing library
@@ -1200,14 +1463,84 @@ int framework_main(FrameworkApp& rApp, const char* pTitleString, HINSTANCE hInst
 
 
 	// Initialise the imgui library
-	ImGui_ImplDX11_Init(renderWindow.m_hWnd, renderWindow.m_pD3DDevice.Get(), renderWindow.m_pDeviceContext.Get());
+	if (headless.bEnabled)
+	{
+		// No window to take input from or draw to, ImGui still runs so the app's UI calls are valid.
+		ImGuiIO& io = ImGui::GetIO();
+		io.DisplaySize = ImVec2(static_cast<float>(Window::s_width), static_cast<float>(Window::s_height));
+		io.RenderDrawListsFn = nullptr;
+
+		// NewFrame() needs the font atlas built, its texture is never made.
+		unsigned char* pFontPixels = nullptr;
+		int fontWidth = 0;
+		int fontHeight = 0;
+		io.Fonts->GetTexDataAsAlpha8(&pFontPixels, &fontWidth, &fontHeight);
+	}
+	else
+	{
+		ImGui_ImplDX11_Init(pRenderWindow->m_hWnd, renderDevice.m_pD3DDevice.Get(), renderDevice.m_pDeviceContext.Get());
+	}
+
+	// Application binds go through the table, flushed by the app before each draw.
+	D3D11BindingDevice bindingDevice(renderDevice.m_pDeviceContext.Get());
+	BindingTable bindings;
+	bindings.init(&bindingDevice);
+
+	// Pipeline state set through the cache skips calls that change nothing.
+	D3D11PipelineDevice pipelineDevice(renderDevice.m_pDeviceContext.Get());
+	StateCache stateCache;
+	stateCache.init(&pipelineDevice);
+
+	// Per draw constants are sub-allocated from one large buffer.
+	D3D11ConstantDevice constantDevice;
+	constantDevice.init(renderDevice.m_pD3DDevice.Get(), renderDevice.m_pDeviceContext.Get());
+	ConstantRing constants;
+	constants.init(&constantDevice);
+
+	// Draws, clears and buffer writes go through a command buffer so they can be swapped for a null or recording device.
+	D3D11CommandDevice commandDevice(renderDevice.m_pDeviceContext.Get());
+	NullCommandDevice nullCommandDevice;
+	CommandBuffer commands;
+	if (headless.bEnabled && headless.bNullCommands)
+	{
+		commands.init(&nullCommandDevice);
+	}
+	else
+	{
+		commands.init(&commandDevice);
+	}
+
+	// Draws recorded on the job pool go to deferred contexts, one per thread that can record at once.
+	D3D11CommandListDevice commandListDevice;
+	commandListDevice.init(renderDevice.m_pD3DDevice.Get(), renderDevice.m_pDeviceContext.Get(), jobPool.numWorkers() + 1, &bindings, &stateCache);
+	CommandRecorder recorder;
+	recorder.init(&commandListDevice, &jobPool);
+
+	// Pass times on the GPU, read back a few frames late so nothing waits on them.
+	D3D11GpuTimerDevice gpuTimerDevice;
+	gpuTimerDevice.init(renderDevice.m_pD3DDevice.Get(), renderDevice.m_pDeviceContext.Get());
+	GpuTimer gpuTimer;
+	gpuTimer.init(&gpuTimerDevice);
+
+	// Shaders the app watches are rebuilt on the job pool when their source changes.
+	ShaderReloader shaderReloader;
+	shaderReloader.init(renderDevice.m_pD3DDevice.Get(), &jobPool);
 
 	SystemsInterface systems = {};
 	systems.pDebugDrawContext = ddContext;
-	systems.pD3DDevice = renderWindow.m_pD3DDevice.Get();
-	systems.pD3DContext = renderWindow.m_pDeviceContext.Get();
-	systems.pSwapRenderTarget = renderWindow.m_pRenderTargetView.Get();
+	systems.pD3DDevice = renderDevice.m_pD3DDevice.Get();
+	systems.pD3DContext = renderDevice.m_pDeviceContext.Get();
+	systems.pCommands = &commands;
+	systems.pSwapRenderTarget = renderDevice.m_pRenderTargetView.Get();
 	systems.pCamera = &camera;
+	systems.pJobPool = &jobPool;
+	systems.pIoService = &ioService;
+	systems.pBindings = &bindings;
+	systems.pStateCache = &stateCache;
+	systems.pShaderReloader = &shaderReloader;
+	systems.pConstants = &constants;
+	systems.pRecorder = &recorder;
+	systems.pGpuTimer = &gpuTimer;
 	systems.width = Window::s_width;
 	systems.height = Window::s_height;
 
@@ -1218,60 +1551,90 @@ int framework_main(FrameworkApp& rApp, const char* pTitleString, HINSTANCE hInst
 	/////////////////////////////////////////////////////////////
 	// Lambda for handling screen resize.
 	/////////////////////////////////////////////////////////////
-	renderWindow.m_pResizeCallback = [&systems, &renderInterface, &rApp, &renderWindow](u32 width, u32 height) {
-		systems.width = width;
-		systems.height = height;
-		systems.pCamera->resizeViewport(width, height);
-		renderInterface.onResize(width, height);
-
-		// Swap chain has changed after a resize update the systems packet.
-		systems.pSwapRenderTarget = renderWindow.m_pRenderTargetView.Get();
-
-		// Let the app handle the resize.
-		rApp.on_resize(systems);
-	};
+	if (pRenderWindow)
+	{
+		RenderWindowD3D11& renderWindow = *pRenderWindow;
+		renderWindow.m_pResizeCallback = [&systems, &renderInterface, &rApp, &renderWindow](u32 width, u32 height) {
+			systems.width = width;
+			systems.height = height;
+			systems.pCamera->resizeViewport(width, height);
+			renderInterface.onResize(width, height);
+
+			// Swap chain has changed after a resize update the systems packet.
+			systems.pSwapRenderTarget = renderWindow.m_pRenderTargetView.Get();
+
+			// Let the app handle the resize.
+			rApp.on_resize(systems);
+		};
+	}
 
 	/////////////////////////////////////////////////////////////
 	// Lambda for handling rendering
 	/////////////////////////////////////////////////////////////
-	renderWindow.m_pRenderCallback = [&systems, &renderWindow, &renderInterface, &rApp]()
+	CameraMotion cameraMotion;
+	cameraMotion.steps.set_rate_hz(kCameraStepHz);
+
+	renderDevice.m_pRenderCallback = [&systems, &pRenderWindow, &renderInterface, &rApp, &headless, &pacer, &cameraMotion]()
 	{
-		// Let Imgui prepare for a new frame.
-		ImGui_ImplDX11_NewFrame();
+		if (headless.bEnabled)
+		{
+			// Same step every frame and no input, so every run does the same work.
+			deltaTime.seconds = headless.deltaSeconds;
+			deltaTime.milliseconds = static_cast<std::int64_t>(deltaTime.seconds * 1000.0);
 
-		static double prevTime = getTimeSeconds();
-		const double t0s = getTimeSeconds();
+			ImGui::GetIO().DeltaTime = headless.deltaSeconds;
+			ImGui::NewFrame();
+		}
+		else
+		{
+			// Let Imgui prepare for a new frame.
+			ImGui_ImplDX11_NewFrame();
 
-		deltaTime.seconds = static_cast<float>(t0s-prevTime);
-		deltaTime.milliseconds = static_cast<std::int64_t>(deltaTime.seconds * 1000.0);
+			static double prevTime = getTimeSeconds();
+			const double t0s = getTimeSeconds();
 
-		prevTime = t0s;
+			deltaTime.seconds = static_cast<float>(t0s-prevTime);
+			deltaTime.milliseconds = static_cast<std::int64_t>(deltaTime.seconds * 1000.0);
 
-		// Plot delta time.
-		/*
-		static float s_times[64];
-		static u32 s_timesIdx = 0;
-		s_times[s_timesIdx] = deltaTime.seconds;
-		s_timesIdx = (s_timesIdx + 1) % 64;
-		ImGui::PlotLines("dT", s_times, 64, s_timesIdx, 0, 0.f, 2.0f/60.0f, ImVec2(400.f, 200.f));
-		*/
+			prevTime = t0s;
 
-		inputUpdate(renderWindow);
+			// Plot delta time.
+			/*
+			static float s_times[64];
+			static u32 s_timesIdx = 0;
+			s_times[s_timesIdx] = deltaTime.seconds;
+			s_timesIdx = (s_timesIdx + 1) % 64;
+			ImGui::PlotLines("dT", s_times, 64, s_timesIdx, 0, 0.f, 2.0f/60.0f, ImVec2(400.f, 200.f));
+			*/
 
-		// size may change so update window size
-		systems.width = renderWindow.s_width;
-		systems.height = renderWindow.s_height;
+			inputUpdate(*pRenderWindow);
+
+			// size may change so update window size
+			systems.width = Window::s_width;
+			systems.height = Window::s_height;
+		}
 
 
+		systems.deltaSeconds = deltaTime.seconds;
+
 		if (mouse.rightButtonDown) {
-			camera.checkKeyboardMovement();
 			camera.checkMouseRotation();
 		}
+		update_camera_motion(cameraMotion, deltaTime.seconds);
 
 		camera.updateMatrices();
 
+		// Swap in shaders that finished compiling, before anything binds them.
+		{
+			PROFILE_SCOPE("Shader reload");
+			systems.pShaderReloader->update();
+		}
+
 		// Let the application update.
-		rApp.on_update(systems);
+		{
+			PROFILE_SCOPE("Update");
+			rApp.on_update(systems);
+		}
 
 
 		m4x4 mvpMatrix = camera.vpMatrix.Transpose();
@@ -1279,14 +1642,39 @@ int framework_main(FrameworkApp& rApp, const char* pTitleString, HINSTANCE hInst
 		renderInterface.setMvpMatrixPtr(mvpMatrix);
 		renderInterface.setCameraFrame(camera.up, camera.right, camera.eye);
 
+		systems.pGpuTimer->begin_frame();
+
 		// Let the application render.
-		rApp.on_render(systems);
+		{
+			PROFILE_SCOPE("Render");
+			GpuPassScope gpuPass(systems.pGpuTimer, "Render");
+			rApp.on_render(systems);
+		}
 
 		// Flush the debug draw queues:
-		dd::flush(systems.pDebugDrawContext);
+		{
+			PROFILE_SCOPE("Debug draw");
+			GpuPassScope gpuPass(systems.pGpuTimer, "Debug draw");
+			dd::flush(systems.pDebugDrawContext);
+		}
+
+		// Debug draw binds its own shaders and inputs, ImGui restores what it changes.
+		systems.pBindings->invalidate();
+		systems.pStateCache->invalidate();
+
+		if (keys.showProfiler)
+		{
+			profiler_window(&keys.showProfiler, pRenderWindow ? &pacer : nullptr);
+		}
 
 		// Flush Imgui draw queues
-		ImGui::Render();
+		{
+			PROFILE_SCOPE("ImGui");
+			GpuPassScope gpuPass(systems.pGpuTimer, "ImGui");
+			ImGui::Render();
+		}
+
+		systems.pGpuTimer->end_frame();
 
 #ifdef DEAD
 		const double t1s = getTimeSeconds();
@@ -1305,19 +1693,65 @@ int framework_main(FrameworkApp& rApp, const char* pTitleString, HINSTANCE hInst
 	/////////////////////////////////////////////////////////////
 	// Enter the game loop.
 	/////////////////////////////////////////////////////////////
-	renderWindow.runMessageLoop();
+	int result = 0;
+	if (pHeadlessRender)
+	{
+		FrameTimings frameTimes;
+		frameTimes.reserve(headless.frames);
+
+		// Startup goes in a profiler frame of its own, the capture is the run's frames only.
+		profiler_end_frame();
+		if (!headless.capturePath.empty())
+		{
+			profiler_capture(headless.frames, headless.capturePath.c_str());
+		}
+		for (u32 frame = 0; frame < headless.frames; ++frame)
+		{
+			const double t0s = getTimeSeconds();
+			pHeadlessRender->renderFrame();
+			frameTimes.add((getTimeSeconds() - t0s) * 1000.0);
+		}
+
+		char title[256];
+		snprintf(title, sizeof(title), "%s : headless, %ux%u, fixed dt %.4f s, %s commands",
+			pTitleString, systems.width, systems.height, headless.deltaSeconds, headless.bNullCommands ? "null" : "D3D11");
+
+		const FrameTimeSummary summary = frameTimes.summarize();
+		debugF("%s\n%u frames : mean %.3f ms, std dev %.3f ms, median %.3f ms, p95 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+			title, summary.frames, summary.meanMs, summary.stdDevMs, summary.medianMs, summary.p95Ms, summary.p99Ms, summary.maxMs);
+		result = frameTimes.write_report(headless.reportPath.c_str(), title) ? 0 : 1;
+	}
+	else
+	{
+		pRenderWindow->runMessageLoop();
+
+		const FramePacingStats pacing = pacer.stats();
+		debugF("Pacing %s : interval mean %.3f ms, std dev %.3f ms, p99 %.3f ms, input to present mean %.3f ms, p99 %.3f ms, %u late\n",
+			pacing_mode_name(pacer.mode()), pacing.interval.meanMs, pacing.interval.stdDevMs, pacing.interval.p99Ms,
+			pacing.latency.meanMs, pacing.latency.p99Ms, pacing.late);
+	}
 
 
 	/////////////////////////////////////////////////////////////
 	// And shutdown
 	/////////////////////////////////////////////////////////////
-	ImGui_ImplDX11_Shutdown();
+	ioService.shutdown();
+	jobPool.waitAll();
+	unmount_asset_packs();
+
+	if (headless.bEnabled)
+	{
+		ImGui::Shutdown();
+	}
+	else
+	{
+		ImGui_ImplDX11_Shutdown();
+	}
 
 	dd::shutdown(ddContext);
-	return 0;
+	return result;
 }
 
-
 Camera::Camera()
 {
 	right = v3(1.0f, 0.0f, 0.0f);
@@ -1393,9 +1827,9 @@ void Camera::move(const MoveDir dir, const float amount)
 	}
 }
 
-void Camera::checkKeyboardMovement()
+void Camera::checkKeyboardMovement(const float seconds)
 {
-	const float moveSpeed = movementSpeed * deltaTime.seconds;
+	const float moveSpeed = movementSpeed * seconds;
 	if (keys.aDown) { move(Camera::Left, moveSpeed); }
 	if (keys.dDown) { move(Camera::Right, moveSpeed); }
 	if (keys.wDown) { move(Camera::Forward, moveSpeed); }
@@ -1557,6 +1991,15 @@ v3 Camera::rotateAroundAxis(const v3 & vec, const v3 & axis, const float angle)
 }
 
 memtype_t* load_file(const char* pstrName, u32& rLengthOut, const u32 kAlignment, const u32 kZeroPadding)
+{
+	u64 length = 0;
+	memtype_t* pMemory = load_file(pstrName, length, kAlignment, kZeroPadding);
+	ASSERT(length <= UINT32_MAX && "File is too large for a 32bit length, use the u64 overload.");
+	rLengthOut = static_cast<u32>(length);
+	return pMemory;
+}
+
+memtype_t* load_file(const char* pstrName, u64& rLengthOut, const u32 kAlignment, const u32 kZeroPadding)
 {
 	std::ifstream hFile;
 
@@ -1564,11 +2007,14 @@ memtype_t* load_file(const char* pstrName, u32& rLengthOut, const u32 kAlignment
 	if (hFile.good())
 	{
 		hFile.seekg(0, std::ios::end);
-		u32 length = static_cast<u32>(hFile.tellg());
+		u64 length = static_cast<u64>(hFile.tellg());
 		hFile.seekg(0, std::ios::beg);
 
+		// The block must be addressable on this platform.
+		ASSERT(length + kZeroPadding <= SIZE_MAX);
+
 		rLengthOut = length;
-		memtype_t* pMemory = (memtype_t*)_aligned_malloc(length + kZeroPadding, kAlignment);
+		memtype_t* pMemory = (memtype_t*)_aligned_malloc(static_cast<size_t>(length + kZeroPadding), kAlignment);
 		ASSERT(pMemory);
 
 		hFile.read((char*)pMemory, length);
@@ -1589,3 +2035,111 @@ void release_loaded_file(memtype_t* ptr)
 {
 	if (ptr) _aligned_free(ptr);
 }
+
+bool map_file(const char* pstrName, FileView& rViewOut, const u32 kAlignment, const u32 kZeroPadding)
+{
+	ASSERT(rViewOut.pData == nullptr); // View is already in use.
+
+	SYSTEM_INFO sysInfo;
+	GetSystemInfo(&sysInfo);
+
+	// Mapped views always start on an allocation granularity boundary.
+	ASSERT(kAlignment <= sysInfo.dwAllocationGranularity);
+
+	HANDLE hFile = CreateFileA(pstrName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(hFile, &fileSize))
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+	const u64 size = static_cast<u64>(fileSize.QuadPart);
+
+	// The OS zero fills the remainder of the last page of a mapping.
+	// If that is too short to honour the padding we need a private copy instead.
+	const u64 kPageSize = sysInfo.dwPageSize;
+	const u64 kTailSlack = (size % kPageSize) ? kPageSize - (size % kPageSize) : 0;
+	const bool bCanMap = size > 0 && size <= SIZE_MAX && kTailSlack >= kZeroPadding;
+
+	if (bCanMap)
+	{
+		HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (hMapping)
+		{
+			const void* pView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+			if (pView)
+			{
+				rViewOut.pData = static_cast<const memtype_t*>(pView);
+				rViewOut.size = size;
+				rViewOut.hFile = hFile;
+				rViewOut.hMapping = hMapping;
+				rViewOut.pMappedBase = pView;
+				rViewOut.pCopy = nullptr;
+				return true;
+			}
+			CloseHandle(hMapping);
+		}
+	}
+
+	// Fallback : copy the file into an aligned block with the padding appended.
+	ASSERT(size + kZeroPadding <= SIZE_MAX);
+	memtype_t* pCopy = (memtype_t*)_aligned_malloc(static_cast<size_t>(size + kZeroPadding), kAlignment ? kAlignment : 1);
+	ASSERT(pCopy);
+
+	u64 bytesRead = 0;
+	while (bytesRead < size)
+	{
+		const DWORD kChunk = static_cast<DWORD>(std::min<u64>(size - bytesRead, 1u << 30));
+		DWORD chunkRead = 0;
+		if (!ReadFile(hFile, pCopy + bytesRead, kChunk, &chunkRead, nullptr) || chunkRead == 0)
+		{
+			_aligned_free(pCopy);
+			CloseHandle(hFile);
+			return false;
+		}
+		bytesRead += chunkRead;
+	}
+	CloseHandle(hFile);
+
+	if (kZeroPadding > 0)
+	{
+		memset(pCopy + size, 0, kZeroPadding);
+	}
+
+	rViewOut.pData = pCopy;
+	rViewOut.size = size;
+	rViewOut.hFile = INVALID_HANDLE_VALUE;
+	rViewOut.hMapping = nullptr;
+	rViewOut.pMappedBase = nullptr;
+	rViewOut.pCopy = pCopy;
+	return true;
+}
+
+void unmap_file(FileView& rView)
+{
+	if (rView.pCopy)
+	{
+		_aligned_free(rView.pCopy);
+	}
+	else if (rView.pMappedBase)
+	{
+		UnmapViewOfFile(rView.pMappedBase);
+	}
+
+	if (rView.hMapping)
+	{
+		CloseHandle(rView.hMapping);
+	}
+	if (rView.hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(rView.hFile);
+	}
+
+	rView = FileView();
+}
@@ -29,6 +29,7 @@ struct Keys
 	// Flags:
 	bool showLabels; // True if object labels are drawn. Toggle with the space bar.
 	bool showGrid;   // True if the ground grid is drawn. Toggle with the return key.
+	bool showProfiler; // True if the profiler window is shown. Toggle with F1.
 };
 
 struct Mouse
@@ -102,7 +103,7 @@ struct Camera
 
 	void move(const MoveDir dir, const float amount);
 
-	void checkKeyboardMovement();
+	void checkKeyboardMovement(const float seconds);
 
 	void checkMouseRotation();
 
@@ -121,6 +122,16 @@ struct Camera
 
 
 
+class JobPool;
+class IoService;
+class BindingTable;
+class StateCache;
+class ShaderReloader;
+class ConstantRing;
+class CommandRecorder;
+class CommandBuffer;
+class GpuTimer;
+
 // ========================================================
 // The SystemsInterface provide access to
 // systems and device contexts.
@@ -129,9 +140,19 @@ struct SystemsInterface
 {
 	ID3D11Device* pD3DDevice;
 	ID3D11DeviceContext* pD3DContext;
+	CommandBuffer* pCommands;	// Draws, clears, targets and buffer writes for pD3DContext.
 	ID3D11RenderTargetView* pSwapRenderTarget; // 
 	dd::ContextHandle pDebugDrawContext;
 	Camera* pCamera;
+	JobPool* pJobPool;		// Shared worker threads.
+	IoService* pIoService;	// Asynchronous file reads, callbacks run on pJobPool.
+	BindingTable* pBindings;	// Batched SRV, sampler and constant buffer binds for pD3DContext.
+	StateCache* pStateCache;	// Shaders, input assembler and output merger state for pD3DContext.
+	ShaderReloader* pShaderReloader;	// Rebuilds watched shaders in the background, swapped in at the start of each frame.
+	ConstantRing* pConstants;	// Per draw constants, one map per batch of draws, bound by offset.
+	CommandRecorder* pRecorder;	// Records draws on pJobPool into per thread contexts, executed in order on pD3DContext.
+	GpuTimer* pGpuTimer;	// GPU time of passes on pD3DContext, results arrive a few frames late.
+	f32 deltaSeconds;	// Since the last frame, the same every frame in headless runs.
 	u32 width;
 	u32 height;
 };
@@ -146,6 +167,10 @@ public:
 	virtual void on_update(SystemsInterface& rSystems) = 0;
 	virtual void on_render(SystemsInterface& rSystems) = 0;
 	virtual void on_resize(SystemsInterface& rSystems) = 0;
+
+	// Run instead of the app when started with -precompile-shaders, e.g. as a post build step.
+	// Compile every shader the app can use into the shader cache, return false on errors.
+	virtual bool on_precompile_shaders() { return true; }
 protected:
 private:
 };
@@ -154,6 +179,8 @@ private:
 // Macro to define entry point.
 // ========================================================
 
+// Opens a window and runs the app until it closes. Started with -headless it runs a fixed
+// number of frames off-screen instead and writes a frame time report, see Framework.cpp.
 int framework_main(FrameworkApp& rApp, const char* pTitleString, HINSTANCE hInstance, int nCmdShow);
 
 #define FRAMEWORK_IMPLEMENT_MAIN(app, appTitle) \
@@ -186,8 +213,33 @@ void drawText(dd::ContextHandle ctx);
 
 // Loads an entire file into an allocated memory block.
 memtype_t* load_file(const char* pstrName, u32& rLengthOut, const u32 kAlignment, const u32 kZeroPadding);
+memtype_t* load_file(const char* pstrName, u64& rLengthOut, const u32 kAlignment, const u32 kZeroPadding);
 
 // Release a previously allocated block.
 void release_loaded_file(memtype_t* ptr);
 
+// A read-only view of an entire file.
+// The view is normally a memory mapping, so pages are only read from disk when touched.
+// The data is aligned to the OS allocation granularity (64KB on Windows) and is followed
+// by at least kZeroPadding zero bytes. The zeros come from the unused tail of the last
+// page when there is room, otherwise the file is copied into an aligned block instead.
+struct FileView
+{
+	const memtype_t* pData = nullptr;
+	u64 size = 0;
+
+	// Internal handles, only one of mapping or copy is used.
+	// A view with neither borrows its memory from something else (e.g. a mounted asset pack).
+	HANDLE hFile = INVALID_HANDLE_VALUE;
+	HANDLE hMapping = nullptr;
+	const void* pMappedBase = nullptr;
+	memtype_t* pCopy = nullptr;
+};
+
+// Maps a file into memory, returns false if the file could not be opened.
+bool map_file(const char* pstrName, FileView& rViewOut, const u32 kAlignment, const u32 kZeroPadding);
+
+// Release a previously mapped view.
+void unmap_file(FileView& rView);
+
 
@@ -0,0 +1,257 @@
+#include "GpuTimer.h"
+#include "Profiler.h"
+
+#include <chrono>
+
+// ========================================================
+// CpuClockTimerDevice
+// ========================================================
+
+CpuClockTimerDevice::Slot& CpuClockTimerDevice::slot(u32 slot)
+{
+	if (slot >= m_slots.size())
+	{
+		m_slots.resize(slot + 1);
+	}
+	return m_slots[slot];
+}
+
+void CpuClockTimerDevice::begin_frame(u32 slotIndex)
+{
+	Slot& rSlot = slot(slotIndex);
+	rSlot.ticks.assign(GpuTimer::kMaxTimestamps, 0);
+	rSlot.frame = m_frames;
+	rSlot.bEnded = false;
+}
+
+void CpuClockTimerDevice::timestamp(u32 slotIndex, u32 index)
+{
+	Slot& rSlot = slot(slotIndex);
+	ASSERT(!rSlot.bEnded && index < rSlot.ticks.size());
+	rSlot.ticks[index] = profile_time_ns();
+}
+
+void CpuClockTimerDevice::end_frame(u32 slotIndex)
+{
+	slot(slotIndex).bEnded = true;
+}
+
+bool CpuClockTimerDevice::resolve(u32 slotIndex, u32 count, u64* pTicksOut, u64& rFrequencyOut, bool& rbDisjointOut)
+{
+	const Slot& rSlot = slot(slotIndex);
+	if (!rSlot.bEnded || m_frames - rSlot.frame < m_latency)
+	{
+		++m_notReady;
+		return false;
+	}
+
+	for (u32 index = 0; index < count; ++index)
+	{
+		pTicksOut[index] = rSlot.ticks[index];
+	}
+	rFrequencyOut = 1000000000;
+	rbDisjointOut = false;
+	return true;
+}
+
+// ========================================================
+// GpuTimer
+// ========================================================
+
+// Open pass with no timestamps, past kMaxPasses or in a skipped frame.
+static const u32 kUntimedPass = ~0u;
+
+void GpuTimer::init(GpuTimerDevice* pDevice)
+{
+	m_pDevice = pDevice;
+	m_track = profiler_register_track("GPU");
+}
+
+void GpuTimer::begin_frame()
+{
+	ASSERT(m_pDevice && !m_bRecording);
+
+	// A slot still waiting on the GPU can't be reused, and waiting is what the ring avoids.
+	m_pDevice->next_frame();
+	m_slot = m_frame % kFramesInFlight;
+	++m_frame;
+	Frame& rFrame = m_frames[m_slot];
+	if (rFrame.bPending)
+	{
+		++m_stats.skipped;
+		return;
+	}
+
+	rFrame.frame = m_frame;
+	rFrame.cpuBeginNs = profile_time_ns();
+	rFrame.numTimestamps = 2;
+	rFrame.passes.clear();
+	m_pDevice->begin_frame(m_slot);
+	m_pDevice->timestamp(m_slot, 0);
+	m_bRecording = true;
+}
+
+void GpuTimer::begin_pass(const char* pName)
+{
+	Frame& rFrame = m_frames[m_slot];
+	if (!m_bRecording || rFrame.passes.size() == kMaxPasses)
+	{
+		m_stats.overflows += m_bRecording ? 1 : 0;
+		m_openPasses.push_back(kUntimedPass);
+		return;
+	}
+
+	const Pass pass = { pName, static_cast<u32>(m_openPasses.size()), rFrame.numTimestamps++, 0 };
+	m_openPasses.push_back(static_cast<u32>(rFrame.passes.size()));
+	rFrame.passes.push_back(pass);
+	m_pDevice->timestamp(m_slot, pass.begin);
+}
+
+void GpuTimer::end_pass()
+{
+	ASSERT(!m_openPasses.empty());
+	const u32 pass = m_openPasses.back();
+	m_openPasses.pop_back();
+	if (pass == kUntimedPass)
+	{
+		return;
+	}
+
+	Frame& rFrame = m_frames[m_slot];
+	rFrame.passes[pass].end = rFrame.numTimestamps++;
+	m_pDevice->timestamp(m_slot, rFrame.passes[pass].end);
+}
+
+void GpuTimer::end_frame()
+{
+	ASSERT(m_openPasses.empty());
+	++m_stats.frames;
+
+	if (m_bRecording)
+	{
+		m_pDevice->timestamp(m_slot, 1);
+		m_pDevice->end_frame(m_slot);
+		m_frames[m_slot].bPending = true;
+		m_bRecording = false;
+	}
+
+	resolve();
+}
+
+void GpuTimer::resolve()
+{
+	// The GPU finishes frames in order, so once one isn't ready the newer ones aren't either.
+	for (;;)
+	{
+		Frame* pOldest = nullptr;
+		u32 oldestSlot = 0;
+		for (u32 slot = 0; slot < kFramesInFlight; ++slot)
+		{
+			if (m_frames[slot].bPending && (!pOldest || m_frames[slot].frame < pOldest->frame))
+			{
+				pOldest = &m_frames[slot];
+				oldestSlot = slot;
+			}
+		}
+		if (!pOldest)
+		{
+			return;
+		}
+
+		u64 ticks[kMaxTimestamps];
+		u64 frequency = 0;
+		bool bDisjoint = false;
+		if (!m_pDevice->resolve(oldestSlot, pOldest->numTimestamps, ticks, frequency, bDisjoint))
+		{
+			return;
+		}
+
+		pOldest->bPending = false;
+		if (bDisjoint || frequency == 0)
+		{
+			++m_stats.disjoint;
+			continue;
+		}
+		++m_stats.resolved;
+		publish(*pOldest, ticks, frequency);
+	}
+}
+
+void GpuTimer::publish(const Frame& frame, const u64* pTicks, u64 frequency)
+{
+	const f64 msPerTick = 1000.0 / frequency;
+	auto elapsedMs = [pTicks, msPerTick](u32 begin, u32 end)
+	{
+		return pTicks[end] > pTicks[begin] ? (pTicks[end] - pTicks[begin]) * msPerTick : 0.0;
+	};
+
+	m_timingsFrame = frame.frame;
+	m_frameMs = elapsedMs(0, 1);
+	m_timings.clear();
+
+	// The GPU clock has its own origin, the frame is placed where the CPU began it.
+	std::vector<ProfileEvent> events;
+	events.reserve(frame.passes.size() + 1);
+	auto toNs = [&frame](f64 ms) { return frame.cpuBeginNs + static_cast<u64>(ms * 1000000.0); };
+	events.push_back({ "GPU frame", frame.cpuBeginNs, toNs(m_frameMs), 0 });
+
+	for (const Pass& rPass : frame.passes)
+	{
+		const GpuPassTiming timing = { rPass.pName, rPass.depth, elapsedMs(0, rPass.begin), elapsedMs(rPass.begin, rPass.end) };
+		m_timings.push_back(timing);
+		events.push_back({ rPass.pName, toNs(timing.startMs), toNs(timing.startMs + timing.ms), rPass.depth + 1 });
+	}
+
+	profiler_add_track_events(m_track, events.data(), static_cast<u32>(events.size()));
+}
+
+#if defined(_WIN32)
+
+// ========================================================
+// D3D11GpuTimerDevice
+// ========================================================
+
+void D3D11GpuTimerDevice::init(ID3D11Device* pDevice, ID3D11DeviceContext* pContext)
+{
+	m_pContext = pContext;
+
+	const D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+	const D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+	for (Slot& rSlot : m_slots)
+	{
+		bool bOk = SUCCEEDED(pDevice->CreateQuery(&disjointDesc, rSlot.disjoint.GetAddressOf()));
+		for (auto& rTimestamp : rSlot.timestamps)
+		{
+			bOk = bOk && SUCCEEDED(pDevice->CreateQuery(&timestampDesc, rTimestamp.GetAddressOf()));
+		}
+		if (!bOk)
+		{
+			panicF("D3D11GpuTimerDevice : failed to create timestamp queries");
+		}
+	}
+}
+
+bool D3D11GpuTimerDevice::resolve(u32 slot, u32 count, u64* pTicksOut, u64& rFrequencyOut, bool& rbDisjointOut)
+{
+	// DONOTFLUSH, asking must not push work to the GPU early either.
+	Slot& rSlot = m_slots[slot];
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+	if (m_pContext->GetData(rSlot.disjoint.Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+	{
+		return false;
+	}
+
+	for (u32 index = 0; index < count; ++index)
+	{
+		if (m_pContext->GetData(rSlot.timestamps[index].Get(), &pTicksOut[index], sizeof(u64), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		{
+			return false;
+		}
+	}
+
+	rFrequencyOut = disjoint.Frequency;
+	rbDisjointOut = disjoint.Disjoint != FALSE;
+	return true;
+}
+
+#endif
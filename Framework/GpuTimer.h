@@ -0,0 +1,217 @@
+#pragma once
+
+#include "CoreTypes.h"
+
+#include <vector>
+
+//================================================================================
+// GpuTimer
+// GPU time of each pass of a frame, from timestamps the GPU writes as it
+// reaches the start and end of the pass.
+//
+// The results of a frame are only ready once the GPU has finished it, a few
+// frames after the CPU submitted it. Each frame records into one of
+// kFramesInFlight slots and the timer only ever asks whether the oldest
+// slots are done, it never waits. If every slot is still waiting the frame
+// goes untimed, counted in Stats::skipped.
+//
+// Resolved passes are kept for timings() and sent to the profiler as the
+// "GPU" track, placed from the CPU time the frame began.
+//
+// Platform independent, the timestamps come from a GpuTimerDevice.
+// D3D11GpuTimerDevice uses timestamp and disjoint queries, CpuClockTimerDevice
+// stands in with the CPU clock and a fixed latency so the ring and the
+// aggregation can be checked headless.
+//================================================================================
+
+// ========================================================
+// GpuTimerDevice
+// ========================================================
+class GpuTimerDevice
+{
+public:
+	virtual ~GpuTimerDevice() {}
+
+	// Start of every frame on the CPU, timed or not.
+	virtual void next_frame() {}
+
+	// Start and end a frame's timestamps in slot, between them write timestamp index.
+	virtual void begin_frame(u32 slot) = 0;
+	virtual void timestamp(u32 slot, u32 index) = 0;
+	virtual void end_frame(u32 slot) = 0;
+
+	// The first count timestamps of the slot's last frame, in ticks of
+	// rFrequencyOut per second. False without waiting if they aren't ready.
+	// rbDisjointOut is set when the ticks can't be trusted, e.g. the GPU
+	// clock changed during the frame.
+	virtual bool resolve(u32 slot, u32 count, u64* pTicksOut, u64& rFrequencyOut, bool& rbDisjointOut) = 0;
+};
+
+// Timestamps from the CPU clock. A frame's are ready once latency more
+// frames have started, as if the GPU ran that far behind.
+class CpuClockTimerDevice : public GpuTimerDevice
+{
+public:
+	explicit CpuClockTimerDevice(u32 latency = 2) : m_latency(latency) {}
+
+	void next_frame() override { ++m_frames; }
+	void begin_frame(u32 slot) override;
+	void timestamp(u32 slot, u32 index) override;
+	void end_frame(u32 slot) override;
+	bool resolve(u32 slot, u32 count, u64* pTicksOut, u64& rFrequencyOut, bool& rbDisjointOut) override;
+
+	// Frames started, and resolve() calls that found the results not ready.
+	u32 num_frames() const { return m_frames; }
+	u32 num_not_ready() const { return m_notReady; }
+
+private:
+	struct Slot
+	{
+		std::vector<u64> ticks;
+		u32 frame = 0;			// m_frames when the slot's frame started.
+		bool bEnded = false;
+	};
+
+	Slot& slot(u32 slot);
+
+	std::vector<Slot> m_slots;
+	u32 m_latency;
+	u32 m_frames = 0;
+	u32 m_notReady = 0;
+};
+
+// ========================================================
+// GpuTimer
+// ========================================================
+
+struct GpuPassTiming
+{
+	const char* pName;
+	u32 depth;			// 0 for passes not inside another.
+	f64 startMs;		// From the start of the frame.
+	f64 ms;
+};
+
+class GpuTimer
+{
+public:
+	static const u32 kFramesInFlight = 4;
+	static const u32 kMaxPasses = 64;
+	static const u32 kMaxTimestamps = 2 + 2 * kMaxPasses;	// The frame's start and end, then the passes'.
+
+	struct Stats
+	{
+		u32 frames;			// end_frame() calls.
+		u32 resolved;		// Frames with results.
+		u32 skipped;		// Frames untimed, every slot was still waiting.
+		u32 disjoint;		// Frames resolved without usable results.
+		u32 overflows;		// Passes untimed, over kMaxPasses in a frame.
+	};
+
+	GpuTimer() {}
+
+	void init(GpuTimerDevice* pDevice);
+
+	// Around everything the frame submits. end_frame() also picks up any results that are ready.
+	void begin_frame();
+	void end_frame();
+
+	// Passes nest. Names are kept until the frame resolves, see profile_intern().
+	void begin_pass(const char* pName);
+	void end_pass();
+
+	// Passes of the newest frame with results, in the order they began.
+	const std::vector<GpuPassTiming>& timings() const { return m_timings; }
+	f64 frame_ms() const { return m_frameMs; }
+
+	// Frames between the newest result and the frame being recorded, 0 before any.
+	u32 latency() const { return m_timingsFrame ? m_frame - m_timingsFrame : 0; }
+
+	const Stats& stats() const { return m_stats; }
+	void reset_stats() { m_stats = {}; }
+
+private:
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+
+	struct Pass
+	{
+		const char* pName;
+		u32 depth;
+		u32 begin;		// Timestamp indices.
+		u32 end;
+	};
+
+	struct Frame
+	{
+		bool bPending;
+		u32 frame;
+		u64 cpuBeginNs;
+		u32 numTimestamps;
+		std::vector<Pass> passes;
+	};
+
+	// Read back finished frames, oldest first, stopping at the first not ready.
+	void resolve();
+	void publish(const Frame& frame, const u64* pTicks, u64 frequency);
+
+	GpuTimerDevice* m_pDevice = nullptr;
+	Frame m_frames[kFramesInFlight] = {};
+	u32 m_frame = 0;				// Frames begun.
+	u32 m_slot = 0;
+	bool m_bRecording = false;		// The current frame has a slot.
+	std::vector<u32> m_openPasses;	// Indices into the slot's passes, kUntimedPass for overflows.
+
+	std::vector<GpuPassTiming> m_timings;
+	f64 m_frameMs = 0.0;
+	u32 m_timingsFrame = 0;
+	u32 m_track = 0;
+
+	Stats m_stats = {};
+};
+
+// Times a pass for the rest of the scope, pTimer may be null.
+class GpuPassScope
+{
+public:
+	GpuPassScope(GpuTimer* pTimer, const char* pName) : m_pTimer(pTimer) { if (m_pTimer) m_pTimer->begin_pass(pName); }
+	~GpuPassScope() { if (m_pTimer) m_pTimer->end_pass(); }
+
+private:
+	GpuPassScope(const GpuPassScope&) = delete;
+	GpuPassScope& operator=(const GpuPassScope&) = delete;
+
+	GpuTimer* m_pTimer;
+};
+
+#if defined(_WIN32)
+
+#include <d3d11.h>
+#include <wrl.h>
+
+// Timestamp queries on the immediate context, deferred contexts can't time.
+// One disjoint query per slot brackets its frame and gives the tick rate.
+class D3D11GpuTimerDevice : public GpuTimerDevice
+{
+public:
+	D3D11GpuTimerDevice() {}
+
+	void init(ID3D11Device* pDevice, ID3D11DeviceContext* pContext);
+
+	void begin_frame(u32 slot) override { m_pContext->Begin(m_slots[slot].disjoint.Get()); }
+	void timestamp(u32 slot, u32 index) override { m_pContext->End(m_slots[slot].timestamps[index].Get()); }
+	void end_frame(u32 slot) override { m_pContext->End(m_slots[slot].disjoint.Get()); }
+	bool resolve(u32 slot, u32 count, u64* pTicksOut, u64& rFrequencyOut, bool& rbDisjointOut) override;
+
+private:
+	struct Slot
+	{
+		Microsoft::WRL::ComPtr<ID3D11Query> disjoint;
+		Microsoft::WRL::ComPtr<ID3D11Query> timestamps[GpuTimer::kMaxTimestamps];
+	};
+
+	ID3D11DeviceContext* m_pContext = nullptr;
+	Slot m_slots[GpuTimer::kFramesInFlight];
+};
+
+#endif
@@ -0,0 +1,271 @@
+#include "HotReload.h"
+#include "JobQueue.h"
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(_WIN32)
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#else
+	#include <sys/stat.h>
+#endif
+
+u64 file_stamp(const char* pPath)
+{
+	// Write time and size, an editor that saves twice within the timer resolution usually changes the size.
+#if defined(_WIN32)
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(pPath, GetFileExInfoStandard, &data))
+	{
+		return 0;
+	}
+	const u64 writeTime = (static_cast<u64>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+	const u64 size = (static_cast<u64>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+#else
+	struct stat info;
+	if (stat(pPath, &info) != 0)
+	{
+		return 0;
+	}
+	const u64 writeTime = static_cast<u64>(info.st_mtim.tv_sec) * 1000000000ull + static_cast<u64>(info.st_mtim.tv_nsec);
+	const u64 size = static_cast<u64>(info.st_size);
+#endif
+	const u64 stamp = hash_bytes(&size, sizeof(size), hash_bytes(&writeTime, sizeof(writeTime)));
+	return stamp ? stamp : 1;
+}
+
+static f64 now_seconds()
+{
+	using Clock = std::chrono::steady_clock;
+	static const Clock::time_point s_start = Clock::now();
+	return std::chrono::duration<f64>(Clock::now() - s_start).count();
+}
+
+HotReload::HotReload()
+{
+}
+
+HotReload::~HotReload()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this]() { return m_inFlight == 0; });
+}
+
+void HotReload::init(JobPool* pJobPool, f64 pollIntervalSeconds)
+{
+	m_pJobPool = pJobPool;
+	m_pollInterval = pollIntervalSeconds;
+}
+
+HotReload::Handle HotReload::add(CompileFn compile, ApplyFn apply)
+{
+	std::unique_ptr<Item> pItem(new Item());
+	pItem->compile = std::move(compile);
+	pItem->apply = std::move(apply);
+	m_items.push_back(std::move(pItem));
+	return static_cast<Handle>(m_items.size() - 1);
+}
+
+void HotReload::set_compile(Handle handle, CompileFn compile)
+{
+	ASSERT(handle < m_items.size());
+	Item& rItem = *m_items[handle];
+
+	// A job in flight holds its own copy, the new function is used from the next compile.
+	std::lock_guard<std::mutex> lock(m_mutex);
+	rItem.compile = std::move(compile);
+	rItem.bWanted = true;
+}
+
+void HotReload::request(Handle handle)
+{
+	ASSERT(handle < m_items.size());
+	m_items[handle]->bWanted = true;
+}
+
+bool HotReload::busy(Handle handle) const
+{
+	ASSERT(handle < m_items.size());
+	const Item& rItem = *m_items[handle];
+	return rItem.bWanted || rItem.bCompiling;
+}
+
+HotReload::Stats HotReload::stats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Stats stats = m_stats;
+	stats.numItems = static_cast<u32>(m_items.size());
+	stats.compilesInFlight = m_inFlight;
+	return stats;
+}
+
+void HotReload::start_compile(Item& rItem)
+{
+	ASSERT(m_pJobPool);
+
+	rItem.bWanted = false;
+	rItem.bCompiling = true;
+
+	// The job works on copies, the item's own fields belong to the owner thread.
+	CompileFn compile;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		compile = rItem.compile;
+		rItem.bDone = false;
+		++m_inFlight;
+	}
+	std::vector<std::string> oldFiles = rItem.files;
+
+	Item* pItem = &rItem;
+	m_pJobPool->pushJob([this, pItem, compile, oldFiles]()
+	{
+		// Stamp the files known so far before reading them, an edit made while
+		// compiling then still shows up as a change on the next poll.
+		std::vector<u64> oldStamps;
+		for (const std::string& rFile : oldFiles)
+		{
+			oldStamps.push_back(file_stamp(rFile.c_str()));
+		}
+
+		std::vector<std::string> files;
+		std::string errors;
+		const bool bOk = compile(files, errors);
+
+		std::vector<u64> stamps;
+		for (const std::string& rFile : files)
+		{
+			auto it = std::find(oldFiles.begin(), oldFiles.end(), rFile);
+			stamps.push_back(it != oldFiles.end() ? oldStamps[it - oldFiles.begin()] : file_stamp(rFile.c_str()));
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		pItem->bOk = bOk;
+		pItem->errors = std::move(errors);
+		pItem->newFiles = std::move(files);
+		pItem->newStamps = std::move(stamps);
+		pItem->bDone = true;
+		++m_stats.compiles;
+		m_stats.failures += bOk ? 0 : 1;
+		--m_inFlight;
+		m_idle.notify_all();
+	});
+}
+
+void HotReload::check_files(Item& rItem)
+{
+	for (size_t i = 0; i < rItem.files.size(); ++i)
+	{
+		if (file_stamp(rItem.files[i].c_str()) != rItem.stamps[i])
+		{
+			rItem.bWanted = true;
+			std::lock_guard<std::mutex> lock(m_mutex);
+			++m_stats.reloads;
+			return;
+		}
+	}
+}
+
+void HotReload::poll_files()
+{
+	const f64 now = now_seconds();
+	if (m_lastPoll >= 0.0 && now - m_lastPoll < m_pollInterval)
+	{
+		return;
+	}
+	m_lastPoll = now;
+
+	for (std::unique_ptr<Item>& rpItem : m_items)
+	{
+		Item& rItem = *rpItem;
+		if (!rItem.bWanted && !rItem.bCompiling)
+		{
+			check_files(rItem);
+		}
+	}
+}
+
+void HotReload::update()
+{
+	// Finished compiles first, so an item that just finished can be polled and restarted.
+	for (std::unique_ptr<Item>& rpItem : m_items)
+	{
+		Item& rItem = *rpItem;
+		if (!rItem.bCompiling)
+		{
+			continue;
+		}
+
+		bool bOk;
+		std::string errors;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!rItem.bDone)
+			{
+				continue;
+			}
+			bOk = rItem.bOk;
+			errors = std::move(rItem.errors);
+			rItem.files = std::move(rItem.newFiles);
+			rItem.stamps = std::move(rItem.newStamps);
+		}
+		rItem.bCompiling = false;
+
+		// Files aren't polled while their item compiles, an edit made meanwhile
+		// shows up against the stamps taken before the compile read them.
+		if (!rItem.bWanted)
+		{
+			check_files(rItem);
+		}
+
+		// Asked for something newer while this compiled, don't show the stale result.
+		if (rItem.bWanted)
+		{
+			continue;
+		}
+
+		rItem.apply(bOk, errors);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_stats.applied;
+	}
+
+	poll_files();
+
+	for (std::unique_ptr<Item>& rpItem : m_items)
+	{
+		if (rpItem->bWanted && !rpItem->bCompiling)
+		{
+			start_compile(*rpItem);
+		}
+	}
+}
+
+void HotReload::flush()
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_idle.wait(lock, [this]() { return m_inFlight == 0; });
+		}
+
+		update();
+
+		// update() may have started compiles for items that were asked for again,
+		// they can finish before this looks so go by the items, not m_inFlight.
+		bool bCompiling = false;
+		for (const std::unique_ptr<Item>& rpItem : m_items)
+		{
+			bCompiling |= rpItem->bCompiling;
+		}
+		if (!bCompiling)
+		{
+			return;
+		}
+	}
+}
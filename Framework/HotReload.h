@@ -0,0 +1,119 @@
+#pragma once
+
+#include "CoreTypes.h"
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class JobPool;
+
+//================================================================================
+// HotReload
+// Rebuilds things made from files when the files change, on background jobs,
+// and hands the results back on the thread that uses them.
+//
+// Each item has a compile function, run on the job pool, that builds a new
+// version somewhere the owner isn't looking and lists the files it read, and
+// an apply function, run from update(), that swaps the new version in. A
+// failed compile still calls apply with the errors so the owner can report
+// them and keep what it has. The owning thread never waits on a compile.
+//
+// Files are polled by modification stamp from update(), at most once per
+// poll interval. An item is only ever compiled by one job at a time, changes
+// made while it compiles queue one more compile and the stale result is
+// dropped.
+//
+// Platform independent, the compile and apply functions do the real work.
+//================================================================================
+
+// Changes when the file is written, zero if it doesn't exist.
+u64 file_stamp(const char* pPath);
+
+class HotReload
+{
+public:
+	using Handle = u32;
+	static const Handle kInvalidHandle = ~0u;
+
+	// Runs on a job. Returns false on errors, lists the files it depends on either way.
+	typedef std::function<bool(std::vector<std::string>& rFilesOut, std::string& rErrorsOut)> CompileFn;
+
+	// Runs in update(), bOk is false when the compile failed.
+	typedef std::function<void(bool bOk, const std::string& rErrors)> ApplyFn;
+
+	struct Stats
+	{
+		u32 numItems;
+		u32 compilesInFlight;
+		u64 compiles;	// Finished compiles.
+		u64 failures;	// Compiles that returned false.
+		u64 applied;	// Results handed to apply, stale ones are not.
+		u64 reloads;	// Compiles started because a file changed.
+	};
+
+	HotReload();
+
+	// Waits for compiles in flight.
+	~HotReload();
+
+	// pJobPool must outlive this. A poll interval of zero checks every update().
+	void init(JobPool* pJobPool, f64 pollIntervalSeconds = 0.25);
+
+	// Register an item, its first compile starts on the next update().
+	Handle add(CompileFn compile, ApplyFn apply);
+
+	// Build something else into the same item, e.g. another entry point, and compile it.
+	void set_compile(Handle handle, CompileFn compile);
+
+	// Compile again even though nothing changed.
+	void request(Handle handle);
+
+	// Apply finished compiles, poll the files and start compiles. Call from the owning thread.
+	void update();
+
+	// Block until no compile is in flight, then apply what finished. For shutdown and tools.
+	void flush();
+
+	bool busy(Handle handle) const;
+	Stats stats() const;
+
+private:
+	struct Item
+	{
+		CompileFn compile;
+		ApplyFn apply;
+
+		// Owner thread only.
+		std::vector<std::string> files;
+		std::vector<u64> stamps;
+		bool bWanted = true;	// Compile on the next update().
+		bool bCompiling = false;
+
+		// Written by the job under m_mutex.
+		bool bDone = false;
+		bool bOk = false;
+		std::string errors;
+		std::vector<std::string> newFiles;
+		std::vector<u64> newStamps;
+	};
+
+	void start_compile(Item& rItem);
+
+	// Wants the item again if any of its files changed since it was compiled.
+	void check_files(Item& rItem);
+	void poll_files();
+
+	JobPool* m_pJobPool = nullptr;
+	f64 m_pollInterval = 0.25;
+	f64 m_lastPoll = -1.0;
+	std::vector<std::unique_ptr<Item>> m_items;	// Indexed by handle.
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_idle;
+	u32 m_inFlight = 0;
+	Stats m_stats = {};
+};
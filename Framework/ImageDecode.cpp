@@ -0,0 +1,560 @@
+#include "ImageDecode.h"
+#include "JobQueue.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_NO_STDIO
+#include "stb/stb_image.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+	#define PNG_USE_SSE 1
+	#include <emmintrin.h>
+#else
+	#define PNG_USE_SSE 0
+#endif
+
+// ========================================================
+// stb_image.
+// ========================================================
+
+static bool decode_with_stb(const memtype_t* pData, u64 size, DecodedImage& rImageOut, const char** pErrorOut)
+{
+	int width = 0;
+	int height = 0;
+	int channelsInFile = 0;
+	stbi_uc* pPixels = stbi_load_from_memory(pData, static_cast<int>(size), &width, &height, &channelsInFile, 4);
+	if (!pPixels)
+	{
+		if (pErrorOut) *pErrorOut = stbi_failure_reason();
+		return false;
+	}
+
+	rImageOut.width = static_cast<u32>(width);
+	rImageOut.height = static_cast<u32>(height);
+	rImageOut.pixels.assign(pPixels, pPixels + static_cast<size_t>(width) * height * 4);
+	stbi_image_free(pPixels);
+	return true;
+}
+
+// ========================================================
+// PNG filter reconstruction.
+// Each row starts with a filter type byte, the filters predict from the
+// pixel to the left (a), above (b) and above left (c) of the unfiltered data.
+// ========================================================
+
+enum PngFilter : u8
+{
+	kPngFilterNone = 0,
+	kPngFilterSub = 1,
+	kPngFilterUp = 2,
+	kPngFilterAvg = 3,
+	kPngFilterPaeth = 4,
+};
+
+static inline u8 paeth_predictor(s32 a, s32 b, s32 c)
+{
+	const s32 p = a + b - c;
+	const s32 pa = abs(p - a);
+	const s32 pb = abs(p - b);
+	const s32 pc = abs(p - c);
+	if (pa <= pb && pa <= pc)
+	{
+		return static_cast<u8>(a);
+	}
+	return static_cast<u8>(pb <= pc ? b : c);
+}
+
+// Any pixel size, also used for the tails the SSE versions leave.
+static void unfilter_row_scalar(u8 filter, u8* pRow, const u8* pPrior, u32 rowBytes, u32 bpp, u32 start)
+{
+	switch (filter)
+	{
+	case kPngFilterSub:
+		for (u32 i = std::max(start, bpp); i < rowBytes; ++i)
+		{
+			pRow[i] = static_cast<u8>(pRow[i] + pRow[i - bpp]);
+		}
+		break;
+	case kPngFilterUp:
+		for (u32 i = start; i < rowBytes; ++i)
+		{
+			pRow[i] = static_cast<u8>(pRow[i] + pPrior[i]);
+		}
+		break;
+	case kPngFilterAvg:
+		for (u32 i = start; i < rowBytes; ++i)
+		{
+			const u32 left = i >= bpp ? pRow[i - bpp] : 0;
+			pRow[i] = static_cast<u8>(pRow[i] + ((left + pPrior[i]) >> 1));
+		}
+		break;
+	case kPngFilterPaeth:
+		for (u32 i = start; i < rowBytes; ++i)
+		{
+			const s32 left = i >= bpp ? pRow[i - bpp] : 0;
+			const s32 upLeft = i >= bpp ? pPrior[i - bpp] : 0;
+			pRow[i] = static_cast<u8>(pRow[i] + paeth_predictor(left, pPrior[i], upLeft));
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+#if PNG_USE_SSE
+
+// Pixels of 3 or 4 bytes moved through the low lane of a register.
+// The size is a template argument so the copies compile to plain moves.
+template<u32 kBpp>
+static inline __m128i load_pixel(const u8* p)
+{
+	u32 value = 0;
+	memcpy(&value, p, kBpp);
+	return _mm_cvtsi32_si128(static_cast<int>(value));
+}
+
+template<u32 kBpp>
+static inline void store_pixel(u8* p, __m128i v)
+{
+	const u32 value = static_cast<u32>(_mm_cvtsi128_si32(v));
+	memcpy(p, &value, kBpp);
+}
+
+static void unfilter_up_sse(u8* pRow, const u8* pPrior, u32 rowBytes)
+{
+	u32 i = 0;
+	for (; i + 16 <= rowBytes; i += 16)
+	{
+		const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow + i));
+		const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pPrior + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pRow + i), _mm_add_epi8(x, b));
+	}
+	unfilter_row_scalar(kPngFilterUp, pRow, pPrior, rowBytes, 1, i);
+}
+
+static void unfilter_sub4_sse(u8* pRow, u32 rowBytes)
+{
+	// Prefix sum of four pixels at a time, carrying the last pixel into the next group.
+	__m128i carry = _mm_setzero_si128();
+	u32 i = 0;
+	for (; i + 16 <= rowBytes; i += 16)
+	{
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow + i));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+		x = _mm_add_epi8(x, carry);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pRow + i), x);
+		carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+	unfilter_row_scalar(kPngFilterSub, pRow, nullptr, rowBytes, 4, i);
+}
+
+static void unfilter_sub3_sse(u8* pRow, u32 rowBytes)
+{
+	__m128i a = _mm_setzero_si128();
+	for (u32 i = 0; i + 3 <= rowBytes; i += 3)
+	{
+		a = _mm_add_epi8(a, load_pixel<3>(pRow + i));
+		store_pixel<3>(pRow + i, a);
+	}
+}
+
+template<u32 kBpp>
+static void unfilter_avg_sse(u8* pRow, const u8* pPrior, u32 rowBytes)
+{
+	const __m128i one = _mm_set1_epi8(1);
+	__m128i a = _mm_setzero_si128();
+	for (u32 i = 0; i + kBpp <= rowBytes; i += kBpp)
+	{
+		// avg_epu8 rounds up, take the carry back off where the low bits differ.
+		const __m128i b = load_pixel<kBpp>(pPrior + i);
+		__m128i avg = _mm_avg_epu8(a, b);
+		avg = _mm_sub_epi8(avg, _mm_and_si128(_mm_xor_si128(a, b), one));
+		a = _mm_add_epi8(load_pixel<kBpp>(pRow + i), avg);
+		store_pixel<kBpp>(pRow + i, a);
+	}
+}
+
+template<u32 kBpp>
+static void unfilter_paeth_sse(u8* pRow, const u8* pPrior, u32 rowBytes)
+{
+	// Predictor maths in 16 bit lanes, ties favour a then b then c.
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a = zero;
+	__m128i c = zero;
+	for (u32 i = 0; i + kBpp <= rowBytes; i += kBpp)
+	{
+		const __m128i b = _mm_unpacklo_epi8(load_pixel<kBpp>(pPrior + i), zero);
+		const __m128i x = load_pixel<kBpp>(pRow + i);
+
+		const __m128i pa0 = _mm_sub_epi16(b, c);
+		const __m128i pb0 = _mm_sub_epi16(a, c);
+		const __m128i pc0 = _mm_add_epi16(pa0, pb0);
+		const __m128i pa = _mm_max_epi16(pa0, _mm_sub_epi16(zero, pa0));
+		const __m128i pb = _mm_max_epi16(pb0, _mm_sub_epi16(zero, pb0));
+		const __m128i pc = _mm_max_epi16(pc0, _mm_sub_epi16(zero, pc0));
+
+		const __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+		const __m128i isA = _mm_cmpeq_epi16(smallest, pa);
+		const __m128i isB = _mm_cmpeq_epi16(smallest, pb);
+		__m128i nearest = _mm_or_si128(_mm_and_si128(isB, b), _mm_andnot_si128(isB, c));
+		nearest = _mm_or_si128(_mm_and_si128(isA, a), _mm_andnot_si128(isA, nearest));
+
+		const __m128i result = _mm_add_epi8(x, _mm_packus_epi16(nearest, zero));
+		store_pixel<kBpp>(pRow + i, result);
+
+		a = _mm_unpacklo_epi8(result, zero);
+		c = b;
+	}
+}
+
+static void unfilter_row(u8 filter, u8* pRow, const u8* pPrior, u32 rowBytes, u32 bpp)
+{
+	if (filter == kPngFilterUp)
+	{
+		unfilter_up_sse(pRow, pPrior, rowBytes);
+		return;
+	}
+	if (bpp != 3 && bpp != 4)
+	{
+		unfilter_row_scalar(filter, pRow, pPrior, rowBytes, bpp, 0);
+		return;
+	}
+
+	switch (filter)
+	{
+	case kPngFilterSub:
+		if (bpp == 4) { unfilter_sub4_sse(pRow, rowBytes); } else { unfilter_sub3_sse(pRow, rowBytes); }
+		break;
+	case kPngFilterAvg:
+		if (bpp == 4) { unfilter_avg_sse<4>(pRow, pPrior, rowBytes); } else { unfilter_avg_sse<3>(pRow, pPrior, rowBytes); }
+		break;
+	case kPngFilterPaeth:
+		if (bpp == 4) { unfilter_paeth_sse<4>(pRow, pPrior, rowBytes); } else { unfilter_paeth_sse<3>(pRow, pPrior, rowBytes); }
+		break;
+	default:
+		break;
+	}
+}
+
+#else
+
+static void unfilter_row(u8 filter, u8* pRow, const u8* pPrior, u32 rowBytes, u32 bpp)
+{
+	unfilter_row_scalar(filter, pRow, pPrior, rowBytes, bpp, 0);
+}
+
+#endif
+
+// ========================================================
+// PNG.
+// ========================================================
+
+enum PngColourType : u8
+{
+	kPngGrey = 0,
+	kPngRgb = 2,
+	kPngPalette = 3,
+	kPngGreyAlpha = 4,
+	kPngRgba = 6,
+};
+
+struct PngImage
+{
+	u32 width = 0;
+	u32 height = 0;
+	u8 colourType = 0;
+	u32 bpp = 0;					// Bytes per pixel of the filtered data.
+	u32 palette[256] = {};			// RGBA, little endian.
+	std::vector<u8> compressed;		// The IDAT chunks joined together.
+};
+
+static inline u32 read_be32(const u8* p)
+{
+	return (static_cast<u32>(p[0]) << 24) | (static_cast<u32>(p[1]) << 16) | (static_cast<u32>(p[2]) << 8) | p[3];
+}
+
+static inline u32 chunk_type(char a, char b, char c, char d)
+{
+	return (static_cast<u32>(a) << 24) | (static_cast<u32>(b) << 16) | (static_cast<u32>(c) << 8) | static_cast<u32>(d);
+}
+
+static bool is_png(const memtype_t* pData, u64 size)
+{
+	static const u8 s_signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	return size >= 8 && memcmp(pData, s_signature, 8) == 0;
+}
+
+// Read the chunks. Only succeeds for the layouts the local path handles.
+static bool parse_png(const memtype_t* pData, u64 size, PngImage& rOut)
+{
+	u64 offset = 8;
+	bool bHeader = false;
+	u32 paletteSize = 0;
+	while (offset + 12 <= size)
+	{
+		const u32 length = read_be32(pData + offset);
+		const u32 type = read_be32(pData + offset + 4);
+		const u8* pChunk = pData + offset + 8;
+		if (length > size - offset - 12)
+		{
+			return false;
+		}
+
+		if (type == chunk_type('I', 'H', 'D', 'R'))
+		{
+			if (length != 13)
+			{
+				return false;
+			}
+			rOut.width = read_be32(pChunk);
+			rOut.height = read_be32(pChunk + 4);
+			rOut.colourType = pChunk[9];
+			const u8 bitDepth = pChunk[8];
+			const u8 interlace = pChunk[12];
+			static const u32 s_channels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+			if (bitDepth != 8 || interlace != 0 || rOut.colourType > kPngRgba || s_channels[rOut.colourType] == 0 ||
+				rOut.width == 0 || rOut.height == 0 || rOut.width > (1u << 24) || rOut.height > (1u << 24))
+			{
+				return false;
+			}
+			rOut.bpp = s_channels[rOut.colourType];
+			bHeader = true;
+		}
+		else if (type == chunk_type('P', 'L', 'T', 'E'))
+		{
+			paletteSize = std::min(length / 3, 256u);
+			for (u32 i = 0; i < paletteSize; ++i)
+			{
+				const u8* p = pChunk + i * 3;
+				rOut.palette[i] = p[0] | (p[1] << 8) | (p[2] << 16) | 0xFF000000u;
+			}
+		}
+		else if (type == chunk_type('t', 'R', 'N', 'S'))
+		{
+			// Colour keys are left to stb_image, palette alpha is simple.
+			if (rOut.colourType != kPngPalette)
+			{
+				return false;
+			}
+			for (u32 i = 0; i < std::min(length, 256u); ++i)
+			{
+				rOut.palette[i] = (rOut.palette[i] & 0x00FFFFFFu) | (static_cast<u32>(pChunk[i]) << 24);
+			}
+		}
+		else if (type == chunk_type('I', 'D', 'A', 'T'))
+		{
+			rOut.compressed.insert(rOut.compressed.end(), pChunk, pChunk + length);
+		}
+		else if (type == chunk_type('I', 'E', 'N', 'D'))
+		{
+			break;
+		}
+		else if (type == chunk_type('C', 'g', 'B', 'I'))
+		{
+			// Apple's variant needs stb_image's conversions.
+			return false;
+		}
+
+		offset += 12 + static_cast<u64>(length);
+	}
+
+	return bHeader && !rOut.compressed.empty() && (rOut.colourType != kPngPalette || paletteSize > 0);
+}
+
+// Pick a range size that keeps each job at a useful amount of work.
+static u32 rows_per_job(u32 rowBytes)
+{
+	return std::max(8u, 256 * 1024 / std::max(rowBytes, 1u));
+}
+
+static void expand_row(const PngImage& rPng, const u8* pSrc, u8* pDst)
+{
+	const u32 width = rPng.width;
+	switch (rPng.colourType)
+	{
+	case kPngRgba:
+		memcpy(pDst, pSrc, width * 4);
+		break;
+	case kPngRgb:
+		for (u32 x = 0; x < width; ++x)
+		{
+			pDst[x * 4 + 0] = pSrc[x * 3 + 0];
+			pDst[x * 4 + 1] = pSrc[x * 3 + 1];
+			pDst[x * 4 + 2] = pSrc[x * 3 + 2];
+			pDst[x * 4 + 3] = 255;
+		}
+		break;
+	case kPngGrey:
+		for (u32 x = 0; x < width; ++x)
+		{
+			const u32 grey = pSrc[x];
+			const u32 pixel = grey | (grey << 8) | (grey << 16) | 0xFF000000u;
+			memcpy(pDst + x * 4, &pixel, 4);
+		}
+		break;
+	case kPngGreyAlpha:
+		for (u32 x = 0; x < width; ++x)
+		{
+			const u32 grey = pSrc[x * 2];
+			const u32 pixel = grey | (grey << 8) | (grey << 16) | (static_cast<u32>(pSrc[x * 2 + 1]) << 24);
+			memcpy(pDst + x * 4, &pixel, 4);
+		}
+		break;
+	case kPngPalette:
+		for (u32 x = 0; x < width; ++x)
+		{
+			memcpy(pDst + x * 4, &rPng.palette[pSrc[x]], 4);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static bool decode_png(const memtype_t* pData, u64 size, DecodedImage& rImageOut, JobPool* pPool)
+{
+	PngImage png;
+	if (!parse_png(pData, size, png) || png.compressed.size() > 0x7FFFFFFF)
+	{
+		return false;
+	}
+
+	const u32 rowBytes = png.width * png.bpp;
+	const u64 stride = static_cast<u64>(rowBytes) + 1;
+	const u64 rawSize = stride * png.height;
+	if (rawSize > 0x7FFFFFFF)
+	{
+		return false;
+	}
+
+	// Deflate is one serial stream, the rest of the work can be split.
+	int inflatedSize = 0;
+	u8* pRaw = reinterpret_cast<u8*>(stbi_zlib_decode_malloc_guesssize_headerflag(
+		reinterpret_cast<const char*>(png.compressed.data()), static_cast<int>(png.compressed.size()),
+		static_cast<int>(rawSize), &inflatedSize, 1));
+	if (!pRaw)
+	{
+		return false;
+	}
+	if (static_cast<u64>(inflatedSize) < rawSize)
+	{
+		stbi_image_free(pRaw);
+		return false;
+	}
+
+	// Rows filtered with None or Sub don't read the row above, so each run
+	// of rows starting at one can be reconstructed independently.
+	std::vector<u32> segments;
+	for (u32 y = 0; y < png.height; ++y)
+	{
+		const u8 filter = pRaw[y * stride];
+		if (filter > kPngFilterPaeth)
+		{
+			stbi_image_free(pRaw);
+			return false;
+		}
+		if (y == 0 || filter == kPngFilterNone || filter == kPngFilterSub)
+		{
+			segments.push_back(y);
+		}
+	}
+	segments.push_back(png.height);
+
+	const std::vector<u8> zeroRow(rowBytes, 0);
+	auto unfilterSegments = [&](u32 begin, u32 end)
+	{
+		for (u32 s = begin; s < end; ++s)
+		{
+			for (u32 y = segments[s]; y < segments[s + 1]; ++y)
+			{
+				u8* pRow = pRaw + y * stride + 1;
+				const u8* pPrior = y > 0 ? pRow - stride : zeroRow.data();
+				unfilter_row(pRaw[y * stride], pRow, pPrior, rowBytes, png.bpp);
+			}
+		}
+	};
+
+	rImageOut.width = png.width;
+	rImageOut.height = png.height;
+	rImageOut.pixels.resize(static_cast<size_t>(png.width) * png.height * 4);
+	auto expandRows = [&](u32 begin, u32 end)
+	{
+		for (u32 y = begin; y < end; ++y)
+		{
+			expand_row(png, pRaw + y * stride + 1, &rImageOut.pixels[static_cast<size_t>(y) * png.width * 4]);
+		}
+	};
+
+	const u32 numSegments = static_cast<u32>(segments.size() - 1);
+	if (pPool)
+	{
+		const u32 rowsPerJob = rows_per_job(rowBytes);
+		const u32 segmentsPerJob = std::max(1u, numSegments * rowsPerJob / png.height);
+		pPool->parallelFor(numSegments, segmentsPerJob, unfilterSegments);
+		pPool->parallelFor(png.height, rowsPerJob, expandRows);
+	}
+	else
+	{
+		unfilterSegments(0, numSegments);
+		expandRows(0, png.height);
+	}
+
+	stbi_image_free(pRaw);
+	return true;
+}
+
+// ========================================================
+// Entry points.
+// ========================================================
+
+bool decode_image_rgba8(const memtype_t* pData, u64 size, DecodedImage& rImageOut, const char** pErrorOut, JobPool* pPool)
+{
+	rImageOut = DecodedImage();
+
+	if (!pData || size == 0 || size > 0x7FFFFFFF)
+	{
+		if (pErrorOut) *pErrorOut = "bad input size";
+		return false;
+	}
+
+	// Anything the local PNG path turns down, including corrupt files, gets a second go through stb_image.
+	if (is_png(pData, size) && decode_png(pData, size, rImageOut, pPool))
+	{
+		return true;
+	}
+	return decode_with_stb(pData, size, rImageOut, pErrorOut);
+}
+
+void decode_images_rgba8(ImageDecodeRequest* pRequests, u32 count, JobPool* pPool)
+{
+	auto decodeRange = [pRequests, pPool](u32 begin, u32 end)
+	{
+		for (u32 i = begin; i < end; ++i)
+		{
+			ImageDecodeRequest& rRequest = pRequests[i];
+			rRequest.pError = nullptr;
+			rRequest.success = decode_image_rgba8(rRequest.pData, rRequest.size, rRequest.image, &rRequest.pError, pPool);
+		}
+	};
+
+	if (pPool)
+	{
+		pPool->parallelFor(count, 1, decodeRange);
+	}
+	else
+	{
+		decodeRange(0, count);
+	}
+}
+
+bool decode_image_rgba8_reference(const memtype_t* pData, u64 size, DecodedImage& rImageOut, const char** pErrorOut)
+{
+	rImageOut = DecodedImage();
+
+	if (!pData || size == 0 || size > 0x7FFFFFFF)
+	{
+		if (pErrorOut) *pErrorOut = "bad input size";
+		return false;
+	}
+	return decode_with_stb(pData, size, rImageOut, pErrorOut);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CoreTypes.h"
+
+#include <vector>
+
+class JobPool;
+
+//================================================================================
+// Image file decoding (PNG, JPEG, TGA, BMP...) always to 8 bit RGBA.
+// Platform independent.
+//
+// 8 bit non interlaced PNGs go through a local path with SSE filter
+// reconstruction that splits rows across the job pool wherever the PNG
+// filters allow it. Everything else is decoded by stb_image.
+//================================================================================
+
+struct DecodedImage
+{
+	u32 width = 0;
+	u32 height = 0;
+	std::vector<memtype_t> pixels;	// width * height * 4, tightly packed.
+};
+
+// Returns false if the data can't be decoded, pErrorOut gets a short reason.
+// pPool may be null to decode on the calling thread.
+bool decode_image_rgba8(const memtype_t* pData, u64 size, DecodedImage& rImageOut, const char** pErrorOut = nullptr, JobPool* pPool = nullptr);
+
+// One entry of a batch decode.
+struct ImageDecodeRequest
+{
+	const memtype_t* pData = nullptr;
+	u64 size = 0;
+	DecodedImage image;
+	const char* pError = nullptr;
+	bool success = false;
+};
+
+// Decode several images at once, one job per image. Large PNGs also split their rows.
+void decode_images_rgba8(ImageDecodeRequest* pRequests, u32 count, JobPool* pPool);
+
+// Force every image through stb_image, for comparisons.
+bool decode_image_rgba8_reference(const memtype_t* pData, u64 size, DecodedImage& rImageOut, const char** pErrorOut = nullptr);
@@ -0,0 +1,73 @@
+#include "InstanceData.h"
+#include "JobQueue.h"
+
+#include <chrono>
+
+// Instances per job, enough to cover the cost of waking a worker.
+static const u32 kPackGrain = 16 * 1024;
+
+static void pack_instance_range(const InstanceGrid& grid, u32 begin, u32 end, InstanceTransform* pOut)
+{
+	const u32 perLayer = grid.countX * grid.countZ;
+	for (u32 instance = begin; instance < end; ++instance)
+	{
+		const u32 x = instance % grid.countX;
+		const u32 z = (instance / grid.countX) % grid.countZ;
+		const u32 y = instance / perLayer;
+
+		InstanceTransform& rOut = pOut[instance];
+		rOut.rows[0][0] = 1.f; rOut.rows[0][1] = 0.f; rOut.rows[0][2] = 0.f; rOut.rows[0][3] = grid.origin[0] + x * grid.spacing;
+		rOut.rows[1][0] = 0.f; rOut.rows[1][1] = 1.f; rOut.rows[1][2] = 0.f; rOut.rows[1][3] = grid.origin[1] + y * grid.spacing;
+		rOut.rows[2][0] = 0.f; rOut.rows[2][1] = 0.f; rOut.rows[2][2] = 1.f; rOut.rows[2][3] = grid.origin[2] + z * grid.spacing;
+	}
+}
+
+void pack_instance_grid(const InstanceGrid& grid, u32 count, InstanceTransform* pOut, JobPool* pPool)
+{
+	ASSERT(count <= grid.count());
+
+	if (pPool && count > kPackGrain)
+	{
+		pPool->parallelFor(count, kPackGrain, [&grid, pOut](u32 begin, u32 end)
+		{
+			pack_instance_range(grid, begin, end, pOut);
+		});
+	}
+	else
+	{
+		pack_instance_range(grid, 0, count, pOut);
+	}
+}
+
+void benchmark_instance_packing(const u32* pCounts, u32 numCounts, u32 numRuns, JobPool* pPool, std::vector<InstancePackTiming>& rTimingsOut)
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	rTimingsOut.clear();
+	for (u32 i = 0; i < numCounts; ++i)
+	{
+		const u32 count = pCounts[i];
+
+		// A square of layers, as many as the count needs.
+		InstanceGrid grid = { 100, (count + 9999) / 10000, 100, 1.5f, { 0.f, 0.f, 0.f } };
+		std::vector<InstanceTransform> output(count);
+
+		InstancePackTiming timing = { count, 0.0, 0.0 };
+		for (u32 run = 0; run < numRuns; ++run)
+		{
+			Clock::time_point start = Clock::now();
+			pack_instance_grid(grid, count, output.data());
+			const f64 serialMs = std::chrono::duration<f64, std::milli>(Clock::now() - start).count();
+			timing.serialMs = (run == 0) ? serialMs : std::min(timing.serialMs, serialMs);
+
+			if (pPool)
+			{
+				start = Clock::now();
+				pack_instance_grid(grid, count, output.data(), pPool);
+				const f64 pooledMs = std::chrono::duration<f64, std::milli>(Clock::now() - start).count();
+				timing.pooledMs = (run == 0) ? pooledMs : std::min(timing.pooledMs, pooledMs);
+			}
+		}
+		rTimingsOut.push_back(timing);
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "CoreTypes.h"
+
+#include <vector>
+
+class JobPool;
+
+//================================================================================
+// Per instance data for instanced draws.
+// Platform independent, packed on the CPU straight into a mapped structured
+// buffer, the vertex shader reads it with SV_InstanceID.
+//================================================================================
+
+// Model transform of one instance. Same layout as InstanceTransform in the
+// shaders: the first three columns of a row-vector matrix stored as rows, so
+// world.x = dot(float4(pos, 1), rows[0]) and so on. 48 bytes, a quarter
+// smaller than a full matrix.
+struct InstanceTransform
+{
+	f32 rows[3][4];
+};
+
+// Instances spaced evenly along x, y and z from an origin, x varying fastest.
+struct InstanceGrid
+{
+	u32 countX;
+	u32 countY;
+	u32 countZ;
+	f32 spacing;
+	f32 origin[3];
+
+	u32 count() const { return countX * countY * countZ; }
+};
+
+// Write the transforms of the first count instances of the grid. pPool may be null to run on the calling thread.
+void pack_instance_grid(const InstanceGrid& grid, u32 count, InstanceTransform* pOut, JobPool* pPool = nullptr);
+
+struct InstancePackTiming
+{
+	u32 count;
+	f64 serialMs;	// Best of the runs on the calling thread.
+	f64 pooledMs;	// Best of the runs across the pool, 0 without a pool.
+};
+
+// Time pack_instance_grid for each instance count.
+void benchmark_instance_packing(const u32* pCounts, u32 numCounts, u32 numRuns, JobPool* pPool, std::vector<InstancePackTiming>& rTimingsOut);
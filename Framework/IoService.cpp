@@ -0,0 +1,498 @@
+#include "IoService.h"
+#include "Framework.h"
+#include "AssetPack.h"
+
+// ========================================================
+// Internal per read state.
+// ========================================================
+
+struct IoService::Op
+{
+	OVERLAPPED overlapped;	// The completion port hands this back to us.
+	HANDLE hFile = INVALID_HANDLE_VALUE;
+	u64 bytesDone = 0;
+	s64 submitTimeUs = 0;
+	IoRequest request;
+	Completion onComplete;
+};
+
+// Completion key used to wake the completion thread for shutdown.
+static const ULONG_PTR kShutdownKey = 1;
+static const ULONG_PTR kReadKey = 2;
+
+// Largest single ReadFile, the DWORD length limits us to under 4GB per call.
+static const u64 kMaxReadChunk = 1u << 30;
+
+// How many completions to drain from the port in one call.
+static const u32 kCompletionBatch = 64;
+
+// Clamp the requested range to the file, false if it starts past the end.
+static bool resolve_range(IoRequest& rRequest, u64 fileSize)
+{
+	if (rRequest.offset > fileSize)
+	{
+		return false;
+	}
+	rRequest.size = std::min(rRequest.length, fileSize - rRequest.offset);
+	return rRequest.size + rRequest.zeroPadding <= SIZE_MAX;
+}
+
+IoService::IoService()
+{
+}
+
+IoService::~IoService()
+{
+	shutdown();
+}
+
+void IoService::init(JobPool* pCallbackPool, Backend backend, u32 kMaxInFlight)
+{
+	ASSERT(!m_initialised);
+
+	m_pCallbackPool = pCallbackPool;
+	m_backend = backend;
+	m_maxInFlight = kMaxInFlight ? kMaxInFlight : 1;
+
+	if (m_backend == kCompletionPort)
+	{
+		m_hPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+		if (m_hPort)
+		{
+			m_completionThread = std::thread(&IoService::completion_loop, this);
+		}
+		else
+		{
+			// Fall back to blocking reads if we can't get a port.
+			errorF("IoService : CreateIoCompletionPort failed, using thread pool.");
+			m_backend = kThreadPool;
+		}
+	}
+
+	if (m_backend == kThreadPool)
+	{
+		// Blocking reads only overlap as much as we have threads.
+		m_ioThreads.launch(std::min(m_maxInFlight, 8u));
+	}
+	else if (!m_pCallbackPool)
+	{
+		// Somewhere for pack reads that isn't the completion thread.
+		m_ioThreads.launch(1);
+	}
+
+	m_initialised = true;
+}
+
+void IoService::shutdown()
+{
+	if (!m_initialised)
+	{
+		return;
+	}
+
+	// Anything queued but never submitted is dropped.
+	for (Op* pOp : m_batch)
+	{
+		delete pOp;
+	}
+	m_batch.clear();
+
+	wait_all();
+
+	if (m_hPort)
+	{
+		PostQueuedCompletionStatus(m_hPort, 0, kShutdownKey, nullptr);
+		m_completionThread.join();
+		CloseHandle(m_hPort);
+		m_hPort = nullptr;
+	}
+
+	m_initialised = false;
+}
+
+void IoService::queue_read(const char* pFilename, Completion onComplete, const u32 kAlignment, const u32 kZeroPadding)
+{
+	queue_read_range(pFilename, 0, IoRequest::kToEnd, std::move(onComplete), kAlignment, kZeroPadding);
+}
+
+void IoService::queue_read_range(const char* pFilename, u64 offset, u64 length, Completion onComplete, const u32 kAlignment, const u32 kZeroPadding)
+{
+	ASSERT(m_initialised);
+
+	Op* pOp = new Op();
+	memset(&pOp->overlapped, 0, sizeof(pOp->overlapped));
+	pOp->request.filename = pFilename;
+	pOp->request.offset = offset;
+	pOp->request.length = length;
+	pOp->request.alignment = kAlignment ? kAlignment : 1;
+	pOp->request.zeroPadding = kZeroPadding;
+	pOp->onComplete = std::move(onComplete);
+
+	m_batch.push_back(pOp);
+}
+
+void IoService::submit()
+{
+	if (m_batch.empty())
+	{
+		return;
+	}
+
+	const s64 now = getTimeMicroseconds();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (Op* pOp : m_batch)
+		{
+			pOp->submitTimeUs = now;
+			m_pending.push_back(pOp);
+		}
+		m_outstanding += static_cast<u32>(m_batch.size());
+	}
+	m_batch.clear();
+
+	pump();
+}
+
+void IoService::wait_all()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this]() { return m_outstanding == 0; });
+}
+
+IoService::Stats IoService::stats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	Stats s = {};
+	s.queueDepth = static_cast<u32>(m_pending.size());
+	s.inFlight = m_inFlight;
+	s.peakInFlight = m_peakInFlight;
+	s.completed = m_completed;
+	s.failed = m_failed;
+	s.bytesRead = m_bytesRead;
+	s.avgLatencyMs = m_completed ? (m_totalLatencyUs / 1000.0) / m_completed : 0.0;
+	s.maxLatencyMs = m_maxLatencyUs / 1000.0;
+	return s;
+}
+
+void IoService::reset_stats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_peakInFlight = m_inFlight;
+	m_completed = 0;
+	m_failed = 0;
+	m_bytesRead = 0;
+	m_totalLatencyUs = 0;
+	m_maxLatencyUs = 0;
+}
+
+// Issue pending reads until we hit the in-flight limit. Reads that finish
+// as they're issued are retired here and their slot goes to the next turn
+// of the loop, rather than through complete(), which would pump again.
+void IoService::pump()
+{
+	for (;;)
+	{
+		Op* pOp = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_pending.empty() || m_inFlight >= m_maxInFlight)
+			{
+				return;
+			}
+			pOp = m_pending.front();
+			m_pending.pop_front();
+
+			++m_inFlight;
+			m_peakInFlight = std::max(m_peakInFlight, m_inFlight);
+		}
+
+		if (asset_in_packs(pOp->request.filename.c_str()))
+		{
+			// Pack entries are already mapped, the only work is copying or decompressing.
+			// Always a job, this may be the completion thread.
+			JobPool& rPool = m_pCallbackPool ? *m_pCallbackPool : m_ioThreads;
+			rPool.pushJob([this, pOp]() { read_from_pack(pOp); });
+		}
+		else if (m_backend == kCompletionPort)
+		{
+			bool bSuccess = false;
+			if (!start_overlapped(pOp, bSuccess))
+			{
+				retire(pOp, bSuccess);
+				finish(pOp);
+			}
+		}
+		else
+		{
+			m_ioThreads.pushJob([this, pOp]() { read_blocking(pOp); });
+		}
+	}
+}
+
+// True once a read is in flight. False if the op finished here, rbSuccessOut
+// says how, and the caller retires it.
+bool IoService::start_overlapped(Op* pOp, bool& rbSuccessOut)
+{
+	IoRequest& rRequest = pOp->request;
+	rbSuccessOut = false;
+
+	pOp->hFile = CreateFileA(rRequest.filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (pOp->hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(pOp->hFile, &fileSize)
+		|| !resolve_range(rRequest, static_cast<u64>(fileSize.QuadPart)))
+	{
+		return false;
+	}
+
+	rRequest.pData = (memtype_t*)_aligned_malloc(static_cast<size_t>(rRequest.size + rRequest.zeroPadding), rRequest.alignment);
+	if (!rRequest.pData)
+	{
+		return false;
+	}
+
+	if (rRequest.size == 0)
+	{
+		rbSuccessOut = true;
+		return false;
+	}
+
+	if (!CreateIoCompletionPort(pOp->hFile, m_hPort, kReadKey, 0))
+	{
+		return false;
+	}
+
+	return issue_overlapped_chunk(pOp);
+}
+
+// False if the read failed to issue, the caller completes the op.
+bool IoService::issue_overlapped_chunk(Op* pOp)
+{
+	const u64 done = pOp->bytesDone;
+	const u64 offset = pOp->request.offset + done;
+	const DWORD chunk = static_cast<DWORD>(std::min(pOp->request.size - done, kMaxReadChunk));
+
+	memset(&pOp->overlapped, 0, sizeof(pOp->overlapped));
+	pOp->overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+	pOp->overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+	// Success or pending both post a packet to the port.
+	return ReadFile(pOp->hFile, pOp->request.pData + done, chunk, nullptr, &pOp->overlapped)
+		|| GetLastError() == ERROR_IO_PENDING;
+}
+
+void IoService::read_blocking(Op* pOp)
+{
+	IoRequest& rRequest = pOp->request;
+
+	pOp->hFile = CreateFileA(rRequest.filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	LARGE_INTEGER fileSize;
+	if (pOp->hFile == INVALID_HANDLE_VALUE
+		|| !GetFileSizeEx(pOp->hFile, &fileSize)
+		|| !resolve_range(rRequest, static_cast<u64>(fileSize.QuadPart)))
+	{
+		complete(pOp, false);
+		return;
+	}
+
+	LARGE_INTEGER start;
+	start.QuadPart = static_cast<LONGLONG>(rRequest.offset);
+	if (rRequest.offset > 0 && !SetFilePointerEx(pOp->hFile, start, nullptr, FILE_BEGIN))
+	{
+		complete(pOp, false);
+		return;
+	}
+
+	rRequest.pData = (memtype_t*)_aligned_malloc(static_cast<size_t>(rRequest.size + rRequest.zeroPadding), rRequest.alignment);
+	if (!rRequest.pData)
+	{
+		complete(pOp, false);
+		return;
+	}
+
+	while (pOp->bytesDone < rRequest.size)
+	{
+		const DWORD chunk = static_cast<DWORD>(std::min(rRequest.size - pOp->bytesDone, kMaxReadChunk));
+		DWORD bytesRead = 0;
+		if (!ReadFile(pOp->hFile, rRequest.pData + pOp->bytesDone, chunk, &bytesRead, nullptr) || bytesRead == 0)
+		{
+			complete(pOp, false);
+			return;
+		}
+		pOp->bytesDone += bytesRead;
+	}
+
+	complete(pOp, true);
+}
+
+void IoService::read_from_pack(Op* pOp)
+{
+	IoRequest& rRequest = pOp->request;
+
+	FileView view;
+	if (!open_asset(rRequest.filename.c_str(), view, rRequest.alignment, rRequest.zeroPadding))
+	{
+		complete(pOp, false);
+		return;
+	}
+
+	if (!resolve_range(rRequest, view.size))
+	{
+		close_asset(view);
+		complete(pOp, false);
+		return;
+	}
+
+	const bool bWholeFile = rRequest.offset == 0 && rRequest.size == view.size;
+	if (view.pCopy && bWholeFile)
+	{
+		// Decompressed entries are already an aligned, padded allocation we can hand over.
+		rRequest.pData = view.pCopy;
+		view.pCopy = nullptr;
+		view.pData = nullptr;
+	}
+	else
+	{
+		// Borrowed from the pack mapping (or only part of a decompressed entry), the request owns its data so copy it out.
+		rRequest.pData = (memtype_t*)_aligned_malloc(static_cast<size_t>(rRequest.size + rRequest.zeroPadding), rRequest.alignment);
+		if (rRequest.pData)
+		{
+			memcpy(rRequest.pData, view.pData + rRequest.offset, static_cast<size_t>(rRequest.size));
+		}
+		close_asset(view);
+	}
+
+	complete(pOp, rRequest.pData != nullptr);
+}
+
+void IoService::completion_loop()
+{
+	OVERLAPPED_ENTRY entries[kCompletionBatch];
+
+	for (;;)
+	{
+		ULONG numEntries = 0;
+		if (!GetQueuedCompletionStatusEx(m_hPort, entries, kCompletionBatch, &numEntries, INFINITE, FALSE))
+		{
+			continue;
+		}
+
+		for (ULONG i = 0; i < numEntries; ++i)
+		{
+			if (entries[i].lpCompletionKey == kShutdownKey)
+			{
+				return;
+			}
+
+			Op* pOp = CONTAINING_RECORD(entries[i].lpOverlapped, Op, overlapped);
+
+			DWORD bytesTransferred = 0;
+			if (!GetOverlappedResult(pOp->hFile, &pOp->overlapped, &bytesTransferred, FALSE) || bytesTransferred == 0)
+			{
+				complete(pOp, false);
+				continue;
+			}
+
+			pOp->bytesDone += bytesTransferred;
+			if (pOp->bytesDone < pOp->request.size)
+			{
+				if (!issue_overlapped_chunk(pOp))
+				{
+					complete(pOp, false);
+				}
+			}
+			else
+			{
+				complete(pOp, true);
+			}
+		}
+	}
+}
+
+// Called once per op from whichever thread finished it, except in pump().
+void IoService::complete(Op* pOp, bool bSuccess)
+{
+	retire(pOp, bSuccess);
+
+	// A slot has freed up. Before the callback is sent, once it has run the
+	// service may be waited on and destroyed.
+	pump();
+
+	finish(pOp);
+}
+
+// Closes the file, counts the op and frees its in-flight slot.
+void IoService::retire(Op* pOp, bool bSuccess)
+{
+	IoRequest& rRequest = pOp->request;
+
+	if (pOp->hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(pOp->hFile);
+		pOp->hFile = INVALID_HANDLE_VALUE;
+	}
+
+	if (bSuccess && rRequest.zeroPadding > 0)
+	{
+		memset(rRequest.pData + rRequest.size, 0, rRequest.zeroPadding);
+	}
+	if (!bSuccess)
+	{
+		release_loaded_file(rRequest.pData);
+		rRequest.pData = nullptr;
+		rRequest.size = 0;
+	}
+	rRequest.success = bSuccess;
+
+	const s64 latencyUs = getTimeMicroseconds() - pOp->submitTimeUs;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		--m_inFlight;
+		if (bSuccess)
+		{
+			++m_completed;
+			m_bytesRead += rRequest.size;
+			m_totalLatencyUs += latencyUs;
+			m_maxLatencyUs = std::max(m_maxLatencyUs, latencyUs);
+		}
+		else
+		{
+			++m_failed;
+		}
+	}
+}
+
+// Runs the callback, on the callback pool if there is one.
+void IoService::finish(Op* pOp)
+{
+	auto run = [this, pOp]()
+	{
+		if (pOp->onComplete)
+		{
+			pOp->onComplete(pOp->request);
+		}
+		release_loaded_file(pOp->request.pData);
+		delete pOp;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		--m_outstanding;
+		m_idle.notify_all();
+	};
+
+	if (m_pCallbackPool)
+	{
+		m_pCallbackPool->pushJob(run);
+	}
+	else
+	{
+		run();
+	}
+}
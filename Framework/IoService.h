@@ -0,0 +1,138 @@
+#pragma once
+
+#include "CommonHeader.h"
+#include "JobQueue.h"
+
+#include <string>
+#include <deque>
+#include <atomic>
+
+// ========================================================
+// IoRequest
+// A single read of a whole file or a byte range of one.
+// ========================================================
+struct IoRequest
+{
+	static const u64 kToEnd = ~0ull;
+
+	std::string filename;
+	u64 offset = 0;			// Where the range starts.
+	u64 length = kToEnd;	// Bytes wanted, clamped to the end of the file.
+
+	// Result : data is aligned and followed by zeroPadding zero bytes.
+	// The service frees pData after the callback unless the callback
+	// takes ownership by setting it to null (free with release_loaded_file).
+	memtype_t* pData = nullptr;
+	u64 size = 0;
+	bool success = false;
+
+	u32 alignment = 16;
+	u32 zeroPadding = 0;
+};
+
+// ========================================================
+// IoService
+// Asynchronous file reads with batched submission.
+// Reads are queued then issued together by submit(), the
+// completion callback runs on the job pool once the data is in memory.
+//
+// Backends:
+//   kCompletionPort : overlapped reads on an I/O completion port, drained
+//                     in batches by a single completion thread.
+//   kThreadPool     : blocking reads on a small pool of I/O threads.
+// Files found in a mounted asset pack skip the backend and are
+// copied or decompressed from the pack mapping on the job pool,
+// or on an I/O thread without one, never on the completion thread.
+//
+// Reads that finish as they're issued (a missing or empty file)
+// complete in the issuing loop, which then moves on to the next,
+// so a batch of them doesn't nest one call per read.
+// ========================================================
+class IoService
+{
+public:
+	enum Backend
+	{
+		kCompletionPort,
+		kThreadPool
+	};
+
+	using Completion = std::function<void(IoRequest& rRequest)>;
+
+	struct Stats
+	{
+		u32 queueDepth;		// Waiting to be issued.
+		u32 inFlight;		// Issued and not yet complete.
+		u32 peakInFlight;
+		u64 completed;
+		u64 failed;
+		u64 bytesRead;
+		f64 avgLatencyMs;	// Submit to data available.
+		f64 maxLatencyMs;
+	};
+
+	IoService();
+	~IoService();
+
+	// pCallbackPool may be null, callbacks then run on the thread that finished the read.
+	void init(JobPool* pCallbackPool, Backend backend = kCompletionPort, u32 kMaxInFlight = 64);
+	void shutdown();
+
+	// Add a read to the pending batch, nothing is issued until submit().
+	void queue_read(const char* pFilename, Completion onComplete, const u32 kAlignment = 16, const u32 kZeroPadding = 0);
+
+	// As queue_read but only [offset, offset + length) of the file, e.g. one mip of a texture.
+	// Reads that start past the end of the file fail.
+	void queue_read_range(const char* pFilename, u64 offset, u64 length, Completion onComplete, const u32 kAlignment = 16, const u32 kZeroPadding = 0);
+
+	// Issue every queued read.
+	void submit();
+
+	// Block until all submitted reads and their callbacks have finished.
+	void wait_all();
+
+	Stats stats() const;
+	void reset_stats();
+
+	Backend backend() const { return m_backend; }
+
+private:
+	struct Op;
+
+	void pump();
+	bool start_overlapped(Op* pOp, bool& rbSuccessOut);
+	bool issue_overlapped_chunk(Op* pOp);
+	void read_blocking(Op* pOp);
+	void read_from_pack(Op* pOp);
+	void complete(Op* pOp, bool bSuccess);
+	void retire(Op* pOp, bool bSuccess);
+	void finish(Op* pOp);
+	void completion_loop();
+
+	Backend m_backend = kCompletionPort;
+	JobPool* m_pCallbackPool = nullptr;
+	u32 m_maxInFlight = 64;
+	bool m_initialised = false;
+
+	// Completion port backend.
+	HANDLE m_hPort = nullptr;
+	std::thread m_completionThread;
+
+	// Thread pool backend, and pack reads without a callback pool.
+	JobPool m_ioThreads;
+
+	std::vector<Op*> m_batch;		// Queued, not submitted (caller thread only).
+	std::deque<Op*> m_pending;		// Submitted, waiting for an in-flight slot.
+	u32 m_inFlight = 0;
+	u32 m_outstanding = 0;			// Submitted and callback not yet finished.
+	mutable std::mutex m_mutex;
+	std::condition_variable m_idle;
+
+	// Counters.
+	u32 m_peakInFlight = 0;
+	u64 m_completed = 0;
+	u64 m_failed = 0;
+	u64 m_bytesRead = 0;
+	s64 m_totalLatencyUs = 0;
+	s64 m_maxLatencyUs = 0;
+};
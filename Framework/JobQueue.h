@@ -1,10 +1,17 @@
 #pragma once
 
+#include "CoreTypes.h"
+#include "Profiler.h"
+
 #include <functional>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <queue>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstdio>
 
 // ========================================================
 // class JobQueue
@@ -85,3 +92,165 @@ private:
 	std::condition_variable condition;
 };
 
+
+// ========================================================
+// class JobPool
+// A shared queue serviced by several worker threads.
+// ========================================================
+
+class JobPool final
+{
+public:
+	typedef std::function<void()> Job;
+	typedef std::function<void(u32 begin, u32 end)> RangeJob;
+
+	// Wait for the worker threads to exit.
+	~JobPool()
+	{
+		if (!workers.empty())
+		{
+			waitAll();
+			mutex.lock();
+			terminating = true;
+			condition.notify_all();
+			mutex.unlock();
+			for (std::thread& worker : workers)
+			{
+				worker.join();
+			}
+		}
+	}
+
+	// Launch the worker threads, zero picks one per hardware thread leaving one for the caller.
+	void launch(u32 numWorkers = 0)
+	{
+		ASSERT(workers.empty()); // Not already launched!
+		if (numWorkers == 0)
+		{
+			const u32 hwThreads = std::thread::hardware_concurrency();
+			numWorkers = hwThreads > 1 ? hwThreads - 1 : 1;
+		}
+		for (u32 i = 0; i < numWorkers; ++i)
+		{
+			workers.emplace_back(&JobPool::queueLoop, this, i);
+		}
+	}
+
+	u32 numWorkers() const { return static_cast<u32>(workers.size()); }
+
+	// Add a new job to the shared queue.
+	void pushJob(Job job)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push(std::move(job));
+		condition.notify_one();
+	}
+
+	// Wait until all work items have been completed.
+	void waitAll()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [this]() { return queue.empty() && active == 0; });
+	}
+
+	// Split [0, count) into ranges of 'grain' items and run them across the workers.
+	// The calling thread helps out and returns once every range has finished,
+	// so this is safe to call from inside another job.
+	void parallelFor(u32 count, u32 grain, const RangeJob& job)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+		grain = grain ? grain : 1;
+
+		PROFILE_SCOPE("parallelFor");
+
+		struct Batch
+		{
+			std::atomic<u32> next{ 0 };
+			std::atomic<u32> remaining{ 0 };
+			std::mutex mutex;
+			std::condition_variable done;
+		};
+
+		const u32 numRanges = (count + grain - 1) / grain;
+		auto pBatch = std::make_shared<Batch>();
+		pBatch->remaining = numRanges;
+
+		auto runRanges = [pBatch, count, grain, numRanges, &job]()
+		{
+			for (;;)
+			{
+				const u32 range = pBatch->next.fetch_add(1);
+				if (range >= numRanges)
+				{
+					break;
+				}
+				const u32 begin = range * grain;
+				job(begin, std::min(begin + grain, count));
+
+				if (pBatch->remaining.fetch_sub(1) == 1)
+				{
+					std::lock_guard<std::mutex> lock(pBatch->mutex);
+					pBatch->done.notify_all();
+				}
+			}
+		};
+
+		// Helpers are only worth waking if there is more than one range.
+		const u32 numHelpers = std::min(numRanges - 1, numWorkers());
+		for (u32 i = 0; i < numHelpers; ++i)
+		{
+			pushJob(runRanges);
+		}
+
+		runRanges();
+
+		std::unique_lock<std::mutex> lock(pBatch->mutex);
+		pBatch->done.wait(lock, [&pBatch]() { return pBatch->remaining == 0; });
+	}
+
+private:
+	void queueLoop(u32 index)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "Worker %u", index);
+		profiler_set_thread_name(name);
+
+		for (;;)
+		{
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this] { return !queue.empty() || terminating; });
+				if (terminating)
+				{
+					break;
+				}
+				job = std::move(queue.front());
+				queue.pop();
+				++active;
+			}
+
+			{
+				PROFILE_SCOPE("Job");
+				job();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				--active;
+				condition.notify_all();
+			}
+		}
+	}
+
+	bool terminating = false;
+	u32 active = 0;
+
+	std::vector<std::thread> workers;
+	std::queue<Job> queue;
+	std::mutex mutex;
+	std::condition_variable condition;
+};
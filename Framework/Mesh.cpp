@@ -1,9 +1,29 @@
 
 #include "Mesh.h"
+#include "Framework.h"
+#include "AssetPack.h"
+#include "StateCache.h"
+#include "BindingTable.h"
+#include "CommandBuffer.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tinyobjloader/tiny_obj_loader.h"
 
+#include <streambuf>
+#include <istream>
+
+// Read only stream buffer over a block of memory.
+// Lets tinyobj parse directly from a mapped file or I/O buffer without an extra copy.
+class MemoryStreamBuf : public std::streambuf
+{
+public:
+	MemoryStreamBuf(const memtype_t* pData, u64 size)
+	{
+		char* pBegin = const_cast<char*>(reinterpret_cast<const char*>(pData));
+		setg(pBegin, pBegin, pBegin + size);
+	}
+};
+
 Mesh::Mesh()
 	: m_pVertexBuffer(nullptr)
 	, m_pIndexBuffer(nullptr)
@@ -71,6 +91,21 @@ void Mesh::bind(ID3D11DeviceContext* pContext) const
 	}
 }
 
+void Mesh::bind(StateCache& rCache) const
+{
+	rCache.set_topology(kTopologyTriangleList);
+
+	ID3D11Buffer* buffers[] = { m_pVertexBuffer };
+	u32 strides[] = { sizeof(MeshVertex) };
+	u32 offsets[] = { 0 };
+	rCache.set_vertex_buffers(0, 1, buffers, strides, offsets);
+
+	if (m_pIndexBuffer)
+	{
+		rCache.set_index_buffer(m_pIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
+	}
+}
+
 void Mesh::draw(ID3D11DeviceContext* pContext) const
 {
 	if (m_pIndexBuffer)
@@ -83,6 +118,33 @@ void Mesh::draw(ID3D11DeviceContext* pContext) const
 	}
 }
 
+void Mesh::draw(CommandBuffer& rCommands) const
+{
+	if (m_pIndexBuffer)
+	{
+		rCommands.draw_indexed(m_indices, 0, 0);
+	}
+	else
+	{
+		rCommands.draw(m_vertices, 0);
+	}
+}
+
+void Mesh::draw_instanced(CommandBuffer& rCommands, BindingTable& rBindings, u32 slot, ID3D11ShaderResourceView* pInstances, u32 numInstances) const
+{
+	rBindings.set_shader_resource(ShaderStage::kVertex, slot, pInstances);
+	rBindings.flush();
+
+	if (m_pIndexBuffer)
+	{
+		rCommands.draw_indexed_instanced(m_indices, numInstances, 0, 0, 0);
+	}
+	else
+	{
+		rCommands.draw_instanced(m_vertices, numInstances, 0, 0);
+	}
+}
+
 // Computes tangents using Lengyel's method for an indexed triangle list.
 // Tangents are computed as a 4d vector where w stores the sign need to reconstruct a bitangent in the shader.
 void compute_tangents_lengyel(MeshVertex* pVertices, u32 kVertices, const u16* pIndices, u32 kIndices)
@@ -296,27 +358,58 @@ void create_mesh_quad_xy(ID3D11Device* pDevice, Mesh& rMeshOut, const f32 kHalfS
 }
 
 void create_mesh_from_obj(ID3D11Device* pDevice, Mesh& rMeshOut, const char* pFilename, const f32 kScale)
+{
+	FileView view;
+	if (!open_asset(pFilename, view, 1, 0))
+	{
+		panicF("Error Loading OBJ %s", pFilename);
+	}
+
+	create_mesh_from_obj_data(pDevice, rMeshOut, view.pData, view.size, pFilename, kScale);
+	close_asset(view);
+}
+
+void create_mesh_from_obj_data(ID3D11Device* pDevice, Mesh& rMeshOut, const memtype_t* pData, u64 size, const char* pDebugName, const f32 kScale)
+{
+	std::vector<MeshData> shapes;
+	if (!load_obj_mesh_data(pData, size, pDebugName, kScale, shapes))
+	{
+		panicF("Error Loading OBJ %s", pDebugName);
+	}
+
+	for (const MeshData& rShape : shapes)
+	{
+		rMeshOut.init_buffers(pDevice, &rShape.vertices[0], rShape.vertices.size(), &rShape.indices[0], rShape.indices.size());
+	}
+}
+
+bool load_obj_mesh_data(const memtype_t* pData, u64 size, const char* pDebugName, const f32 kScale, std::vector<MeshData>& rShapesOut)
 {
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
 	std::vector<tinyobj::material_t> materials;
 
-	std::vector<MeshVertex> meshVertices;
+	MemoryStreamBuf streamBuf(pData, size);
+	std::istream objStream(&streamBuf);
+	tinyobj::MaterialFileReader matFileReader("");
 
 	std::string err;
-	bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, pFilename);
+	bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, &objStream, &matFileReader);
 
 	if (!err.empty()) { // `err` may contain warning message.
-		debugF("load_obj_mesh( %s ) : %s", pFilename, err.c_str());
+		debugF("load_obj_mesh( %s ) : %s", pDebugName, err.c_str());
 	}
 
 	if (!ret) {
-		panicF("Error Loading OBJ %s", pFilename);
+		return false;
 	}
 
+	rShapesOut.resize(shapes.size());
+
 	// Loop over shapes
 	for (size_t s = 0; s < shapes.size(); s++) {
 
+		std::vector<MeshVertex>& meshVertices = rShapesOut[s].vertices;
 		meshVertices.clear();
 
 		// Loop over faces(polygon)
@@ -366,7 +459,8 @@ void create_mesh_from_obj(ID3D11Device* pDevice, Mesh& rMeshOut, const char* pFi
 		}
 
 		// Make a sequential index buffer so we can use the tangent calculation function
-		std::vector<u16> m_indices(meshVertices.size());
+		std::vector<u16>& m_indices = rShapesOut[s].indices;
+		m_indices.resize(meshVertices.size());
 		for (u32 i = 0; i < meshVertices.size(); ++i)
 		{
 			m_indices[i] = i;
@@ -374,7 +468,6 @@ void create_mesh_from_obj(ID3D11Device* pDevice, Mesh& rMeshOut, const char* pFi
 
 		// compute the tangents,
 		compute_tangents_lengyel(&meshVertices[0], meshVertices.size(), &m_indices[0], m_indices.size());
-
-		rMeshOut.init_buffers(pDevice, &meshVertices[0], meshVertices.size(), &m_indices[0], m_indices.size());
 	}
+	return true;
 }
@@ -3,6 +3,12 @@
 #include "CommonHeader.h"
 #include "VertexFormats.h"
 
+#include <vector>
+
+class StateCache;
+class BindingTable;
+class CommandBuffer;
+
 
 using MeshVertex = Vertex_Pos3fColour4ubNormal3fTangent3fTex2f; // vertex type
 
@@ -19,7 +25,14 @@ public:
 
 	void init_buffers(ID3D11Device* pDevice, const MeshVertex* pVertices, const u32 kNumVerts, const u16* pIndices, const u32 kNumIndices);
 	void bind(ID3D11DeviceContext* pContext) const;
+	void bind(StateCache& rCache) const;	// Skips buffers that are already bound.
 	void draw(ID3D11DeviceContext* pContext) const;
+	void draw(CommandBuffer& rCommands) const;
+
+	// One draw of numInstances copies. pInstances is a structured buffer of
+	// per instance data bound to the vertex shader's slot, indexed there by
+	// SV_InstanceID, which starts at 0 for every draw.
+	void draw_instanced(CommandBuffer& rCommands, BindingTable& rBindings, u32 slot, ID3D11ShaderResourceView* pInstances, u32 numInstances) const;
 
 	// Accessors.
 	const ID3D11Buffer* vertex_buffer() const { return m_pVertexBuffer; }
@@ -45,4 +58,22 @@ void create_mesh_quad_xy(ID3D11Device* pDevice, Mesh& rMeshOut, const f32 kHalfS
 
 void create_mesh_from_obj(ID3D11Device* pDevice, Mesh& rMeshOut, const char* pFilename, const f32 kScale);
 
+// As above but parses OBJ text that is already in memory.
+void create_mesh_from_obj_data(ID3D11Device* pDevice, Mesh& rMeshOut, const memtype_t* pData, u64 size, const char* pDebugName, const f32 kScale);
+
+// Vertices and indices of one shape, ready for init_buffers.
+struct MeshData
+{
+	std::vector<MeshVertex> vertices;
+	std::vector<u16> indices;
+};
+
+// The CPU side of create_mesh_from_obj_data, one MeshData per shape in the
+// file with tangents computed. Returns false if the OBJ can't be parsed.
+bool load_obj_mesh_data(const memtype_t* pData, u64 size, const char* pDebugName, const f32 kScale, std::vector<MeshData>& rShapesOut);
+
+// Tangents for an indexed triangle list from its positions, normals and
+// texture coordinates, w is the sign of the bitangent.
+void compute_tangents_lengyel(MeshVertex* pVertices, u32 kVertices, const u16* pIndices, u32 kIndices);
+
 
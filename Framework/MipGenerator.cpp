@@ -0,0 +1,493 @@
+#include "MipGenerator.h"
+#include "JobQueue.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+	#define MIPS_USE_SSE 1
+	#include <emmintrin.h>
+#else
+	#define MIPS_USE_SSE 0
+#endif
+
+// ========================================================
+// Four channel float maths.
+// One RGBA pixel fits exactly in an SSE register so every filter
+// below works a whole pixel at a time.
+// ========================================================
+
+#if MIPS_USE_SSE
+
+struct Vec4
+{
+	__m128 v;
+};
+
+static inline Vec4 vec4_zero() { return { _mm_setzero_ps() }; }
+static inline Vec4 vec4_load(const f32* p) { return { _mm_loadu_ps(p) }; }
+static inline void vec4_store(f32* p, Vec4 a) { _mm_storeu_ps(p, a.v); }
+static inline Vec4 vec4_add(Vec4 a, Vec4 b) { return { _mm_add_ps(a.v, b.v) }; }
+static inline Vec4 vec4_scale(Vec4 a, f32 s) { return { _mm_mul_ps(a.v, _mm_set1_ps(s)) }; }
+static inline Vec4 vec4_madd(Vec4 acc, Vec4 a, f32 w) { return { _mm_add_ps(acc.v, _mm_mul_ps(a.v, _mm_set1_ps(w))) }; }
+
+// Clamp to [0,1] and scale to integer indices.
+static inline void vec4_to_indices(Vec4 a, f32 scaleRgb, f32 scaleA, s32* pOut)
+{
+	const __m128 clamped = _mm_min_ps(_mm_max_ps(a.v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	const __m128 scaled = _mm_add_ps(_mm_mul_ps(clamped, _mm_set_ps(scaleA, scaleRgb, scaleRgb, scaleRgb)), _mm_set1_ps(0.5f));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut), _mm_cvttps_epi32(scaled));
+}
+
+#else
+
+struct Vec4
+{
+	f32 v[4];
+};
+
+static inline Vec4 vec4_zero() { return { { 0.0f, 0.0f, 0.0f, 0.0f } }; }
+static inline Vec4 vec4_load(const f32* p) { return { { p[0], p[1], p[2], p[3] } }; }
+static inline void vec4_store(f32* p, Vec4 a) { p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; p[3] = a.v[3]; }
+static inline Vec4 vec4_add(Vec4 a, Vec4 b) { return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; }
+static inline Vec4 vec4_scale(Vec4 a, f32 s) { return { { a.v[0] * s, a.v[1] * s, a.v[2] * s, a.v[3] * s } }; }
+static inline Vec4 vec4_madd(Vec4 acc, Vec4 a, f32 w) { return vec4_add(acc, vec4_scale(a, w)); }
+
+static inline void vec4_to_indices(Vec4 a, f32 scaleRgb, f32 scaleA, s32* pOut)
+{
+	for (u32 c = 0; c < 4; ++c)
+	{
+		const f32 clamped = std::min(std::max(a.v[c], 0.0f), 1.0f);
+		pOut[c] = static_cast<s32>(clamped * (c == 3 ? scaleA : scaleRgb) + 0.5f);
+	}
+}
+
+#endif
+
+// ========================================================
+// Colour space conversion tables.
+// ========================================================
+
+// Linear values are quantised to this many steps before encoding to sRGB,
+// fine enough to be within a fraction of an 8 bit step even at the steep end of the curve.
+static const u32 kSrgbEncodeSteps = 16384;
+
+struct ColourTables
+{
+	f32 toLinear[2][256];				// [bSrgb][byte]
+	u8 fromLinearSrgb[kSrgbEncodeSteps];
+
+	ColourTables()
+	{
+		for (u32 i = 0; i < 256; ++i)
+		{
+			const f32 c = i / 255.0f;
+			toLinear[0][i] = c;
+			toLinear[1][i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (u32 i = 0; i < kSrgbEncodeSteps; ++i)
+		{
+			const f32 l = i / static_cast<f32>(kSrgbEncodeSteps - 1);
+			const f32 c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+			fromLinearSrgb[i] = static_cast<u8>(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+	}
+};
+
+static const ColourTables& colour_tables()
+{
+	static const ColourTables s_tables;
+	return s_tables;
+}
+
+// Expand a row of RGBA8 pixels to linear floats.
+static void decode_row(const memtype_t* pSrc, u32 width, bool bSrgb, f32* pOut)
+{
+	const f32* pRgb = colour_tables().toLinear[bSrgb ? 1 : 0];
+	const f32* pAlpha = colour_tables().toLinear[0];
+	for (u32 i = 0; i < width * 4; i += 4)
+	{
+		pOut[i + 0] = pRgb[pSrc[i + 0]];
+		pOut[i + 1] = pRgb[pSrc[i + 1]];
+		pOut[i + 2] = pRgb[pSrc[i + 2]];
+		pOut[i + 3] = pAlpha[pSrc[i + 3]];
+	}
+}
+
+static inline void encode_pixel(Vec4 pixel, bool bSrgb, memtype_t* pOut)
+{
+	s32 idx[4];
+	if (bSrgb)
+	{
+		const u8* pTable = colour_tables().fromLinearSrgb;
+		vec4_to_indices(pixel, static_cast<f32>(kSrgbEncodeSteps - 1), 255.0f, idx);
+		pOut[0] = pTable[idx[0]];
+		pOut[1] = pTable[idx[1]];
+		pOut[2] = pTable[idx[2]];
+		pOut[3] = static_cast<u8>(idx[3]);
+	}
+	else
+	{
+		vec4_to_indices(pixel, 255.0f, 255.0f, idx);
+		pOut[0] = static_cast<u8>(idx[0]);
+		pOut[1] = static_cast<u8>(idx[1]);
+		pOut[2] = static_cast<u8>(idx[2]);
+		pOut[3] = static_cast<u8>(idx[3]);
+	}
+}
+
+// ========================================================
+// Level description.
+// ========================================================
+
+struct MipLevel
+{
+	memtype_t* pData;
+	u32 width;
+	u32 height;
+	u32 rowPitch;
+};
+
+// Per thread scratch rows, reused between ranges and levels.
+static std::vector<f32>& scratch_buffer(u32 index)
+{
+	thread_local std::vector<f32> s_scratch[3];
+	return s_scratch[index];
+}
+
+// Pick a range size that keeps each job at a useful amount of work.
+static u32 rows_per_job(u32 width)
+{
+	return std::max(4u, 64 * 1024 / std::max(width, 1u));
+}
+
+// ========================================================
+// Box filter.
+// ========================================================
+
+#if MIPS_USE_SSE
+// Linear data can stay in integers, two output pixels per iteration.
+static u32 box_row_linear_sse(const memtype_t* pRow0, const memtype_t* pRow1, u32 dstWidth, memtype_t* pDst)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi16(2);
+
+	u32 x = 0;
+	for (; x + 2 <= dstWidth; x += 2)
+	{
+		const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow0 + x * 8));
+		const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow1 + x * 8));
+
+		// Sum vertically, lo holds source pixels 0,1 and hi holds 2,3.
+		const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(r0, zero), _mm_unpacklo_epi8(r1, zero));
+		const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(r0, zero), _mm_unpackhi_epi8(r1, zero));
+
+		// Then horizontally.
+		const __m128i sumLo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+		const __m128i sumHi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+		const __m128i sum = _mm_unpacklo_epi64(sumLo, sumHi);
+
+		const __m128i avg = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(pDst + x * 4), _mm_packus_epi16(avg, zero));
+	}
+	return x;
+}
+#endif
+
+static void box_rows(const MipLevel& rSrc, const MipLevel& rDst, bool bSrgb, u32 begin, u32 end)
+{
+	std::vector<f32>& rRow0 = scratch_buffer(0);
+	std::vector<f32>& rRow1 = scratch_buffer(1);
+
+	for (u32 y = begin; y < end; ++y)
+	{
+		const memtype_t* pSrc0 = rSrc.pData + static_cast<u64>(std::min(y * 2, rSrc.height - 1)) * rSrc.rowPitch;
+		const memtype_t* pSrc1 = rSrc.pData + static_cast<u64>(std::min(y * 2 + 1, rSrc.height - 1)) * rSrc.rowPitch;
+		memtype_t* pDst = rDst.pData + static_cast<u64>(y) * rDst.rowPitch;
+
+		u32 x = 0;
+#if MIPS_USE_SSE
+		if (!bSrgb && rSrc.width == rDst.width * 2)
+		{
+			x = box_row_linear_sse(pSrc0, pSrc1, rDst.width, pDst);
+		}
+#endif
+		if (x == rDst.width)
+		{
+			continue;
+		}
+
+		rRow0.resize(rSrc.width * 4);
+		rRow1.resize(rSrc.width * 4);
+		decode_row(pSrc0, rSrc.width, bSrgb, rRow0.data());
+		decode_row(pSrc1, rSrc.width, bSrgb, rRow1.data());
+
+		// Odd sizes clamp the second sample so the last row or column is dropped.
+		for (; x < rDst.width; ++x)
+		{
+			const u32 x0 = x * 2;
+			const u32 x1 = std::min(x0 + 1, rSrc.width - 1);
+
+			Vec4 sum = vec4_load(&rRow0[x0 * 4]);
+			sum = vec4_add(sum, vec4_load(&rRow0[x1 * 4]));
+			sum = vec4_add(sum, vec4_load(&rRow1[x0 * 4]));
+			sum = vec4_add(sum, vec4_load(&rRow1[x1 * 4]));
+			encode_pixel(vec4_scale(sum, 0.25f), bSrgb, pDst + x * 4);
+		}
+	}
+}
+
+// ========================================================
+// Kaiser filter.
+// Separable windowed sinc, each output pixel has its own list of
+// clamped source taps so non power of two sizes are resampled properly.
+// ========================================================
+
+static const f32 kKaiserRadius = 2.0f;	// In destination pixels.
+static const f32 kKaiserAlpha = 4.0f;
+
+struct FilterTap
+{
+	u32 index;
+	f32 weight;
+};
+
+struct FilterTaps
+{
+	std::vector<u32> first;	// dstSize + 1 entries, taps for i are [first[i], first[i+1]).
+	std::vector<FilterTap> taps;
+};
+
+// Zeroth order modified Bessel function of the first kind.
+static f32 bessel_i0(f32 x)
+{
+	f32 sum = 1.0f;
+	f32 term = 1.0f;
+	const f32 halfXSq = 0.25f * x * x;
+	for (u32 k = 1; k < 32; ++k)
+	{
+		term *= halfXSq / static_cast<f32>(k * k);
+		sum += term;
+		if (term < 1e-7f * sum)
+		{
+			break;
+		}
+	}
+	return sum;
+}
+
+static f32 kaiser_weight(f32 t)
+{
+	if (fabsf(t) >= kKaiserRadius)
+	{
+		return 0.0f;
+	}
+
+	const f32 pix = 3.1415926535897931f * t;
+	const f32 sinc = fabsf(t) < 1e-5f ? 1.0f : sinf(pix) / pix;
+
+	const f32 r = t / kKaiserRadius;
+	const f32 window = bessel_i0(kKaiserAlpha * sqrtf(1.0f - r * r)) / bessel_i0(kKaiserAlpha);
+	return sinc * window;
+}
+
+static void build_kaiser_taps(u32 srcSize, u32 dstSize, FilterTaps& rOut)
+{
+	rOut.first.clear();
+	rOut.taps.clear();
+
+	const f32 scale = static_cast<f32>(srcSize) / dstSize;
+	const f32 support = kKaiserRadius * scale;
+
+	for (u32 i = 0; i < dstSize; ++i)
+	{
+		rOut.first.push_back(static_cast<u32>(rOut.taps.size()));
+
+		const f32 centre = (i + 0.5f) * scale - 0.5f;
+		const s32 lo = static_cast<s32>(ceilf(centre - support));
+		const s32 hi = static_cast<s32>(floorf(centre + support));
+
+		f32 total = 0.0f;
+		const size_t start = rOut.taps.size();
+		for (s32 s = lo; s <= hi; ++s)
+		{
+			const f32 w = kaiser_weight((s - centre) / scale);
+			if (w == 0.0f)
+			{
+				continue;
+			}
+
+			// Clamp to edge, merging with the previous tap if it lands on the same pixel.
+			const u32 index = static_cast<u32>(std::min(std::max(s, 0), static_cast<s32>(srcSize) - 1));
+			if (rOut.taps.size() > start && rOut.taps.back().index == index)
+			{
+				rOut.taps.back().weight += w;
+			}
+			else
+			{
+				rOut.taps.push_back({ index, w });
+			}
+			total += w;
+		}
+
+		for (size_t t = start; t < rOut.taps.size(); ++t)
+		{
+			rOut.taps[t].weight /= total;
+		}
+	}
+	rOut.first.push_back(static_cast<u32>(rOut.taps.size()));
+}
+
+static void kaiser_rows(const MipLevel& rSrc, const MipLevel& rDst, bool bSrgb,
+	const FilterTaps& rTapsX, const FilterTaps& rTapsY, u32 begin, u32 end)
+{
+	// Source rows this band of output rows reads from.
+	u32 rowMin = rSrc.height;
+	u32 rowMax = 0;
+	for (u32 t = rTapsY.first[begin]; t < rTapsY.first[end]; ++t)
+	{
+		rowMin = std::min(rowMin, rTapsY.taps[t].index);
+		rowMax = std::max(rowMax, rTapsY.taps[t].index);
+	}
+
+	// Horizontal pass over just those rows.
+	const u32 numRows = rowMax - rowMin + 1;
+	std::vector<f32>& rDecoded = scratch_buffer(0);
+	std::vector<f32>& rFiltered = scratch_buffer(1);
+	rDecoded.resize(rSrc.width * 4);
+	rFiltered.resize(static_cast<size_t>(numRows) * rDst.width * 4);
+
+	for (u32 r = 0; r < numRows; ++r)
+	{
+		decode_row(rSrc.pData + static_cast<u64>(rowMin + r) * rSrc.rowPitch, rSrc.width, bSrgb, rDecoded.data());
+
+		f32* pOut = &rFiltered[static_cast<size_t>(r) * rDst.width * 4];
+		for (u32 x = 0; x < rDst.width; ++x)
+		{
+			Vec4 acc = vec4_zero();
+			for (u32 t = rTapsX.first[x]; t < rTapsX.first[x + 1]; ++t)
+			{
+				acc = vec4_madd(acc, vec4_load(&rDecoded[rTapsX.taps[t].index * 4]), rTapsX.taps[t].weight);
+			}
+			vec4_store(pOut + x * 4, acc);
+		}
+	}
+
+	// Vertical pass straight to the output.
+	for (u32 y = begin; y < end; ++y)
+	{
+		memtype_t* pDst = rDst.pData + static_cast<u64>(y) * rDst.rowPitch;
+		for (u32 x = 0; x < rDst.width; ++x)
+		{
+			Vec4 acc = vec4_zero();
+			for (u32 t = rTapsY.first[y]; t < rTapsY.first[y + 1]; ++t)
+			{
+				const size_t row = rTapsY.taps[t].index - rowMin;
+				acc = vec4_madd(acc, vec4_load(&rFiltered[(row * rDst.width + x) * 4]), rTapsY.taps[t].weight);
+			}
+			encode_pixel(acc, bSrgb, pDst + x * 4);
+		}
+	}
+}
+
+// ========================================================
+// Mip chain.
+// ========================================================
+
+u32 mip_level_count(u32 width, u32 height)
+{
+	u32 levels = 1;
+	u32 size = std::max(width, height);
+	while (size > 1)
+	{
+		size >>= 1;
+		++levels;
+	}
+	return levels;
+}
+
+void generate_mips(const memtype_t* pRgba, u32 width, u32 height, u32 rowPitch,
+	const MipOptions& rOptions, TextureBuffer& rChainOut, JobPool* pPool)
+{
+	ASSERT(pRgba && width > 0 && height > 0 && rowPitch >= width * 4);
+
+	u32 numLevels = mip_level_count(width, height);
+	if (rOptions.maxLevels > 0)
+	{
+		numLevels = std::min(numLevels, rOptions.maxLevels);
+	}
+
+	// Lay every level out in one allocation.
+	std::vector<MipLevel> levels(numLevels);
+	u64 totalBytes = 0;
+	for (u32 i = 0; i < numLevels; ++i)
+	{
+		levels[i].width = std::max(width >> i, 1u);
+		levels[i].height = std::max(height >> i, 1u);
+		levels[i].rowPitch = levels[i].width * 4;
+		totalBytes += (static_cast<u64>(levels[i].rowPitch) * levels[i].height + 15) & ~15ull;
+	}
+
+	rChainOut.storage.resize(static_cast<size_t>(totalBytes));
+
+	u64 offset = 0;
+	for (u32 i = 0; i < numLevels; ++i)
+	{
+		levels[i].pData = rChainOut.storage.data() + offset;
+		offset += (static_cast<u64>(levels[i].rowPitch) * levels[i].height + 15) & ~15ull;
+	}
+
+	for (u32 y = 0; y < height; ++y)
+	{
+		memcpy(levels[0].pData + static_cast<u64>(y) * levels[0].rowPitch, pRgba + static_cast<u64>(y) * rowPitch, width * 4);
+	}
+
+	// Each level is filtered from the one above it.
+	FilterTaps tapsX;
+	FilterTaps tapsY;
+	for (u32 i = 1; i < numLevels; ++i)
+	{
+		const MipLevel& rSrc = levels[i - 1];
+		const MipLevel& rDst = levels[i];
+
+		JobPool::RangeJob job;
+		if (rOptions.filter == kMipFilterKaiser)
+		{
+			build_kaiser_taps(rSrc.width, rDst.width, tapsX);
+			build_kaiser_taps(rSrc.height, rDst.height, tapsY);
+			job = [&](u32 begin, u32 end) { kaiser_rows(rSrc, rDst, rOptions.bSrgb, tapsX, tapsY, begin, end); };
+		}
+		else
+		{
+			job = [&](u32 begin, u32 end) { box_rows(rSrc, rDst, rOptions.bSrgb, begin, end); };
+		}
+
+		if (pPool)
+		{
+			pPool->parallelFor(rDst.height, rows_per_job(rDst.width), job);
+		}
+		else
+		{
+			job(0, rDst.height);
+		}
+	}
+
+	TextureData& rTexture = rChainOut.texture;
+	rTexture = TextureData();
+	rTexture.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	rTexture.dimension = kTexture2D;
+	rTexture.width = width;
+	rTexture.height = height;
+	rTexture.depth = 1;
+	rTexture.mipLevels = numLevels;
+	rTexture.arraySize = 1;
+	rTexture.subresources.resize(numLevels);
+	for (u32 i = 0; i < numLevels; ++i)
+	{
+		TextureSubresource& rSub = rTexture.subresources[i];
+		rSub.pData = levels[i].pData;
+		rSub.width = levels[i].width;
+		rSub.height = levels[i].height;
+		rSub.depth = 1;
+		rSub.rowPitch = levels[i].rowPitch;
+		rSub.slicePitch = levels[i].rowPitch * levels[i].height;
+		rSub.numRows = levels[i].height;
+	}
+}
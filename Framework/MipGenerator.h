@@ -0,0 +1,38 @@
+#pragma once
+
+#include "CoreTypes.h"
+#include "TextureData.h"
+
+#include <vector>
+
+class JobPool;
+
+//================================================================================
+// CPU mip chain generation for 8 bit RGBA images.
+// Platform independent.
+//
+// Filtering is done in linear space when the source is sRGB encoded, the
+// stored format stays R8G8B8A8_UNORM so shaders see the same values as an
+// image loaded without mips. Rows of each level are spread across the job pool.
+//================================================================================
+
+enum MipFilter : u32
+{
+	kMipFilterBox,		// 2x2 average, fastest.
+	kMipFilterKaiser,	// Windowed sinc, sharper and handles odd sizes properly.
+};
+
+struct MipOptions
+{
+	MipFilter filter = kMipFilterBox;
+	bool bSrgb = true;		// Colour data, filter in linear space. Alpha is always linear.
+	u32 maxLevels = 0;		// Zero for the full chain down to 1x1.
+};
+
+// Number of levels in a full chain for the given size.
+u32 mip_level_count(u32 width, u32 height);
+
+// Build the mip chain for an RGBA8 image, level 0 is a copy of the source.
+// pPool may be null to run on the calling thread.
+void generate_mips(const memtype_t* pRgba, u32 width, u32 height, u32 rowPitch,
+	const MipOptions& rOptions, TextureBuffer& rChainOut, JobPool* pPool = nullptr);
@@ -0,0 +1,435 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+std::atomic<bool> g_profilerEnabled{ true };
+thread_local ProfileBuffer* t_pProfileBuffer = nullptr;
+
+using Clock = std::chrono::steady_clock;
+
+// ========================================================
+// ProfilerState
+// ========================================================
+
+struct ProfilerState
+{
+	// A thread recording markers, or a track with pBuffer null.
+	struct Thread
+	{
+		std::unique_ptr<ProfileBuffer> pBuffer;
+		std::string name;
+		std::vector<ProfileEvent> pending;	// Track events for the next frame.
+	};
+
+	ProfilerState()
+		: startTicks(profile_ticks())
+		, startTime(Clock::now())
+	{
+	}
+
+	// Ticks to nanoseconds, measured against the clock over the whole run so far.
+	void calibrate()
+	{
+		const u64 ticks = profile_ticks() - startTicks;
+		const f64 ns = std::chrono::duration<f64, std::nano>(Clock::now() - startTime).count();
+		if (ticks > 0 && ns > 0.0)
+		{
+			nsPerTick = ns / ticks;
+		}
+	}
+
+	u64 to_ns(u64 ticks) const
+	{
+		return ticks > startTicks ? static_cast<u64>((ticks - startTicks) * nsPerTick) : 0;
+	}
+
+	// Hand each event written since the last drain to fn, oldest first. Returns the events dropped.
+	template<typename Fn>
+	static u32 drain(ProfileBuffer& rBuffer, Fn fn)
+	{
+		const u32 read = rBuffer.m_read.load(std::memory_order_relaxed);
+		const u32 write = rBuffer.m_write.load(std::memory_order_acquire);
+		for (u32 event = read; event != write; ++event)
+		{
+			fn(rBuffer.m_events[event & (ProfileBuffer::kCapacity - 1)]);
+		}
+		rBuffer.m_read.store(write, std::memory_order_release);
+		return rBuffer.m_dropped.exchange(0, std::memory_order_relaxed);
+	}
+
+	const u64 startTicks;
+	const Clock::time_point startTime;
+	f64 nsPerTick = 1.0;
+
+	std::mutex mutex;				// Guards threads and names, registration can race with a drain.
+	std::vector<Thread> threads;
+	std::unordered_set<std::string> names;
+
+	ProfileFrame lastFrame = {};
+	u64 frameIndex = 0;
+	u64 frameBeginNs = 0;
+
+	u32 captureRemaining = 0;
+	std::string capturePath;
+	std::vector<ProfileFrame> captureFrames;
+};
+
+static ProfilerState& profiler_state()
+{
+	static ProfilerState s_state;
+	return s_state;
+}
+
+u64 profile_time_ns()
+{
+	return static_cast<u64>(std::chrono::duration<f64, std::nano>(Clock::now() - profiler_state().startTime).count());
+}
+
+ProfileBuffer* profile_register_thread()
+{
+	ProfilerState& rState = profiler_state();
+	std::lock_guard<std::mutex> lock(rState.mutex);
+
+	ProfilerState::Thread thread;
+	thread.pBuffer.reset(new ProfileBuffer());
+	char name[32];
+	snprintf(name, sizeof(name), "Thread %u", static_cast<u32>(rState.threads.size()));
+	thread.name = name;
+
+	t_pProfileBuffer = thread.pBuffer.get();
+	rState.threads.push_back(std::move(thread));
+	return t_pProfileBuffer;
+}
+
+const char* profile_intern(const char* pName)
+{
+	ProfilerState& rState = profiler_state();
+	std::lock_guard<std::mutex> lock(rState.mutex);
+	return rState.names.insert(pName).first->c_str();
+}
+
+u32 profiler_register_track(const char* pName)
+{
+	ProfilerState& rState = profiler_state();
+	std::lock_guard<std::mutex> lock(rState.mutex);
+
+	ProfilerState::Thread track;
+	track.name = pName;
+	rState.threads.push_back(std::move(track));
+	return static_cast<u32>(rState.threads.size() - 1);
+}
+
+void profiler_add_track_events(u32 track, const ProfileEvent* pEvents, u32 count)
+{
+	ProfilerState& rState = profiler_state();
+	std::lock_guard<std::mutex> lock(rState.mutex);
+
+	ProfilerState::Thread& rTrack = rState.threads[track];
+	ASSERT(!rTrack.pBuffer);
+	rTrack.pending.insert(rTrack.pending.end(), pEvents, pEvents + count);
+}
+
+void profiler_set_enabled(bool bEnabled)
+{
+	g_profilerEnabled.store(bEnabled, std::memory_order_relaxed);
+}
+
+bool profiler_enabled()
+{
+	return g_profilerEnabled.load(std::memory_order_relaxed);
+}
+
+void profiler_set_thread_name(const char* pName)
+{
+	ProfileBuffer* pBuffer = t_pProfileBuffer ? t_pProfileBuffer : profile_register_thread();
+
+	ProfilerState& rState = profiler_state();
+	std::lock_guard<std::mutex> lock(rState.mutex);
+	for (ProfilerState::Thread& rThread : rState.threads)
+	{
+		if (rThread.pBuffer.get() == pBuffer)
+		{
+			rThread.name = pName;
+		}
+	}
+}
+
+// ========================================================
+// Frames
+// ========================================================
+
+void profiler_end_frame()
+{
+	ProfilerState& rState = profiler_state();
+	rState.calibrate();
+
+	ProfileFrame& rFrame = rState.lastFrame;
+	rFrame.index = rState.frameIndex++;
+	rFrame.beginNs = rState.frameBeginNs;
+	rFrame.endNs = profile_time_ns();
+	rFrame.dropped = 0;
+	rFrame.threads.clear();
+	rState.frameBeginNs = rFrame.endNs;
+
+	{
+		std::lock_guard<std::mutex> lock(rState.mutex);
+		for (u32 index = 0; index < rState.threads.size(); ++index)
+		{
+			ProfilerState::Thread& rThread = rState.threads[index];
+
+			ProfileThread thread;
+			thread.id = index;
+			if (rThread.pBuffer)
+			{
+				rFrame.dropped += ProfilerState::drain(*rThread.pBuffer, [&rState, &thread](const ProfileBuffer::RawEvent& rEvent)
+				{
+					thread.events.push_back({ rEvent.pName, rState.to_ns(rEvent.beginTicks), rState.to_ns(rEvent.endTicks), rEvent.depth });
+				});
+			}
+			else
+			{
+				thread.events.swap(rThread.pending);
+			}
+
+			if (!thread.events.empty())
+			{
+				thread.name = rThread.name;
+				rFrame.threads.push_back(std::move(thread));
+			}
+		}
+	}
+
+	// Scopes are pushed as they close, children before parents.
+	for (ProfileThread& rThread : rFrame.threads)
+	{
+		std::sort(rThread.events.begin(), rThread.events.end(), [](const ProfileEvent& a, const ProfileEvent& b)
+		{
+			return a.beginNs != b.beginNs ? a.beginNs < b.beginNs : a.depth < b.depth;
+		});
+	}
+
+	if (rState.captureRemaining > 0)
+	{
+		rState.captureFrames.push_back(rFrame);
+		if (--rState.captureRemaining == 0)
+		{
+			if (write_chrome_trace(rState.captureFrames, rState.capturePath.c_str()))
+			{
+				debugF("Profiler : captured %u frames to %s\n", static_cast<u32>(rState.captureFrames.size()), rState.capturePath.c_str());
+			}
+			rState.captureFrames.clear();
+		}
+	}
+}
+
+const ProfileFrame& profiler_last_frame()
+{
+	return profiler_state().lastFrame;
+}
+
+void profiler_capture(u32 numFrames, const char* pPath)
+{
+	ProfilerState& rState = profiler_state();
+	rState.captureRemaining = numFrames;
+	rState.capturePath = pPath;
+	rState.captureFrames.clear();
+}
+
+bool profiler_capturing()
+{
+	return profiler_state().captureRemaining > 0;
+}
+
+void build_profile_tree(const ProfileThread& thread, std::vector<ProfileNode>& rNodesOut)
+{
+	rNodesOut.clear();
+
+	// The node of the innermost open scope at each depth.
+	std::vector<u32> path;
+	for (const ProfileEvent& rEvent : thread.events)
+	{
+		path.resize(std::min<size_t>(rEvent.depth, path.size()));
+		const u32 parent = path.empty() ? ProfileNode::kNoParent : path.back();
+		const u32 depth = static_cast<u32>(path.size());
+		const u64 durationNs = rEvent.endNs - rEvent.beginNs;
+
+		// Merge with an earlier call from the same parent, names are compared by pointer first.
+		u32 node = ProfileNode::kNoParent;
+		for (u32 i = (parent == ProfileNode::kNoParent) ? 0 : parent + 1; i < rNodesOut.size(); ++i)
+		{
+			const ProfileNode& rNode = rNodesOut[i];
+			if (rNode.parent == parent && (rNode.pName == rEvent.pName || strcmp(rNode.pName, rEvent.pName) == 0))
+			{
+				node = i;
+				break;
+			}
+		}
+		if (node == ProfileNode::kNoParent)
+		{
+			node = static_cast<u32>(rNodesOut.size());
+			rNodesOut.push_back({ rEvent.pName, parent, depth, 0, 0, 0 });
+		}
+
+		ProfileNode& rNode = rNodesOut[node];
+		++rNode.calls;
+		rNode.totalNs += durationNs;
+		rNode.selfNs += durationNs;
+		if (parent != ProfileNode::kNoParent)
+		{
+			ProfileNode& rParent = rNodesOut[parent];
+			rParent.selfNs -= std::min(rParent.selfNs, durationNs);
+		}
+		path.push_back(node);
+	}
+}
+
+// ========================================================
+// Chrome trace
+// ========================================================
+
+static void write_json_string(std::ofstream& out, const char* pText)
+{
+	out << '"';
+	for (const char* p = pText; *p; ++p)
+	{
+		if (*p == '"' || *p == '\\')
+		{
+			out << '\\';
+		}
+		if (static_cast<unsigned char>(*p) >= 0x20)
+		{
+			out << *p;
+		}
+	}
+	out << '"';
+}
+
+bool write_chrome_trace(const std::vector<ProfileFrame>& frames, const char* pPath)
+{
+	std::ofstream out(pPath, std::ios::trunc);
+	if (!out)
+	{
+		errorF("Profiler : can't write trace %s", pPath);
+		return false;
+	}
+
+	char line[256];
+	bool bFirst = true;
+	auto separator = [&out, &bFirst]()
+	{
+		out << (bFirst ? "\n" : ",\n");
+		bFirst = false;
+	};
+
+	out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+	// Name each thread once, from the first frame it appears in.
+	std::vector<bool> named;
+	for (const ProfileFrame& rFrame : frames)
+	{
+		for (const ProfileThread& rThread : rFrame.threads)
+		{
+			if (rThread.id >= named.size())
+			{
+				named.resize(rThread.id + 1, false);
+			}
+			if (!named[rThread.id])
+			{
+				named[rThread.id] = true;
+				separator();
+				snprintf(line, sizeof(line), "{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", rThread.id);
+				out << line;
+				write_json_string(out, rThread.name.c_str());
+				out << "}}";
+			}
+		}
+	}
+
+	// Timestamps are in microseconds, kept to the nanosecond.
+	for (const ProfileFrame& rFrame : frames)
+	{
+		separator();
+		snprintf(line, sizeof(line), "{\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"name\":\"Frame %llu\"}",
+			rFrame.beginNs * 0.001, static_cast<unsigned long long>(rFrame.index));
+		out << line;
+
+		for (const ProfileThread& rThread : rFrame.threads)
+		{
+			for (const ProfileEvent& rEvent : rThread.events)
+			{
+				separator();
+				snprintf(line, sizeof(line), "{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":",
+					rThread.id, rEvent.beginNs * 0.001, (rEvent.endNs - rEvent.beginNs) * 0.001);
+				out << line;
+				write_json_string(out, rEvent.pName);
+				out << "}";
+			}
+		}
+	}
+
+	out << "\n]}\n";
+	return static_cast<bool>(out);
+}
+
+// ========================================================
+// Benchmark
+// ========================================================
+
+f64 benchmark_profile_markers(u32 numMarkers)
+{
+	// Record into a buffer of its own so the thread's real events are left alone.
+	// Kept for the next call, CpuBench calls this in a loop and the buffer is 512 KB.
+	static thread_local std::unique_ptr<ProfileBuffer> t_pBenchmarkBuffer;
+	if (!t_pBenchmarkBuffer)
+	{
+		t_pBenchmarkBuffer.reset(new ProfileBuffer());
+	}
+	ProfileBuffer* pBuffer = t_pBenchmarkBuffer.get();
+	ProfileBuffer* pThreadBuffer = t_pProfileBuffer;
+	const bool bWasEnabled = profiler_enabled();
+	t_pProfileBuffer = pBuffer;
+	profiler_set_enabled(true);
+
+	// Batches that fit in the ring, drained between them outside the timing.
+	const u32 kBatch = ProfileBuffer::kCapacity / 2;
+	f64 totalNs = 0.0;
+	for (u32 done = 0; done < numMarkers; done += kBatch)
+	{
+		const u32 count = std::min(kBatch, numMarkers - done);
+		const Clock::time_point start = Clock::now();
+		for (u32 marker = 0; marker < count; ++marker)
+		{
+			PROFILE_SCOPE("Benchmark");
+		}
+		totalNs += std::chrono::duration<f64, std::nano>(Clock::now() - start).count();
+
+		ProfilerState::drain(*pBuffer, [](const ProfileBuffer::RawEvent&) {});
+	}
+
+	t_pProfileBuffer = pThreadBuffer;
+	profiler_set_enabled(bWasEnabled);
+	return numMarkers ? totalNs / numMarkers : 0.0;
+}
+
+f64 benchmark_profile_ticks(u32 numReads)
+{
+	const Clock::time_point start = Clock::now();
+	u64 sum = 0;
+	for (u32 read = 0; read < numReads; ++read)
+	{
+		sum += profile_ticks();
+	}
+	const f64 totalNs = std::chrono::duration<f64, std::nano>(Clock::now() - start).count();
+
+	// Used so the reads aren't optimized away.
+	static std::atomic<u64> s_sink{ 0 };
+	s_sink += sum;
+	return numReads ? totalNs / numReads : 0.0;
+}
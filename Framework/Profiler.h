@@ -0,0 +1,240 @@
+#pragma once
+
+#include "CoreTypes.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define PROFILER_USE_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_USE_TSC 1
+#else
+#include <chrono>
+#define PROFILER_USE_TSC 0
+#endif
+
+//================================================================================
+// Profiler
+// CPU time of named scopes on every thread, collected per frame.
+//
+//  void update()
+//  {
+//      PROFILE_SCOPE("Update");
+//      ...
+//  }
+//
+// A marker reads the time stamp counter when the scope opens and closes and
+// pushes one event to a ring owned by its thread, no locks and no allocation.
+// profiler_end_frame() drains the rings into the frame just finished, where
+// the events of each thread nest by depth into a hierarchy. Frames can be
+// captured to a Chrome trace (chrome://tracing, ui.perfetto.dev).
+//
+// Names must outlive the profiler, string literals or from profile_intern().
+// Events that don't fit in a thread's ring before the next drain are dropped
+// and counted.
+// Platform independent, the view is in ProfilerView.h.
+//================================================================================
+
+#define PROFILE_JOIN2(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_JOIN(profileScope, __LINE__)(name)
+
+// Raw timestamp, converted to nanoseconds when the events are drained.
+inline u64 profile_ticks()
+{
+#if PROFILER_USE_TSC
+	return __rdtsc();
+#else
+	return static_cast<u64>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// Nanoseconds since the profiler started, on the same clock as the events.
+u64 profile_time_ns();
+
+// ========================================================
+// ProfileBuffer
+// One thread's events, written by that thread only and
+// read by profiler_end_frame().
+// ========================================================
+class ProfileBuffer
+{
+public:
+	static const u32 kCapacity = 16 * 1024;	// Power of two.
+
+	struct RawEvent
+	{
+		const char* pName;
+		u64 beginTicks;
+		u64 endTicks;
+		u32 depth;
+	};
+
+	void push(const char* pName, u64 beginTicks, u64 endTicks, u32 depth)
+	{
+		const u32 write = m_write.load(std::memory_order_relaxed);
+		if (write - m_read.load(std::memory_order_acquire) == kCapacity)
+		{
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		m_events[write & (kCapacity - 1)] = { pName, beginTicks, endTicks, depth };
+		m_write.store(write + 1, std::memory_order_release);
+	}
+
+	u32 m_depth = 0;	// Scopes open on the thread.
+
+private:
+	friend struct ProfilerState;
+
+	std::atomic<u32> m_write{ 0 };
+	std::atomic<u32> m_read{ 0 };
+	std::atomic<u32> m_dropped{ 0 };
+	RawEvent m_events[kCapacity];
+};
+
+extern std::atomic<bool> g_profilerEnabled;
+extern thread_local ProfileBuffer* t_pProfileBuffer;
+
+// Registers the calling thread the first time it records.
+ProfileBuffer* profile_register_thread();
+
+inline ProfileBuffer* profile_thread_buffer()
+{
+	if (!g_profilerEnabled.load(std::memory_order_relaxed))
+	{
+		return nullptr;
+	}
+	ProfileBuffer* pBuffer = t_pProfileBuffer;
+	return pBuffer ? pBuffer : profile_register_thread();
+}
+
+// ========================================================
+// ProfileScope
+// ========================================================
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* pName)
+		: m_pName(pName)
+		, m_pBuffer(profile_thread_buffer())
+	{
+		if (m_pBuffer)
+		{
+			m_depth = m_pBuffer->m_depth++;
+			m_beginTicks = profile_ticks();
+		}
+	}
+
+	~ProfileScope()
+	{
+		if (m_pBuffer)
+		{
+			const u64 endTicks = profile_ticks();
+			--m_pBuffer->m_depth;
+			m_pBuffer->push(m_pName, m_beginTicks, endTicks, m_depth);
+		}
+	}
+
+private:
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+	const char* m_pName;
+	ProfileBuffer* m_pBuffer;
+	u64 m_beginTicks = 0;
+	u32 m_depth = 0;
+};
+
+// ========================================================
+// Frames
+// ========================================================
+
+struct ProfileEvent
+{
+	const char* pName;
+	u64 beginNs;
+	u64 endNs;
+	u32 depth;		// 0 for scopes with no parent on their thread.
+};
+
+struct ProfileThread
+{
+	u32 id;				// Order the thread or track was registered in.
+	std::string name;
+	std::vector<ProfileEvent> events;	// By begin time, parents before their children.
+};
+
+struct ProfileFrame
+{
+	u64 index;
+	u64 beginNs;
+	u64 endNs;
+	u32 dropped;	// Events lost to full rings.
+	std::vector<ProfileThread> threads;	// Threads and tracks with events this frame.
+};
+
+// Scopes with the same name under the same parent merged, in first call order.
+struct ProfileNode
+{
+	const char* pName;
+	u32 parent;		// kNoParent at the roots.
+	u32 depth;
+	u32 calls;
+	u64 totalNs;
+	u64 selfNs;		// totalNs less the children's.
+
+	static const u32 kNoParent = ~0u;
+};
+
+// Markers record nothing while disabled, on by default.
+void profiler_set_enabled(bool bEnabled);
+bool profiler_enabled();
+
+// Shown in the view and the trace, copied.
+void profiler_set_thread_name(const char* pName);
+
+// A stable copy of a name built at run time, for markers and tracks. Looks
+// the name up under a lock, so not for every marker.
+const char* profile_intern(const char* pName);
+
+// A track of events timed somewhere other than a thread, e.g. on the GPU,
+// shown and exported beside the threads. Returns the track's id.
+u32 profiler_register_track(const char* pName);
+
+// Events for the track, they go in the next frame closed. Times are on the
+// profile_time_ns() clock and may be from earlier frames.
+void profiler_add_track_events(u32 track, const ProfileEvent* pEvents, u32 count);
+
+// Close the current frame and start the next, once per frame on one thread.
+void profiler_end_frame();
+
+// The last frame closed, empty before the first.
+const ProfileFrame& profiler_last_frame();
+
+// Keep the next numFrames frames and write them to a Chrome trace at pPath.
+void profiler_capture(u32 numFrames, const char* pPath);
+bool profiler_capturing();
+
+// Merge a thread's events into a call tree, parents before children.
+void build_profile_tree(const ProfileThread& thread, std::vector<ProfileNode>& rNodesOut);
+
+// Chrome trace event format, one complete event per scope. Returns false if the file can't be written.
+bool write_chrome_trace(const std::vector<ProfileFrame>& frames, const char* pPath);
+
+// What one marker should cost on top of its two time stamp reads, the ring
+// push and the nesting. The reads alone take 15 to 55 ns depending on the CPU
+// and whether it's virtualized, which is the host's cost, not the profiler's.
+// CpuBench's profiler/marker case fails over it.
+static const f64 kProfileMarkerOverheadBudgetNs = 15.0;
+
+// Average cost of one marker on the calling thread, in nanoseconds. Enables
+// the profiler while it runs and drops the events it records.
+f64 benchmark_profile_markers(u32 numMarkers);
+
+// Average cost of one profile_ticks() read, in nanoseconds.
+f64 benchmark_profile_ticks(u32 numReads);
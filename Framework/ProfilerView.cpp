@@ -0,0 +1,230 @@
+#include "ProfilerView.h"
+#include "Profiler.h"
+#include "FramePacer.h"
+
+#include "imgui/imgui.h"
+
+#include <algorithm>
+
+static const char* kCapturePath = "profile_capture.json";
+
+struct ProfilerViewState
+{
+	bool bFrozen = false;		// Keep showing frozenFrame.
+	ProfileFrame frozenFrame = {};
+	int captureFrames = 60;
+	int treeThread = 0;			// Index in the frame's threads of the call tree shown.
+	f64 markerNs = 0.0;			// Last benchmark, 0 before the first.
+	f64 ticksNs = 0.0;
+	std::vector<ProfileNode> nodes;
+};
+
+static ProfilerViewState s_view;
+
+// Stable colour per name so a scope keeps its colour from frame to frame.
+static ImU32 scope_colour(const char* pName)
+{
+	u32 hash = 2166136261u;
+	for (const char* p = pName; *p; ++p)
+	{
+		hash = (hash ^ static_cast<u8>(*p)) * 16777619u;
+	}
+	return IM_COL32(96 + (hash & 0x7f), 96 + ((hash >> 8) & 0x7f), 96 + ((hash >> 16) & 0x7f), 255);
+}
+
+// Scopes of one thread laid out along the frame, one row per depth.
+static void draw_flame_graph(const ProfileFrame& frame, const ProfileThread& thread)
+{
+	const f32 rowHeight = ImGui::GetTextLineHeight() + 2.f;
+	u32 maxDepth = 0;
+	for (const ProfileEvent& rEvent : thread.events)
+	{
+		maxDepth = std::max(maxDepth, rEvent.depth);
+	}
+
+	const ImVec2 origin = ImGui::GetCursorScreenPos();
+	const f32 width = std::max(ImGui::GetContentRegionAvail().x, 64.f);
+	const f32 height = rowHeight * (maxDepth + 1);
+	const f64 frameNs = static_cast<f64>(std::max<u64>(frame.endNs - frame.beginNs, 1));
+
+	// Tracks can arrive frames late, like the GPU's, those are laid out from their first event.
+	u64 baseNs = frame.beginNs;
+	if (!thread.events.empty() && thread.events.front().endNs <= frame.beginNs)
+	{
+		baseNs = thread.events.front().beginNs;
+	}
+
+	ImDrawList* pDrawList = ImGui::GetWindowDrawList();
+	pDrawList->AddRectFilled(origin, ImVec2(origin.x + width, origin.y + height), IM_COL32(32, 32, 32, 255));
+
+	for (const ProfileEvent& rEvent : thread.events)
+	{
+		// Scopes that started before the frame are clipped to it.
+		const f64 begin = rEvent.beginNs > baseNs ? static_cast<f64>(rEvent.beginNs - baseNs) : 0.0;
+		const f64 end = rEvent.endNs > baseNs ? static_cast<f64>(rEvent.endNs - baseNs) : 0.0;
+		const f32 x0 = origin.x + static_cast<f32>(std::min(begin / frameNs, 1.0) * width);
+		const f32 x1 = origin.x + static_cast<f32>(std::min(end / frameNs, 1.0) * width);
+		if (x1 - x0 < 1.f)
+		{
+			continue;
+		}
+
+		const ImVec2 min(x0, origin.y + rEvent.depth * rowHeight);
+		const ImVec2 max(x1, min.y + rowHeight - 1.f);
+		pDrawList->AddRectFilled(min, max, scope_colour(rEvent.pName));
+
+		if (ImGui::CalcTextSize(rEvent.pName).x < x1 - x0 - 4.f)
+		{
+			pDrawList->AddText(ImVec2(x0 + 2.f, min.y + 1.f), IM_COL32(0, 0, 0, 255), rEvent.pName);
+		}
+		if (ImGui::IsMouseHoveringRect(min, max))
+		{
+			ImGui::SetTooltip("%s\n%.3f ms", rEvent.pName, (rEvent.endNs - rEvent.beginNs) * 1e-6);
+		}
+	}
+
+	ImGui::Dummy(ImVec2(width, height));
+}
+
+static void draw_tree_node(const std::vector<ProfileNode>& nodes, u32 node)
+{
+	const ProfileNode& rNode = nodes[node];
+
+	bool bHasChildren = false;
+	for (u32 child = node + 1; child < nodes.size() && !bHasChildren; ++child)
+	{
+		bHasChildren = nodes[child].parent == node;
+	}
+
+	const ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_DefaultOpen | (bHasChildren ? 0 : ImGuiTreeNodeFlags_Leaf);
+	const bool bOpen = ImGui::TreeNodeEx(&rNode, flags, "%s  %.3f ms (self %.3f ms) x%u",
+		rNode.pName, rNode.totalNs * 1e-6, rNode.selfNs * 1e-6, rNode.calls);
+	if (bOpen)
+	{
+		for (u32 child = node + 1; child < nodes.size(); ++child)
+		{
+			if (nodes[child].parent == node)
+			{
+				draw_tree_node(nodes, child);
+			}
+		}
+		ImGui::TreePop();
+	}
+}
+
+static bool pacing_mode_item(void*, int index, const char** ppTextOut)
+{
+	*ppTextOut = pacing_mode_name(static_cast<PacingMode>(index));
+	return true;
+}
+
+static void draw_pacing(FramePacer& rPacer)
+{
+	int mode = static_cast<int>(rPacer.mode());
+	if (ImGui::Combo("Pacing", &mode, pacing_mode_item, nullptr, kNumPacingModes))
+	{
+		rPacer.set_mode(static_cast<PacingMode>(mode));
+		rPacer.reset_stats();
+	}
+	if (rPacer.mode() == kPacingFixedRate || rPacer.mode() == kPacingLowLatency)
+	{
+		f32 hz = static_cast<f32>(rPacer.target_hz());
+		if (ImGui::SliderFloat("Target Hz", &hz, 10.f, 240.f, "%.0f"))
+		{
+			rPacer.set_target_hz(hz);
+			rPacer.reset_stats();
+		}
+	}
+
+	const FramePacingStats stats = rPacer.stats();
+	ImGui::Text("Interval : mean %.3f ms, std dev %.3f ms, p99 %.3f ms, max %.3f ms",
+		stats.interval.meanMs, stats.interval.stdDevMs, stats.interval.p99Ms, stats.interval.maxMs);
+	ImGui::Text("Input to present : mean %.3f ms, p99 %.3f ms", stats.latency.meanMs, stats.latency.p99Ms);
+	ImGui::Text("Waiting %.3f ms a frame, %u late, %u skipped", stats.waitMs, stats.late, stats.skipped);
+	if (rPacer.mode() == kPacingLowLatency)
+	{
+		ImGui::Text("Predicted frame %.3f ms", rPacer.predicted_frame_ns() * 1e-6);
+	}
+}
+
+void profiler_window(bool* pOpen, FramePacer* pPacer)
+{
+	ImGui::SetNextWindowSize(ImVec2(640.f, 480.f), ImGuiCond_FirstUseEver);
+	if (!ImGui::Begin("Profiler", pOpen))
+	{
+		ImGui::End();
+		return;
+	}
+
+	bool bEnabled = profiler_enabled();
+	if (ImGui::Checkbox("Enabled", &bEnabled))
+	{
+		profiler_set_enabled(bEnabled);
+	}
+	ImGui::SameLine();
+	if (ImGui::Checkbox("Freeze", &s_view.bFrozen) && s_view.bFrozen)
+	{
+		s_view.frozenFrame = profiler_last_frame();
+	}
+
+	// Capture the next frames to a Chrome trace.
+	ImGui::SliderInt("Frames", &s_view.captureFrames, 1, 600);
+	ImGui::SameLine();
+	if (profiler_capturing())
+	{
+		ImGui::Text("Capturing...");
+	}
+	else if (ImGui::Button("Capture"))
+	{
+		profiler_capture(static_cast<u32>(s_view.captureFrames), kCapturePath);
+	}
+
+	if (ImGui::Button("Measure marker cost"))
+	{
+		s_view.markerNs = benchmark_profile_markers(1000000);
+		s_view.ticksNs = benchmark_profile_ticks(1000000);
+	}
+	if (s_view.markerNs > 0.0)
+	{
+		ImGui::SameLine();
+		ImGui::Text("%.1f ns per marker, %.1f ns over its two clock reads (budget %.0f ns)", s_view.markerNs,
+			s_view.markerNs - 2.0 * s_view.ticksNs, kProfileMarkerOverheadBudgetNs);
+	}
+
+	if (pPacer && ImGui::CollapsingHeader("Frame pacing"))
+	{
+		draw_pacing(*pPacer);
+	}
+
+	const ProfileFrame& frame = s_view.bFrozen ? s_view.frozenFrame : profiler_last_frame();
+	ImGui::Text("Frame %llu : %.3f ms, %u events dropped", static_cast<unsigned long long>(frame.index),
+		(frame.endNs - frame.beginNs) * 1e-6, frame.dropped);
+
+	for (const ProfileThread& rThread : frame.threads)
+	{
+		ImGui::Text("%s", rThread.name.c_str());
+		draw_flame_graph(frame, rThread);
+	}
+
+	if (!frame.threads.empty())
+	{
+		ImGui::Separator();
+		const int lastThread = static_cast<int>(frame.threads.size()) - 1;
+		ImGui::SliderInt("Call tree", &s_view.treeThread, 0, lastThread);
+		s_view.treeThread = std::min(std::max(s_view.treeThread, 0), lastThread);
+		const ProfileThread& rTreeThread = frame.threads[s_view.treeThread];
+		ImGui::SameLine();
+		ImGui::Text("%s", rTreeThread.name.c_str());
+
+		build_profile_tree(rTreeThread, s_view.nodes);
+		for (u32 node = 0; node < s_view.nodes.size(); ++node)
+		{
+			if (s_view.nodes[node].parent == ProfileNode::kNoParent)
+			{
+				draw_tree_node(s_view.nodes, node);
+			}
+		}
+	}
+
+	ImGui::End();
+}
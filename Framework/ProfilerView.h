@@ -0,0 +1,16 @@
+#pragma once
+
+#include "CoreTypes.h"
+
+//================================================================================
+// Profiler view
+// ImGui window over the profiler: a flame graph of the last frame on each
+// thread and track, the call tree of one of them, frame capture to a Chrome
+// trace and the marker cost benchmark. With a pacer also the frame pacing:
+// the mode, the spread of the frame intervals and input to present latency.
+//================================================================================
+
+class FramePacer;
+
+// Draw the window, call between ImGui::NewFrame() and ImGui::Render(). pPacer may be null.
+void profiler_window(bool* pOpen, FramePacer* pPacer = nullptr);
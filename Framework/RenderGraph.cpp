@@ -0,0 +1,404 @@
+#include "RenderGraph.h"
+#include "GpuTimer.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+RenderGraph::RenderGraph()
+{
+	reset();
+}
+
+void RenderGraph::reset()
+{
+	m_passes.clear();
+	m_resources.clear();
+	m_order.clear();
+	m_physical.clear();
+	m_stats = {};
+}
+
+RenderGraph::Resource RenderGraph::create_target(const char* pName, const RenderTargetDesc& desc)
+{
+	m_resources.push_back({ pName, desc, false, kInvalid, kInvalid, kInvalid });
+	return static_cast<Resource>(m_resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::import_target(const char* pName, const RenderTargetDesc& desc)
+{
+	m_resources.push_back({ pName, desc, true, kInvalid, kInvalid, kInvalid });
+	return static_cast<Resource>(m_resources.size() - 1);
+}
+
+RenderGraph::Pass RenderGraph::add_pass(const char* pName, ExecuteFn execute)
+{
+	PassData pass;
+	pass.name = pName;
+	pass.execute = std::move(execute);
+	pass.bKeep = false;
+	pass.position = kInvalid;
+	m_passes.push_back(std::move(pass));
+	return static_cast<Pass>(m_passes.size() - 1);
+}
+
+void RenderGraph::access(Pass pass, Resource resource, u32 access)
+{
+	ASSERT(pass < m_passes.size() && resource < m_resources.size());
+
+	for (PassAccess& rAccess : m_passes[pass].accesses)
+	{
+		if (rAccess.resource == resource)
+		{
+			rAccess.access |= access;
+			return;
+		}
+	}
+	m_passes[pass].accesses.push_back({ resource, access });
+}
+
+void RenderGraph::read(Pass pass, Resource resource)
+{
+	access(pass, resource, kAccessRead);
+}
+
+void RenderGraph::write(Pass pass, Resource resource)
+{
+	access(pass, resource, kAccessWrite);
+}
+
+void RenderGraph::keep(Pass pass)
+{
+	m_passes[pass].bKeep = true;
+}
+
+// ========================================================
+// Compile
+// ========================================================
+
+bool RenderGraph::compile(std::string* pErrorOut)
+{
+	m_stats = {};
+	m_physical.clear();
+	for (ResourceData& rResource : m_resources)
+	{
+		rResource.firstUse = kInvalid;
+		rResource.lastUse = kInvalid;
+		rResource.physical = kInvalid;
+	}
+
+	build_dependencies();
+	cull();
+	if (!sort(pErrorOut))
+	{
+		return false;
+	}
+	assign_physical();
+	return true;
+}
+
+void RenderGraph::build_dependencies()
+{
+	struct Use
+	{
+		Pass pass;
+		u32 access;
+	};
+
+	// Uses of each target in declaration order.
+	std::vector<std::vector<Use>> uses(m_resources.size());
+	for (Pass pass = 0; pass < m_passes.size(); ++pass)
+	{
+		m_passes[pass].after.clear();
+		m_passes[pass].inputs.clear();
+		for (const PassAccess& rAccess : m_passes[pass].accesses)
+		{
+			uses[rAccess.resource].push_back({ pass, rAccess.access });
+		}
+	}
+
+	for (const std::vector<Use>& rUses : uses)
+	{
+		Pass firstWriter = kInvalid;
+		for (const Use& rUse : rUses)
+		{
+			if (rUse.access & kAccessWrite)
+			{
+				firstWriter = rUse.pass;
+				break;
+			}
+		}
+
+		Pass lastWriter = kInvalid;
+		std::vector<Pass> readers;	// Of lastWriter's contents.
+		for (const Use& rUse : rUses)
+		{
+			PassData& rPass = m_passes[rUse.pass];
+
+			if (rUse.access & kAccessRead)
+			{
+				const Pass source = (lastWriter != kInvalid) ? lastWriter : firstWriter;
+				if (source != kInvalid && source != rUse.pass)
+				{
+					rPass.after.push_back(source);
+					rPass.inputs.push_back(source);
+				}
+				// Reads of a later write are ordered by that write, not against it.
+				if (lastWriter != kInvalid)
+				{
+					readers.push_back(rUse.pass);
+				}
+			}
+
+			if (rUse.access & kAccessWrite)
+			{
+				// The previous contents may be kept, e.g. drawing over the scene.
+				if (lastWriter != kInvalid && lastWriter != rUse.pass)
+				{
+					rPass.after.push_back(lastWriter);
+					rPass.inputs.push_back(lastWriter);
+				}
+				// Don't overwrite what is still to be read.
+				for (Pass reader : readers)
+				{
+					if (reader != rUse.pass)
+					{
+						rPass.after.push_back(reader);
+					}
+				}
+				readers.clear();
+				lastWriter = rUse.pass;
+			}
+		}
+	}
+
+	for (PassData& rPass : m_passes)
+	{
+		std::sort(rPass.after.begin(), rPass.after.end());
+		rPass.after.erase(std::unique(rPass.after.begin(), rPass.after.end()), rPass.after.end());
+	}
+}
+
+void RenderGraph::cull()
+{
+	// Walk back from the roots through the passes whose results are used.
+	std::vector<Pass> stack;
+	for (Pass pass = 0; pass < m_passes.size(); ++pass)
+	{
+		PassData& rPass = m_passes[pass];
+		rPass.position = kInvalid;
+
+		bool bRoot = rPass.bKeep;
+		for (const PassAccess& rAccess : rPass.accesses)
+		{
+			bRoot |= (rAccess.access & kAccessWrite) && m_resources[rAccess.resource].bImported;
+		}
+		if (bRoot)
+		{
+			stack.push_back(pass);
+		}
+	}
+
+	// Live passes are marked with position 0 until sort() numbers them.
+	while (!stack.empty())
+	{
+		const Pass pass = stack.back();
+		stack.pop_back();
+		if (m_passes[pass].position == 0)
+		{
+			continue;
+		}
+		m_passes[pass].position = 0;
+		for (Pass input : m_passes[pass].inputs)
+		{
+			stack.push_back(input);
+		}
+	}
+}
+
+bool RenderGraph::sort(std::string* pErrorOut)
+{
+	const u32 numPasses = static_cast<u32>(m_passes.size());
+
+	std::vector<u32> waitingOn(numPasses, 0);
+	std::vector<std::vector<Pass>> unblocks(numPasses);
+	for (Pass pass = 0; pass < numPasses; ++pass)
+	{
+		if (culled(pass))
+		{
+			continue;
+		}
+		for (Pass before : m_passes[pass].after)
+		{
+			if (!culled(before))
+			{
+				++waitingOn[pass];
+				unblocks[before].push_back(pass);
+			}
+		}
+	}
+
+	// Of the passes that are ready, run the one declared first.
+	std::priority_queue<Pass, std::vector<Pass>, std::greater<Pass>> ready;
+	u32 numLive = 0;
+	for (Pass pass = 0; pass < numPasses; ++pass)
+	{
+		if (!culled(pass))
+		{
+			++numLive;
+			if (waitingOn[pass] == 0)
+			{
+				ready.push(pass);
+			}
+		}
+	}
+
+	m_order.clear();
+	while (!ready.empty())
+	{
+		const Pass pass = ready.top();
+		ready.pop();
+		m_order.push_back(pass);
+		for (Pass next : unblocks[pass])
+		{
+			if (--waitingOn[next] == 0)
+			{
+				ready.push(next);
+			}
+		}
+	}
+
+	if (m_order.size() != numLive)
+	{
+		if (pErrorOut)
+		{
+			*pErrorOut = "RenderGraph : passes depend on each other:";
+			for (Pass pass = 0; pass < numPasses; ++pass)
+			{
+				if (!culled(pass) && waitingOn[pass] != 0)
+				{
+					*pErrorOut += " '" + m_passes[pass].name + "'";
+				}
+			}
+		}
+		for (PassData& rPass : m_passes)
+		{
+			rPass.position = kInvalid;
+		}
+		m_order.clear();
+		return false;
+	}
+
+	for (u32 position = 0; position < m_order.size(); ++position)
+	{
+		m_passes[m_order[position]].position = position;
+	}
+	return true;
+}
+
+void RenderGraph::assign_physical()
+{
+	for (u32 position = 0; position < m_order.size(); ++position)
+	{
+		for (const PassAccess& rAccess : m_passes[m_order[position]].accesses)
+		{
+			ResourceData& rResource = m_resources[rAccess.resource];
+			rResource.firstUse = std::min(rResource.firstUse, position);
+			rResource.lastUse = (rResource.lastUse == kInvalid) ? position : std::max(rResource.lastUse, position);
+		}
+	}
+
+	std::vector<Resource> transients;
+	for (Resource resource = 0; resource < m_resources.size(); ++resource)
+	{
+		if (!m_resources[resource].bImported && m_resources[resource].firstUse != kInvalid)
+		{
+			transients.push_back(resource);
+		}
+	}
+	std::stable_sort(transients.begin(), transients.end(), [this](Resource a, Resource b)
+	{
+		return m_resources[a].firstUse < m_resources[b].firstUse;
+	});
+
+	// Greedy interval assignment: reuse the physical target that was freed last,
+	// so ones that came free earlier stay available for other sizes.
+	m_physical.clear();
+	std::vector<u32> physicalLastUse;
+	for (Resource resource : transients)
+	{
+		ResourceData& rResource = m_resources[resource];
+
+		u32 best = kInvalid;
+		for (u32 physical = 0; physical < m_physical.size(); ++physical)
+		{
+			const RenderTargetDesc& rDesc = m_physical[physical];
+			const bool bFits = rDesc.width == rResource.desc.width && rDesc.height == rResource.desc.height
+				&& rDesc.format == rResource.desc.format;
+			if (bFits && physicalLastUse[physical] < rResource.firstUse
+				&& (best == kInvalid || physicalLastUse[physical] > physicalLastUse[best]))
+			{
+				best = physical;
+			}
+		}
+
+		if (best == kInvalid)
+		{
+			best = static_cast<u32>(m_physical.size());
+			m_physical.push_back(rResource.desc);
+			physicalLastUse.push_back(rResource.lastUse);
+		}
+		else
+		{
+			m_physical[best].flags |= rResource.desc.flags;
+			physicalLastUse[best] = rResource.lastUse;
+		}
+		rResource.physical = best;
+	}
+
+	// Stats.
+	const u32 numPasses = m_stats.numPasses = static_cast<u32>(m_passes.size());
+	m_stats.numCulled = numPasses - static_cast<u32>(m_order.size());
+	m_stats.numTransient = static_cast<u32>(transients.size());
+	m_stats.numPhysical = static_cast<u32>(m_physical.size());
+	m_stats.physicalBytes = 0;
+	for (const RenderTargetDesc& rDesc : m_physical)
+	{
+		m_stats.physicalBytes += rDesc.bytes();
+	}
+	m_stats.unaliasedBytes = 0;
+	for (Resource resource : transients)
+	{
+		m_stats.unaliasedBytes += m_resources[resource].desc.bytes();
+	}
+	m_stats.peakLiveBytes = 0;
+	for (u32 position = 0; position < m_order.size(); ++position)
+	{
+		u64 liveBytes = 0;
+		for (Resource resource : transients)
+		{
+			const ResourceData& rResource = m_resources[resource];
+			if (rResource.firstUse <= position && position <= rResource.lastUse)
+			{
+				liveBytes += rResource.desc.bytes();
+			}
+		}
+		m_stats.peakLiveBytes = std::max(m_stats.peakLiveBytes, liveBytes);
+	}
+}
+
+void RenderGraph::execute(GpuTimer* pTimer) const
+{
+	for (Pass pass : m_order)
+	{
+		if (m_passes[pass].execute)
+		{
+			// Pass names go when the graph is reset, the timings outlive it.
+			const char* pName = profile_intern(m_passes[pass].name.c_str());
+			PROFILE_SCOPE(pName);
+			GpuPassScope gpuPass(pTimer, pName);
+			m_passes[pass].execute();
+		}
+	}
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "CoreTypes.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class GpuTimer;
+
+//================================================================================
+// RenderGraph
+// Passes declare the targets they read and write, compile() then:
+//  - orders them. A read sees the last write declared before it, or the
+//    first write if the target isn't written until later, so a pass can be
+//    declared before the one that produces its input.
+//  - culls passes whose output nobody uses. Passes that write an imported
+//    target (the back buffer, anything kept between frames) or are marked
+//    keep() are the roots, everything they don't read from is dropped.
+//  - works out when each transient target is first and last used, and puts
+//    targets whose lifetimes don't overlap on the same physical target.
+//
+// Platform independent, nothing is created here. RenderTargetPool makes the
+// D3D11 textures for a compiled graph. D3D11 can't place two resources in one
+// allocation, so only targets of the same size and format share; the physical
+// target gets the bind flags of every target on it.
+//
+// Typically rebuilt every frame: reset(), declare, compile(), execute().
+//================================================================================
+
+enum RenderTargetFlags : u32
+{
+	kTargetShaderResource = 1 << 0,
+	kTargetRenderTarget = 1 << 1,
+	kTargetUnorderedAccess = 1 << 2,
+};
+
+struct RenderTargetDesc
+{
+	u32 width;
+	u32 height;
+	u32 format;			// DXGI_FORMAT.
+	u32 bytesPerPixel;
+	u32 flags;			// RenderTargetFlags.
+
+	u64 bytes() const { return u64(width) * height * bytesPerPixel; }
+};
+
+class RenderGraph
+{
+public:
+	using Resource = u32;
+	using Pass = u32;
+	static const u32 kInvalid = ~0u;
+
+	typedef std::function<void()> ExecuteFn;
+
+	struct Stats
+	{
+		u32 numPasses;			// Declared.
+		u32 numCulled;
+		u32 numTransient;		// Transient targets used by a live pass.
+		u32 numPhysical;
+		u64 physicalBytes;		// Memory of the physical targets, what is allocated.
+		u64 unaliasedBytes;		// What the transient targets would take on their own.
+		u64 peakLiveBytes;		// Most transient bytes alive during one pass, the floor for any aliasing.
+	};
+
+	RenderGraph();
+
+	// Forget every pass and target, the physical assignment from the last compile goes too.
+	void reset();
+
+	// Target created for this graph, only valid between its first and last use.
+	Resource create_target(const char* pName, const RenderTargetDesc& desc);
+
+	// Target owned outside the graph, never aliased. A write to it keeps the pass alive.
+	Resource import_target(const char* pName, const RenderTargetDesc& desc);
+
+	Pass add_pass(const char* pName, ExecuteFn execute);
+	void read(Pass pass, Resource resource);
+	void write(Pass pass, Resource resource);
+
+	// Never cull the pass, e.g. it reads back or has other side effects.
+	void keep(Pass pass);
+
+	// False if the passes depend on each other in a loop, the graph can't be executed then.
+	bool compile(std::string* pErrorOut = nullptr);
+
+	// Run the live passes in order, each in a profiler scope and timed on the GPU when pTimer is given.
+	void execute(GpuTimer* pTimer = nullptr) const;
+
+	// ---- Results of compile() ----
+
+	// Live passes in execution order.
+	const std::vector<Pass>& order() const { return m_order; }
+	bool culled(Pass pass) const { return m_passes[pass].position == kInvalid; }
+
+	// Physical target of a transient target, kInvalid for imported or unused targets.
+	u32 physical(Resource resource) const { return m_resources[resource].physical; }
+	u32 num_physical() const { return static_cast<u32>(m_physical.size()); }
+	const RenderTargetDesc& physical_desc(u32 physical) const { return m_physical[physical]; }
+
+	// Positions in order() of the first and last live pass to use the target, kInvalid if none does.
+	u32 first_use(Resource resource) const { return m_resources[resource].firstUse; }
+	u32 last_use(Resource resource) const { return m_resources[resource].lastUse; }
+
+	const Stats& stats() const { return m_stats; }
+
+	u32 num_passes() const { return static_cast<u32>(m_passes.size()); }
+	u32 num_resources() const { return static_cast<u32>(m_resources.size()); }
+	const char* pass_name(Pass pass) const { return m_passes[pass].name.c_str(); }
+	const char* resource_name(Resource resource) const { return m_resources[resource].name.c_str(); }
+	const RenderTargetDesc& resource_desc(Resource resource) const { return m_resources[resource].desc; }
+	bool imported(Resource resource) const { return m_resources[resource].bImported; }
+
+private:
+	enum Access : u32
+	{
+		kAccessRead = 1 << 0,
+		kAccessWrite = 1 << 1,
+	};
+
+	struct PassAccess
+	{
+		Resource resource;
+		u32 access;
+	};
+
+	struct PassData
+	{
+		std::string name;
+		ExecuteFn execute;
+		std::vector<PassAccess> accesses;
+		std::vector<Pass> after;		// Must run after these.
+		std::vector<Pass> inputs;		// Passes whose writes this one uses.
+		bool bKeep;
+		u32 position;					// In m_order, kInvalid when culled.
+	};
+
+	struct ResourceData
+	{
+		std::string name;
+		RenderTargetDesc desc;
+		bool bImported;
+		u32 firstUse;
+		u32 lastUse;
+		u32 physical;
+	};
+
+	void access(Pass pass, Resource resource, u32 access);
+	void build_dependencies();
+	void cull();
+	bool sort(std::string* pErrorOut);
+	void assign_physical();
+
+	std::vector<PassData> m_passes;
+	std::vector<ResourceData> m_resources;
+
+	std::vector<Pass> m_order;
+	std::vector<RenderTargetDesc> m_physical;
+	Stats m_stats;
+};
@@ -0,0 +1,86 @@
+#include "RenderTargetPool.h"
+
+void RenderTargetPool::init(ID3D11Device* pDevice)
+{
+	m_pDevice = pDevice;
+}
+
+void RenderTargetPool::create(Target& rTarget, const RenderTargetDesc& desc)
+{
+	rTarget = Target();
+	rTarget.desc = desc;
+
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = desc.width;
+	textureDesc.Height = desc.height;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = static_cast<DXGI_FORMAT>(desc.format);
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = ((desc.flags & kTargetShaderResource) ? D3D11_BIND_SHADER_RESOURCE : 0)
+		| ((desc.flags & kTargetRenderTarget) ? D3D11_BIND_RENDER_TARGET : 0)
+		| ((desc.flags & kTargetUnorderedAccess) ? D3D11_BIND_UNORDERED_ACCESS : 0);
+
+	if (FAILED(m_pDevice->CreateTexture2D(&textureDesc, nullptr, rTarget.texture.GetAddressOf())))
+	{
+		panicF("RenderTargetPool : failed to create a %ux%u target", desc.width, desc.height);
+	}
+	if ((desc.flags & kTargetRenderTarget) && FAILED(m_pDevice->CreateRenderTargetView(rTarget.texture.Get(), nullptr, rTarget.renderTarget.GetAddressOf())))
+	{
+		panicF("RenderTargetPool : failed to create a render target view");
+	}
+	if ((desc.flags & kTargetShaderResource) && FAILED(m_pDevice->CreateShaderResourceView(rTarget.texture.Get(), nullptr, rTarget.shaderResource.GetAddressOf())))
+	{
+		panicF("RenderTargetPool : failed to create a shader resource view");
+	}
+	if ((desc.flags & kTargetUnorderedAccess) && FAILED(m_pDevice->CreateUnorderedAccessView(rTarget.texture.Get(), nullptr, rTarget.unorderedAccess.GetAddressOf())))
+	{
+		panicF("RenderTargetPool : failed to create an unordered access view");
+	}
+}
+
+void RenderTargetPool::realize(const RenderGraph& graph)
+{
+	ASSERT(m_pDevice);
+
+	// Textures past the graph's count are released.
+	m_targets.resize(graph.num_physical());
+	for (u32 physical = 0; physical < graph.num_physical(); ++physical)
+	{
+		const RenderTargetDesc& rDesc = graph.physical_desc(physical);
+		const RenderTargetDesc& rHave = m_targets[physical].desc;
+		if (!m_targets[physical].texture || rHave.width != rDesc.width || rHave.height != rDesc.height
+			|| rHave.format != rDesc.format || rHave.flags != rDesc.flags)
+		{
+			create(m_targets[physical], rDesc);
+		}
+	}
+
+	m_views.assign(graph.num_resources(), Views());
+	for (RenderGraph::Resource resource = 0; resource < graph.num_resources(); ++resource)
+	{
+		const u32 physical = graph.physical(resource);
+		if (physical != RenderGraph::kInvalid)
+		{
+			const Target& rTarget = m_targets[physical];
+			m_views[resource] = { rTarget.texture.Get(), rTarget.renderTarget.Get(), rTarget.shaderResource.Get(), rTarget.unorderedAccess.Get() };
+		}
+	}
+}
+
+void RenderTargetPool::import(RenderGraph::Resource resource, ID3D11Texture2D* pTexture, ID3D11RenderTargetView* pRenderTarget,
+	ID3D11ShaderResourceView* pShaderResource, ID3D11UnorderedAccessView* pUnorderedAccess)
+{
+	m_views[resource] = { pTexture, pRenderTarget, pShaderResource, pUnorderedAccess };
+}
+
+u64 RenderTargetPool::bytes() const
+{
+	u64 total = 0;
+	for (const Target& rTarget : m_targets)
+	{
+		total += rTarget.desc.bytes();
+	}
+	return total;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "CommonHeader.h"
+#include "RenderGraph.h"
+
+#include <vector>
+
+//================================================================================
+// RenderTargetPool
+// The D3D11 textures behind a compiled RenderGraph. One texture per physical
+// target, kept from frame to frame and only recreated when the graph asks for
+// a different size, format or bind flags, so rebuilding the graph every frame
+// doesn't allocate.
+//
+// Per frame: compile the graph, realize() it, import() the targets owned
+// elsewhere, then execute the graph. Passes look up their views here.
+//================================================================================
+class RenderTargetPool
+{
+public:
+	RenderTargetPool() {}
+
+	void init(ID3D11Device* pDevice);
+
+	// Make the physical targets of the graph and point its transient targets at them.
+	void realize(const RenderGraph& graph);
+
+	// Views of a target the graph imported, any may be null. Call after realize().
+	void import(RenderGraph::Resource resource, ID3D11Texture2D* pTexture, ID3D11RenderTargetView* pRenderTarget,
+		ID3D11ShaderResourceView* pShaderResource, ID3D11UnorderedAccessView* pUnorderedAccess = nullptr);
+
+	ID3D11Texture2D* texture(RenderGraph::Resource resource) const { return m_views[resource].pTexture; }
+	ID3D11RenderTargetView* rtv(RenderGraph::Resource resource) const { return m_views[resource].pRenderTarget; }
+	ID3D11ShaderResourceView* srv(RenderGraph::Resource resource) const { return m_views[resource].pShaderResource; }
+	ID3D11UnorderedAccessView* uav(RenderGraph::Resource resource) const { return m_views[resource].pUnorderedAccess; }
+
+	// Memory of the pooled textures.
+	u64 bytes() const;
+
+private:
+	RenderTargetPool(const RenderTargetPool&) = delete;
+	RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+	struct Target
+	{
+		RenderTargetDesc desc;
+		ComPtr<ID3D11Texture2D> texture;
+		ComPtr<ID3D11RenderTargetView> renderTarget;
+		ComPtr<ID3D11ShaderResourceView> shaderResource;
+		ComPtr<ID3D11UnorderedAccessView> unorderedAccess;
+	};
+
+	struct Views
+	{
+		ID3D11Texture2D* pTexture;
+		ID3D11RenderTargetView* pRenderTarget;
+		ID3D11ShaderResourceView* pShaderResource;
+		ID3D11UnorderedAccessView* pUnorderedAccess;
+	};
+
+	void create(Target& rTarget, const RenderTargetDesc& desc);
+
+	ID3D11Device* m_pDevice = nullptr;
+	std::vector<Target> m_targets;	// Indexed by physical target.
+	std::vector<Views> m_views;		// Indexed by graph resource.
+};
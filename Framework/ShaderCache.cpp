@@ -0,0 +1,455 @@
+#include "ShaderCache.h"
+#include "AssetPack.h"
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+static const char* s_cacheDirectory = "Cache/Shaders/";
+static const u32 kShaderCacheMagic = 0x31434853;	// "SHC1"
+
+// On disk: this header, the include paths (each null terminated), then the bytecode.
+struct ShaderCacheFileHeader
+{
+	u32 magic;
+	u32 numIncludes;
+	u64 key;
+	u32 includeBytes;
+	u32 bytecodeSize;
+};
+
+// Folds a file's path and contents into the hash.
+static u64 hash_view(const char* pPath, const FileView& view, u64 hash)
+{
+	hash = hash_bytes(pPath, strlen(pPath) + 1, hash);
+	hash = hash_bytes(view.pData, view.size, hash);
+	return hash_bytes(&view.size, sizeof(view.size), hash);
+}
+
+// Resolves #include through the asset packs so shaders don't need to be loose on disk.
+// Includes are looked up relative to the directory of the file being compiled.
+// Every file is folded into the cache key as it's served, so the key is of
+// the bytes the compiler read even if a file is saved again before it finishes.
+class AssetInclude : public ID3DInclude
+{
+public:
+	// key is the hash so far, of the entry and the source.
+	AssetInclude(const char* pRootFile, u64 key)
+		: m_key(key)
+	{
+		const char* pSlash = strrchr(pRootFile, '/');
+		const char* pBackSlash = strrchr(pRootFile, '\\');
+		if (pBackSlash > pSlash) pSlash = pBackSlash;
+		if (pSlash)
+		{
+			m_directory.assign(pRootFile, pSlash + 1);
+		}
+	}
+
+	HRESULT __stdcall Open(D3D_INCLUDE_TYPE /*IncludeType*/, LPCSTR pFileName, LPCVOID /*pParentData*/, LPCVOID* ppData, UINT* pBytes) override
+	{
+		const std::string path = m_directory + pFileName;
+
+		FileView* pView = new FileView();
+		if (!open_asset(path.c_str(), *pView, 1, 0))
+		{
+			delete pView;
+			return E_FAIL;
+		}
+
+		// Keyed on the first open, the order lookups hash the includes in. A file
+		// that changed between two opens gave the compiler both versions, and
+		// no key stands for that.
+		const u64 contents = hash_bytes(pView->pData, pView->size);
+		auto it = std::find(m_includes.begin(), m_includes.end(), path);
+		if (it == m_includes.end())
+		{
+			m_includes.push_back(path);
+			m_contents.push_back(contents);
+			m_key = hash_view(path.c_str(), *pView, m_key);
+		}
+		else if (m_contents[it - m_includes.begin()] != contents)
+		{
+			m_bConsistent = false;
+		}
+
+		m_openViews.push_back(pView);
+		*ppData = pView->pData;
+		*pBytes = static_cast<UINT>(pView->size);
+		return S_OK;
+	}
+
+	HRESULT __stdcall Close(LPCVOID pData) override
+	{
+		for (auto it = m_openViews.begin(); it != m_openViews.end(); ++it)
+		{
+			if ((*it)->pData == pData)
+			{
+				close_asset(**it);
+				delete *it;
+				m_openViews.erase(it);
+				return S_OK;
+			}
+		}
+		return E_FAIL;
+	}
+
+	~AssetInclude()
+	{
+		for (FileView* pView : m_openViews)
+		{
+			close_asset(*pView);
+			delete pView;
+		}
+	}
+
+	const std::vector<std::string>& includes() const { return m_includes; }
+
+	// Cache key of what was compiled, 0 if an include changed during the compile.
+	u64 key() const { return m_bConsistent ? nonzero_key(m_key) : 0; }
+
+	// 0 is kept for entries that must not be found again.
+	static u64 nonzero_key(u64 key) { return key ? key : 1; }
+
+private:
+	std::string m_directory;
+	std::vector<FileView*> m_openViews;
+	std::vector<std::string> m_includes;
+	std::vector<u64> m_contents;	// Hash of each include's bytes when first opened.
+	u64 m_key;
+	bool m_bConsistent = true;
+};
+
+// A compiled entry point and what it was built from.
+struct ShaderCacheEntry
+{
+	u64 key;
+	std::vector<std::string> includes;
+	ComPtr<ID3DBlob> pBytecode;
+};
+
+static std::mutex s_mutex;
+static std::unordered_map<u64, ShaderCacheEntry> s_entries;	// By name_hash().
+static ShaderCacheStats s_stats = {};
+static std::function<void(const char* pFilename)> s_compiledHook;
+
+u32 shader_compile_flags()
+{
+	UINT shaderFlags = D3DCOMPILE_ENABLE_STRICTNESS;
+
+	// Set the D3DCOMPILE_DEBUG flag to embed debug information in the shaders.
+	// Setting this flag improves the shader debugging experience, but still allows
+	// the shaders to be optimized and to run exactly the way they will run in
+	// the release configuration.
+#if defined(DEBUG) || defined(_DEBUG)
+	shaderFlags |= D3DCOMPILE_DEBUG;
+#endif // DEBUG
+
+	return shaderFlags;
+}
+
+// Identifies the entry, everything except the file contents.
+static u64 name_hash(const char* pFilename, const char* pEntryPoint, const char* pProfile, const D3D_SHADER_MACRO* pMacros, u32 flags)
+{
+	// Hash the terminators too so "ab"+"c" and "a"+"bc" differ.
+	u64 hash = hash_bytes(pFilename, strlen(pFilename) + 1);
+	hash = hash_bytes(pEntryPoint, strlen(pEntryPoint) + 1, hash);
+	hash = hash_bytes(pProfile, strlen(pProfile) + 1, hash);
+	for (const D3D_SHADER_MACRO* pMacro = pMacros; pMacro && pMacro->Name; ++pMacro)
+	{
+		const char* pValue = pMacro->Definition ? pMacro->Definition : "";
+		hash = hash_bytes(pMacro->Name, strlen(pMacro->Name) + 1, hash);
+		hash = hash_bytes(pValue, strlen(pValue) + 1, hash);
+	}
+	return hash_bytes(&flags, sizeof(flags), hash);
+}
+
+// Folds a file's contents into the hash, a missing file hashes differently from an empty one.
+static u64 hash_file(const char* pPath, u64 hash)
+{
+	FileView view;
+	if (!open_asset(pPath, view, 1, 0))
+	{
+		const u64 kMissing = ~0ull;
+		hash = hash_bytes(pPath, strlen(pPath) + 1, hash);
+		return hash_bytes(&kMissing, sizeof(kMissing), hash);
+	}
+	hash = hash_view(pPath, view, hash);
+	close_asset(view);
+	return hash;
+}
+
+// Start of every key, what the entry is and which compiler built it.
+static u64 key_seed(u64 nameHash)
+{
+	const u32 compilerVersion = D3D_COMPILER_VERSION;
+	const u64 hash = hash_bytes(&nameHash, sizeof(nameHash));
+	return hash_bytes(&compilerVersion, sizeof(compilerVersion), hash);
+}
+
+// Key for the entry as the files are now, given the includes it used last time.
+// Hashes the same way compile_entry() does as the compiler reads the files.
+static u64 content_key(u64 nameHash, const char* pFilename, const std::vector<std::string>& rIncludes)
+{
+	u64 hash = hash_file(pFilename, key_seed(nameHash));
+	for (const std::string& rInclude : rIncludes)
+	{
+		hash = hash_file(rInclude.c_str(), hash);
+	}
+	return AssetInclude::nonzero_key(hash);
+}
+
+static std::string cache_path(u64 nameHash)
+{
+	char fileName[32];
+	snprintf(fileName, sizeof(fileName), "%016llx.shc", static_cast<unsigned long long>(nameHash));
+	return std::string(s_cacheDirectory) + fileName;
+}
+
+// Load an entry from Cache/Shaders if it is still up to date.
+static bool load_entry(u64 nameHash, const char* pFilename, ShaderCacheEntry& rEntryOut)
+{
+	const std::string path = cache_path(nameHash);
+	FileView view;
+	if (!map_file(path.c_str(), view, 4, 0))
+	{
+		return false;
+	}
+
+	bool bValid = false;
+	ShaderCacheFileHeader header;
+	if (view.size >= sizeof(header))
+	{
+		memcpy(&header, view.pData, sizeof(header));
+		bValid = header.magic == kShaderCacheMagic
+			&& view.size == sizeof(header) + static_cast<u64>(header.includeBytes) + header.bytecodeSize;
+	}
+
+	if (bValid)
+	{
+		// Include paths, each null terminated.
+		const char* pNames = reinterpret_cast<const char*>(view.pData + sizeof(header));
+		const char* pNamesEnd = pNames + header.includeBytes;
+		rEntryOut.includes.clear();
+		while (pNames < pNamesEnd && rEntryOut.includes.size() < header.numIncludes)
+		{
+			const size_t length = strnlen(pNames, pNamesEnd - pNames);
+			rEntryOut.includes.emplace_back(pNames, length);
+			pNames += length + 1;
+		}
+
+		bValid = rEntryOut.includes.size() == header.numIncludes
+			&& content_key(nameHash, pFilename, rEntryOut.includes) == header.key
+			&& SUCCEEDED(D3DCreateBlob(header.bytecodeSize, rEntryOut.pBytecode.ReleaseAndGetAddressOf()));
+	}
+
+	if (bValid)
+	{
+		memcpy(rEntryOut.pBytecode->GetBufferPointer(), view.pData + sizeof(header) + header.includeBytes, header.bytecodeSize);
+		rEntryOut.key = header.key;
+	}
+
+	unmap_file(view);
+	return bValid;
+}
+
+// Write an entry to Cache/Shaders, failures are reported but not fatal.
+static void store_entry(u64 nameHash, const ShaderCacheEntry& rEntry)
+{
+	std::string names;
+	for (const std::string& rInclude : rEntry.includes)
+	{
+		names.append(rInclude.c_str(), rInclude.size() + 1);
+	}
+
+	ShaderCacheFileHeader header = {};
+	header.magic = kShaderCacheMagic;
+	header.numIncludes = static_cast<u32>(rEntry.includes.size());
+	header.key = rEntry.key;
+	header.includeBytes = static_cast<u32>(names.size());
+	header.bytecodeSize = static_cast<u32>(rEntry.pBytecode->GetBufferSize());
+
+	CreateDirectoryA("Cache", nullptr);
+	CreateDirectoryA(s_cacheDirectory, nullptr);
+
+	// Write to a temporary and rename so a crash never leaves a half written entry.
+	// The temporary is unique per thread as two jobs may compile the same entry.
+	const std::string path = cache_path(nameHash);
+	const std::string tempPath = path + "." + std::to_string(GetCurrentThreadId()) + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(names.data(), names.size());
+		out.write(static_cast<const char*>(rEntry.pBytecode->GetBufferPointer()), header.bytecodeSize);
+		if (!out.good())
+		{
+			errorF("Shader cache : could not write %s", tempPath.c_str());
+			return;
+		}
+	}
+
+	if (!MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		errorF("Shader cache : could not replace %s", path.c_str());
+		DeleteFileA(tempPath.c_str());
+	}
+}
+
+// Fills the entry's key from the source and includes as the compiler read them,
+// the files may have been saved again by the time it returns.
+static bool compile_entry(u64 nameHash, const char* pFilename, const char* pEntryPoint, const char* pProfile, const D3D_SHADER_MACRO* pMacros,
+	u32 flags, ShaderCacheEntry& rEntryOut, std::string* pErrorsOut)
+{
+	// Compile from a view of the source (loose or from a pack), the file name is still passed for error messages.
+	FileView view;
+	if (!open_asset(pFilename, view, 1, 0))
+	{
+		if (pErrorsOut)
+		{
+			*pErrorsOut = "Failed to open shader '" + std::string(pFilename) + "'";
+		}
+		return false;
+	}
+
+	static const D3D_SHADER_MACRO s_noMacros[] = { { NULL, NULL } };
+
+	AssetInclude includeHandler(pFilename, hash_view(pFilename, view, key_seed(nameHash)));
+
+	ComPtr<ID3DBlob> pErrorBlob;
+	HRESULT hr = D3DCompile(view.pData, static_cast<SIZE_T>(view.size), pFilename, pMacros ? pMacros : s_noMacros, &includeHandler,
+		pEntryPoint, pProfile, flags, 0, rEntryOut.pBytecode.ReleaseAndGetAddressOf(), pErrorBlob.GetAddressOf());
+	close_asset(view);
+	if (FAILED(hr))
+	{
+		if (pErrorsOut)
+		{
+			*pErrorsOut = pErrorBlob ? static_cast<const char*>(pErrorBlob->GetBufferPointer()) : "<no info>";
+		}
+		return false;
+	}
+
+	rEntryOut.includes = includeHandler.includes();
+	rEntryOut.key = includeHandler.key();
+
+	if (s_compiledHook)
+	{
+		s_compiledHook(pFilename);
+	}
+	return true;
+}
+
+bool shader_cache_compile(const char* pFilename, const char* pEntryPoint, const char* pProfile, const D3D_SHADER_MACRO* pMacros,
+	ID3DBlob** ppBlobOut, std::string* pErrorsOut)
+{
+	const u32 flags = shader_compile_flags();
+	const u64 nameHash = name_hash(pFilename, pEntryPoint, pProfile, pMacros, flags);
+
+	// Memory, checked against the files as they are now.
+	ShaderCacheEntry entry;
+	bool bFound = false;
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		auto it = s_entries.find(nameHash);
+		if (it != s_entries.end())
+		{
+			entry = it->second;
+			bFound = true;
+		}
+	}
+	if (bFound && content_key(nameHash, pFilename, entry.includes) == entry.key)
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		++s_stats.memoryHits;
+		*ppBlobOut = entry.pBytecode.Detach();
+		return true;
+	}
+
+	// Disk.
+	if (load_entry(nameHash, pFilename, entry))
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		++s_stats.diskHits;
+		s_entries[nameHash] = entry;
+		*ppBlobOut = entry.pBytecode.Detach();
+		return true;
+	}
+
+	// Compiler.
+	const auto start = std::chrono::high_resolution_clock::now();
+	if (!compile_entry(nameHash, pFilename, pEntryPoint, pProfile, pMacros, flags, entry, pErrorsOut))
+	{
+		return false;
+	}
+	const f64 compileMs = std::chrono::duration<f64, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// Kept in memory for shader_cache_dependencies() even when the key is 0, which no lookup matches.
+	if (entry.key)
+	{
+		store_entry(nameHash, entry);
+	}
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		++s_stats.compiles;
+		s_stats.compileMs += compileMs;
+		s_entries[nameHash] = entry;
+	}
+	*ppBlobOut = entry.pBytecode.Detach();
+	return true;
+}
+
+bool shader_cache_precompile(const ShaderSetDesc& desc)
+{
+	bool bOk = true;
+	std::vector<D3D_SHADER_MACRO> macros;
+	const u32 numVariants = shader_variant_count(desc);
+	for (u32 variant = 0; variant < numVariants; ++variant)
+	{
+		shader_variant_macros(desc, variant, macros);
+		for (u32 i = 0; i < ShaderStage::kMaxStages; ++i)
+		{
+			if (!desc.entryPoints[i])
+			{
+				continue;
+			}
+
+			ComPtr<ID3DBlob> pBlob;
+			std::string errors;
+			if (!shader_cache_compile(desc.filename, desc.entryPoints[i], shader_stage_profile(static_cast<ShaderStage::ShaderStageEnum>(i)),
+				macros.data(), pBlob.GetAddressOf(), &errors))
+			{
+				errorF("%s(%s) variant %u : %s", desc.filename, desc.entryPoints[i], variant, errors.c_str());
+				bOk = false;
+			}
+		}
+	}
+	return bOk;
+}
+
+void shader_cache_dependencies(const char* pFilename, const char* pEntryPoint, const char* pProfile, const D3D_SHADER_MACRO* pMacros,
+	std::vector<std::string>& rFilesOut)
+{
+	const u64 nameHash = name_hash(pFilename, pEntryPoint, pProfile, pMacros, shader_compile_flags());
+
+	rFilesOut.push_back(pFilename);
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	auto it = s_entries.find(nameHash);
+	if (it != s_entries.end())
+	{
+		rFilesOut.insert(rFilesOut.end(), it->second.includes.begin(), it->second.includes.end());
+	}
+}
+
+void shader_cache_set_compiled_hook(std::function<void(const char* pFilename)> hook)
+{
+	s_compiledHook = std::move(hook);
+}
+
+ShaderCacheStats shader_cache_stats()
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	return s_stats;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "CommonHeader.h"
+#include "ShaderSet.h"
+
+#include <d3dcompiler.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+//================================================================================
+// Shader cache.
+// Compiled bytecode is kept in memory and written under Cache/Shaders, so an
+// entry point is compiled once per change rather than on every launch.
+// Entries are keyed by a hash of the source, every file it includes, the
+// macros, the entry point, the profile and the compile flags. The include
+// list is stored with each entry so an edited include is noticed without
+// running the preprocessor; a lookup only hashes files that are already
+// mapped, which is far cheaper than D3DCompile. A compile keys its entry by
+// the bytes the compiler read, a file saved again meanwhile doesn't match.
+//
+// Thread safe, shaders can be compiled from jobs.
+//================================================================================
+
+struct ShaderCacheStats
+{
+	u32 memoryHits;	// Found in memory.
+	u32 diskHits;	// Loaded from Cache/Shaders.
+	u32 compiles;	// Had to run the compiler.
+	f64 compileMs;	// Time spent compiling.
+};
+
+// Flags every shader is compiled with, part of the key.
+u32 shader_compile_flags();
+
+// Bytecode for one entry point, from memory, then disk, then the compiler.
+// pMacros is null or ends with a null name. On failure returns false and
+// fills pErrorsOut (if set) with the compiler output.
+bool shader_cache_compile(const char* pFilename, const char* pEntryPoint, const char* pProfile, const D3D_SHADER_MACRO* pMacros,
+	ID3DBlob** ppBlobOut, std::string* pErrorsOut = nullptr);
+
+// Compile every stage of every variant of a set into the cache without creating any shaders.
+// Used by the build time precompile so the first launch doesn't compile either.
+bool shader_cache_precompile(const ShaderSetDesc& desc);
+
+// Appends the source and every file it included, as of the last compile or load of the
+// entry. Only the source if it hasn't been compiled, e.g. because the source failed to compile.
+void shader_cache_dependencies(const char* pFilename, const char* pEntryPoint, const char* pProfile, const D3D_SHADER_MACRO* pMacros,
+	std::vector<std::string>& rFilesOut);
+
+ShaderCacheStats shader_cache_stats();
+
+// Called on the compiling thread once the compiler has read the files, before
+// the entry is stored. For checks that save a file mid-compile, null to clear.
+// Set it while nothing compiles.
+void shader_cache_set_compiled_hook(std::function<void(const char* pFilename)> hook);
@@ -0,0 +1,99 @@
+#include "ShaderPermutations.h"
+#include "ShaderReloader.h"
+
+const char* ShaderPermutations::own(const char* pString)
+{
+	if (!pString)
+	{
+		return nullptr;
+	}
+	m_strings.emplace_back(pString);
+	return m_strings.back().c_str();
+}
+
+void ShaderPermutations::init(ID3D11Device* pDevice, const ShaderSetDesc& desc, const ShaderSet::InputLayoutDesc& layout)
+{
+	ASSERT(m_sets.empty());	// The sets may be watched, they can't move.
+
+	m_desc = desc;
+	m_layout = layout;
+	m_desc.filename = own(desc.filename);
+	for (u32 i = 0; i < ShaderStage::kMaxStages; ++i)
+	{
+		m_desc.entryPoints[i] = own(desc.entryPoints[i]);
+	}
+
+	for (const D3D_SHADER_MACRO* pMacro = desc.macros; pMacro && pMacro->Name; ++pMacro)
+	{
+		m_macros.push_back({ own(pMacro->Name), own(pMacro->Definition) });
+	}
+	m_macros.push_back({ nullptr, nullptr });
+	m_desc.macros = m_macros.data();
+
+	for (u32 i = 0; i < desc.numAxes; ++i)
+	{
+		const ShaderAxis& rAxis = desc.axes[i];
+		for (u32 value = 0; value < rAxis.numValues; ++value)
+		{
+			m_values[i].push_back(own(rAxis.values[value]));
+		}
+		m_desc.axes[i] = { own(rAxis.name), m_values[i].data(), rAxis.numValues };
+	}
+
+	// Each variant is an ordinary set with its axis values as fixed macros.
+	m_sets.resize(shader_variant_count(m_desc));
+
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (u32 variant = 0; variant < m_sets.size(); ++variant)
+	{
+		shader_variant_macros(m_desc, variant, macros);
+
+		ShaderSetDesc variantDesc = m_desc;
+		variantDesc.macros = macros.data();
+		variantDesc.numAxes = 0;
+		m_sets[variant].init(pDevice, variantDesc, layout);
+	}
+}
+
+void ShaderPermutations::watch(ShaderReloader& rReloader)
+{
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (u32 variant = 0; variant < m_sets.size(); ++variant)
+	{
+		shader_variant_macros(m_desc, variant, macros);
+
+		ShaderSetDesc variantDesc = m_desc;
+		variantDesc.macros = macros.data();
+		variantDesc.numAxes = 0;
+		rReloader.watch(m_sets[variant], variantDesc, m_layout);
+	}
+}
+
+u32 ShaderPermutations::find_value(u32 axis, const char* pValue) const
+{
+	ASSERT(axis < m_desc.numAxes);
+
+	const ShaderAxis& rAxis = m_desc.axes[axis];
+	for (u32 i = 0; i < rAxis.numValues; ++i)
+	{
+		if (strcmp(rAxis.values[i], pValue) == 0)
+		{
+			return i;
+		}
+	}
+	return kInvalidIndex;
+}
+
+u32 ShaderPermutations::variant(const u32* pValueIndices) const
+{
+	// Mixed radix, the first axis varies fastest to match shader_variant_macros.
+	u32 index = 0;
+	u32 stride = 1;
+	for (u32 i = 0; i < m_desc.numAxes; ++i)
+	{
+		ASSERT(pValueIndices[i] < m_desc.axes[i].numValues);
+		index += pValueIndices[i] * stride;
+		stride *= m_desc.axes[i].numValues;
+	}
+	return index;
+}
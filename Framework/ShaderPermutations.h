@@ -0,0 +1,63 @@
+#pragma once
+
+#include "CommonHeader.h"
+#include "ShaderSet.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+class ShaderReloader;
+
+//================================================================================
+// ShaderPermutations
+// Every variant of a ShaderSetDesc with axes, e.g. MAT_SIZE x ALGORITHM.
+// Each combination is compiled with its values defined as macros, so the
+// shader can pick code with #if instead of branching on constants per pixel.
+// All variants are created up front (through the shader cache, so normally
+// a lookup per variant) and switching is an index into an array.
+//================================================================================
+class ShaderPermutations
+{
+public:
+	static const u32 kInvalidIndex = ~0u;
+
+	ShaderPermutations() {}
+
+	// Panics if a variant fails to build, like ShaderSet::init.
+	// The desc is copied, its strings don't have to outlive the call.
+	void init(ID3D11Device* pDevice, const ShaderSetDesc& desc, const ShaderSet::InputLayoutDesc& layout);
+
+	// Hot reload every variant, the sets keep their addresses.
+	void watch(ShaderReloader& rReloader);
+
+	u32 num_axes() const { return m_desc.numAxes; }
+	u32 num_variants() const { return static_cast<u32>(m_sets.size()); }
+
+	// Position of a value in its axis, kInvalidIndex if the axis doesn't have it.
+	// Look values up once, not per frame.
+	u32 find_value(u32 axis, const char* pValue) const;
+
+	// Variant for one value index per axis, in the order the axes were added.
+	u32 variant(const u32* pValueIndices) const;
+
+	ShaderSet& get(u32 variant) { return m_sets[variant]; }
+	const ShaderSet& get(u32 variant) const { return m_sets[variant]; }
+
+	const ShaderSetDesc& desc() const { return m_desc; }
+
+private:
+	ShaderPermutations(const ShaderPermutations&) = delete;
+	ShaderPermutations& operator=(const ShaderPermutations&) = delete;
+
+	const char* own(const char* pString);
+
+	// Copy of the desc pointing into m_strings and m_values.
+	std::deque<std::string> m_strings;
+	std::vector<D3D_SHADER_MACRO> m_macros;
+	std::vector<const char*> m_values[ShaderSetDesc::kMaxAxes];
+	ShaderSetDesc m_desc = {};
+
+	ShaderSet::InputLayoutDesc m_layout;
+	std::vector<ShaderSet> m_sets;
+};
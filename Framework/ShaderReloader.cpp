@@ -0,0 +1,134 @@
+#include "ShaderReloader.h"
+#include "ShaderCache.h"
+
+ShaderReloader::ShaderReloader()
+{
+}
+
+ShaderReloader::~ShaderReloader()
+{
+}
+
+void ShaderReloader::init(ID3D11Device* pDevice, JobPool* pJobPool)
+{
+	m_pDevice = pDevice;
+	m_reload.init(pJobPool);
+}
+
+ShaderReloader::Watched& ShaderReloader::find(const ShaderSet& rShaders) const
+{
+	for (const std::unique_ptr<Watched>& rpWatched : m_watched)
+	{
+		if (rpWatched->pTarget == &rShaders)
+		{
+			return *rpWatched;
+		}
+	}
+	panicF("ShaderReloader : set is not watched");
+	return *m_watched.front();
+}
+
+HotReload::CompileFn ShaderReloader::make_compile(Watched& rWatched, const ShaderSetDesc& desc)
+{
+	// The caller's strings may be temporaries.
+	Desc owned;
+	owned.filename = desc.filename;
+	for (u32 i = 0; i < ShaderStage::kMaxStages; ++i)
+	{
+		owned.entryPoints[i] = desc.entryPoints[i] ? desc.entryPoints[i] : "";
+	}
+	for (const D3D_SHADER_MACRO* pMacro = desc.macros; pMacro && pMacro->Name; ++pMacro)
+	{
+		owned.macros.emplace_back(pMacro->Name, pMacro->Definition ? pMacro->Definition : "");
+	}
+
+	ID3D11Device* pDevice = m_pDevice;
+	Watched* pWatched = &rWatched;
+	return [pDevice, pWatched, owned](std::vector<std::string>& rFilesOut, std::string& rErrorsOut)
+	{
+		ShaderSetDesc desc = {};
+		desc.filename = owned.filename.c_str();
+		for (u32 i = 0; i < ShaderStage::kMaxStages; ++i)
+		{
+			desc.entryPoints[i] = owned.entryPoints[i].empty() ? nullptr : owned.entryPoints[i].c_str();
+		}
+		std::vector<D3D_SHADER_MACRO> macros;
+		for (const auto& rMacro : owned.macros)
+		{
+			macros.push_back({ rMacro.first.c_str(), rMacro.second.c_str() });
+		}
+		macros.push_back({ nullptr, nullptr });
+		desc.macros = macros.data();
+
+		// Into staging, the render thread may be drawing with the target.
+		const bool bOk = pWatched->staging.create(pDevice, desc, pWatched->layout, &rErrorsOut);
+
+		for (u32 i = 0; i < ShaderStage::kMaxStages; ++i)
+		{
+			if (desc.entryPoints[i])
+			{
+				shader_cache_dependencies(desc.filename, desc.entryPoints[i], shader_stage_profile(static_cast<ShaderStage::ShaderStageEnum>(i)),
+					desc.macros, rFilesOut);
+			}
+		}
+		std::sort(rFilesOut.begin(), rFilesOut.end());
+		rFilesOut.erase(std::unique(rFilesOut.begin(), rFilesOut.end()), rFilesOut.end());
+		return bOk;
+	};
+}
+
+void ShaderReloader::watch(ShaderSet& rShaders, const ShaderSetDesc& desc, const ShaderSet::InputLayoutDesc& layout)
+{
+	ASSERT(desc.numAxes == 0);	// One variant, see ShaderPermutations::watch.
+
+	std::unique_ptr<Watched> pWatched(new Watched());
+	pWatched->pTarget = &rShaders;
+	pWatched->layout = layout;
+
+	Watched* pRaw = pWatched.get();
+	pWatched->handle = m_reload.add(make_compile(*pWatched, desc), [pRaw](bool bOk, const std::string& rErrors)
+	{
+		if (bOk)
+		{
+			*pRaw->pTarget = std::move(pRaw->staging);
+			pRaw->errors.clear();
+		}
+		else
+		{
+			errorF("%s", rErrors.c_str());
+			pRaw->errors = rErrors;
+		}
+	});
+	m_watched.push_back(std::move(pWatched));
+}
+
+void ShaderReloader::change(ShaderSet& rShaders, const ShaderSetDesc& desc)
+{
+	ASSERT(desc.numAxes == 0);
+
+	Watched& rWatched = find(rShaders);
+	m_reload.set_compile(rWatched.handle, make_compile(rWatched, desc));
+}
+
+bool ShaderReloader::pending(const ShaderSet& rShaders) const
+{
+	return m_reload.busy(find(rShaders).handle);
+}
+
+void ShaderReloader::update()
+{
+	m_reload.update();
+}
+
+const std::string& ShaderReloader::last_error() const
+{
+	static const std::string s_none;
+	for (const std::unique_ptr<Watched>& rpWatched : m_watched)
+	{
+		if (!rpWatched->errors.empty())
+		{
+			return rpWatched->errors;
+		}
+	}
+	return s_none;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "CommonHeader.h"
+#include "ShaderSet.h"
+#include "HotReload.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class JobPool;
+
+//================================================================================
+// ShaderReloader
+// Keeps ShaderSets up to date with their source. Compiles run on the job pool
+// (through the shader cache) and the finished set is swapped in by update(),
+// so the render thread never waits on the compiler. A set that fails to
+// compile keeps its old shaders and the errors are printed.
+//
+// A watched ShaderSet is only written by update(), call it once a frame from
+// the thread that renders, before anything binds the sets.
+//================================================================================
+class ShaderReloader
+{
+public:
+	ShaderReloader();
+
+	// Waits for compiles in flight.
+	~ShaderReloader();
+
+	// The device is only used to create shaders, which is safe from the job pool.
+	void init(ID3D11Device* pDevice, JobPool* pJobPool);
+
+	// Recompile rShaders whenever its source or an include changes. rShaders must
+	// outlive the reloader; it is left as it is until the first compile finishes,
+	// so init() it first if it has to be usable straight away.
+	void watch(ShaderSet& rShaders, const ShaderSetDesc& desc, const ShaderSet::InputLayoutDesc& layout);
+
+	// Build a watched set from other entry points, e.g. to switch effect without a hitch.
+	// The old shaders stay bound until the new ones are ready.
+	void change(ShaderSet& rShaders, const ShaderSetDesc& desc);
+
+	// True from watch() or change() until the result has been swapped in.
+	bool pending(const ShaderSet& rShaders) const;
+
+	// Swap in finished sets and start compiles for changed files.
+	void update();
+
+	// Compiler output of a set whose last compile failed, empty if they all worked.
+	const std::string& last_error() const;
+
+	HotReload::Stats stats() const { return m_reload.stats(); }
+
+private:
+	// A ShaderSetDesc that owns its strings.
+	struct Desc
+	{
+		std::string filename;
+		std::string entryPoints[ShaderStage::kMaxStages];
+		std::vector<std::pair<std::string, std::string>> macros;
+	};
+
+	struct Watched
+	{
+		ShaderSet* pTarget;
+		ShaderSet::InputLayoutDesc layout;
+		ShaderSet staging;	// Written by the compile job, moved into pTarget by apply.
+		HotReload::Handle handle;
+		std::string errors;	// From the last compile, empty when it worked.
+	};
+
+	Watched& find(const ShaderSet& rShaders) const;
+	HotReload::CompileFn make_compile(Watched& rWatched, const ShaderSetDesc& desc);
+
+	ID3D11Device* m_pDevice = nullptr;
+	std::vector<std::unique_ptr<Watched>> m_watched;
+	HotReload m_reload;	// Declared last so it is destroyed first, waiting for jobs that write to m_watched.
+};
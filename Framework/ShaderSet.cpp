@@ -1,7 +1,8 @@
 #include "CommonHeader.h"
+#include "Framework.h"
 #include "ShaderSet.h"
-
-#include <d3dcompiler.h>
+#include "ShaderCache.h"
+#include "StateCache.h"
 
 
 // ========================================================
@@ -9,49 +10,86 @@
 // ========================================================
 
 
-void compileShaderFromFile(const char * fileName, const char * entryPoint, const char * shaderModel, ID3DBlob ** ppBlobOut)
+// Compute is 5.0 for typed UAV stores, it needs a feature level 11 device.
+const char* shader_stage_profile(ShaderStage::ShaderStageEnum stage)
 {
-	UINT shaderFlags = D3DCOMPILE_ENABLE_STRICTNESS;
-
-	// Set the D3DCOMPILE_DEBUG flag to embed debug information in the shaders.
-	// Setting this flag improves the shader debugging experience, but still allows
-	// the shaders to be optimized and to run exactly the way they will run in
-	// the release configuration.
-#if defined(DEBUG) || defined(_DEBUG)
-	shaderFlags |= D3DCOMPILE_DEBUG;
-#endif // DEBUG
+	static const char* s_profiles[ShaderStage::kMaxStages] = { "vs_4_0", "hs_4_0" ,"ds_4_0" ,"gs_4_0" ,"ps_4_0" ,"cs_5_0" };
+	return s_profiles[stage];
+}
 
-	wchar_t fileNameW[MAX_PATH];
-	size_t numChars;
-	mbstowcs_s(&numChars, fileNameW, MAX_PATH, fileName, MAX_PATH);
+u32 shader_variant_count(const ShaderSetDesc& desc)
+{
+	u32 count = 1;
+	for (u32 i = 0; i < desc.numAxes; ++i)
+	{
+		ASSERT(desc.axes[i].numValues > 0);
+		count *= desc.axes[i].numValues;
+	}
+	return count;
+}
 
-	D3D_SHADER_MACRO macros[] = { {NULL, NULL} };
+void shader_variant_macros(const ShaderSetDesc& desc, u32 variant, std::vector<D3D_SHADER_MACRO>& rMacrosOut)
+{
+	ASSERT(variant < shader_variant_count(desc));
 
-	ComPtr<ID3DBlob> pErrorBlob;
-	HRESULT hr = D3DCompileFromFile(fileNameW, macros, D3D_COMPILE_STANDARD_FILE_INCLUDE, entryPoint, shaderModel,
-		shaderFlags, 0, ppBlobOut, pErrorBlob.GetAddressOf());
-	if (FAILED(hr))
+	rMacrosOut.clear();
+	for (const D3D_SHADER_MACRO* pMacro = desc.macros; pMacro && pMacro->Name; ++pMacro)
 	{
-		auto * details = (pErrorBlob ? static_cast<const char *>(pErrorBlob->GetBufferPointer()) : "<no info>");
-		panicF("Failed to compile shader '%s'!\nError info:\n%s", fileName, details);
+		rMacrosOut.push_back(*pMacro);
 	}
+	for (u32 i = 0; i < desc.numAxes; ++i)
+	{
+		const ShaderAxis& rAxis = desc.axes[i];
+		rMacrosOut.push_back({ rAxis.name, rAxis.values[variant % rAxis.numValues] });
+		variant /= rAxis.numValues;
+	}
+	rMacrosOut.push_back({ nullptr, nullptr });
 }
 
-
 ShaderSet::ShaderSet()
 {
 }
 
 void ShaderSet::init(ID3D11Device* device, const ShaderSetDesc& desc, const InputLayoutDesc & layout)
 {
+	std::string errors;
+	if (!create(device, desc, layout, &errors))
+	{
+		panicF("%s", errors.c_str());
+	}
+}
+
+// Keeps the first error and returns false so callers can bail out in one line.
+static bool set_error(std::string* pErrorsOut, const std::string& error)
+{
+	if (pErrorsOut)
+	{
+		*pErrorsOut = error;
+	}
+	return false;
+}
+
+bool ShaderSet::create(ID3D11Device* device, const ShaderSetDesc& desc, const InputLayoutDesc & layout, std::string* pErrorsOut)
+{
+	ASSERT(desc.numAxes == 0);
+
 	ComPtr<ID3DBlob> blobs[ShaderStage::kMaxStages];
-	static const char* profiles[ShaderStage::kMaxStages] = { "vs_4_0", "hs_4_0" ,"ds_4_0" ,"gs_4_0" ,"ps_4_0" ,"cs_4_0" };
 
-	// Compile each stage we set an entry point for.
+	// Compile each stage we set an entry point for, bytecode comes from the
+	// shader cache and is only compiled when the source has changed.
 	for (u32 i = 0; i < ShaderStage::kMaxStages; ++i)
 	{
-		if (desc.entryPoints[i])
-			compileShaderFromFile(desc.filename, desc.entryPoints[i], profiles[i], blobs[i].GetAddressOf());
+		if (!desc.entryPoints[i])
+		{
+			continue;
+		}
+
+		std::string errors;
+		if (!shader_cache_compile(desc.filename, desc.entryPoints[i], shader_stage_profile(static_cast<ShaderStage::ShaderStageEnum>(i)),
+			desc.macros, blobs[i].GetAddressOf(), &errors))
+		{
+			return set_error(pErrorsOut, "Failed to compile shader '" + std::string(desc.filename) + "'!\nError info:\n" + errors);
+		}
 	}
 
 	// check we have either (compute) or (vertex + pixel)
@@ -60,77 +98,85 @@ void ShaderSet::init(ID3D11Device* device, const ShaderSetDesc& desc, const Inpu
 		|| (blobs[ShaderStage::kVertex] != nullptr && blobs[ShaderStage::kPixel] != nullptr)
 	);
 
+	// Built aside and moved in at the end, so a failure leaves this set as it was.
+	ShaderSet built;
 	HRESULT hr;
 
 	// Create the vertex shader:
 	if (blobs[ShaderStage::kVertex])
 	{
-		hr = device->CreateVertexShader(blobs[ShaderStage::kVertex]->GetBufferPointer(), blobs[ShaderStage::kVertex]->GetBufferSize(), nullptr, vs.GetAddressOf());
+		hr = device->CreateVertexShader(blobs[ShaderStage::kVertex]->GetBufferPointer(), blobs[ShaderStage::kVertex]->GetBufferSize(), nullptr, built.vs.GetAddressOf());
 		if (FAILED(hr))
 		{
-			panicF("Failed to create vertex shader");
+			return set_error(pErrorsOut, "Failed to create vertex shader");
 		}
 	}
 
 	// Create the hull shader:
 	if (blobs[ShaderStage::kHull])
 	{
-		hr = device->CreateHullShader(blobs[ShaderStage::kHull]->GetBufferPointer(), blobs[ShaderStage::kHull]->GetBufferSize(), nullptr, hs.GetAddressOf());
+		hr = device->CreateHullShader(blobs[ShaderStage::kHull]->GetBufferPointer(), blobs[ShaderStage::kHull]->GetBufferSize(), nullptr, built.hs.GetAddressOf());
 		if (FAILED(hr))
 		{
-			panicF("Failed to create hull shader");
+			return set_error(pErrorsOut, "Failed to create hull shader");
 		}
 	}
 
 	// Create the domain shader:
 	if (blobs[ShaderStage::kDomain])
 	{
-		hr = device->CreateDomainShader(blobs[ShaderStage::kDomain]->GetBufferPointer(), blobs[ShaderStage::kDomain]->GetBufferSize(), nullptr, ds.GetAddressOf());
+		hr = device->CreateDomainShader(blobs[ShaderStage::kDomain]->GetBufferPointer(), blobs[ShaderStage::kDomain]->GetBufferSize(), nullptr, built.ds.GetAddressOf());
 		if (FAILED(hr))
 		{
-			panicF("Failed to create hull shader");
+			return set_error(pErrorsOut, "Failed to create domain shader");
 		}
 	}
 
 	// Create the geometry shader:
 	if (blobs[ShaderStage::kGeometry])
 	{
-		hr = device->CreateGeometryShader(blobs[ShaderStage::kGeometry]->GetBufferPointer(), blobs[ShaderStage::kGeometry]->GetBufferSize(), nullptr, gs.GetAddressOf());
+		hr = device->CreateGeometryShader(blobs[ShaderStage::kGeometry]->GetBufferPointer(), blobs[ShaderStage::kGeometry]->GetBufferSize(), nullptr, built.gs.GetAddressOf());
 		if (FAILED(hr))
 		{
-			panicF("Failed to create geometry shader");
+			return set_error(pErrorsOut, "Failed to create geometry shader");
 		}
 	}
 
 	// Create the pixel shader:
 	if (blobs[ShaderStage::kPixel])
 	{
-		hr = device->CreatePixelShader(blobs[ShaderStage::kPixel]->GetBufferPointer(), blobs[ShaderStage::kPixel]->GetBufferSize(), nullptr, ps.GetAddressOf());
+		hr = device->CreatePixelShader(blobs[ShaderStage::kPixel]->GetBufferPointer(), blobs[ShaderStage::kPixel]->GetBufferSize(), nullptr, built.ps.GetAddressOf());
 		if (FAILED(hr))
 		{
-			panicF("Failed to create pixel shader");
+			return set_error(pErrorsOut, "Failed to create pixel shader");
 		}
 	}
 
 	// Create the compute shader:
 	if (blobs[ShaderStage::kCompute])
 	{
-		hr = device->CreateComputeShader(blobs[ShaderStage::kCompute]->GetBufferPointer(), blobs[ShaderStage::kCompute]->GetBufferSize(), nullptr, cs.GetAddressOf());
+		hr = device->CreateComputeShader(blobs[ShaderStage::kCompute]->GetBufferPointer(), blobs[ShaderStage::kCompute]->GetBufferSize(), nullptr, built.cs.GetAddressOf());
 		if (FAILED(hr))
 		{
-			panicF("Failed to create pixel shader");
+			return set_error(pErrorsOut, "Failed to create compute shader");
 		}
 	}
 
 	// Create vertex input layout:
-	hr = device->CreateInputLayout(std::get<0>(layout), std::get<1>(layout),
-		blobs[ShaderStage::kVertex]->GetBufferPointer(),
-		blobs[ShaderStage::kVertex]->GetBufferSize(),
-		inputLayout.GetAddressOf());
-	if (FAILED(hr))
+	if (blobs[ShaderStage::kVertex])
 	{
-		panicF("Failed to create vertex layout!");
+		hr = device->CreateInputLayout(std::get<0>(layout), std::get<1>(layout),
+			blobs[ShaderStage::kVertex]->GetBufferPointer(),
+			blobs[ShaderStage::kVertex]->GetBufferSize(),
+			built.inputLayout.GetAddressOf());
+		if (FAILED(hr))
+		{
+			return set_error(pErrorsOut, "Failed to create vertex layout!");
+		}
 	}
+
+	*this = std::move(built);
+	return true;
 }
 
 
@@ -205,3 +251,14 @@ void ShaderSet::bind(ID3D11DeviceContext* pContext) const
 
 }
 
+void ShaderSet::bind(StateCache& rCache) const
+{
+	// The input layout only means something with a vertex shader.
+	rCache.set_input_layout(vs ? inputLayout.Get() : NULL);
+	rCache.set_vertex_shader(vs.Get());
+	rCache.set_hull_shader(hs.Get());
+	rCache.set_domain_shader(ds.Get());
+	rCache.set_geometry_shader(gs.Get());
+	rCache.set_pixel_shader(ps.Get());
+	rCache.set_compute_shader(cs.Get());
+}
@@ -1,33 +1,39 @@
 #pragma once
 
-// ========================================================
-// Shader stage enum
-// ========================================================
-namespace ShaderStage
-{
-	enum ShaderStageEnum
-	{
-		kVertex,
-		kHull,
-		kDomain,
-		kGeometry,
-		kPixel,
-		kCompute,
-
-		kMaxStages
-	};
-}
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "ShaderStage.h"
+
+// Shader model each stage is compiled for, e.g. "ps_4_0".
+const char* shader_stage_profile(ShaderStage::ShaderStageEnum stage);
 
 // ========================================================
 // ShaderSet
 // ========================================================
 
+// One compile time switch: a macro and the values it can take.
+// Each combination of axis values is a separate variant of the shaders.
+struct ShaderAxis
+{
+	const char* name;
+	const char* const* values;
+	u32 numValues;
+};
+
 // Describes the entry points for a given set of shaders
 // Fill in the filename then multiple entry points.
+// Macros are defined for every variant, axes are expanded by ShaderPermutations.
 struct ShaderSetDesc
 {
+	static const u32 kMaxAxes = 4;
+
 	const char* filename;
 	const char* entryPoints[ShaderStage::kMaxStages];
+	const D3D_SHADER_MACRO* macros;	// Null, or ends with a null name.
+	ShaderAxis axes[kMaxAxes];
+	u32 numAxes;
 
 	static ShaderSetDesc Create_VS_PS(const char* fName, const char* vsEntry, const char* psEntry)
 	{
@@ -37,16 +43,50 @@ struct ShaderSetDesc
 		desc.entryPoints[ShaderStage::kPixel] = psEntry;
 		return desc;
 	}
+
+	static ShaderSetDesc Create_CS(const char* fName, const char* csEntry)
+	{
+		ShaderSetDesc desc = {};
+		desc.filename = fName;
+		desc.entryPoints[ShaderStage::kCompute] = csEntry;
+		return desc;
+	}
+
+	// The values must outlive the desc, string literals in a static array are typical.
+	template<u32 kNumValues>
+	ShaderSetDesc& add_axis(const char* pName, const char* const (&values)[kNumValues])
+	{
+		ASSERT(numAxes < kMaxAxes);
+		axes[numAxes++] = { pName, values, kNumValues };
+		return *this;
+	}
 };
 
+// Number of variants the axes of a desc describe, 1 without axes.
+u32 shader_variant_count(const ShaderSetDesc& desc);
+
+// Defines for one variant: desc.macros followed by one value per axis, null terminated.
+// Variants are numbered with the first axis varying fastest.
+void shader_variant_macros(const ShaderSetDesc& desc, u32 variant, std::vector<D3D_SHADER_MACRO>& rMacrosOut);
+
+class StateCache;
+
 struct ShaderSet
 {
 	using InputLayoutDesc = std::tuple<const D3D11_INPUT_ELEMENT_DESC *, int>;
 	ShaderSet();
 	void init(ID3D11Device* device, const ShaderSetDesc& desc, const InputLayoutDesc & layout);
 
+	// Compiles with desc.macros, a desc with axes goes through ShaderPermutations instead.
+	// As init() without panicking, returns false with the compiler output and leaves the set unchanged.
+	// Only needs the device, not a context, so it can run on a job.
+	bool create(ID3D11Device* device, const ShaderSetDesc& desc, const InputLayoutDesc & layout, std::string* pErrorsOut);
+
 	void bind(ID3D11DeviceContext* pContext) const;
 
+	// As above through a state cache, stages that are already set are skipped.
+	void bind(StateCache& rCache) const;
+
 	ComPtr<ID3D11InputLayout>  inputLayout;
 	ComPtr<ID3D11VertexShader> vs;
 	ComPtr<ID3D11HullShader> hs;
@@ -0,0 +1,19 @@
+#pragma once
+
+// ========================================================
+// Shader stage enum
+// ========================================================
+namespace ShaderStage
+{
+	enum ShaderStageEnum
+	{
+		kVertex,
+		kHull,
+		kDomain,
+		kGeometry,
+		kPixel,
+		kCompute,
+
+		kMaxStages
+	};
+}
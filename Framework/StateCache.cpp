@@ -0,0 +1,229 @@
+#include "StateCache.h"
+
+const char* pipeline_state_name(PipelineStateKind kind)
+{
+	static const char* s_names[kNumPipelineStateKinds] =
+	{
+		"VS", "HS", "DS", "GS", "PS", "CS",
+		"Input layout", "Topology", "Vertex buffers", "Index buffer",
+		"Blend", "Rasterizer", "Depth stencil",
+	};
+	return kind < kNumPipelineStateKinds ? s_names[kind] : "Unknown";
+}
+
+u32 RecordingPipelineDevice::total_calls() const
+{
+	u32 total = 0;
+	for (u32 count : m_calls)
+	{
+		total += count;
+	}
+	return total;
+}
+
+u32 StateCache::Stats::total_sent() const
+{
+	u32 total = 0;
+	for (u32 count : sent)
+	{
+		total += count;
+	}
+	return total;
+}
+
+u32 StateCache::Stats::total_skipped() const
+{
+	u32 total = 0;
+	for (u32 count : skipped)
+	{
+		total += count;
+	}
+	return total;
+}
+
+StateCache::StateCache()
+{
+	invalidate();
+}
+
+void StateCache::init(PipelineDevice* pDevice)
+{
+	m_pDevice = pDevice;
+	invalidate();
+}
+
+void StateCache::invalidate()
+{
+	memset(m_known, 0, sizeof(m_known));
+	m_knownVertexSlots = 0;
+}
+
+bool StateCache::filter(PipelineStateKind kind, bool bSame)
+{
+	ASSERT(m_pDevice);
+
+	if (bSame && m_known[kind])
+	{
+		++m_stats.skipped[kind];
+		return false;
+	}
+	m_known[kind] = true;
+	++m_stats.sent[kind];
+	return true;
+}
+
+void StateCache::set_vertex_shader(ID3D11VertexShader* pShader)
+{
+	if (filter(kStateVertexShader, pShader == m_pVertexShader))
+	{
+		m_pVertexShader = pShader;
+		m_pDevice->set_vertex_shader(pShader);
+	}
+}
+
+void StateCache::set_hull_shader(ID3D11HullShader* pShader)
+{
+	if (filter(kStateHullShader, pShader == m_pHullShader))
+	{
+		m_pHullShader = pShader;
+		m_pDevice->set_hull_shader(pShader);
+	}
+}
+
+void StateCache::set_domain_shader(ID3D11DomainShader* pShader)
+{
+	if (filter(kStateDomainShader, pShader == m_pDomainShader))
+	{
+		m_pDomainShader = pShader;
+		m_pDevice->set_domain_shader(pShader);
+	}
+}
+
+void StateCache::set_geometry_shader(ID3D11GeometryShader* pShader)
+{
+	if (filter(kStateGeometryShader, pShader == m_pGeometryShader))
+	{
+		m_pGeometryShader = pShader;
+		m_pDevice->set_geometry_shader(pShader);
+	}
+}
+
+void StateCache::set_pixel_shader(ID3D11PixelShader* pShader)
+{
+	if (filter(kStatePixelShader, pShader == m_pPixelShader))
+	{
+		m_pPixelShader = pShader;
+		m_pDevice->set_pixel_shader(pShader);
+	}
+}
+
+void StateCache::set_compute_shader(ID3D11ComputeShader* pShader)
+{
+	if (filter(kStateComputeShader, pShader == m_pComputeShader))
+	{
+		m_pComputeShader = pShader;
+		m_pDevice->set_compute_shader(pShader);
+	}
+}
+
+void StateCache::set_input_layout(ID3D11InputLayout* pLayout)
+{
+	if (filter(kStateInputLayout, pLayout == m_pInputLayout))
+	{
+		m_pInputLayout = pLayout;
+		m_pDevice->set_input_layout(pLayout);
+	}
+}
+
+void StateCache::set_topology(PrimitiveTopology topology)
+{
+	if (filter(kStateTopology, topology == m_topology))
+	{
+		m_topology = topology;
+		m_pDevice->set_topology(topology);
+	}
+}
+
+void StateCache::set_vertex_buffers(u32 startSlot, u32 count, ID3D11Buffer* const* ppBuffers, const u32* pStrides, const u32* pOffsets)
+{
+	ASSERT(startSlot + count <= kMaxVertexBuffers);
+
+	// Only the slots that differ are sent, as one ranged call.
+	auto same = [&](u32 slot)
+	{
+		const u32 i = slot - startSlot;
+		return (m_knownVertexSlots & (1u << slot)) && m_vertexBuffers[slot] == ppBuffers[i]
+			&& m_vertexStrides[slot] == pStrides[i] && m_vertexOffsets[slot] == pOffsets[i];
+	};
+
+	u32 begin = startSlot;
+	u32 end = startSlot + count;
+	while (begin < end && same(begin))
+	{
+		++begin;
+	}
+	while (end > begin && same(end - 1))
+	{
+		--end;
+	}
+
+	if (!filter(kStateVertexBuffers, begin == end))
+	{
+		return;
+	}
+
+	const u32 first = begin - startSlot;
+	for (u32 slot = begin; slot < end; ++slot)
+	{
+		m_vertexBuffers[slot] = ppBuffers[slot - startSlot];
+		m_vertexStrides[slot] = pStrides[slot - startSlot];
+		m_vertexOffsets[slot] = pOffsets[slot - startSlot];
+		m_knownVertexSlots |= 1u << slot;
+	}
+	m_pDevice->set_vertex_buffers(begin, end - begin, ppBuffers + first, pStrides + first, pOffsets + first);
+}
+
+void StateCache::set_index_buffer(ID3D11Buffer* pBuffer, DXGI_FORMAT format, u32 offset)
+{
+	if (filter(kStateIndexBuffer, pBuffer == m_pIndexBuffer && format == m_indexFormat && offset == m_indexOffset))
+	{
+		m_pIndexBuffer = pBuffer;
+		m_indexFormat = format;
+		m_indexOffset = offset;
+		m_pDevice->set_index_buffer(pBuffer, format, offset);
+	}
+}
+
+void StateCache::set_blend_state(ID3D11BlendState* pState, const f32 blendFactor[4], u32 sampleMask)
+{
+	// Null means all ones, the same as D3D11.
+	static const f32 s_ones[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	const f32* pFactor = blendFactor ? blendFactor : s_ones;
+
+	if (filter(kStateBlend, pState == m_pBlendState && memcmp(pFactor, m_blendFactor, sizeof(m_blendFactor)) == 0 && sampleMask == m_sampleMask))
+	{
+		m_pBlendState = pState;
+		memcpy(m_blendFactor, pFactor, sizeof(m_blendFactor));
+		m_sampleMask = sampleMask;
+		m_pDevice->set_blend_state(pState, m_blendFactor, sampleMask);
+	}
+}
+
+void StateCache::set_rasterizer_state(ID3D11RasterizerState* pState)
+{
+	if (filter(kStateRasterizer, pState == m_pRasterizerState))
+	{
+		m_pRasterizerState = pState;
+		m_pDevice->set_rasterizer_state(pState);
+	}
+}
+
+void StateCache::set_depth_stencil_state(ID3D11DepthStencilState* pState, u32 stencilRef)
+{
+	if (filter(kStateDepthStencil, pState == m_pDepthStencilState && stencilRef == m_stencilRef))
+	{
+		m_pDepthStencilState = pState;
+		m_stencilRef = stencilRef;
+		m_pDevice->set_depth_stencil_state(pState, stencilRef);
+	}
+}
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "CoreTypes.h"
+#include "DxgiFormat.h"
+
+//================================================================================
+// StateCache
+// Sits in front of the device context and drops calls that would set
+// pipeline state to what it already is: shaders, input layout, topology,
+// vertex and index buffers, blend, rasterizer and depth stencil state.
+// Counts what was sent and what was skipped.
+//
+// Platform independent, the calls that get through go to a PipelineDevice.
+// D3D11PipelineDevice forwards to a device context, RecordingPipelineDevice
+// just counts, so the filtering can be checked without D3D.
+//
+// Anything that sets state behind the cache's back must be followed by invalidate().
+//================================================================================
+
+// Only pointers to these are used here.
+struct ID3D11VertexShader;
+struct ID3D11HullShader;
+struct ID3D11DomainShader;
+struct ID3D11GeometryShader;
+struct ID3D11PixelShader;
+struct ID3D11ComputeShader;
+struct ID3D11InputLayout;
+struct ID3D11Buffer;
+struct ID3D11BlendState;
+struct ID3D11RasterizerState;
+struct ID3D11DepthStencilState;
+
+// Values match D3D11_PRIMITIVE_TOPOLOGY.
+enum PrimitiveTopology : u32
+{
+	kTopologyUndefined = 0,
+	kTopologyPointList = 1,
+	kTopologyLineList = 2,
+	kTopologyLineStrip = 3,
+	kTopologyTriangleList = 4,
+	kTopologyTriangleStrip = 5,
+};
+
+// The groups of state the cache tracks, used to index the counters.
+enum PipelineStateKind : u32
+{
+	kStateVertexShader,
+	kStateHullShader,
+	kStateDomainShader,
+	kStateGeometryShader,
+	kStatePixelShader,
+	kStateComputeShader,
+	kStateInputLayout,
+	kStateTopology,
+	kStateVertexBuffers,
+	kStateIndexBuffer,
+	kStateBlend,
+	kStateRasterizer,
+	kStateDepthStencil,
+
+	kNumPipelineStateKinds
+};
+
+const char* pipeline_state_name(PipelineStateKind kind);
+
+// ========================================================
+// PipelineDevice
+// Where the calls that change something end up.
+// ========================================================
+class PipelineDevice
+{
+public:
+	virtual ~PipelineDevice() {}
+
+	virtual void set_vertex_shader(ID3D11VertexShader* pShader) = 0;
+	virtual void set_hull_shader(ID3D11HullShader* pShader) = 0;
+	virtual void set_domain_shader(ID3D11DomainShader* pShader) = 0;
+	virtual void set_geometry_shader(ID3D11GeometryShader* pShader) = 0;
+	virtual void set_pixel_shader(ID3D11PixelShader* pShader) = 0;
+	virtual void set_compute_shader(ID3D11ComputeShader* pShader) = 0;
+	virtual void set_input_layout(ID3D11InputLayout* pLayout) = 0;
+	virtual void set_topology(PrimitiveTopology topology) = 0;
+	virtual void set_vertex_buffers(u32 startSlot, u32 count, ID3D11Buffer* const* ppBuffers, const u32* pStrides, const u32* pOffsets) = 0;
+	virtual void set_index_buffer(ID3D11Buffer* pBuffer, DXGI_FORMAT format, u32 offset) = 0;
+	virtual void set_blend_state(ID3D11BlendState* pState, const f32 blendFactor[4], u32 sampleMask) = 0;
+	virtual void set_rasterizer_state(ID3D11RasterizerState* pState) = 0;
+	virtual void set_depth_stencil_state(ID3D11DepthStencilState* pState, u32 stencilRef) = 0;
+};
+
+// Stand-in device that only counts calls per kind.
+class RecordingPipelineDevice : public PipelineDevice
+{
+public:
+	RecordingPipelineDevice() { clear_calls(); }
+
+	void set_vertex_shader(ID3D11VertexShader*) override { ++m_calls[kStateVertexShader]; }
+	void set_hull_shader(ID3D11HullShader*) override { ++m_calls[kStateHullShader]; }
+	void set_domain_shader(ID3D11DomainShader*) override { ++m_calls[kStateDomainShader]; }
+	void set_geometry_shader(ID3D11GeometryShader*) override { ++m_calls[kStateGeometryShader]; }
+	void set_pixel_shader(ID3D11PixelShader*) override { ++m_calls[kStatePixelShader]; }
+	void set_compute_shader(ID3D11ComputeShader*) override { ++m_calls[kStateComputeShader]; }
+	void set_input_layout(ID3D11InputLayout*) override { ++m_calls[kStateInputLayout]; }
+	void set_topology(PrimitiveTopology) override { ++m_calls[kStateTopology]; }
+	void set_vertex_buffers(u32, u32, ID3D11Buffer* const*, const u32*, const u32*) override { ++m_calls[kStateVertexBuffers]; }
+	void set_index_buffer(ID3D11Buffer*, DXGI_FORMAT, u32) override { ++m_calls[kStateIndexBuffer]; }
+	void set_blend_state(ID3D11BlendState*, const f32[4], u32) override { ++m_calls[kStateBlend]; }
+	void set_rasterizer_state(ID3D11RasterizerState*) override { ++m_calls[kStateRasterizer]; }
+	void set_depth_stencil_state(ID3D11DepthStencilState*, u32) override { ++m_calls[kStateDepthStencil]; }
+
+	u32 calls(PipelineStateKind kind) const { return m_calls[kind]; }
+	u32 total_calls() const;
+	void clear_calls() { memset(m_calls, 0, sizeof(m_calls)); }
+
+private:
+	u32 m_calls[kNumPipelineStateKinds];
+};
+
+// ========================================================
+// StateCache
+// ========================================================
+class StateCache
+{
+public:
+	static const u32 kMaxVertexBuffers = 8;
+
+	struct Stats
+	{
+		u32 sent[kNumPipelineStateKinds];
+		u32 skipped[kNumPipelineStateKinds];
+
+		u32 total_sent() const;
+		u32 total_skipped() const;
+	};
+
+	StateCache();
+
+	void init(PipelineDevice* pDevice);
+
+	void set_vertex_shader(ID3D11VertexShader* pShader);
+	void set_hull_shader(ID3D11HullShader* pShader);
+	void set_domain_shader(ID3D11DomainShader* pShader);
+	void set_geometry_shader(ID3D11GeometryShader* pShader);
+	void set_pixel_shader(ID3D11PixelShader* pShader);
+	void set_compute_shader(ID3D11ComputeShader* pShader);
+	void set_input_layout(ID3D11InputLayout* pLayout);
+	void set_topology(PrimitiveTopology topology);
+	void set_vertex_buffers(u32 startSlot, u32 count, ID3D11Buffer* const* ppBuffers, const u32* pStrides, const u32* pOffsets);
+	void set_index_buffer(ID3D11Buffer* pBuffer, DXGI_FORMAT format, u32 offset);
+	void set_blend_state(ID3D11BlendState* pState, const f32 blendFactor[4] = nullptr, u32 sampleMask = 0xFFFFFFFF);
+	void set_rasterizer_state(ID3D11RasterizerState* pState);
+	void set_depth_stencil_state(ID3D11DepthStencilState* pState, u32 stencilRef = 0);
+
+	// Forget the device state, the next call of each kind is always sent.
+	void invalidate();
+
+	const Stats& stats() const { return m_stats; }
+	void reset_stats() { m_stats = {}; }
+
+private:
+	// Counts the call, true if it has to go to the device.
+	bool filter(PipelineStateKind kind, bool bSame);
+
+	PipelineDevice* m_pDevice = nullptr;
+	bool m_known[kNumPipelineStateKinds];	// False until a kind has been sent once.
+
+	ID3D11VertexShader* m_pVertexShader = nullptr;
+	ID3D11HullShader* m_pHullShader = nullptr;
+	ID3D11DomainShader* m_pDomainShader = nullptr;
+	ID3D11GeometryShader* m_pGeometryShader = nullptr;
+	ID3D11PixelShader* m_pPixelShader = nullptr;
+	ID3D11ComputeShader* m_pComputeShader = nullptr;
+	ID3D11InputLayout* m_pInputLayout = nullptr;
+	PrimitiveTopology m_topology = kTopologyUndefined;
+
+	ID3D11Buffer* m_vertexBuffers[kMaxVertexBuffers] = {};
+	u32 m_vertexStrides[kMaxVertexBuffers] = {};
+	u32 m_vertexOffsets[kMaxVertexBuffers] = {};
+	u32 m_knownVertexSlots = 0;	// Bit per slot, only slots sent since invalidate() can be skipped.
+
+	ID3D11Buffer* m_pIndexBuffer = nullptr;
+	DXGI_FORMAT m_indexFormat = DXGI_FORMAT_UNKNOWN;
+	u32 m_indexOffset = 0;
+
+	ID3D11BlendState* m_pBlendState = nullptr;
+	f32 m_blendFactor[4] = {};
+	u32 m_sampleMask = 0;
+	ID3D11RasterizerState* m_pRasterizerState = nullptr;
+	ID3D11DepthStencilState* m_pDepthStencilState = nullptr;
+	u32 m_stencilRef = 0;
+
+	Stats m_stats = {};
+};
+
+#if defined(_WIN32)
+
+#include <d3d11.h>
+
+// Sends the calls to a device context.
+class D3D11PipelineDevice : public PipelineDevice
+{
+public:
+	explicit D3D11PipelineDevice(ID3D11DeviceContext* pContext = nullptr) : m_pContext(pContext) {}
+
+	void set_context(ID3D11DeviceContext* pContext) { m_pContext = pContext; }
+
+	void set_vertex_shader(ID3D11VertexShader* pShader) override { m_pContext->VSSetShader(pShader, nullptr, 0); }
+	void set_hull_shader(ID3D11HullShader* pShader) override { m_pContext->HSSetShader(pShader, nullptr, 0); }
+	void set_domain_shader(ID3D11DomainShader* pShader) override { m_pContext->DSSetShader(pShader, nullptr, 0); }
+	void set_geometry_shader(ID3D11GeometryShader* pShader) override { m_pContext->GSSetShader(pShader, nullptr, 0); }
+	void set_pixel_shader(ID3D11PixelShader* pShader) override { m_pContext->PSSetShader(pShader, nullptr, 0); }
+	void set_compute_shader(ID3D11ComputeShader* pShader) override { m_pContext->CSSetShader(pShader, nullptr, 0); }
+	void set_input_layout(ID3D11InputLayout* pLayout) override { m_pContext->IASetInputLayout(pLayout); }
+	void set_topology(PrimitiveTopology topology) override { m_pContext->IASetPrimitiveTopology(static_cast<D3D11_PRIMITIVE_TOPOLOGY>(topology)); }
+	void set_vertex_buffers(u32 startSlot, u32 count, ID3D11Buffer* const* ppBuffers, const u32* pStrides, const u32* pOffsets) override
+	{
+		m_pContext->IASetVertexBuffers(startSlot, count, ppBuffers, pStrides, pOffsets);
+	}
+	void set_index_buffer(ID3D11Buffer* pBuffer, DXGI_FORMAT format, u32 offset) override { m_pContext->IASetIndexBuffer(pBuffer, format, offset); }
+	void set_blend_state(ID3D11BlendState* pState, const f32 blendFactor[4], u32 sampleMask) override { m_pContext->OMSetBlendState(pState, blendFactor, sampleMask); }
+	void set_rasterizer_state(ID3D11RasterizerState* pState) override { m_pContext->RSSetState(pState); }
+	void set_depth_stencil_state(ID3D11DepthStencilState* pState, u32 stencilRef) override { m_pContext->OMSetDepthStencilState(pState, stencilRef); }
+
+private:
+	ID3D11DeviceContext* m_pContext;
+};
+
+#endif
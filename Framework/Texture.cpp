@@ -1,5 +1,10 @@
 #include "Texture.h"
-#include "DirectXTK/DDSTextureLoader.h"
+#include "Framework.h"
+#include "AssetPack.h"
+#include "BlockCompress.h"
+#include "ImageDecode.h"
+#include "MipGenerator.h"
+#include "TextureCache.h"
 #include "DirectXTK/WICTextureLoader.h"
 
 Texture::Texture()
@@ -17,35 +22,280 @@ Texture::~Texture()
 
 void Texture::init_from_dds(ID3D11Device* pDevice, const char* pFilename)
 {
-	wchar_t fileNameW[MAX_PATH];
-	size_t numChars;
-	mbstowcs_s(&numChars, fileNameW, MAX_PATH, pFilename, MAX_PATH);
+	// Open through the asset packs (or map the loose file) so the loader reads without an extra copy.
+	FileView view;
+	if (!open_asset(pFilename, view, 16, 0))
+	{
+		panicF("Could not load texture : %s ", pFilename);
+	}
 
-	HRESULT hr = DirectX::CreateDDSTextureFromFile(pDevice, fileNameW, &m_pTexture, &m_pTextureView);
-	if (FAILED(hr))
+	init_from_dds_data(pDevice, view.pData, view.size, pFilename);
+	close_asset(view);
+}
+
+void Texture::init_from_image(ID3D11Device* pDevice, const char* pFilename, bool bGenerateMips, JobPool* pJobPool)
+{
+	FileView view;
+	if (!open_asset(pFilename, view, 16, 0))
 	{
 		panicF("Could not load texture : %s ", pFilename);
 	}
+
+	init_from_image_data(pDevice, view.pData, view.size, pFilename, bGenerateMips, pJobPool);
+	close_asset(view);
 }
 
-void Texture::init_from_image(ID3D11Device* pDevice, const char* pFilename, bool bGenerateMips)
+void Texture::init_from_dds_data(ID3D11Device* pDevice, const memtype_t* pData, u64 size, const char* pDebugName)
 {
-	wchar_t fileNameW[MAX_PATH];
-	size_t numChars;
-	mbstowcs_s(&numChars, fileNameW, MAX_PATH, pFilename, MAX_PATH);
+	TextureData data;
+	const char* pError = nullptr;
+	if (!parse_dds(pData, size, data, &pError))
+	{
+		panicF("Could not load texture : %s (%s)", pDebugName, pError);
+	}
+
+	init_from_texture_data(pDevice, data, pDebugName);
+}
+
+void Texture::init_from_texture_data(ID3D11Device* pDevice, const TextureData& rData, const char* pDebugName)
+{
+	ASSERT(!m_pTexture); // Already initialised.
+
+	// Subresources can point straight at the source data.
+	std::vector<D3D11_SUBRESOURCE_DATA> initData(rData.subresources.size());
+	for (size_t i = 0; i < initData.size(); ++i)
+	{
+		initData[i].pSysMem = rData.subresources[i].pData;
+		initData[i].SysMemPitch = rData.subresources[i].rowPitch;
+		initData[i].SysMemSlicePitch = rData.subresources[i].slicePitch;
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = rData.format;
+
+	HRESULT hr = E_FAIL;
+	switch (rData.dimension)
+	{
+	case kTexture1D:
+	{
+		D3D11_TEXTURE1D_DESC desc = {};
+		desc.Width = rData.width;
+		desc.MipLevels = rData.mipLevels;
+		desc.ArraySize = rData.arraySize;
+		desc.Format = rData.format;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		ID3D11Texture1D* pTexture = nullptr;
+		hr = pDevice->CreateTexture1D(&desc, initData.data(), &pTexture);
+		m_pTexture = pTexture;
+
+		if (rData.arraySize > 1)
+		{
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE1DARRAY;
+			srvDesc.Texture1DArray.MipLevels = rData.mipLevels;
+			srvDesc.Texture1DArray.ArraySize = rData.arraySize;
+		}
+		else
+		{
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE1D;
+			srvDesc.Texture1D.MipLevels = rData.mipLevels;
+		}
+		break;
+	}
+	case kTexture2D:
+	{
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = rData.width;
+		desc.Height = rData.height;
+		desc.MipLevels = rData.mipLevels;
+		desc.ArraySize = rData.arraySize;
+		desc.Format = rData.format;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.MiscFlags = rData.isCubeMap ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+
+		ID3D11Texture2D* pTexture = nullptr;
+		hr = pDevice->CreateTexture2D(&desc, initData.data(), &pTexture);
+		m_pTexture = pTexture;
 
-	HRESULT hr = DirectX::CreateWICTextureFromFile(pDevice, fileNameW, &m_pTexture, &m_pTextureView);
+		if (rData.isCubeMap && rData.arraySize > 6)
+		{
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBEARRAY;
+			srvDesc.TextureCubeArray.MipLevels = rData.mipLevels;
+			srvDesc.TextureCubeArray.NumCubes = rData.arraySize / 6;
+		}
+		else if (rData.isCubeMap)
+		{
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+			srvDesc.TextureCube.MipLevels = rData.mipLevels;
+		}
+		else if (rData.arraySize > 1)
+		{
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+			srvDesc.Texture2DArray.MipLevels = rData.mipLevels;
+			srvDesc.Texture2DArray.ArraySize = rData.arraySize;
+		}
+		else
+		{
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+			srvDesc.Texture2D.MipLevels = rData.mipLevels;
+		}
+		break;
+	}
+	case kTexture3D:
+	{
+		D3D11_TEXTURE3D_DESC desc = {};
+		desc.Width = rData.width;
+		desc.Height = rData.height;
+		desc.Depth = rData.depth;
+		desc.MipLevels = rData.mipLevels;
+		desc.Format = rData.format;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		ID3D11Texture3D* pTexture = nullptr;
+		hr = pDevice->CreateTexture3D(&desc, initData.data(), &pTexture);
+		m_pTexture = pTexture;
+
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE3D;
+		srvDesc.Texture3D.MipLevels = rData.mipLevels;
+		break;
+	}
+	default:
+		break;
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		hr = pDevice->CreateShaderResourceView(m_pTexture, &srvDesc, &m_pTextureView);
+	}
 	if (FAILED(hr))
 	{
-		panicF("Could not load texture : %s ", pFilename);
+		panicF("Could not create texture : %s ", pDebugName);
+	}
+}
+
+void Texture::init_from_image_data(ID3D11Device* pDevice, const memtype_t* pData, u64 size, const char* pDebugName, bool bGenerateMips, JobPool* pJobPool)
+{
+	if (!bGenerateMips)
+	{
+		HRESULT hr = DirectX::CreateWICTextureFromMemory(pDevice, pData, static_cast<size_t>(size), &m_pTexture, &m_pTextureView);
+		if (FAILED(hr))
+		{
+			panicF("Could not load texture : %s ", pDebugName);
+		}
+		return;
+	}
+
+	// Colour images are assumed to be sRGB encoded, so filter in linear space.
+	MipOptions options;
+	options.filter = kMipFilterKaiser;
+	options.bSrgb = true;
+	static const char* s_mipSettings = "mips:kaiser:srgb";
+
+	const u64 key = texture_cache_key(pData, size, s_mipSettings);
+
+	FileView cached;
+	TextureData cachedData;
+	if (texture_cache_load(pDebugName, s_mipSettings, key, cached, cachedData))
+	{
+		init_from_texture_data(pDevice, cachedData, pDebugName);
+		unmap_file(cached);
+		return;
+	}
+
+	DecodedImage image;
+	const char* pError = nullptr;
+	if (!decode_image_rgba8(pData, size, image, &pError, pJobPool))
+	{
+		panicF("Could not load texture : %s (%s)", pDebugName, pError);
+	}
+
+	TextureBuffer mips;
+	generate_mips(image.pixels.data(), image.width, image.height, image.width * 4, options, mips, pJobPool);
+
+	texture_cache_store(pDebugName, s_mipSettings, key, mips.texture);
+	init_from_texture_data(pDevice, mips.texture, pDebugName);
+}
+
+void Texture::init_compressed(ID3D11Device* pDevice, const memtype_t* pData, u64 size, const char* pDebugName, DXGI_FORMAT blockFormat, JobPool* pJobPool)
+{
+	ASSERT(block_compress_supported(blockFormat));
+
+	// BC4 and BC5 hold data rather than colour, keep their mips linear.
+	const bool bColour = blockFormat != DXGI_FORMAT_BC4_UNORM && blockFormat != DXGI_FORMAT_BC5_UNORM;
+	char settings[64];
+	snprintf(settings, sizeof(settings), "bc:%u:mips:kaiser:%s", static_cast<u32>(blockFormat), bColour ? "srgb" : "linear");
+
+	const u64 key = texture_cache_key(pData, size, settings);
+
+	FileView cached;
+	TextureData cachedData;
+	if (texture_cache_load(pDebugName, settings, key, cached, cachedData))
+	{
+		init_from_texture_data(pDevice, cachedData, pDebugName);
+		unmap_file(cached);
+		return;
 	}
+
+	TextureData source;
+	DecodedImage image;
+	if (parse_dds(pData, size, source))
+	{
+		// Already compressed, nothing to gain from decoding it again.
+		if (texture_format_is_compressed(source.format))
+		{
+			init_from_texture_data(pDevice, source, pDebugName);
+			return;
+		}
+	}
+	else
+	{
+		const char* pError = nullptr;
+		if (!decode_image_rgba8(pData, size, image, &pError, pJobPool))
+		{
+			panicF("Could not load texture : %s (%s)", pDebugName, pError);
+		}
+		source.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		source.dimension = kTexture2D;
+		source.width = image.width;
+		source.height = image.height;
+		source.depth = 1;
+		source.mipLevels = 1;
+		source.arraySize = 1;
+		source.subresources.push_back({ image.pixels.data(), image.width, image.height, 1, image.width * 4, image.width * 4 * image.height, image.height });
+	}
+
+	// Single 2D images get a full chain, anything more complex is taken as it is.
+	TextureBuffer mips;
+	if (source.mipLevels == 1 && source.arraySize == 1 && source.dimension == kTexture2D && texture_format_bits_per_pixel(source.format) == 32)
+	{
+		MipOptions options;
+		options.filter = kMipFilterKaiser;
+		options.bSrgb = bColour;
+
+		const TextureSubresource& rTop = source.subresources[0];
+		generate_mips(rTop.pData, rTop.width, rTop.height, rTop.rowPitch, options, mips, pJobPool);
+		mips.texture.format = source.format;	// Keeps BGRA sources swizzled correctly.
+	}
+	const TextureData& rUncompressed = mips.texture.mipLevels ? mips.texture : source;
+
+	TextureBuffer compressed;
+	const char* pError = nullptr;
+	if (!compress_texture(rUncompressed, blockFormat, compressed, pJobPool, nullptr, &pError))
+	{
+		panicF("Could not compress texture : %s (%s)", pDebugName, pError);
+	}
+
+	texture_cache_store(pDebugName, settings, key, compressed.texture);
+	init_from_texture_data(pDevice, compressed.texture, pDebugName);
 }
 
 void Texture::bind(ID3D11DeviceContext* pDeviceContext, ShaderStage::ShaderStageEnum stage, u32 slot) const
 {
-	// This is not very efficient.
-	// We could bind multiple in a single call.
-	// An opportunity for you to change ;)
+	// One call per texture, see BindingTable for binding several at once.
 
 	switch (stage)
 	{
@@ -2,6 +2,9 @@
 
 #include "CommonHeader.h"
 #include "ShaderSet.h"
+#include "TextureData.h"
+
+class JobPool;
 
 class Texture
 {
@@ -15,11 +18,26 @@ public:
 	void init_from_dds(ID3D11Device* pDevice, const char* pFilename);
 
 	// Initialize from a non-dds image files such as JPEG, or PNG
-	void init_from_image(ID3D11Device* pDevice, const char* pFilename, bool bGenerateMips);
+	// Generated mips are cached, pJobPool spreads the filtering across threads when set.
+	void init_from_image(ID3D11Device* pDevice, const char* pFilename, bool bGenerateMips, JobPool* pJobPool = nullptr);
+
+	// Initialize from a DDS or image file that is already in memory.
+	void init_from_dds_data(ID3D11Device* pDevice, const memtype_t* pData, u64 size, const char* pDebugName);
+	void init_from_image_data(ID3D11Device* pDevice, const memtype_t* pData, u64 size, const char* pDebugName, bool bGenerateMips, JobPool* pJobPool = nullptr);
+
+	// Block compress a DDS or image file to BC1/BC4/BC5/BC7, generating mips first if it has none.
+	// The result is kept in the texture cache so the encode only happens once.
+	void init_compressed(ID3D11Device* pDevice, const memtype_t* pData, u64 size, const char* pDebugName, DXGI_FORMAT blockFormat, JobPool* pJobPool = nullptr);
+
+	// Create the GPU texture from parsed data (see parse_dds), the data is not needed afterwards.
+	void init_from_texture_data(ID3D11Device* pDevice, const TextureData& rData, const char* pDebugName);
 
 	// bind to the pipeline on a particular shader and slot
+	// Prefer passing view() to a BindingTable, which batches and skips redundant binds.
 	void bind(ID3D11DeviceContext* pDeviceContext, ShaderStage::ShaderStageEnum stage, u32 slot) const;
 
+	ID3D11ShaderResourceView* view() const { return m_pTextureView; }
+
 private:
 	ID3D11Resource* m_pTexture;
 	ID3D11ShaderResourceView* m_pTextureView;
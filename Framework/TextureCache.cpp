@@ -0,0 +1,73 @@
+#include "TextureCache.h"
+
+#include <fstream>
+#include <string>
+
+static const char* s_cacheDirectory = "Cache/Textures/";
+
+u64 texture_cache_key(const memtype_t* pSourceData, u64 sourceSize, const char* pSettings)
+{
+	u64 hash = hash_bytes(pSourceData, sourceSize);
+	hash = hash_bytes(pSettings, strlen(pSettings), hash);
+	hash = hash_bytes(&sourceSize, sizeof(sourceSize), hash);
+
+	// Zero means untagged in the DDS header.
+	return hash ? hash : 1;
+}
+
+// One file per source and settings combination.
+static std::string cache_path(const char* pSourceName, const char* pSettings)
+{
+	std::string name(pSourceName);
+	name += '|';
+	name += pSettings;
+
+	char fileName[32];
+	const u64 nameHash = hash_bytes(name.data(), name.size());
+	snprintf(fileName, sizeof(fileName), "%016llx.dds", static_cast<unsigned long long>(nameHash));
+	return std::string(s_cacheDirectory) + fileName;
+}
+
+bool texture_cache_load(const char* pSourceName, const char* pSettings, u64 key, FileView& rViewOut, TextureData& rTextureOut)
+{
+	const std::string path = cache_path(pSourceName, pSettings);
+	if (!map_file(path.c_str(), rViewOut, 16, 0))
+	{
+		return false;
+	}
+
+	if (dds_user_tag(rViewOut.pData, rViewOut.size) != key || !parse_dds(rViewOut.pData, rViewOut.size, rTextureOut))
+	{
+		unmap_file(rViewOut);
+		return false;
+	}
+	return true;
+}
+
+void texture_cache_store(const char* pSourceName, const char* pSettings, u64 key, const TextureData& rTexture)
+{
+	std::vector<memtype_t> file;
+	write_dds(rTexture, file, key);
+
+	CreateDirectoryA("Cache", nullptr);
+	CreateDirectoryA(s_cacheDirectory, nullptr);
+
+	// Write to a temporary and rename so a crash never leaves a half written entry.
+	const std::string path = cache_path(pSourceName, pSettings);
+	const std::string tempPath = path + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(file.data()), file.size());
+		if (!out.good())
+		{
+			errorF("Texture cache : could not write %s", tempPath.c_str());
+			return;
+		}
+	}
+
+	if (!MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		errorF("Texture cache : could not replace %s", path.c_str());
+		DeleteFileA(tempPath.c_str());
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "CommonHeader.h"
+#include "Framework.h"
+#include "TextureData.h"
+
+//================================================================================
+// Texture cache.
+// Processed textures (generated mips, block compression...) are written as
+// DDS files under Cache/Textures so the work is only done once per asset.
+// Each entry is tagged with a key built from the source contents and the
+// processing settings, a changed source or setting simply rebuilds it.
+//================================================================================
+
+// Key for a processed texture. pSettings describes the processing, e.g. "mips:kaiser:srgb".
+u64 texture_cache_key(const memtype_t* pSourceData, u64 sourceSize, const char* pSettings);
+
+// Look up a cached texture. On success rViewOut holds the file and rTextureOut points into it,
+// release the view with unmap_file once the texture has been created.
+bool texture_cache_load(const char* pSourceName, const char* pSettings, u64 key, FileView& rViewOut, TextureData& rTextureOut);
+
+// Write a processed texture to the cache, failures are reported but not fatal.
+void texture_cache_store(const char* pSourceName, const char* pSettings, u64 key, const TextureData& rTexture);
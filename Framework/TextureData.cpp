@@ -0,0 +1,810 @@
+#include "TextureData.h"
+
+// ========================================================
+// DDS file structures.
+// Same layout as DDS.h from DirectXTex, see DirectXTK/DDSTextureLoader.cpp.
+// ========================================================
+
+#define DDS_FOURCC_CODE(ch0, ch1, ch2, ch3) \
+	((u32)(u8)(ch0) | ((u32)(u8)(ch1) << 8) | ((u32)(u8)(ch2) << 16) | ((u32)(u8)(ch3) << 24))
+
+static const u32 kDdsMagic = 0x20534444; // "DDS "
+
+#pragma pack(push,1)
+
+struct DdsPixelFormat
+{
+	u32 size;
+	u32 flags;
+	u32 fourCC;
+	u32 RGBBitCount;
+	u32 RBitMask;
+	u32 GBitMask;
+	u32 BBitMask;
+	u32 ABitMask;
+};
+
+struct DdsHeader
+{
+	u32 size;
+	u32 flags;
+	u32 height;
+	u32 width;
+	u32 pitchOrLinearSize;
+	u32 depth; // only if kDdsHeaderFlagsVolume is set in flags
+	u32 mipMapCount;
+	u32 reserved1[11];
+	DdsPixelFormat ddspf;
+	u32 caps;
+	u32 caps2;
+	u32 caps3;
+	u32 caps4;
+	u32 reserved2;
+};
+
+struct DdsHeaderDxt10
+{
+	u32 dxgiFormat;
+	u32 resourceDimension;
+	u32 miscFlag;
+	u32 arraySize;
+	u32 miscFlags2;
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(DdsPixelFormat) == 32, "DDS pixel format size mismatch");
+static_assert(sizeof(DdsHeader) == 124, "DDS header size mismatch");
+static_assert(sizeof(DdsHeaderDxt10) == 20, "DDS DX10 header size mismatch");
+
+static const u32 kDdsFourCC = 0x00000004;		// DDPF_FOURCC
+static const u32 kDdsRgb = 0x00000040;			// DDPF_RGB
+static const u32 kDdsLuminance = 0x00020000;	// DDPF_LUMINANCE
+static const u32 kDdsAlpha = 0x00000002;		// DDPF_ALPHA
+static const u32 kDdsBumpDuDv = 0x00080000;		// DDPF_BUMPDUDV
+
+static const u32 kDdsHeaderFlagsVolume = 0x00800000;	// DDSD_DEPTH
+static const u32 kDdsHeight = 0x00000002;				// DDSD_HEIGHT
+
+static const u32 kDdsCubemap = 0x00000200;				// DDSCAPS2_CUBEMAP
+static const u32 kDdsCubemapAllFaces = 0x0000FE00;		// DDSCAPS2_CUBEMAP | all six faces
+
+static const u32 kDdsHeaderFlagsTexture = 0x00001007;	// DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT
+static const u32 kDdsHeaderFlagsMipmap = 0x00020000;	// DDSD_MIPMAPCOUNT
+static const u32 kDdsHeaderFlagsPitch = 0x00000008;		// DDSD_PITCH
+static const u32 kDdsHeaderFlagsLinearSize = 0x00080000; // DDSD_LINEARSIZE
+static const u32 kDdsSurfaceFlagsTexture = 0x00001000;	// DDSCAPS_TEXTURE
+static const u32 kDdsSurfaceFlagsMipmap = 0x00400008;	// DDSCAPS_COMPLEX | DDSCAPS_MIPMAP
+static const u32 kDdsSurfaceFlagsCubemap = 0x00000008;	// DDSCAPS_COMPLEX
+
+// Marks files written by write_dds that carry a user tag in reserved1[1..2].
+static const u32 kDdsUserTagMagic = DDS_FOURCC_CODE('S', 'T', 'G', 'A');
+
+static const u32 kResourceMiscTextureCube = 0x4;		// D3D11_RESOURCE_MISC_TEXTURECUBE
+
+// D3D11 hardware limits, files claiming more than this are rejected.
+static const u32 kMaxMipLevels = 15;
+static const u32 kMaxTexture1DSize = 16384;
+static const u32 kMaxTexture2DSize = 16384;
+static const u32 kMaxTextureCubeSize = 16384;
+static const u32 kMaxTexture3DSize = 2048;
+static const u32 kMaxArraySize = 2048;
+
+// ========================================================
+// Format information.
+// ========================================================
+
+u32 texture_format_bits_per_pixel(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+	case DXGI_FORMAT_R32G32B32A32_UINT:
+	case DXGI_FORMAT_R32G32B32A32_SINT:
+		return 128;
+
+	case DXGI_FORMAT_R32G32B32_TYPELESS:
+	case DXGI_FORMAT_R32G32B32_FLOAT:
+	case DXGI_FORMAT_R32G32B32_UINT:
+	case DXGI_FORMAT_R32G32B32_SINT:
+		return 96;
+
+	case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+	case DXGI_FORMAT_R16G16B16A16_UINT:
+	case DXGI_FORMAT_R16G16B16A16_SNORM:
+	case DXGI_FORMAT_R16G16B16A16_SINT:
+	case DXGI_FORMAT_R32G32_TYPELESS:
+	case DXGI_FORMAT_R32G32_FLOAT:
+	case DXGI_FORMAT_R32G32_UINT:
+	case DXGI_FORMAT_R32G32_SINT:
+	case DXGI_FORMAT_R32G8X24_TYPELESS:
+	case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+	case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+	case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+	case DXGI_FORMAT_Y416:
+	case DXGI_FORMAT_Y210:
+	case DXGI_FORMAT_Y216:
+		return 64;
+
+	case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+	case DXGI_FORMAT_R10G10B10A2_UNORM:
+	case DXGI_FORMAT_R10G10B10A2_UINT:
+	case DXGI_FORMAT_R11G11B10_FLOAT:
+	case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_R8G8B8A8_UINT:
+	case DXGI_FORMAT_R8G8B8A8_SNORM:
+	case DXGI_FORMAT_R8G8B8A8_SINT:
+	case DXGI_FORMAT_R16G16_TYPELESS:
+	case DXGI_FORMAT_R16G16_FLOAT:
+	case DXGI_FORMAT_R16G16_UNORM:
+	case DXGI_FORMAT_R16G16_UINT:
+	case DXGI_FORMAT_R16G16_SNORM:
+	case DXGI_FORMAT_R16G16_SINT:
+	case DXGI_FORMAT_R32_TYPELESS:
+	case DXGI_FORMAT_D32_FLOAT:
+	case DXGI_FORMAT_R32_FLOAT:
+	case DXGI_FORMAT_R32_UINT:
+	case DXGI_FORMAT_R32_SINT:
+	case DXGI_FORMAT_R24G8_TYPELESS:
+	case DXGI_FORMAT_D24_UNORM_S8_UINT:
+	case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+	case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+	case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+	case DXGI_FORMAT_R8G8_B8G8_UNORM:
+	case DXGI_FORMAT_G8R8_G8B8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+	case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+	case DXGI_FORMAT_AYUV:
+	case DXGI_FORMAT_Y410:
+	case DXGI_FORMAT_YUY2:
+		return 32;
+
+	case DXGI_FORMAT_P010:
+	case DXGI_FORMAT_P016:
+		return 24;
+
+	case DXGI_FORMAT_R8G8_TYPELESS:
+	case DXGI_FORMAT_R8G8_UNORM:
+	case DXGI_FORMAT_R8G8_UINT:
+	case DXGI_FORMAT_R8G8_SNORM:
+	case DXGI_FORMAT_R8G8_SINT:
+	case DXGI_FORMAT_R16_TYPELESS:
+	case DXGI_FORMAT_R16_FLOAT:
+	case DXGI_FORMAT_D16_UNORM:
+	case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_R16_UINT:
+	case DXGI_FORMAT_R16_SNORM:
+	case DXGI_FORMAT_R16_SINT:
+	case DXGI_FORMAT_B5G6R5_UNORM:
+	case DXGI_FORMAT_B5G5R5A1_UNORM:
+	case DXGI_FORMAT_A8P8:
+	case DXGI_FORMAT_B4G4R4A4_UNORM:
+		return 16;
+
+	case DXGI_FORMAT_NV12:
+	case DXGI_FORMAT_420_OPAQUE:
+	case DXGI_FORMAT_NV11:
+		return 12;
+
+	case DXGI_FORMAT_R8_TYPELESS:
+	case DXGI_FORMAT_R8_UNORM:
+	case DXGI_FORMAT_R8_UINT:
+	case DXGI_FORMAT_R8_SNORM:
+	case DXGI_FORMAT_R8_SINT:
+	case DXGI_FORMAT_A8_UNORM:
+	case DXGI_FORMAT_AI44:
+	case DXGI_FORMAT_IA44:
+	case DXGI_FORMAT_P8:
+		return 8;
+
+	case DXGI_FORMAT_R1_UNORM:
+		return 1;
+
+	case DXGI_FORMAT_BC1_TYPELESS:
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_TYPELESS:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+		return 4;
+
+	case DXGI_FORMAT_BC2_TYPELESS:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_TYPELESS:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_TYPELESS:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_BC6H_TYPELESS:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_TYPELESS:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return 8;
+
+	default:
+		return 0;
+	}
+}
+
+// Bytes per 4x4 block, 0 if the format isn't block compressed.
+static u32 block_bytes(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_TYPELESS:
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_TYPELESS:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+		return 8;
+
+	case DXGI_FORMAT_BC2_TYPELESS:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_TYPELESS:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_TYPELESS:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_BC6H_TYPELESS:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_TYPELESS:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return 16;
+
+	default:
+		return 0;
+	}
+}
+
+bool texture_format_is_compressed(DXGI_FORMAT format)
+{
+	return block_bytes(format) != 0;
+}
+
+void texture_surface_info(u32 width, u32 height, DXGI_FORMAT format, u64* pNumBytesOut, u64* pRowBytesOut, u64* pNumRowsOut)
+{
+	u64 numBytes = 0;
+	u64 rowBytes = 0;
+	u64 numRows = 0;
+
+	bool packed = false;
+	bool planar = false;
+	u64 bpe = block_bytes(format);
+	const bool bc = bpe != 0;
+
+	switch (format)
+	{
+	case DXGI_FORMAT_R8G8_B8G8_UNORM:
+	case DXGI_FORMAT_G8R8_G8B8_UNORM:
+	case DXGI_FORMAT_YUY2:
+		packed = true;
+		bpe = 4;
+		break;
+
+	case DXGI_FORMAT_Y210:
+	case DXGI_FORMAT_Y216:
+		packed = true;
+		bpe = 8;
+		break;
+
+	case DXGI_FORMAT_NV12:
+	case DXGI_FORMAT_420_OPAQUE:
+		planar = true;
+		bpe = 2;
+		break;
+
+	case DXGI_FORMAT_P010:
+	case DXGI_FORMAT_P016:
+		planar = true;
+		bpe = 4;
+		break;
+
+	default:
+		break;
+	}
+
+	if (bc)
+	{
+		const u64 numBlocksWide = width > 0 ? std::max<u64>(1, (width + 3) / 4) : 0;
+		const u64 numBlocksHigh = height > 0 ? std::max<u64>(1, (height + 3) / 4) : 0;
+		rowBytes = numBlocksWide * bpe;
+		numRows = numBlocksHigh;
+		numBytes = rowBytes * numBlocksHigh;
+	}
+	else if (packed)
+	{
+		rowBytes = ((static_cast<u64>(width) + 1) >> 1) * bpe;
+		numRows = height;
+		numBytes = rowBytes * height;
+	}
+	else if (format == DXGI_FORMAT_NV11)
+	{
+		rowBytes = ((static_cast<u64>(width) + 3) >> 2) * 4;
+		numRows = static_cast<u64>(height) * 2; // Same simplifying assumption as Direct3D.
+		numBytes = rowBytes * numRows;
+	}
+	else if (planar)
+	{
+		rowBytes = ((static_cast<u64>(width) + 1) >> 1) * bpe;
+		numBytes = (rowBytes * height) + ((rowBytes * height + 1) >> 1);
+		numRows = height + ((static_cast<u64>(height) + 1) >> 1);
+	}
+	else
+	{
+		const u64 bpp = texture_format_bits_per_pixel(format);
+		rowBytes = (width * bpp + 7) / 8; // round up to nearest byte
+		numRows = height;
+		numBytes = rowBytes * height;
+	}
+
+	if (pNumBytesOut) *pNumBytesOut = numBytes;
+	if (pRowBytesOut) *pRowBytesOut = rowBytes;
+	if (pNumRowsOut) *pNumRowsOut = numRows;
+}
+
+// ========================================================
+// DDS parsing.
+// ========================================================
+
+// Map a legacy (pre DX10 header) pixel format to DXGI.
+static DXGI_FORMAT dds_legacy_format(const DdsPixelFormat& ddpf)
+{
+#define IS_BITMASK(r, g, b, a) (ddpf.RBitMask == r && ddpf.GBitMask == g && ddpf.BBitMask == b && ddpf.ABitMask == a)
+
+	if (ddpf.flags & kDdsRgb)
+	{
+		// sRGB formats are only written with the DX10 header.
+		switch (ddpf.RGBBitCount)
+		{
+		case 32:
+			if (IS_BITMASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000)) return DXGI_FORMAT_R8G8B8A8_UNORM;
+			if (IS_BITMASK(0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000)) return DXGI_FORMAT_B8G8R8A8_UNORM;
+			if (IS_BITMASK(0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000)) return DXGI_FORMAT_B8G8R8X8_UNORM;
+
+			// D3DX writes 10:10:10:2 with the red and blue masks swapped, assume that's what we have.
+			if (IS_BITMASK(0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000)) return DXGI_FORMAT_R10G10B10A2_UNORM;
+
+			if (IS_BITMASK(0x0000ffff, 0xffff0000, 0x00000000, 0x00000000)) return DXGI_FORMAT_R16G16_UNORM;
+
+			// Only 32-bit color channel format in D3D9 was R32F
+			if (IS_BITMASK(0xffffffff, 0x00000000, 0x00000000, 0x00000000)) return DXGI_FORMAT_R32_FLOAT;
+			break;
+
+		case 16:
+			if (IS_BITMASK(0x7c00, 0x03e0, 0x001f, 0x8000)) return DXGI_FORMAT_B5G5R5A1_UNORM;
+			if (IS_BITMASK(0xf800, 0x07e0, 0x001f, 0x0000)) return DXGI_FORMAT_B5G6R5_UNORM;
+			if (IS_BITMASK(0x0f00, 0x00f0, 0x000f, 0xf000)) return DXGI_FORMAT_B4G4R4A4_UNORM;
+			break;
+		}
+	}
+	else if (ddpf.flags & kDdsLuminance)
+	{
+		if (8 == ddpf.RGBBitCount)
+		{
+			if (IS_BITMASK(0x000000ff, 0x00000000, 0x00000000, 0x00000000)) return DXGI_FORMAT_R8_UNORM;
+
+			// Some writers set the bit count to 8 for 8:8 luminance alpha.
+			if (IS_BITMASK(0x000000ff, 0x00000000, 0x00000000, 0x0000ff00)) return DXGI_FORMAT_R8G8_UNORM;
+		}
+
+		if (16 == ddpf.RGBBitCount)
+		{
+			if (IS_BITMASK(0x0000ffff, 0x00000000, 0x00000000, 0x00000000)) return DXGI_FORMAT_R16_UNORM;
+			if (IS_BITMASK(0x000000ff, 0x00000000, 0x00000000, 0x0000ff00)) return DXGI_FORMAT_R8G8_UNORM;
+		}
+	}
+	else if (ddpf.flags & kDdsAlpha)
+	{
+		if (8 == ddpf.RGBBitCount) return DXGI_FORMAT_A8_UNORM;
+	}
+	else if (ddpf.flags & kDdsBumpDuDv)
+	{
+		if (16 == ddpf.RGBBitCount)
+		{
+			if (IS_BITMASK(0x00ff, 0xff00, 0x0000, 0x0000)) return DXGI_FORMAT_R8G8_SNORM;
+		}
+
+		if (32 == ddpf.RGBBitCount)
+		{
+			if (IS_BITMASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000)) return DXGI_FORMAT_R8G8B8A8_SNORM;
+			if (IS_BITMASK(0x0000ffff, 0xffff0000, 0x00000000, 0x00000000)) return DXGI_FORMAT_R16G16_SNORM;
+		}
+	}
+	else if (ddpf.flags & kDdsFourCC)
+	{
+		switch (ddpf.fourCC)
+		{
+		case DDS_FOURCC_CODE('D', 'X', 'T', '1'): return DXGI_FORMAT_BC1_UNORM;
+		case DDS_FOURCC_CODE('D', 'X', 'T', '3'): return DXGI_FORMAT_BC2_UNORM;
+		case DDS_FOURCC_CODE('D', 'X', 'T', '5'): return DXGI_FORMAT_BC3_UNORM;
+
+		// Pre-multiplied alpha has no DXGI format but the data is the same.
+		case DDS_FOURCC_CODE('D', 'X', 'T', '2'): return DXGI_FORMAT_BC2_UNORM;
+		case DDS_FOURCC_CODE('D', 'X', 'T', '4'): return DXGI_FORMAT_BC3_UNORM;
+
+		case DDS_FOURCC_CODE('A', 'T', 'I', '1'): return DXGI_FORMAT_BC4_UNORM;
+		case DDS_FOURCC_CODE('B', 'C', '4', 'U'): return DXGI_FORMAT_BC4_UNORM;
+		case DDS_FOURCC_CODE('B', 'C', '4', 'S'): return DXGI_FORMAT_BC4_SNORM;
+
+		case DDS_FOURCC_CODE('A', 'T', 'I', '2'): return DXGI_FORMAT_BC5_UNORM;
+		case DDS_FOURCC_CODE('B', 'C', '5', 'U'): return DXGI_FORMAT_BC5_UNORM;
+		case DDS_FOURCC_CODE('B', 'C', '5', 'S'): return DXGI_FORMAT_BC5_SNORM;
+
+		case DDS_FOURCC_CODE('R', 'G', 'B', 'G'): return DXGI_FORMAT_R8G8_B8G8_UNORM;
+		case DDS_FOURCC_CODE('G', 'R', 'G', 'B'): return DXGI_FORMAT_G8R8_G8B8_UNORM;
+		case DDS_FOURCC_CODE('Y', 'U', 'Y', '2'): return DXGI_FORMAT_YUY2;
+
+		// D3DFORMAT enums stored as the FourCC.
+		case 36: return DXGI_FORMAT_R16G16B16A16_UNORM;	// D3DFMT_A16B16G16R16
+		case 110: return DXGI_FORMAT_R16G16B16A16_SNORM;	// D3DFMT_Q16W16V16U16
+		case 111: return DXGI_FORMAT_R16_FLOAT;				// D3DFMT_R16F
+		case 112: return DXGI_FORMAT_R16G16_FLOAT;			// D3DFMT_G16R16F
+		case 113: return DXGI_FORMAT_R16G16B16A16_FLOAT;	// D3DFMT_A16B16G16R16F
+		case 114: return DXGI_FORMAT_R32_FLOAT;				// D3DFMT_R32F
+		case 115: return DXGI_FORMAT_R32G32_FLOAT;			// D3DFMT_G32R32F
+		case 116: return DXGI_FORMAT_R32G32B32A32_FLOAT;	// D3DFMT_A32B32G32R32F
+		}
+	}
+
+#undef IS_BITMASK
+
+	return DXGI_FORMAT_UNKNOWN;
+}
+
+static bool dds_fail(const char** pErrorOut, const char* pReason)
+{
+	if (pErrorOut)
+	{
+		*pErrorOut = pReason;
+	}
+	return false;
+}
+
+bool parse_dds(const memtype_t* pData, u64 size, TextureData& rTextureOut, const char** pErrorOut)
+{
+	rTextureOut = TextureData();
+
+	if (!pData || size < sizeof(u32) + sizeof(DdsHeader))
+	{
+		return dds_fail(pErrorOut, "file too small");
+	}
+
+	u32 magic;
+	memcpy(&magic, pData, sizeof(magic));
+	if (magic != kDdsMagic)
+	{
+		return dds_fail(pErrorOut, "not a DDS file");
+	}
+
+	// Copy the headers out so the file data doesn't need to be aligned.
+	DdsHeader header;
+	memcpy(&header, pData + sizeof(u32), sizeof(header));
+	if (header.size != sizeof(DdsHeader) || header.ddspf.size != sizeof(DdsPixelFormat))
+	{
+		return dds_fail(pErrorOut, "bad header size");
+	}
+
+	u64 dataOffset = sizeof(u32) + sizeof(DdsHeader);
+
+	u32 width = header.width;
+	u32 height = header.height;
+	u32 depth = header.depth;
+	u32 mipCount = header.mipMapCount ? header.mipMapCount : 1;
+	u32 arraySize = 1;
+	bool isCubeMap = false;
+	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+	TextureDimension dimension = kTextureUnknown;
+
+	if ((header.ddspf.flags & kDdsFourCC) && header.ddspf.fourCC == DDS_FOURCC_CODE('D', 'X', '1', '0'))
+	{
+		if (size < dataOffset + sizeof(DdsHeaderDxt10))
+		{
+			return dds_fail(pErrorOut, "file too small for DX10 header");
+		}
+
+		DdsHeaderDxt10 dx10;
+		memcpy(&dx10, pData + dataOffset, sizeof(dx10));
+		dataOffset += sizeof(DdsHeaderDxt10);
+
+		arraySize = dx10.arraySize;
+		if (arraySize == 0)
+		{
+			return dds_fail(pErrorOut, "zero array size");
+		}
+
+		format = static_cast<DXGI_FORMAT>(dx10.dxgiFormat);
+		switch (format)
+		{
+		case DXGI_FORMAT_AI44:
+		case DXGI_FORMAT_IA44:
+		case DXGI_FORMAT_P8:
+		case DXGI_FORMAT_A8P8:
+			return dds_fail(pErrorOut, "palettized formats are not supported");
+
+		default:
+			if (texture_format_bits_per_pixel(format) == 0)
+			{
+				return dds_fail(pErrorOut, "unknown format");
+			}
+		}
+
+		switch (dx10.resourceDimension)
+		{
+		case kTexture1D:
+			// D3DX writes 1D textures with a fixed height of 1
+			if ((header.flags & kDdsHeight) && height != 1)
+			{
+				return dds_fail(pErrorOut, "1D texture with height");
+			}
+			height = depth = 1;
+			break;
+
+		case kTexture2D:
+			if (dx10.miscFlag & kResourceMiscTextureCube)
+			{
+				arraySize *= 6;
+				isCubeMap = true;
+			}
+			depth = 1;
+			break;
+
+		case kTexture3D:
+			if (!(header.flags & kDdsHeaderFlagsVolume))
+			{
+				return dds_fail(pErrorOut, "3D texture without volume flag");
+			}
+			if (arraySize > 1)
+			{
+				return dds_fail(pErrorOut, "3D texture arrays are not supported");
+			}
+			break;
+
+		default:
+			return dds_fail(pErrorOut, "unknown resource dimension");
+		}
+
+		dimension = static_cast<TextureDimension>(dx10.resourceDimension);
+	}
+	else
+	{
+		format = dds_legacy_format(header.ddspf);
+		if (format == DXGI_FORMAT_UNKNOWN)
+		{
+			return dds_fail(pErrorOut, "unsupported legacy format");
+		}
+
+		if (header.flags & kDdsHeaderFlagsVolume)
+		{
+			dimension = kTexture3D;
+		}
+		else
+		{
+			if (header.caps2 & kDdsCubemap)
+			{
+				// We require all six faces to be defined
+				if ((header.caps2 & kDdsCubemapAllFaces) != kDdsCubemapAllFaces)
+				{
+					return dds_fail(pErrorOut, "partial cube maps are not supported");
+				}
+				arraySize = 6;
+				isCubeMap = true;
+			}
+
+			// Legacy files have no way to express a 1D texture.
+			depth = 1;
+			dimension = kTexture2D;
+		}
+	}
+
+	// Don't trust metadata beyond what the hardware could ever create.
+	if (mipCount > kMaxMipLevels)
+	{
+		return dds_fail(pErrorOut, "too many mip levels");
+	}
+
+	bool bWithinLimits = true;
+	switch (dimension)
+	{
+	case kTexture1D:
+		bWithinLimits = arraySize <= kMaxArraySize && width <= kMaxTexture1DSize;
+		break;
+	case kTexture2D:
+		bWithinLimits = arraySize <= kMaxArraySize
+			&& width <= (isCubeMap ? kMaxTextureCubeSize : kMaxTexture2DSize)
+			&& height <= (isCubeMap ? kMaxTextureCubeSize : kMaxTexture2DSize);
+		break;
+	case kTexture3D:
+		bWithinLimits = arraySize == 1 && width <= kMaxTexture3DSize && height <= kMaxTexture3DSize && depth <= kMaxTexture3DSize;
+		break;
+	default:
+		bWithinLimits = false;
+		break;
+	}
+	if (!bWithinLimits || width == 0 || height == 0 || depth == 0)
+	{
+		return dds_fail(pErrorOut, "dimensions out of range");
+	}
+
+	// Walk the subresources, each array item holds its full mip chain.
+	std::vector<TextureSubresource> subresources;
+	subresources.reserve(static_cast<size_t>(mipCount) * arraySize);
+
+	u64 offset = dataOffset;
+	for (u32 item = 0; item < arraySize; ++item)
+	{
+		u32 w = width;
+		u32 h = height;
+		u32 d = depth;
+		for (u32 mip = 0; mip < mipCount; ++mip)
+		{
+			u64 numBytes = 0;
+			u64 rowBytes = 0;
+			u64 numRows = 0;
+			texture_surface_info(w, h, format, &numBytes, &rowBytes, &numRows);
+
+			const u64 totalBytes = numBytes * d;
+			if (numBytes > 0xFFFFFFFFu || totalBytes > size - offset)
+			{
+				return dds_fail(pErrorOut, "file is truncated");
+			}
+
+			TextureSubresource sub;
+			sub.pData = pData + offset;
+			sub.width = w;
+			sub.height = h;
+			sub.depth = d;
+			sub.rowPitch = static_cast<u32>(rowBytes);
+			sub.slicePitch = static_cast<u32>(numBytes);
+			sub.numRows = static_cast<u32>(numRows);
+			subresources.push_back(sub);
+
+			offset += totalBytes;
+
+			w = std::max(w >> 1, 1u);
+			h = std::max(h >> 1, 1u);
+			d = std::max(d >> 1, 1u);
+		}
+	}
+
+	rTextureOut.format = format;
+	rTextureOut.dimension = dimension;
+	rTextureOut.width = width;
+	rTextureOut.height = height;
+	rTextureOut.depth = depth;
+	rTextureOut.mipLevels = mipCount;
+	rTextureOut.arraySize = arraySize;
+	rTextureOut.isCubeMap = isCubeMap;
+	rTextureOut.subresources = std::move(subresources);
+	return true;
+}
+
+// ========================================================
+// DDS writing.
+// ========================================================
+
+void write_dds(const TextureData& rTexture, std::vector<memtype_t>& rFileOut, u64 userTag)
+{
+	ASSERT(rTexture.subresources.size() == static_cast<size_t>(rTexture.mipLevels) * rTexture.arraySize);
+
+	DdsHeader header = {};
+	header.size = sizeof(DdsHeader);
+	header.flags = kDdsHeaderFlagsTexture | kDdsHeaderFlagsMipmap;
+	header.width = rTexture.width;
+	header.height = rTexture.height;
+	header.depth = rTexture.dimension == kTexture3D ? rTexture.depth : 0;
+	header.mipMapCount = rTexture.mipLevels;
+	header.ddspf.size = sizeof(DdsPixelFormat);
+	header.ddspf.flags = kDdsFourCC;
+	header.ddspf.fourCC = DDS_FOURCC_CODE('D', 'X', '1', '0');
+	header.caps = kDdsSurfaceFlagsTexture;
+
+	u64 rowBytes = 0;
+	u64 numBytes = 0;
+	texture_surface_info(rTexture.width, rTexture.height, rTexture.format, &numBytes, &rowBytes, nullptr);
+	if (texture_format_is_compressed(rTexture.format))
+	{
+		header.flags |= kDdsHeaderFlagsLinearSize;
+		header.pitchOrLinearSize = static_cast<u32>(numBytes);
+	}
+	else
+	{
+		header.flags |= kDdsHeaderFlagsPitch;
+		header.pitchOrLinearSize = static_cast<u32>(rowBytes);
+	}
+
+	if (rTexture.mipLevels > 1)
+	{
+		header.caps |= kDdsSurfaceFlagsMipmap;
+	}
+	if (rTexture.dimension == kTexture3D)
+	{
+		header.flags |= kDdsHeaderFlagsVolume;
+	}
+	if (rTexture.isCubeMap)
+	{
+		header.caps |= kDdsSurfaceFlagsCubemap;
+		header.caps2 = kDdsCubemapAllFaces;
+	}
+
+	if (userTag != 0)
+	{
+		header.reserved1[0] = kDdsUserTagMagic;
+		header.reserved1[1] = static_cast<u32>(userTag);
+		header.reserved1[2] = static_cast<u32>(userTag >> 32);
+	}
+
+	DdsHeaderDxt10 dx10 = {};
+	dx10.dxgiFormat = rTexture.format;
+	dx10.resourceDimension = rTexture.dimension;
+	dx10.miscFlag = rTexture.isCubeMap ? kResourceMiscTextureCube : 0;
+	dx10.arraySize = rTexture.isCubeMap ? rTexture.arraySize / 6 : rTexture.arraySize;
+
+	// Work out the size first so the output is allocated once.
+	u64 totalBytes = sizeof(u32) + sizeof(DdsHeader) + sizeof(DdsHeaderDxt10);
+	for (const TextureSubresource& rSub : rTexture.subresources)
+	{
+		texture_surface_info(rSub.width, rSub.height, rTexture.format, &numBytes, nullptr, nullptr);
+		totalBytes += numBytes * rSub.depth;
+	}
+
+	rFileOut.resize(static_cast<size_t>(totalBytes));
+	memtype_t* pOut = rFileOut.data();
+	memcpy(pOut, &kDdsMagic, sizeof(u32));
+	pOut += sizeof(u32);
+	memcpy(pOut, &header, sizeof(header));
+	pOut += sizeof(header);
+	memcpy(pOut, &dx10, sizeof(dx10));
+	pOut += sizeof(dx10);
+
+	// Rows are written tightly packed whatever the source pitch was.
+	for (const TextureSubresource& rSub : rTexture.subresources)
+	{
+		u64 numRows = 0;
+		texture_surface_info(rSub.width, rSub.height, rTexture.format, nullptr, &rowBytes, &numRows);
+		for (u32 z = 0; z < rSub.depth; ++z)
+		{
+			const memtype_t* pSlice = rSub.pData + static_cast<u64>(z) * rSub.slicePitch;
+			for (u64 row = 0; row < numRows; ++row)
+			{
+				memcpy(pOut, pSlice + row * rSub.rowPitch, static_cast<size_t>(rowBytes));
+				pOut += rowBytes;
+			}
+		}
+	}
+	ASSERT(pOut == rFileOut.data() + rFileOut.size());
+}
+
+u64 dds_user_tag(const memtype_t* pData, u64 size)
+{
+	if (!pData || size < sizeof(u32) + sizeof(DdsHeader))
+	{
+		return 0;
+	}
+
+	DdsHeader header;
+	memcpy(&header, pData + sizeof(u32), sizeof(header));
+	if (header.reserved1[0] != kDdsUserTagMagic)
+	{
+		return 0;
+	}
+	return static_cast<u64>(header.reserved1[1]) | (static_cast<u64>(header.reserved1[2]) << 32);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "CoreTypes.h"
+#include "DxgiFormat.h"
+
+#include <vector>
+
+//================================================================================
+// TextureData
+// CPU side description of a texture and all its subresources.
+// Platform independent, the pixel data is not owned and usually points
+// straight into a mapped file so parsing costs no copies.
+//================================================================================
+
+// Values match D3D11_RESOURCE_DIMENSION.
+enum TextureDimension : u32
+{
+	kTextureUnknown = 0,
+	kTexture1D = 2,
+	kTexture2D = 3,
+	kTexture3D = 4,
+};
+
+struct TextureSubresource
+{
+	const memtype_t* pData;
+	u32 width;
+	u32 height;
+	u32 depth;
+	u32 rowPitch;	// Bytes per row of pixels or blocks.
+	u32 slicePitch;	// Bytes per 2D slice.
+	u32 numRows;	// Rows of pixels or blocks in a slice.
+};
+
+struct TextureData
+{
+	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+	TextureDimension dimension = kTextureUnknown;
+	u32 width = 0;
+	u32 height = 0;
+	u32 depth = 0;
+	u32 mipLevels = 0;
+	u32 arraySize = 0;	// Includes the 6 faces for cube maps.
+	bool isCubeMap = false;
+
+	// arraySize * mipLevels entries, mips of each array item are contiguous
+	// so the index matches D3D11CalcSubresource.
+	std::vector<TextureSubresource> subresources;
+
+	const TextureSubresource& subresource(u32 mip, u32 item) const
+	{
+		ASSERT(mip < mipLevels && item < arraySize);
+		return subresources[item * mipLevels + mip];
+	}
+};
+
+// A texture that owns its pixels, subresources point into storage.
+class TextureBuffer
+{
+public:
+	TextureBuffer() = default;
+	TextureBuffer(TextureBuffer&&) = default;
+	TextureBuffer& operator=(TextureBuffer&&) = default;
+
+	std::vector<memtype_t> storage;
+	TextureData texture;
+
+private:
+	// Copying would leave the subresources pointing at the old storage.
+	TextureBuffer(const TextureBuffer&) = delete;
+	TextureBuffer& operator=(const TextureBuffer&) = delete;
+};
+
+// Parse a DDS file in memory. Subresources point into pData, which must outlive rTextureOut.
+// Returns false for corrupt or unsupported files, pErrorOut gets a short reason.
+bool parse_dds(const memtype_t* pData, u64 size, TextureData& rTextureOut, const char** pErrorOut = nullptr);
+
+// Serialise as a DDS file with the DX10 header. userTag is kept in the
+// reserved header words so caches can tell which source a file was built from.
+void write_dds(const TextureData& rTexture, std::vector<memtype_t>& rFileOut, u64 userTag = 0);
+
+// The tag stored by write_dds, zero if the file has none.
+u64 dds_user_tag(const memtype_t* pData, u64 size);
+
+// Bits per pixel (or per pixel averaged over a block), 0 for unknown formats.
+u32 texture_format_bits_per_pixel(DXGI_FORMAT format);
+
+// True for the BCn block compressed formats.
+bool texture_format_is_compressed(DXGI_FORMAT format);
+
+// Size of one 2D surface of the given format.
+void texture_surface_info(u32 width, u32 height, DXGI_FORMAT format, u64* pNumBytesOut, u64* pRowBytesOut, u64* pNumRowsOut);
@@ -0,0 +1,333 @@
+#include "TextureResidency.h"
+
+// Frames a texture counts as visible after its last set_screen_size().
+static const u64 kVisibleFrames = 4;
+
+// A visible texture only gives up a level to one at least this much blurrier after the swap.
+static const f32 kSwapHysteresis = 2.0f;
+
+TextureResidency::TextureResidency()
+{
+}
+
+void TextureResidency::set_budget(u64 budgetBytes)
+{
+	m_budget = budgetBytes;
+}
+
+void TextureResidency::set_max_loads_in_flight(u32 maxLoads)
+{
+	m_maxLoadsInFlight = maxLoads ? maxLoads : 1;
+}
+
+TextureResidency::Handle TextureResidency::add(u32 width, u32 height, u32 numMips, const u64* pMipBytes, u32 numTailMips)
+{
+	ASSERT(numMips > 0 && numTailMips > 0 && numTailMips <= numMips);
+
+	Handle handle;
+	if (!m_freeHandles.empty())
+	{
+		handle = m_freeHandles.back();
+		m_freeHandles.pop_back();
+	}
+	else
+	{
+		handle = static_cast<Handle>(m_entries.size());
+		m_entries.emplace_back();
+	}
+
+	Entry& rEntry = m_entries[handle];
+	rEntry = Entry();
+	rEntry.width = width;
+	rEntry.height = height;
+	rEntry.numMips = numMips;
+	rEntry.tailMip = numMips - numTailMips;
+	rEntry.residentMip = rEntry.tailMip;
+	rEntry.wantedMip = rEntry.tailMip;
+	rEntry.bAlive = true;
+	rEntry.mipBytes.assign(pMipBytes, pMipBytes + numMips);
+
+	// The tail is always resident, even if it doesn't fit.
+	for (u32 mip = rEntry.tailMip; mip < numMips; ++mip)
+	{
+		m_residentBytes += pMipBytes[mip];
+	}
+	m_peakCommittedBytes = std::max(m_peakCommittedBytes, committed_bytes());
+	return handle;
+}
+
+void TextureResidency::remove(Handle texture)
+{
+	Entry& rEntry = m_entries[texture];
+	ASSERT(rEntry.bAlive);
+
+	for (u32 mip = rEntry.residentMip; mip < rEntry.numMips; ++mip)
+	{
+		m_residentBytes -= rEntry.mipBytes[mip];
+	}
+	rEntry.bAlive = false;
+
+	// A load in flight still points at this handle, it is recycled once that reports back.
+	if (!rEntry.bLoading)
+	{
+		m_freeHandles.push_back(texture);
+	}
+}
+
+void TextureResidency::set_screen_size(Handle texture, f32 pixels, u64 frame)
+{
+	Entry& rEntry = m_entries[texture];
+	ASSERT(rEntry.bAlive);
+
+	// Several draws of one texture in a frame, the largest decides.
+	if (rEntry.lastVisibleFrame == frame)
+	{
+		rEntry.screenPixels = std::max(rEntry.screenPixels, pixels);
+	}
+	else
+	{
+		rEntry.screenPixels = pixels;
+		rEntry.lastVisibleFrame = frame;
+	}
+}
+
+f32 TextureResidency::texel_ratio(const Entry& rEntry, u32 mip) const
+{
+	const u32 texels = std::max(std::max(rEntry.width, rEntry.height) >> mip, 1u);
+	return rEntry.screenPixels / static_cast<f32>(texels);
+}
+
+u32 TextureResidency::desired_mip(const Entry& rEntry, u64 frame) const
+{
+	if (rEntry.screenPixels <= 0.0f || frame > rEntry.lastVisibleFrame + kVisibleFrames)
+	{
+		return rEntry.tailMip;
+	}
+
+	// The smallest level that still has a texel per pixel.
+	const f32 texelsPerPixel = static_cast<f32>(std::max(rEntry.width, rEntry.height)) / rEntry.screenPixels;
+	if (texelsPerPixel <= 1.0f)
+	{
+		return 0;
+	}
+	const u32 mip = static_cast<u32>(std::floor(std::log2(texelsPerPixel)));
+	return std::min(mip, rEntry.tailMip);
+}
+
+void TextureResidency::update(u64 frame, std::vector<Request>& rLoadsOut, std::vector<Request>& rEvictionsOut)
+{
+	rLoadsOut.clear();
+	rEvictionsOut.clear();
+
+	for (Entry& rEntry : m_entries)
+	{
+		if (rEntry.bAlive)
+		{
+			rEntry.wantedMip = desired_mip(rEntry, frame);
+		}
+	}
+
+	// The budget went down, give back memory from anything.
+	if (committed_bytes() > m_budget)
+	{
+		make_room(0, kInvalidHandle, 0.0f, rEvictionsOut);
+	}
+
+	m_candidates.clear();
+	for (Handle handle = 0; handle < m_entries.size(); ++handle)
+	{
+		const Entry& rEntry = m_entries[handle];
+		if (rEntry.bAlive && !rEntry.bLoading && rEntry.residentMip > rEntry.wantedMip)
+		{
+			m_candidates.push_back(handle);
+		}
+	}
+
+	// Blurriest first.
+	std::sort(m_candidates.begin(), m_candidates.end(), [this](Handle a, Handle b)
+	{
+		const f32 ratioA = texel_ratio(m_entries[a], m_entries[a].residentMip);
+		const f32 ratioB = texel_ratio(m_entries[b], m_entries[b].residentMip);
+		return ratioA != ratioB ? ratioA > ratioB : a < b;
+	});
+
+	for (Handle handle : m_candidates)
+	{
+		if (m_loadsInFlight >= m_maxLoadsInFlight)
+		{
+			break;
+		}
+
+		Entry& rEntry = m_entries[handle];
+		const u32 mip = rEntry.residentMip - 1;
+		const u64 bytes = rEntry.mipBytes[mip];
+		if (committed_bytes() + bytes > m_budget
+			&& !make_room(bytes, handle, texel_ratio(rEntry, rEntry.residentMip), rEvictionsOut))
+		{
+			// A smaller level further down may still fit.
+			continue;
+		}
+
+		rEntry.bLoading = true;
+		m_inFlightBytes += bytes;
+		++m_loadsInFlight;
+		m_peakCommittedBytes = std::max(m_peakCommittedBytes, committed_bytes());
+		rLoadsOut.push_back({ handle, mip });
+	}
+}
+
+bool TextureResidency::make_room(u64 bytesNeeded, Handle forTexture, f32 forPriority, std::vector<Request>& rEvictionsOut)
+{
+	m_victims.clear();
+	for (Handle handle = 0; handle < m_entries.size(); ++handle)
+	{
+		const Entry& rEntry = m_entries[handle];
+		if (rEntry.bAlive && !rEntry.bLoading && handle != forTexture && rEntry.residentMip < rEntry.tailMip)
+		{
+			m_victims.push_back(handle);
+		}
+	}
+
+	// Mips nobody needs go first, then least recently visible, then the sharpest.
+	std::sort(m_victims.begin(), m_victims.end(), [this](Handle a, Handle b)
+	{
+		const Entry& rA = m_entries[a];
+		const Entry& rB = m_entries[b];
+		const bool bExcessA = rA.residentMip < rA.wantedMip;
+		const bool bExcessB = rB.residentMip < rB.wantedMip;
+		if (bExcessA != bExcessB)
+		{
+			return bExcessA;
+		}
+		if (rA.lastVisibleFrame != rB.lastVisibleFrame)
+		{
+			return rA.lastVisibleFrame < rB.lastVisibleFrame;
+		}
+		const f32 ratioA = texel_ratio(rA, rA.residentMip);
+		const f32 ratioB = texel_ratio(rB, rB.residentMip);
+		return ratioA != ratioB ? ratioA < ratioB : a < b;
+	});
+
+	const u64 target = m_budget >= bytesNeeded ? m_budget - bytesNeeded : 0;
+	const bool bForLoad = forTexture != kInvalidHandle;
+
+	// Count what we could free before touching anything, a load that still
+	// wouldn't fit should not cost anyone their mips.
+	u64 committed = committed_bytes();
+	size_t numVictims = 0;
+	std::vector<u32> newResident;
+	newResident.reserve(m_victims.size());
+	for (; numVictims < m_victims.size() && committed > target; ++numVictims)
+	{
+		const Entry& rEntry = m_entries[m_victims[numVictims]];
+		u32 mip = rEntry.residentMip;
+		while (mip < rEntry.tailMip && committed > target)
+		{
+			const bool bExcess = mip < rEntry.wantedMip;
+			if (bForLoad && !bExcess && texel_ratio(rEntry, mip + 1) * kSwapHysteresis >= forPriority)
+			{
+				break;
+			}
+			committed -= rEntry.mipBytes[mip];
+			++mip;
+		}
+		newResident.push_back(mip);
+	}
+
+	if (bForLoad && committed > target)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < numVictims; ++i)
+	{
+		while (m_entries[m_victims[i]].residentMip < newResident[i])
+		{
+			evict_top(m_victims[i], rEvictionsOut);
+		}
+	}
+	return committed <= target;
+}
+
+void TextureResidency::evict_top(Handle texture, std::vector<Request>& rEvictionsOut)
+{
+	Entry& rEntry = m_entries[texture];
+	ASSERT(rEntry.residentMip < rEntry.tailMip);
+
+	m_residentBytes -= rEntry.mipBytes[rEntry.residentMip];
+	++rEntry.residentMip;
+	++m_mipsEvicted;
+
+	// Several levels off one texture in a frame are applied as a single eviction.
+	for (Request& rEviction : rEvictionsOut)
+	{
+		if (rEviction.texture == texture)
+		{
+			rEviction.mip = rEntry.residentMip;
+			return;
+		}
+	}
+	rEvictionsOut.push_back({ texture, rEntry.residentMip });
+}
+
+void TextureResidency::on_loaded(const Request& rLoad, bool bSuccess)
+{
+	Entry& rEntry = m_entries[rLoad.texture];
+	ASSERT(rEntry.bLoading);
+
+	rEntry.bLoading = false;
+	m_inFlightBytes -= rEntry.mipBytes[rLoad.mip];
+	--m_loadsInFlight;
+
+	if (!rEntry.bAlive)
+	{
+		m_freeHandles.push_back(rLoad.texture);
+		return;
+	}
+
+	if (!bSuccess)
+	{
+		++m_loadsFailed;
+		return;
+	}
+
+	// Textures with a load in flight are never evicted, so this is always the next level up.
+	ASSERT(rLoad.mip + 1 == rEntry.residentMip);
+	rEntry.residentMip = rLoad.mip;
+	m_residentBytes += rEntry.mipBytes[rLoad.mip];
+	++m_mipsLoaded;
+}
+
+u32 TextureResidency::resident_mip(Handle texture) const
+{
+	return m_entries[texture].residentMip;
+}
+
+u32 TextureResidency::wanted_mip(Handle texture) const
+{
+	return m_entries[texture].wantedMip;
+}
+
+TextureResidency::Stats TextureResidency::stats() const
+{
+	Stats s = {};
+	for (const Entry& rEntry : m_entries)
+	{
+		s.numTextures += rEntry.bAlive ? 1 : 0;
+	}
+	s.loadsInFlight = m_loadsInFlight;
+	s.residentBytes = m_residentBytes;
+	s.inFlightBytes = m_inFlightBytes;
+	s.peakCommittedBytes = m_peakCommittedBytes;
+	s.mipsLoaded = m_mipsLoaded;
+	s.mipsEvicted = m_mipsEvicted;
+	s.loadsFailed = m_loadsFailed;
+	return s;
+}
+
+f32 TextureResidency::projected_size(f32 radius, f32 distance, f32 fovY, f32 viewportHeight)
+{
+	// Inside the sphere it fills the screen.
+	distance = std::max(distance, radius);
+	return radius * viewportHeight / (distance * std::tan(fovY * 0.5f));
+}
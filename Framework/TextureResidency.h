@@ -0,0 +1,133 @@
+#pragma once
+
+#include "CoreTypes.h"
+
+#include <vector>
+
+//================================================================================
+// TextureResidency
+// Decides which mips of streamed textures should be in memory.
+// Platform independent, it only does the bookkeeping: the caller reads the
+// mips it is asked for, uploads them and reports back with on_loaded(), and
+// applies evictions by dropping the top mips of a texture.
+//
+// Each texture keeps a tail of small mips resident at all times. Above that,
+// levels are streamed one at a time from the tail upwards, most blurry first
+// (screen pixels per resident texel), until the level that matches the
+// texture's size on screen is resident.
+//
+// Resident plus in flight bytes never exceed the budget. When a load does not
+// fit, mips above what their texture currently needs are evicted, least
+// recently visible first. A texture that is still on screen only loses mips
+// to one that is far blurrier, so two textures can't keep swapping a level.
+//================================================================================
+
+class TextureResidency
+{
+public:
+	using Handle = u32;
+	static const Handle kInvalidHandle = ~0u;
+
+	// One mip to stream in, or the new top mip after dropping everything above it.
+	struct Request
+	{
+		Handle texture;
+		u32 mip;
+	};
+
+	struct Stats
+	{
+		u32 numTextures;
+		u32 loadsInFlight;
+		u64 residentBytes;
+		u64 inFlightBytes;
+		u64 peakCommittedBytes;	// Highest resident + in flight seen.
+		u64 mipsLoaded;
+		u64 mipsEvicted;
+		u64 loadsFailed;
+	};
+
+	TextureResidency();
+
+	// Bytes of GPU memory the streamed mips may use. The tails are counted too.
+	// Lowering the budget evicts on the next update().
+	void set_budget(u64 budgetBytes);
+	u64 budget() const { return m_budget; }
+
+	// Limit on reads issued at once, more queue up in priority order.
+	void set_max_loads_in_flight(u32 maxLoads);
+
+	// Register a texture, pMipBytes holds the size of each level starting with the largest.
+	// The last numTailMips levels are resident from the start.
+	Handle add(u32 width, u32 height, u32 numMips, const u64* pMipBytes, u32 numTailMips);
+
+	// Forget a texture, its resident bytes are released. Loads still in flight for it are ignored.
+	void remove(Handle texture);
+
+	// How many pixels the largest side of the texture covers on screen this frame.
+	// Textures that are not touched for a few frames count as off screen.
+	void set_screen_size(Handle texture, f32 pixels, u64 frame);
+
+	// Pick evictions and loads for this frame. Evictions are decided before loads
+	// and their bytes are released immediately, so apply them first.
+	void update(u64 frame, std::vector<Request>& rLoadsOut, std::vector<Request>& rEvictionsOut);
+
+	// A load requested by update() finished, on failure the level stays unresident
+	// and is requested again later.
+	void on_loaded(const Request& rLoad, bool bSuccess);
+
+	// Highest resolution level in memory, the smallest index.
+	u32 resident_mip(Handle texture) const;
+
+	// Level that matches the on screen size, what the texture is streaming towards.
+	u32 wanted_mip(Handle texture) const;
+
+	u64 resident_bytes() const { return m_residentBytes; }
+	u64 committed_bytes() const { return m_residentBytes + m_inFlightBytes; }
+	Stats stats() const;
+
+	// Largest side in pixels of a sphere of the given radius at a distance from the camera.
+	static f32 projected_size(f32 radius, f32 distance, f32 fovY, f32 viewportHeight);
+
+private:
+	struct Entry
+	{
+		u32 width = 0;			// Level 0.
+		u32 height = 0;
+		u32 numMips = 0;
+		u32 tailMip = 0;		// First level of the always resident tail.
+		u32 residentMip = 0;
+		u32 wantedMip = 0;
+		bool bLoading = false;
+		bool bAlive = false;
+		f32 screenPixels = 0.0f;
+		u64 lastVisibleFrame = 0;
+		std::vector<u64> mipBytes;
+	};
+
+	// Screen pixels per texel of the given level, above 1 means the level is too blurry.
+	f32 texel_ratio(const Entry& rEntry, u32 mip) const;
+	u32 desired_mip(const Entry& rEntry, u64 frame) const;
+
+	// Drop top mips, cheapest first, until bytesNeeded fit. Loads only take memory
+	// from textures it should hurt less than it helps, eviction under a lowered budget takes any.
+	bool make_room(u64 bytesNeeded, Handle forTexture, f32 forPriority, std::vector<Request>& rEvictionsOut);
+	void evict_top(Handle texture, std::vector<Request>& rEvictionsOut);
+
+	std::vector<Entry> m_entries;
+	std::vector<Handle> m_freeHandles;
+
+	u64 m_budget = 0;
+	u32 m_maxLoadsInFlight = 8;
+	u32 m_loadsInFlight = 0;
+	u64 m_residentBytes = 0;
+	u64 m_inFlightBytes = 0;
+	u64 m_peakCommittedBytes = 0;
+	u64 m_mipsLoaded = 0;
+	u64 m_mipsEvicted = 0;
+	u64 m_loadsFailed = 0;
+
+	// Scratch for update().
+	std::vector<Handle> m_candidates;
+	std::vector<Handle> m_victims;
+};
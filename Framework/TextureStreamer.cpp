@@ -0,0 +1,327 @@
+#include "TextureStreamer.h"
+#include "Framework.h"
+#include "AssetPack.h"
+#include "IoService.h"
+#include "TextureData.h"
+
+// ========================================================
+// StreamingTexture
+// ========================================================
+
+StreamingTexture::~StreamingTexture()
+{
+	SAFE_RELEASE(m_pTextureView);
+	SAFE_RELEASE(m_pTexture);
+}
+
+void StreamingTexture::set_screen_size(f32 pixels)
+{
+	m_pStreamer->m_residency.set_screen_size(m_handle, pixels, m_pStreamer->m_frame);
+}
+
+void StreamingTexture::bind(ID3D11DeviceContext* pDeviceContext, ShaderStage::ShaderStageEnum stage, u32 slot) const
+{
+	switch (stage)
+	{
+	case ShaderStage::kVertex:
+		pDeviceContext->VSSetShaderResources(slot, 1, &m_pTextureView);
+		break;
+	case ShaderStage::kHull:
+		pDeviceContext->HSSetShaderResources(slot, 1, &m_pTextureView);
+		break;
+	case ShaderStage::kDomain:
+		pDeviceContext->DSSetShaderResources(slot, 1, &m_pTextureView);
+		break;
+	case ShaderStage::kGeometry:
+		pDeviceContext->GSSetShaderResources(slot, 1, &m_pTextureView);
+		break;
+	case ShaderStage::kPixel:
+		pDeviceContext->PSSetShaderResources(slot, 1, &m_pTextureView);
+		break;
+	case ShaderStage::kCompute:
+		pDeviceContext->CSSetShaderResources(slot, 1, &m_pTextureView);
+		break;
+	}
+}
+
+// ========================================================
+// TextureStreamer
+// ========================================================
+
+TextureStreamer::TextureStreamer()
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	shutdown();
+}
+
+void TextureStreamer::init(ID3D11Device* pDevice, IoService* pIoService, u64 budgetBytes, u32 maxLoadsInFlight)
+{
+	ASSERT(!m_pDevice);
+
+	m_pDevice = pDevice;
+	m_pIoService = pIoService;
+	m_residency.set_budget(budgetBytes);
+	m_residency.set_max_loads_in_flight(maxLoadsInFlight);
+	m_rateStartUs = getTimeMicroseconds();
+}
+
+void TextureStreamer::shutdown()
+{
+	if (!m_pDevice)
+	{
+		return;
+	}
+
+	// Callbacks still hold texture pointers.
+	m_pIoService->wait_all();
+	for (Arrival& rArrival : m_arrivals)
+	{
+		release_loaded_file(rArrival.pData);
+	}
+	m_arrivals.clear();
+	m_textures.clear();
+
+	m_residency = TextureResidency();
+	m_pDevice = nullptr;
+	m_pIoService = nullptr;
+}
+
+StreamingTexture* TextureStreamer::add(const char* pFilename)
+{
+	ASSERT(m_pDevice);
+
+	// Mapped, so only the header and the tail are actually read here.
+	FileView view;
+	if (!open_asset(pFilename, view, 16, 0))
+	{
+		panicF("Could not load texture : %s ", pFilename);
+	}
+
+	TextureData data;
+	const char* pError = nullptr;
+	if (!parse_dds(view.pData, view.size, data, &pError))
+	{
+		panicF("Could not load texture : %s (%s)", pFilename, pError);
+	}
+	if (data.dimension != kTexture2D || data.arraySize != 1 || data.isCubeMap)
+	{
+		panicF("Could not stream texture : %s (only single 2D textures can be streamed)", pFilename);
+	}
+
+	std::unique_ptr<StreamingTexture> pTexture(new StreamingTexture());
+	pTexture->m_pStreamer = this;
+	pTexture->m_filename = pFilename;
+	pTexture->m_format = data.format;
+	pTexture->m_mips.resize(data.mipLevels);
+
+	std::vector<u64> mipBytes(data.mipLevels);
+	for (u32 mip = 0; mip < data.mipLevels; ++mip)
+	{
+		const TextureSubresource& rSub = data.subresource(mip, 0);
+		StreamingTexture::MipSource& rSource = pTexture->m_mips[mip];
+		rSource.offset = static_cast<u64>(rSub.pData - view.pData);
+		rSource.size = rSub.slicePitch;
+		rSource.width = rSub.width;
+		rSource.height = rSub.height;
+		rSource.rowPitch = rSub.rowPitch;
+		mipBytes[mip] = rSub.slicePitch;
+	}
+
+	// The tail starts at the first level small enough, every level above it must be
+	// usable as the top of a texture, which for block formats means a multiple of 4.
+	u32 tailMip = 0;
+	while (tailMip + 1 < data.mipLevels && std::max(pTexture->m_mips[tailMip].width, pTexture->m_mips[tailMip].height) > kTailSize)
+	{
+		++tailMip;
+	}
+	if (texture_format_is_compressed(data.format))
+	{
+		for (u32 mip = 0; mip <= tailMip; ++mip)
+		{
+			const StreamingTexture::MipSource& rSource = pTexture->m_mips[mip];
+			if ((rSource.width & 3) || (rSource.height & 3))
+			{
+				tailMip = mip > 0 ? mip - 1 : 0;
+				break;
+			}
+		}
+	}
+
+	std::vector<D3D11_SUBRESOURCE_DATA> initData(data.mipLevels - tailMip);
+	for (u32 mip = tailMip; mip < data.mipLevels; ++mip)
+	{
+		const TextureSubresource& rSub = data.subresource(mip, 0);
+		initData[mip - tailMip].pSysMem = rSub.pData;
+		initData[mip - tailMip].SysMemPitch = rSub.rowPitch;
+		initData[mip - tailMip].SysMemSlicePitch = rSub.slicePitch;
+	}
+	if (!create_levels(*pTexture, tailMip, initData.data(), &pTexture->m_pTexture, &pTexture->m_pTextureView))
+	{
+		panicF("Could not create texture : %s ", pFilename);
+	}
+	close_asset(view);
+
+	pTexture->m_residentMip = tailMip;
+	pTexture->m_handle = m_residency.add(data.width, data.height, data.mipLevels, mipBytes.data(), data.mipLevels - tailMip);
+
+	const TextureResidency::Handle handle = pTexture->m_handle;
+	if (handle >= m_textures.size())
+	{
+		m_textures.resize(handle + 1);
+	}
+	m_textures[handle] = std::move(pTexture);
+	return m_textures[handle].get();
+}
+
+void TextureStreamer::set_budget(u64 budgetBytes)
+{
+	m_residency.set_budget(budgetBytes);
+}
+
+void TextureStreamer::update(ID3D11DeviceContext* pContext)
+{
+	ASSERT(m_pDevice);
+
+	{
+		std::lock_guard<std::mutex> lock(m_arrivalMutex);
+		m_uploads.swap(m_arrivals);
+	}
+
+	for (Arrival& rArrival : m_uploads)
+	{
+		StreamingTexture& rTexture = *rArrival.pTexture;
+		if (rArrival.pData)
+		{
+			rebuild(pContext, rTexture, rArrival.load.mip, rArrival.pData);
+			m_bytesStreamed += rTexture.m_mips[rArrival.load.mip].size;
+			++m_rateMips;
+			release_loaded_file(rArrival.pData);
+		}
+		else
+		{
+			errorF("TextureStreamer : failed to read mip %u of %s", rArrival.load.mip, rTexture.m_filename.c_str());
+		}
+		m_residency.on_loaded(rArrival.load, rArrival.pData != nullptr);
+	}
+	m_uploads.clear();
+
+	m_residency.update(m_frame, m_loads, m_evictions);
+
+	for (const TextureResidency::Request& rEviction : m_evictions)
+	{
+		rebuild(pContext, *m_textures[rEviction.texture], rEviction.mip, nullptr);
+	}
+
+	for (const TextureResidency::Request& rLoad : m_loads)
+	{
+		StreamingTexture* pTexture = m_textures[rLoad.texture].get();
+		const StreamingTexture::MipSource& rSource = pTexture->m_mips[rLoad.mip];
+		m_pIoService->queue_read_range(pTexture->m_filename.c_str(), rSource.offset, rSource.size,
+			[this, pTexture, rLoad](IoRequest& r)
+		{
+			// A short read means the file changed under us, treat it as a failure.
+			memtype_t* pData = nullptr;
+			if (r.success && r.size == pTexture->m_mips[rLoad.mip].size)
+			{
+				pData = r.pData;
+				r.pData = nullptr;
+			}
+
+			std::lock_guard<std::mutex> lock(m_arrivalMutex);
+			m_arrivals.push_back({ pTexture, rLoad, pData });
+		});
+	}
+	if (!m_loads.empty())
+	{
+		m_pIoService->submit();
+	}
+
+	// Rate over roughly the last second.
+	const s64 now = getTimeMicroseconds();
+	if (now - m_rateStartUs >= 1000000)
+	{
+		m_mipsPerSecond = m_rateMips * 1e6 / static_cast<f64>(now - m_rateStartUs);
+		m_rateMips = 0;
+		m_rateStartUs = now;
+	}
+
+	++m_frame;
+}
+
+TextureStreamer::Stats TextureStreamer::stats() const
+{
+	Stats s = {};
+	s.residency = m_residency.stats();
+	s.budgetBytes = m_residency.budget();
+	s.bytesStreamed = m_bytesStreamed;
+	s.mipsPerSecond = m_mipsPerSecond;
+	return s;
+}
+
+bool TextureStreamer::create_levels(StreamingTexture& rTexture, u32 topMip, const D3D11_SUBRESOURCE_DATA* pInitData,
+	ID3D11Texture2D** ppTextureOut, ID3D11ShaderResourceView** ppViewOut)
+{
+	const u32 numLevels = static_cast<u32>(rTexture.m_mips.size()) - topMip;
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = rTexture.m_mips[topMip].width;
+	desc.Height = rTexture.m_mips[topMip].height;
+	desc.MipLevels = numLevels;
+	desc.ArraySize = 1;
+	desc.Format = rTexture.m_format;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	HRESULT hr = m_pDevice->CreateTexture2D(&desc, pInitData, ppTextureOut);
+	if (FAILED(hr))
+	{
+		return false;
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = rTexture.m_format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MipLevels = numLevels;
+
+	hr = m_pDevice->CreateShaderResourceView(*ppTextureOut, &srvDesc, ppViewOut);
+	if (FAILED(hr))
+	{
+		SAFE_RELEASE(*ppTextureOut);
+		return false;
+	}
+	return true;
+}
+
+void TextureStreamer::rebuild(ID3D11DeviceContext* pContext, StreamingTexture& rTexture, u32 topMip, const memtype_t* pTopData)
+{
+	ASSERT(pTopData ? topMip + 1 == rTexture.m_residentMip : topMip > rTexture.m_residentMip);
+
+	ID3D11Texture2D* pTexture = nullptr;
+	ID3D11ShaderResourceView* pView = nullptr;
+	if (!create_levels(rTexture, topMip, nullptr, &pTexture, &pView))
+	{
+		panicF("Could not create texture : %s ", rTexture.m_filename.c_str());
+	}
+
+	if (pTopData)
+	{
+		pContext->UpdateSubresource(pTexture, 0, nullptr, pTopData, rTexture.m_mips[topMip].rowPitch, 0);
+	}
+
+	// Levels both textures share stay on the GPU.
+	const u32 firstCopy = pTopData ? topMip + 1 : topMip;
+	for (u32 mip = firstCopy; mip < rTexture.m_mips.size(); ++mip)
+	{
+		pContext->CopySubresourceRegion(pTexture, mip - topMip, 0, 0, 0, rTexture.m_pTexture, mip - rTexture.m_residentMip, nullptr);
+	}
+
+	SAFE_RELEASE(rTexture.m_pTextureView);
+	SAFE_RELEASE(rTexture.m_pTexture);
+	rTexture.m_pTexture = pTexture;
+	rTexture.m_pTextureView = pView;
+	rTexture.m_residentMip = topMip;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "CommonHeader.h"
+#include "ShaderSet.h"
+#include "TextureResidency.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+class IoService;
+class TextureStreamer;
+
+//================================================================================
+// StreamingTexture
+// A 2D DDS texture that starts with only its small mips in memory, the
+// TextureStreamer reads the larger ones as it is seen closer up and drops
+// them again under memory pressure. The GPU texture only holds the resident
+// levels so evicted mips really free their memory.
+//================================================================================
+class StreamingTexture
+{
+public:
+	~StreamingTexture();
+
+	// Largest side in pixels this texture covers on screen, call each frame it is drawn.
+	// See TextureResidency::projected_size.
+	void set_screen_size(f32 pixels);
+
+	// bind to the pipeline on a particular shader and slot
+	void bind(ID3D11DeviceContext* pDeviceContext, ShaderStage::ShaderStageEnum stage, u32 slot) const;
+
+	// Changes when residency changes, fetch it each frame rather than keeping it.
+	ID3D11ShaderResourceView* view() const { return m_pTextureView; }
+
+	// Highest resolution level currently on the GPU, 0 is the full size image.
+	u32 resident_mip() const { return m_residentMip; }
+	u32 mip_levels() const { return static_cast<u32>(m_mips.size()); }
+
+private:
+	friend class TextureStreamer;
+
+	// Where each level lives in the file.
+	struct MipSource
+	{
+		u64 offset;
+		u64 size;
+		u32 width;
+		u32 height;
+		u32 rowPitch;
+	};
+
+	TextureStreamer* m_pStreamer = nullptr;
+	TextureResidency::Handle m_handle = TextureResidency::kInvalidHandle;
+	std::string m_filename;
+	DXGI_FORMAT m_format = DXGI_FORMAT_UNKNOWN;
+	std::vector<MipSource> m_mips;
+	u32 m_residentMip = 0;
+
+	ID3D11Texture2D* m_pTexture = nullptr;
+	ID3D11ShaderResourceView* m_pTextureView = nullptr;
+};
+
+//================================================================================
+// TextureStreamer
+// Streams mips of StreamingTextures through the IoService within a memory budget.
+// TextureResidency picks what to load and evict, reads complete on the job
+// pool and are uploaded by update() on the thread that owns the device context.
+//
+// Per frame:
+//   pTexture->set_screen_size(...) for everything drawn,
+//   streamer.update(pContext) once, after the draws.
+//================================================================================
+class TextureStreamer
+{
+public:
+	struct Stats
+	{
+		TextureResidency::Stats residency;
+		u64 budgetBytes;
+		u64 bytesStreamed;
+		f64 mipsPerSecond;	// Levels uploaded, averaged over the last second or so.
+	};
+
+	TextureStreamer();
+	~TextureStreamer();
+
+	// pIoService must outlive the streamer. Reads only go out from update().
+	void init(ID3D11Device* pDevice, IoService* pIoService, u64 budgetBytes, u32 maxLoadsInFlight = 8);
+
+	// Waits for reads in flight and releases every texture.
+	void shutdown();
+
+	// Open a single 2D DDS and upload only its mip tail (levels of kTailSize pixels and below).
+	// Block compressed levels that aren't a multiple of 4 can't be the top of a texture,
+	// so those and everything below them go in the tail. Arrays and cube maps panic, use Texture.
+	// The texture is owned by the streamer and lives until shutdown().
+	StreamingTexture* add(const char* pFilename);
+
+	void set_budget(u64 budgetBytes);
+
+	// Upload finished reads, apply evictions and issue new reads.
+	void update(ID3D11DeviceContext* pContext);
+
+	Stats stats() const;
+	const TextureResidency& residency() const { return m_residency; }
+
+	// Largest side of the smallest level that is streamed, everything below is loaded up front.
+	static const u32 kTailSize = 64;
+
+private:
+	friend class StreamingTexture;
+
+	// A read that has finished on the job pool, waiting for update().
+	struct Arrival
+	{
+		StreamingTexture* pTexture;
+		TextureResidency::Request load;
+		memtype_t* pData;	// Null when the read failed.
+	};
+
+	// Recreate the texture holding levels [topMip, end). The top level comes
+	// from pTopData when set, everything else is copied from the old texture.
+	void rebuild(ID3D11DeviceContext* pContext, StreamingTexture& rTexture, u32 topMip, const memtype_t* pTopData);
+	bool create_levels(StreamingTexture& rTexture, u32 topMip, const D3D11_SUBRESOURCE_DATA* pInitData,
+		ID3D11Texture2D** ppTextureOut, ID3D11ShaderResourceView** ppViewOut);
+
+	ID3D11Device* m_pDevice = nullptr;
+	IoService* m_pIoService = nullptr;
+	TextureResidency m_residency;
+	std::vector<std::unique_ptr<StreamingTexture>> m_textures;	// Indexed by residency handle.
+	u64 m_frame = 0;
+
+	std::mutex m_arrivalMutex;
+	std::vector<Arrival> m_arrivals;	// Filled by read callbacks.
+
+	// Scratch for update().
+	std::vector<Arrival> m_uploads;
+	std::vector<TextureResidency::Request> m_loads;
+	std::vector<TextureResidency::Request> m_evictions;
+
+	// Counters.
+	u64 m_bytesStreamed = 0;
+	u64 m_rateMips = 0;
+	s64 m_rateStartUs = 0;
+	f64 m_mipsPerSecond = 0.0;
+};
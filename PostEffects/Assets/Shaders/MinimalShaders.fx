@@ -18,10 +18,20 @@ cbuffer PerFrameCB : register(b0)
 cbuffer PerDrawCB : register(b1)
 {
     matrix matMVP;
+    uint instanceBase;      // First of this draw's instances in gInstances.
+    uint3 perDrawPadding;
 };
 
 Texture2D texture0 : register(t0);
 
+// Model transform of an instance, see InstanceData.h.
+struct InstanceTransform
+{
+    float4 rows[3];
+};
+
+StructuredBuffer<InstanceTransform> gInstances : register(t1);
+
 SamplerState linearMipSampler : register(s0);
 
 
@@ -55,6 +65,24 @@ VertexOutput VS_Mesh(VertexInput input)
     return output;
 }
 
+// As VS_Mesh, the model transform comes from gInstances and the view and
+// projection are applied here instead of on the CPU.
+VertexOutput VS_Mesh_Instanced(VertexInput input, uint instance : SV_InstanceID)
+{
+    const InstanceTransform model = gInstances[instanceBase + instance];
+    const float4 pos = float4(input.pos, 1.0f);
+    const float4 world = float4(dot(pos, model.rows[0]), dot(pos, model.rows[1]), dot(pos, model.rows[2]), 1.0f);
+
+    VertexOutput output;
+    output.vpos  = mul(mul(world, matView), matProjection);
+    output.color = input.color;
+    output.normal = input.normal;
+    output.tangent = input.tangent;
+    output.uv = input.uv;
+
+    return output;
+}
+
 float4 PS_Mesh(VertexOutput input) : SV_TARGET
 {
 	float lightIntensity = dot(normalize(float3(1,1,1)), input.normal);
@@ -133,6 +133,19 @@ float4 Grayscale(float4 col)
 ////	return (distance < d) ? secondClosestColor : closestColor;
 ////}
 
+// Permutation axes, set by the application as D3D_SHADER_MACROs.
+#define ALGORITHM_BAYER 0
+#define ALGORITHM_BAYER_RANDOM 1
+#define ALGORITHM_DOT 2
+
+#ifndef ALGORITHM
+	#define ALGORITHM ALGORITHM_BAYER
+#endif
+
+#ifndef MAT_SIZE
+	#define MAT_SIZE 4
+#endif
+
 static int bayerMatrix2x2[2][2] = { 
 	{0, 2},
 	{3, 1} };
@@ -192,97 +205,79 @@ float rand_1_05(float2 uv)
 	return abs(noise.x + noise.y) * 0.5;
 }
 
-float find_closest_bayer(int x, int y, float c0, int i)
+// The dither is compiled once per algorithm and matrix size (see ShaderPermutations),
+// so the matrix and the algorithm are picked here rather than per pixel.
+#if MAT_SIZE == 2
+	#define BAYER_MATRIX bayerMatrix2x2
+	#define DOT_MATRIX dotMatrix2x2
+#elif MAT_SIZE == 4
+	#define BAYER_MATRIX bayerMatrix4x4
+	#define DOT_MATRIX dotMatrix4x4
+#else
+	#define BAYER_MATRIX bayerMatrix8x8
+	#define DOT_MATRIX dotMatrix8x8
+#endif
+
+float dither_limit(int x, int y)
 {
-	float limit = 0;
-
-	limit = (matSize == 2) ? (x < matSize) ? (bayerMatrix2x2[x][y] + 1) / matSizeSq : 0.0f : limit;
-	limit = (matSize == 4) ? (x < matSize) ? (bayerMatrix4x4[x][y] + 1) / matSizeSq : 0.0f : limit;
-	limit = (matSize == 8) ? (x < matSize) ? (bayerMatrix8x8[x][y] + 1) / matSizeSq : 0.0f : limit;
-
-	return(c0 < limit) ? colour1[i] : colour2[i];
+#if ALGORITHM == ALGORITHM_DOT
+	return (DOT_MATRIX[x][y] + 1) / float(MAT_SIZE * MAT_SIZE);
+#else
+	return (BAYER_MATRIX[x][y] + 1) / float(MAT_SIZE * MAT_SIZE);
+#endif
 }
 
-float find_closest_bayerR1(int x, int y, float c0, int i)
+// Colour for one pixel, shared by the pixel and compute paths.
+float3 dither_pixel(uint2 pixel, float luminance)
 {
-	float limit = 0;
-
-	limit = (matSize == 4) ? (x < matSize) ? (bayerMatrix4x4v2[x][y] + 1) / matSizeSq : 0.0f : limit;
-
-	return(c0 < limit) ? colour1[i] : colour2[i];
-}
+	int2 xy = pixel % MAT_SIZE;
 
-float find_closest_dot(int x, int y, float c0, int i)
-{
-	float limit = 0;
-
-	limit = (matSize == 2) ? (x < matSize) ? (dotMatrix2x2[x][y] + 1) / matSizeSq : 0.0f : limit;
-	limit = (matSize == 4) ? (x < matSize) ? (dotMatrix4x4[x][y] + 1) / matSizeSq : 0.0f : limit;
-	limit = (matSize == 8) ? (x < matSize) ? (dotMatrix8x8[x][y] + 1) / matSizeSq : 0.0f : limit;
+#if ALGORITHM == ALGORITHM_BAYER_RANDOM
+	// Transpose the matrix for about half the pixels to break up the pattern.
+	if (rand_1_05(float2(pixel) + 0.5f) <= 0.5f)
+	{
+		xy = xy.yx;
+	}
+#endif
 
-	return(c0 < limit) ? colour1[i] : colour2[i];
+	return (luminance < dither_limit(xy.x, xy.y)) ? colour1 : colour2;
 }
 
-float4 PS_PostEffect_Bayer_Dither(VertexOutput input) : SV_TARGET
+float4 PS_PostEffect_Dither(VertexOutput input) : SV_TARGET
 {
 	// Courtesy of: http://devlog-martinsh.blogspot.com/2011/03/glsl-8x8-bayer-matrix-dithering.html
 	float4 col = gColourSurface.Sample(linearMipSampler, input.uv);
 	float4 grayscale = Grayscale(col);
-	float2 xy = input.vpos.xy;
-	int x = (int)(xy.x % matSize);
-	int y = (int)(xy.y % matSize);
-
-	float3 finalRGB;
-
-	finalRGB.x = find_closest_bayer(x, y, grayscale.x, 0);
-	finalRGB.y = find_closest_bayer(x, y, grayscale.y, 1);
-	finalRGB.z = find_closest_bayer(x, y, grayscale.z, 2);
-
-	float finalC = (finalRGB.x > 0.5) ? colour1 : colour2;
 
-	return float4(finalRGB.xyz, 1.0);
+	return float4(dither_pixel(uint2(input.vpos.xy), grayscale.x), 1.0);
 }
 
-float4 PS_PostEffect_Bayer_Dot_Dither(VertexOutput input) : SV_TARGET
-{
-	// Courtesy of: http://devlog-martinsh.blogspot.com/2011/03/glsl-8x8-bayer-matrix-dithering.html
-	float4 col = gColourSurface.Sample(linearMipSampler, input.uv);
-	float4 grayscale = Grayscale(col);
-	float2 xy = input.vpos.xy;
-	int x = (int)(xy.x % matSize);
-	int y = (int)(xy.y % matSize);
+// Compute path, one group per TILE_SIZE x TILE_SIZE tile of the screen.
+// The tile's luminance goes through groupshared memory first so kernels that
+// read neighbours (error diffusion, filters) can share the loads.
+// DitherKernel.cpp emulates this on the CPU, keep the two in step.
+#ifndef TILE_SIZE
+	#define TILE_SIZE 8
+#endif
 
-	float3 finalRGB;
+RWTexture2D<float4> gDitherOutput : register(u0);
 
-	finalRGB.x = find_closest_dot(x, y, grayscale.x, 0);
-	finalRGB.y = find_closest_dot(x, y, grayscale.y, 1);
-	finalRGB.z = find_closest_dot(x, y, grayscale.z, 2);
+groupshared float gTileLuminance[TILE_SIZE * TILE_SIZE];
 
-	float finalC = (finalRGB.x > 0.5) ? colour1 : colour2;
-
-	return float4(finalRGB.xyz, 1.0);
-}
-
-float4 PS_PostEffect_Bayer_Random_Dither(VertexOutput input) : SV_TARGET
+[numthreads(TILE_SIZE, TILE_SIZE, 1)]
+void CS_PostEffect_Dither(uint3 dispatchThread : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex)
 {
-	// Courtesy of: http://devlog-martinsh.blogspot.com/2011/03/glsl-8x8-bayer-matrix-dithering.html
-	float4 col = gColourSurface.Sample(linearMipSampler, input.uv);
-	float4 grayscale = Grayscale(col);
-	float2 xy = input.vpos.xy;
-	int x = (int)(xy.x % matSize);
-	int y = (int)(xy.y % matSize);
-
-	float3 finalRGB;
-
-	float rand = rand_1_05(input.vpos.xy);
+	// Out of range loads return zero.
+	gTileLuminance[groupIndex] = Grayscale(gColourSurface.Load(int3(dispatchThread.xy, 0))).x;
 
-	finalRGB.x = (rand > 0.5f) ? find_closest_bayer(x, y, grayscale.x, 0) : find_closest_bayer(y, x, grayscale.x, 0);
-	finalRGB.y = (rand > 0.5f) ? find_closest_bayer(x, y, grayscale.y, 1) : find_closest_bayer(y, x, grayscale.y, 1);
-	finalRGB.z = (rand > 0.5f) ? find_closest_bayer(x, y, grayscale.z, 2) : find_closest_bayer(y, x, grayscale.z, 2);
+	GroupMemoryBarrierWithGroupSync();
 
-	float finalC = (finalRGB.x > 0.5) ? colour1 : colour2;
-
-	return float4(finalRGB.xyz, 1.0);
+	uint width, height;
+	gDitherOutput.GetDimensions(width, height);
+	if (dispatchThread.x < width && dispatchThread.y < height)
+	{
+		gDitherOutput[dispatchThread.xy] = float4(dither_pixel(dispatchThread.xy, gTileLuminance[groupIndex]), 1.0);
+	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////
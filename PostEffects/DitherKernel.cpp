@@ -0,0 +1,212 @@
+#include "DitherKernel.h"
+#include "ComputeEmulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+// ========================================================
+// Threshold tables, copies of the ones in PostEffectShaders.fx.
+// ========================================================
+
+static const u8 s_bayer2x2[2][2] = {
+	{ 0, 2 },
+	{ 3, 1 } };
+
+static const u8 s_dot2x2[2][2] = {
+	{ 3, 1 },
+	{ 0, 2 } };
+
+static const u8 s_bayer4x4[4][4] = {
+	{ 0,  8,  2,  10 },
+	{ 12, 4,  14, 6 },
+	{ 3,  11, 1,  9 },
+	{ 15, 7,  13, 5 } };
+
+static const u8 s_dot4x4[4][4] = {
+	{ 12, 5,  6,  13 },
+	{ 4,  0,  1,  7 },
+	{ 11, 3,  2,  8 },
+	{ 15, 10, 9,  14 } };
+
+static const u8 s_bayer8x8[8][8] = {
+	{ 0,  32, 8,  40, 2,  34, 10, 42 },
+	{ 48, 16, 56, 24, 50, 18, 58, 26 },
+	{ 12, 44, 4,  36, 14, 46, 6,  38 },
+	{ 60, 28, 52, 20, 62, 30, 54, 22 },
+	{ 3,  35, 11, 43, 1,  33, 9,  41 },
+	{ 51, 19, 59, 27, 49, 17, 57, 25 },
+	{ 15, 47, 7,  39, 13, 45, 5,  37 },
+	{ 63, 31, 55, 23, 61, 29, 53, 21 } };
+
+static const u8 s_dot8x8[8][8] = {
+	{ 24, 10, 12, 26, 35, 47, 49, 37 },
+	{ 8,  0,  2,  14, 45, 59, 61, 51 },
+	{ 22, 6,  4,  16, 43, 57, 63, 53 },
+	{ 30, 20, 18, 28, 33, 41, 55, 39 },
+	{ 34, 46, 48, 36, 25, 11, 13, 27 },
+	{ 44, 58, 60, 50, 9,  1,  3,  15 },
+	{ 42, 56, 62, 52, 23, 7,  5,  17 },
+	{ 32, 40, 54, 38, 31, 21, 19, 29 } };
+
+// dither_limit() for all positions of the selected table, indexed [x * matSize + y].
+static void build_limits(const DitherParams& params, f32* pLimits)
+{
+	const bool bDot = params.algorithm == kDitherDot;
+	const u32 n = params.matSize;
+	for (u32 x = 0; x < n; ++x)
+	{
+		for (u32 y = 0; y < n; ++y)
+		{
+			u32 value;
+			switch (n)
+			{
+			case 2:  value = bDot ? s_dot2x2[x][y] : s_bayer2x2[x][y]; break;
+			case 4:  value = bDot ? s_dot4x4[x][y] : s_bayer4x4[x][y]; break;
+			default: value = bDot ? s_dot8x8[x][y] : s_bayer8x8[x][y]; break;
+			}
+			pLimits[x * n + y] = (value + 1) / f32(n * n);
+		}
+	}
+}
+
+// ========================================================
+// Shader functions
+// ========================================================
+
+static f32 grayscale(const u8* pRgba)
+{
+	return (pRgba[0] / 255.f) * 0.299f + (pRgba[1] / 255.f) * 0.587f + (pRgba[2] / 255.f) * 0.114f;
+}
+
+// rand_1_05() at a pixel centre.
+static f32 rand_1_05(u32 x, u32 y)
+{
+	const f32 d = (x + 0.5f) * (12.9898f * 2.f) + (y + 0.5f) * (78.233f * 2.f);
+	const f32 noise = std::sin(d) * 43758.5453f;
+	return noise - std::floor(noise);
+}
+
+// Float to UNORM as the output merger / UAV store converts it.
+static u8 to_unorm8(f32 value)
+{
+	value = std::min(std::max(value, 0.f), 1.f);
+	return static_cast<u8>(value * 255.f + 0.5f);
+}
+
+// ========================================================
+// Dither
+// ========================================================
+
+void dither_rgba8_cpu(const u8* pSrc, u32 width, u32 height, u32 srcPitch, const DitherParams& params,
+	u8* pDst, u32 dstPitch, JobPool* pPool)
+{
+	ASSERT(params.matSize == 2 || params.matSize == 4 || params.matSize == 8);
+	ASSERT(params.tileSize > 0 && params.tileSize <= kMaxDitherTileSize);
+
+	f32 limits[8 * 8];
+	build_limits(params, limits);
+
+	u8 colours[2][4];
+	for (u32 c = 0; c < 3; ++c)
+	{
+		colours[0][c] = to_unorm8(params.colour1[c]);
+		colours[1][c] = to_unorm8(params.colour2[c]);
+	}
+	colours[0][3] = colours[1][3] = 255;
+
+	const u32 tile = params.tileSize;
+	const u32 n = params.matSize;
+
+	// [numthreads(TILE_SIZE, TILE_SIZE, 1)], see CS_PostEffect_Dither.
+	auto kernel = [&](const ComputeGroup& group)
+	{
+		f32* pTileLuminance = static_cast<f32*>(group.pGroupShared);
+
+		// Every thread loads one pixel of the tile, outside the image reads as black.
+		for (u32 ty = 0; ty < tile; ++ty)
+		{
+			for (u32 tx = 0; tx < tile; ++tx)
+			{
+				const u32 x = group.x * tile + tx;
+				const u32 y = group.y * tile + ty;
+				pTileLuminance[ty * tile + tx] = (x < width && y < height) ? grayscale(pSrc + y * srcPitch + x * 4) : 0.f;
+			}
+		}
+
+		// GroupMemoryBarrierWithGroupSync()
+
+		for (u32 ty = 0; ty < tile; ++ty)
+		{
+			for (u32 tx = 0; tx < tile; ++tx)
+			{
+				const u32 x = group.x * tile + tx;
+				const u32 y = group.y * tile + ty;
+				if (x >= width || y >= height)
+				{
+					continue;
+				}
+
+				u32 mx = x % n;
+				u32 my = y % n;
+				if (params.algorithm == kDitherBayerRandom && rand_1_05(x, y) <= 0.5f)
+				{
+					std::swap(mx, my);
+				}
+
+				const bool bBelow = pTileLuminance[ty * tile + tx] < limits[mx * n + my];
+				memcpy(pDst + y * dstPitch + x * 4, colours[bBelow ? 0 : 1], 4);
+			}
+		}
+	};
+
+	emulate_dispatch(compute_group_count(width, tile), compute_group_count(height, tile), tile * tile * sizeof(f32), kernel, pPool);
+}
+
+ImageDifference compare_rgba8(const u8* pA, u32 pitchA, const u8* pB, u32 pitchB, u32 width, u32 height, u32 tolerance)
+{
+	ImageDifference difference = {};
+	for (u32 y = 0; y < height; ++y)
+	{
+		const u8* pRowA = pA + y * pitchA;
+		const u8* pRowB = pB + y * pitchB;
+		for (u32 x = 0; x < width; ++x)
+		{
+			u32 pixelDifference = 0;
+			for (u32 c = 0; c < 4; ++c)
+			{
+				pixelDifference = std::max<u32>(pixelDifference, std::abs(pRowA[x * 4 + c] - pRowB[x * 4 + c]));
+			}
+			difference.maxDifference = std::max(difference.maxDifference, pixelDifference);
+			difference.numDifferent += pixelDifference > tolerance ? 1 : 0;
+		}
+	}
+	return difference;
+}
+
+void benchmark_dither_tiles(const u8* pSrc, u32 width, u32 height, u32 srcPitch, const DitherParams& params,
+	const u32* pTileSizes, u32 numTileSizes, u32 numRuns, JobPool* pPool, std::vector<DitherTileTiming>& rTimingsOut)
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	std::vector<u8> output(width * height * 4);
+
+	rTimingsOut.clear();
+	for (u32 i = 0; i < numTileSizes; ++i)
+	{
+		DitherParams tileParams = params;
+		tileParams.tileSize = pTileSizes[i];
+
+		DitherTileTiming timing = { pTileSizes[i], 0.0 };
+		for (u32 run = 0; run < numRuns; ++run)
+		{
+			const Clock::time_point start = Clock::now();
+			dither_rgba8_cpu(pSrc, width, height, srcPitch, tileParams, output.data(), width * 4, pPool);
+			const f64 ms = std::chrono::duration<f64, std::milli>(Clock::now() - start).count();
+			timing.ms = (run == 0) ? ms : std::min(timing.ms, ms);
+		}
+		rTimingsOut.push_back(timing);
+	}
+}
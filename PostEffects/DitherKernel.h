@@ -0,0 +1,62 @@
+#pragma once
+
+#include "CoreTypes.h"
+
+#include <vector>
+
+class JobPool;
+
+//================================================================================
+// CPU reference for CS_PostEffect_Dither in PostEffectShaders.fx.
+// Platform independent.
+//
+// Runs the same tile kernel through emulate_dispatch, so the compute path can
+// be checked against it and tile sizes can be compared without a GPU.
+// Images are 8 bit RGBA like the colour surface.
+//================================================================================
+
+// Same order and values as the ALGORITHM_* defines in the shader.
+enum DitherAlgorithm : u32
+{
+	kDitherBayer,
+	kDitherBayerRandom,
+	kDitherDot,
+
+	kNumDitherAlgorithms
+};
+
+struct DitherParams
+{
+	DitherAlgorithm algorithm = kDitherBayer;
+	u32 matSize = 4;					// MAT_SIZE, 2, 4 or 8.
+	u32 tileSize = 8;					// TILE_SIZE, threads along each side of a group, at most kMaxDitherTileSize.
+	f32 colour1[3] = { 0.f, 0.f, 0.f };	// Pixels darker than their threshold.
+	f32 colour2[3] = { 1.f, 1.f, 1.f };
+};
+
+static const u32 kMaxDitherTileSize = 32;
+
+// The TILE_SIZE permutations the shader is built with.
+static const u32 kDitherTileSizeValues[] = { 8, 16, 32 };
+
+// Dither pSrc into pDst, which may not overlap. pPool may be null to run on the calling thread.
+void dither_rgba8_cpu(const u8* pSrc, u32 width, u32 height, u32 srcPitch, const DitherParams& params,
+	u8* pDst, u32 dstPitch, JobPool* pPool = nullptr);
+
+struct ImageDifference
+{
+	u32 numDifferent;	// Pixels with a channel further apart than the tolerance.
+	u32 maxDifference;	// Largest channel difference.
+};
+
+ImageDifference compare_rgba8(const u8* pA, u32 pitchA, const u8* pB, u32 pitchB, u32 width, u32 height, u32 tolerance);
+
+struct DitherTileTiming
+{
+	u32 tileSize;
+	f64 ms;		// Best of the runs.
+};
+
+// Time dither_rgba8_cpu on pSrc once per tile size, params.tileSize is ignored.
+void benchmark_dither_tiles(const u8* pSrc, u32 width, u32 height, u32 srcPitch, const DitherParams& params,
+	const u32* pTileSizes, u32 numTileSizes, u32 numRuns, JobPool* pPool, std::vector<DitherTileTiming>& rTimingsOut);
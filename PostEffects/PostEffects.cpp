@@ -3,11 +3,89 @@
 #include "ShaderSet.h"
 #include "Mesh.h"
 #include "Texture.h"
+#include "IoService.h"
+#include "BindingTable.h"
+#include "StateCache.h"
+#include "ShaderCache.h"
+#include "ShaderReloader.h"
+#include "ShaderPermutations.h"
+#include "ComputeEmulation.h"
+#include "DitherKernel.h"
+#include "RenderGraph.h"
+#include "RenderTargetPool.h"
+#include "ConstantRing.h"
+#include "InstanceData.h"
+#include "CommandLists.h"
+#include "CommandBuffer.h"
+#include "GpuTimer.h"
+#include "FixedTimestep.h"
 #include <string>
 #include <random>
 #define MAX_PALETTES 4
 #define kNumberOfAlgorithms 4
 
+// Dither permutations, the algorithms are in the same order as m_PostEffectNames.
+static const char* const kDitherAlgorithms[] = { "ALGORITHM_BAYER", "ALGORITHM_BAYER_RANDOM", "ALGORITHM_DOT" };
+static const char* const kDitherMatSizes[] = { "2", "4", "8" };
+static const char* const kDitherTileSizes[] = { "8", "16", "32" };	// kDitherTileSizeValues as defines.
+
+// The scene, a grid of instances per model.
+static const f32 kGridSpacing = 1.5f;
+static const u32 kNumInstances = 5;
+static const u32 kNumModelTypes = 4;
+static const u32 kNumGridModels = kNumModelTypes - 2;
+
+// Per instance data in the vertex shader, t1 in MinimalShaders.fx.
+static const u32 kInstanceSlot = 1;
+
+// Instance counts timed by the packing benchmark.
+static const u32 kInstancePackCounts[] = { 10000, 100000, 1000000 };
+
+static ShaderSetDesc dither_shader_desc()
+{
+	return ShaderSetDesc::Create_VS_PS("Assets/Shaders/PostEffectShaders.fx", "VS_PostEffect", "PS_PostEffect_Dither")
+		.add_axis("ALGORITHM", kDitherAlgorithms)
+		.add_axis("MAT_SIZE", kDitherMatSizes);
+}
+
+static ShaderSetDesc dither_compute_desc()
+{
+	return ShaderSetDesc::Create_CS("Assets/Shaders/PostEffectShaders.fx", "CS_PostEffect_Dither")
+		.add_axis("ALGORITHM", kDitherAlgorithms)
+		.add_axis("MAT_SIZE", kDitherMatSizes)
+		.add_axis("TILE_SIZE", kDitherTileSizes);
+}
+
+// Copy an R8G8B8A8 texture to the CPU, tightly packed. Stalls until the GPU has caught up.
+static void read_back_rgba8(ID3D11Device* pDevice, ID3D11DeviceContext* pContext, ID3D11Texture2D* pTexture, std::vector<u8>& rPixelsOut)
+{
+	D3D11_TEXTURE2D_DESC desc;
+	pTexture->GetDesc(&desc);
+	desc.Usage = D3D11_USAGE_STAGING;
+	desc.BindFlags = 0;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	desc.MiscFlags = 0;
+
+	ID3D11Texture2D* pStaging = nullptr;
+	if (FAILED(pDevice->CreateTexture2D(&desc, NULL, &pStaging)))
+	{
+		panicF("Failed to create read back texture");
+	}
+	pContext->CopyResource(pStaging, pTexture);
+
+	rPixelsOut.resize(desc.Width * desc.Height * 4);
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (!FAILED(pContext->Map(pStaging, 0, D3D11_MAP_READ, 0, &mapped)))
+	{
+		for (u32 y = 0; y < desc.Height; ++y)
+		{
+			memcpy(&rPixelsOut[y * desc.Width * 4], static_cast<const u8*>(mapped.pData) + y * mapped.RowPitch, desc.Width * 4);
+		}
+		pContext->Unmap(pStaging, 0);
+	}
+	SAFE_RELEASE(pStaging);
+}
+
 //================================================================================
 // Minimal Application
 // An example of how to use selected parts of this framework.
@@ -28,9 +106,22 @@ public:
 		f32 padding[3];
 	};
 
+	// What the scene animates, stepped at a fixed rate and drawn between the last two steps.
+	struct SceneState
+	{
+		f32 time;	// Seconds of animation, the shaders' time.
+	};
+
+	static void step_scene(const SceneState& previous, SceneState& next, f32 dt)
+	{
+		next.time = previous.time + dt;
+	}
+
 	struct PerDrawCBData
 	{
 		m4x4 m_matMVP;
+		u32 m_instanceBase;		// Instanced draws, first instance in the instance buffer.
+		u32 m_padding[3];
 	};
 
 	struct ColourPreset
@@ -57,21 +148,43 @@ public:
 
 	void SetupModelsAndTextures(SystemsInterface& systems)
 	{
-		// Initialize a mesh directly.
-		create_mesh_cube(systems.pD3DDevice, m_meshArray[0], 0.5f);
+		ID3D11Device* pDevice = systems.pD3DDevice;
+		IoService& io = *systems.pIoService;
+
+		// Read all the asset files in one batch.
+		// Each resource is created on a worker as soon as its data arrives (the D3D11 device is free threaded).
+		auto queueTexture = [this, pDevice, &io](u32 index, const char* pFilename)
+		{
+			io.queue_read(pFilename, [this, pDevice, index](IoRequest& r)
+			{
+				if (!r.success) { panicF("Could not load texture : %s ", r.filename.c_str()); }
+				m_textures[index].init_from_dds_data(pDevice, r.pData, r.size, r.filename.c_str());
+			});
+		};
 
 		////create_mesh_from_obj(systems.pD3DDevice, m_meshArray[1], "Assets/Models/Table2obj.obj", 0.01f);
 
 		// Initialize a mesh from an .OBJ file
-		create_mesh_from_obj(systems.pD3DDevice, m_meshArray[1], "Assets/Models/apple.obj", 0.01f);
-		create_mesh_quad_xy(systems.pD3DDevice, m_meshArray[2], systems.height / 2);
-		create_mesh_quad_xy(systems.pD3DDevice, m_meshArray[3], systems.height / 2);
+		io.queue_read("Assets/Models/apple.obj", [this, pDevice](IoRequest& r)
+		{
+			if (!r.success) { panicF("Error Loading OBJ %s", r.filename.c_str()); }
+			create_mesh_from_obj_data(pDevice, m_meshArray[1], r.pData, r.size, r.filename.c_str(), 0.01f);
+		});
 
 		// Initialise some textures;
-		m_textures[0].init_from_dds(systems.pD3DDevice, "Assets/Textures/gradient.dds");
-		m_textures[1].init_from_dds(systems.pD3DDevice, "Assets/Textures/apple_diffuse.dds");
-		m_textures[2].init_from_dds(systems.pD3DDevice, "Assets/Textures/lenna.dds");
-		m_textures[3].init_from_dds(systems.pD3DDevice, "Assets/Textures/gradient.dds");
+		queueTexture(0, "Assets/Textures/gradient.dds");
+		queueTexture(1, "Assets/Textures/apple_diffuse.dds");
+		queueTexture(2, "Assets/Textures/lenna.dds");
+		queueTexture(3, "Assets/Textures/gradient.dds");
+
+		io.submit();
+
+		// Initialize a mesh directly while the reads are in flight.
+		create_mesh_cube(pDevice, m_meshArray[0], 0.5f);
+		create_mesh_quad_xy(pDevice, m_meshArray[2], systems.height / 2);
+		create_mesh_quad_xy(pDevice, m_meshArray[3], systems.height / 2);
+
+		io.wait_all();
 	}
 
 	void SetupPalettes()
@@ -132,16 +245,8 @@ public:
 		ImGui::Text("\n------ Algorithm Controls ------");
 		ImGui::Text("Dither Algorithm");
 		
-		if (ImGui::ListBox("", &m_postEffect, &m_PostEffectNames[0], kNumberOfAlgorithms))
-		{
-			std::string algorithmToUse = "PS_PostEffect_";
-			algorithmToUse += m_PostEffectNames[m_postEffect];
-
-			m_postEffectShader.init(systems.pD3DDevice
-				, ShaderSetDesc::Create_VS_PS("Assets/Shaders/PostEffectShaders.fx", "VS_PostEffect", algorithmToUse.c_str())
-				, { VertexFormatTraits<MeshVertex>::desc, VertexFormatTraits<MeshVertex>::size }
-			);
-		}
+		// Every variant is compiled up front, switching is just picking another set.
+		ImGui::ListBox("", &m_postEffect, &m_PostEffectNames[0], kNumberOfAlgorithms);
 
 		if (m_postEffect < kNumberOfAlgorithms - 1)
 		{
@@ -154,10 +259,95 @@ public:
 
 				}
 				m_matSizeSq = m_matSize * m_matSize;
+				m_ditherMatSize = m_ditherShaders.find_value(1, std::to_string(m_matSize).c_str());
 			}
 
 			ImGui::Text(("Matrix Size: " + std::to_string(m_matSize) + "x" + std::to_string(m_matSize)).c_str());
+
+			if (m_bComputeSupported)
+			{
+				ImGui::Checkbox("Compute shader", &m_bComputeDither);
+			}
+			if (m_bComputeDither)
+			{
+				if (ImGui::Button("Change Tile Size"))
+				{
+					m_ditherTileSize = (m_ditherTileSize + 1) % ARRAYSIZE(kDitherTileSizeValues);
+				}
+				ImGui::SameLine();
+				ImGui::Text("Tile Size: %ux%u", kDitherTileSizeValues[m_ditherTileSize], kDitherTileSizeValues[m_ditherTileSize]);
+
+				if (ImGui::Button("Check against CPU"))
+				{
+					m_bCheckDither = true;
+				}
+				if (m_ditherCheck.bValid)
+				{
+					ImGui::Text("CPU reference: %u pixels differ (max %u)", m_ditherCheck.difference.numDifferent, m_ditherCheck.difference.maxDifference);
+					for (const DitherTileTiming& rTiming : m_ditherCheck.timings)
+					{
+						ImGui::Text("  CPU %ux%u tiles: %.2f ms", rTiming.tileSize, rTiming.tileSize, rTiming.ms);
+					}
+				}
+			}
+		}
+
+		ImGui::Text("--------------------------------");
+		ImGui::Text("\n------ Effect Chain ------");
+		ImGui::Checkbox("Pixelate", &m_bPixelate);
+		ImGui::Checkbox("Cross Stitch", &m_bCrossStitch);
+
+		// Last frame's graph.
+		const RenderGraph::Stats& graphStats = m_renderGraph.stats();
+		ImGui::Text("Passes: %u (%u culled)", graphStats.numPasses - graphStats.numCulled, graphStats.numCulled);
+		ImGui::Text("Targets: %u on %u textures, %.1f MB (%.1f MB unaliased)", graphStats.numTransient, graphStats.numPhysical,
+			graphStats.physicalBytes / (1024.0 * 1024.0), graphStats.unaliasedBytes / (1024.0 * 1024.0));
+
+		// GPU time of each pass, from a few frames ago.
+		const GpuTimer& gpuTimer = *systems.pGpuTimer;
+		ImGui::Text("GPU: %.2f ms (%u frames behind)", gpuTimer.frame_ms(), gpuTimer.latency());
+		for (const GpuPassTiming& rTiming : gpuTimer.timings())
+		{
+			ImGui::Text("  %*s%s: %.3f ms", rTiming.depth * 2, "", rTiming.pName, rTiming.ms);
+		}
+
+		ImGui::Text("--------------------------------");
+		ImGui::Text("\n------ Instancing ------");
+		ImGui::Checkbox("Hardware instancing", &m_bInstanced);
+		if (!m_bInstanced)
+		{
+			ImGui::Checkbox("Record draws on workers", &m_bRecordOnWorkers);
+			if (m_bRecordOnWorkers)
+			{
+				const CommandRecorder::Stats& recorderStats = systems.pRecorder->stats();
+				ImGui::Text("  %u command lists on %u contexts", recorderStats.chunks, systems.pRecorder->num_contexts());
+			}
+		}
+		systems.pRecorder->reset_stats();
+		if (ImGui::Button("Benchmark instance packing"))
+		{
+			benchmark_instance_packing(kInstancePackCounts, ARRAYSIZE(kInstancePackCounts), 3, systems.pJobPool, m_instancePackTimings);
 		}
+		for (const InstancePackTiming& rTiming : m_instancePackTimings)
+		{
+			ImGui::Text("  %u instances: %.2f ms, %.2f ms on the job pool", rTiming.count, rTiming.serialMs, rTiming.pooledMs);
+		}
+
+		ImGui::Text("--------------------------------");
+		ImGui::Text("\n------ Simulation ------");
+		FixedTimestep& sceneSteps = m_scene.timestep();
+		f32 sceneHz = static_cast<f32>(sceneSteps.rate_hz());
+		if (ImGui::SliderFloat("Steps a second", &sceneHz, 10.f, 240.f, "%.0f"))
+		{
+			sceneSteps.set_rate_hz(sceneHz);
+		}
+		bool bSceneOnWorker = m_scene.threaded();
+		if (ImGui::Checkbox("Step on a worker", &bSceneOnWorker))
+		{
+			m_scene.set_job_pool(bSceneOnWorker ? systems.pJobPool : nullptr);
+		}
+		ImGui::Text("  %u steps this frame (%.3f ms), alpha %.2f, %.1f s dropped", m_scene.frame_steps(), m_scene.steps_ms(),
+			m_scene.alpha(), sceneSteps.dropped_seconds());
 
 		ImGui::Text("--------------------------------");
 		ImGui::Text("\n------ Colour Controls ------");
@@ -186,6 +376,34 @@ public:
 
 		ImGui::Text(("Colour Set: " + m_colourName).c_str());
 		ImGui::Text("--------------------------------");
+
+		// Called before this frame's draws, so these are last frame's binds.
+		const BindingTable::Stats bindingStats = systems.pBindings->stats();
+		ImGui::Text("Bind calls: %u (%u of %u binds skipped)", bindingStats.calls, bindingStats.bindsSkipped, bindingStats.bindsRequested);
+		systems.pBindings->reset_stats();
+
+		const StateCache::Stats& stateStats = systems.pStateCache->stats();
+		ImGui::Text("State calls: %u (%u redundant skipped)", stateStats.total_sent(), stateStats.total_skipped());
+		systems.pStateCache->reset_stats();
+
+		const CommandBuffer::Stats& commandStats = systems.pCommands->stats();
+		ImGui::Text("Draws: %u, dispatches: %u, buffer writes: %u (%.1f KB)", commandStats.draws, commandStats.dispatches,
+			commandStats.bufferUpdates, commandStats.bytesUpdated / 1024.0f);
+		systems.pCommands->reset_stats();
+
+		const ConstantRing::Stats& constantStats = systems.pConstants->stats();
+		ImGui::Text("Constant maps: %u for %u draws (%.1f KB)", constantStats.uploads, constantStats.slices, constantStats.bytes / 1024.0f);
+		systems.pConstants->reset_stats();
+
+		const ShaderCacheStats shaderStats = shader_cache_stats();
+		ImGui::Text("Shaders: %u compiled (%.0f ms), %u cached", shaderStats.compiles, shaderStats.compileMs, shaderStats.memoryHits + shaderStats.diskHits);
+
+		const std::string& shaderError = systems.pShaderReloader->last_error();
+		if (!shaderError.empty())
+		{
+			ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Shader error, using the last good version:");
+			ImGui::TextWrapped("%s", shaderError.c_str());
+		}
 	}
 
 	void on_init(SystemsInterface& systems) override
@@ -207,7 +425,8 @@ public:
 		SetupPostProcessNames();
 		SetupPalettes();
 
-		// Create our rendering and depth surfaces.
+		// Create our depth surface, the colour targets are made by the render graph.
+		m_renderTargets.init(systems.pD3DDevice);
 		create_render_surfaces(systems.pD3DDevice, systems.pD3DContext, systems.width, systems.height);
 
 		// create fullscreen quad for post-fx / lighting passes. (-1, 1) in XY
@@ -225,31 +444,87 @@ public:
 			, ShaderSetDesc::Create_VS_PS("Assets/Shaders/MinimalShaders.fx", "VS_Mesh", "PS_Mesh")
 			, { VertexFormatTraits<MeshVertex>::desc, VertexFormatTraits<MeshVertex>::size }
 		);
-
-		std::string algorithmToUse = "PS_PostEffect_";
-		algorithmToUse += m_PostEffectNames[m_postEffect];
+		m_meshInstancedShader.init(systems.pD3DDevice
+			, ShaderSetDesc::Create_VS_PS("Assets/Shaders/MinimalShaders.fx", "VS_Mesh_Instanced", "PS_Mesh")
+			, { VertexFormatTraits<MeshVertex>::desc, VertexFormatTraits<MeshVertex>::size }
+		);
 
 		// Compile a set of shaders for our post effect
 		m_postEffectShader.init(systems.pD3DDevice
-			, ShaderSetDesc::Create_VS_PS("Assets/Shaders/PostEffectShaders.fx", "VS_PostEffect", algorithmToUse.c_str())
+			, ShaderSetDesc::Create_VS_PS("Assets/Shaders/PostEffectShaders.fx", "VS_PostEffect", "PS_PostEffect_None")
+			, { VertexFormatTraits<MeshVertex>::desc, VertexFormatTraits<MeshVertex>::size }
+		);
+
+		// Effects that can go before the dither.
+		m_pixelateShader.init(systems.pD3DDevice
+			, ShaderSetDesc::Create_VS_PS("Assets/Shaders/PostEffectShaders.fx", "VS_PostEffect", "PS_PostEffect_Pixelate")
+			, { VertexFormatTraits<MeshVertex>::desc, VertexFormatTraits<MeshVertex>::size }
+		);
+		m_crossStitchShader.init(systems.pD3DDevice
+			, ShaderSetDesc::Create_VS_PS("Assets/Shaders/PostEffectShaders.fx", "VS_PostEffect", "PS_PostEffect_CrossStitch")
+			, { VertexFormatTraits<MeshVertex>::desc, VertexFormatTraits<MeshVertex>::size }
+		);
+
+		// And one per dither algorithm and matrix size.
+		m_ditherShaders.init(systems.pD3DDevice
+			, dither_shader_desc()
+			, { VertexFormatTraits<MeshVertex>::desc, VertexFormatTraits<MeshVertex>::size }
+		);
+		m_ditherMatSize = m_ditherShaders.find_value(1, std::to_string(m_matSize).c_str());
+
+		// The compute path needs cs_5_0.
+		m_bComputeSupported = systems.pD3DDevice->GetFeatureLevel() >= D3D_FEATURE_LEVEL_11_0;
+		if (m_bComputeSupported)
+		{
+			m_ditherComputeShaders.init(systems.pD3DDevice, dither_compute_desc(), { nullptr, 0 });
+		}
+
+		// Pick up edits to the .fx files while running.
+		systems.pShaderReloader->watch(m_meshShader
+			, ShaderSetDesc::Create_VS_PS("Assets/Shaders/MinimalShaders.fx", "VS_Mesh", "PS_Mesh")
+			, { VertexFormatTraits<MeshVertex>::desc, VertexFormatTraits<MeshVertex>::size }
+		);
+		systems.pShaderReloader->watch(m_meshInstancedShader
+			, ShaderSetDesc::Create_VS_PS("Assets/Shaders/MinimalShaders.fx", "VS_Mesh_Instanced", "PS_Mesh")
 			, { VertexFormatTraits<MeshVertex>::desc, VertexFormatTraits<MeshVertex>::size }
 		);
+		systems.pShaderReloader->watch(m_postEffectShader
+			, ShaderSetDesc::Create_VS_PS("Assets/Shaders/PostEffectShaders.fx", "VS_PostEffect", "PS_PostEffect_None")
+			, { VertexFormatTraits<MeshVertex>::desc, VertexFormatTraits<MeshVertex>::size }
+		);
+		systems.pShaderReloader->watch(m_pixelateShader
+			, ShaderSetDesc::Create_VS_PS("Assets/Shaders/PostEffectShaders.fx", "VS_PostEffect", "PS_PostEffect_Pixelate")
+			, { VertexFormatTraits<MeshVertex>::desc, VertexFormatTraits<MeshVertex>::size }
+		);
+		systems.pShaderReloader->watch(m_crossStitchShader
+			, ShaderSetDesc::Create_VS_PS("Assets/Shaders/PostEffectShaders.fx", "VS_PostEffect", "PS_PostEffect_CrossStitch")
+			, { VertexFormatTraits<MeshVertex>::desc, VertexFormatTraits<MeshVertex>::size }
+		);
+		m_ditherShaders.watch(*systems.pShaderReloader);
+		if (m_bComputeSupported)
+		{
+			m_ditherComputeShaders.watch(*systems.pShaderReloader);
+		}
 
 		constexpr int size = sizeof(PerFrameCBData);
 
 		// Create Per Frame Constant Buffer.
 		m_pPerFrameCB = create_constant_buffer<PerFrameCBData>(systems.pD3DDevice);
 
-		// Create Per Frame Constant Buffer.
-		m_pPerDrawCB = create_constant_buffer<PerDrawCBData>(systems.pD3DDevice);
-
 		SetupModelsAndTextures(systems);
 
+		// Transforms of every grid instance, filled each frame.
+		m_pInstanceBuffer = create_structured_buffer<InstanceTransform>(systems.pD3DDevice, kNumGridModels * kNumInstances * kNumInstances);
+		m_pInstanceView = create_structured_buffer_view(systems.pD3DDevice, m_pInstanceBuffer);
+
 		// We need a sampler state to define wrapping and mipmap parameters.
 		m_pLinearMipSamplerState = create_basic_sampler(systems.pD3DDevice, D3D11_TEXTURE_ADDRESS_WRAP);
 
 		// Setup per-frame data
 		m_perFrameCBData.m_time = 0.0f;
+
+		// The scene steps on the job pool while each frame renders.
+		m_scene.init(SceneState{ 0.0f }, step_scene, systems.pJobPool);
 	}
 
 	void on_update(SystemsInterface& systems) override
@@ -265,87 +540,184 @@ public:
 		// This function displays some useful debugging values, camera positions etc.
 		DemoFeatures::editorHud(systems.pDebugDrawContext);
 
+		// Start this frame's steps, the frame draws the ones that finished last frame.
+		m_scene.begin_frame(systems.deltaSeconds);
+		const SceneState& previous = m_scene.previous();
+		const SceneState& current = m_scene.current();
+
 		// Update Per Frame Data.
 		m_perFrameCBData.m_matProjection = systems.pCamera->projMatrix.Transpose();
 		m_perFrameCBData.m_matView = systems.pCamera->viewMatrix.Transpose();
-		m_perFrameCBData.m_time += 0.001f;
+		m_perFrameCBData.m_time = previous.time + (current.time - previous.time) * m_scene.alpha();
 		m_perFrameCBData.matSize = m_matSize;
 		m_perFrameCBData.matSizeSq = m_matSizeSq;
 	}
 
 	void on_render(SystemsInterface& systems) override
 	{
-		// Grid from -50 to +50 in both X & Z
-
-		
-		//=======================================================================================
-		// The Main rendering Pass
-		// Draw our scene into the off-screen render surface
-		//=======================================================================================
 		HandleImGui(systems);
 
-		// Bind the render target views for colour and depth to the output merger.
-		systems.pD3DContext->OMSetRenderTargets(1, &m_pColourSurfaceTargetView, m_pDepthSurfaceTargetView);
+		// Push Per Frame Data to GPU
+		systems.pCommands->update_buffer(m_pPerFrameCB, m_perFrameCBData);
 
-		// Clear colour and depth
-		f32 clearValue[] = { 0.0f, 0.0f, 0.0f, 0.f };
-		systems.pD3DContext->ClearRenderTargetView(m_pColourSurfaceTargetView, clearValue);
-		systems.pD3DContext->ClearDepthStencilView(m_pDepthSurfaceTargetView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.f, 0);
+		// The passes for this frame's effects, the graph picks the targets.
+		build_render_graph(systems);
 
+		std::string error;
+		if (!m_renderGraph.compile(&error))
+		{
+			panicF("%s", error.c_str());
+		}
+		m_renderTargets.realize(m_renderGraph);
+		m_renderTargets.import(m_backBuffer, nullptr, systems.pSwapRenderTarget, nullptr);
+		m_renderGraph.execute(systems.pGpuTimer);
 
-		// Push Per Frame Data to GPU
-		D3D11_MAPPED_SUBRESOURCE subresource;
-		if (!FAILED(systems.pD3DContext->Map(m_pPerFrameCB, 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource)))
+		// re-bind depth for debugging output which is rendered after this lot.
+		systems.pCommands->set_render_target(systems.pSwapRenderTarget, m_pDepthSurfaceTargetView);
+	}
+
+	//=======================================================================================
+	// Render graph
+	// Scene -> [Pixelate] -> [Cross Stitch] -> Dither or copy -> back buffer.
+	// Each effect reads the previous target and writes a new one, the graph
+	// puts targets that aren't alive at the same time on the same texture.
+	//=======================================================================================
+	void build_render_graph(SystemsInterface& systems)
+	{
+		RenderGraph& graph = m_renderGraph;
+		graph.reset();
+
+		const RenderTargetDesc colourDesc = { systems.width, systems.height, DXGI_FORMAT_R8G8B8A8_UNORM, 4, kTargetRenderTarget | kTargetShaderResource };
+		m_backBuffer = graph.import_target("Back buffer", colourDesc);
+
+		const RenderGraph::Resource scene = graph.create_target("Scene colour", colourDesc);
+		const RenderGraph::Pass scenePass = graph.add_pass("Scene", [this, &systems, scene]()
+		{
+			render_scene(systems, m_renderTargets.rtv(scene));
+		});
+		graph.write(scenePass, scene);
+
+		RenderGraph::Resource colour = scene;
+		if (m_bPixelate)
 		{
-			memcpy(subresource.pData, &m_perFrameCBData, sizeof(PerFrameCBData));
-			systems.pD3DContext->Unmap(m_pPerFrameCB, 0);
+			colour = add_post_pass(systems, "Pixelate", m_pixelateShader, colour, graph.create_target("Pixelated", colourDesc));
+		}
+		if (m_bCrossStitch)
+		{
+			colour = add_post_pass(systems, "Cross Stitch", m_crossStitchShader, colour, graph.create_target("Cross stitched", colourDesc));
 		}
 
-		// Bind our set of shaders.
-		m_meshShader.bind(systems.pD3DContext);
+		const bool bDither = m_postEffect < kNumberOfAlgorithms - 1;
+		if (bDither && m_bComputeDither)
+		{
+			RenderTargetDesc ditherDesc = colourDesc;
+			ditherDesc.flags = kTargetUnorderedAccess | kTargetShaderResource;
+			const RenderGraph::Resource dithered = graph.create_target("Dithered", ditherDesc);
 
-		// Bind Constant Buffers, to both PS and VS stages
-		ID3D11Buffer* buffers[] = { m_pPerFrameCB, m_pPerDrawCB };
-		systems.pD3DContext->VSSetConstantBuffers(0, 2, buffers);
-		systems.pD3DContext->PSSetConstantBuffers(0, 2, buffers);
+			const RenderGraph::Pass ditherPass = graph.add_pass("Dither (compute)", [this, &systems, colour, dithered]()
+			{
+				dispatch_dither(systems, colour, dithered);
+			});
+			graph.read(ditherPass, colour);
+			graph.write(ditherPass, dithered);
 
-		// Bind a sampler state
-		ID3D11SamplerState* samplers[] = { m_pLinearMipSamplerState };
-		systems.pD3DContext->PSSetSamplers(0, 1, samplers);
+			// The compute path has already dithered, the quad just copies its output.
+			add_post_pass(systems, "Present", m_postEffectShader, dithered, m_backBuffer);
+		}
+		else if (bDither)
+		{
+			const u32 values[] = { static_cast<u32>(m_postEffect), m_ditherMatSize };
+			add_post_pass(systems, "Dither", m_ditherShaders.get(m_ditherShaders.variant(values)), colour, m_backBuffer);
+		}
+		else
+		{
+			add_post_pass(systems, "Present", m_postEffectShader, colour, m_backBuffer);
+		}
+	}
+
+	// Full screen quad reading source and writing target, returns target.
+	RenderGraph::Resource add_post_pass(SystemsInterface& systems, const char* pName, const ShaderSet& shaders, RenderGraph::Resource source, RenderGraph::Resource target)
+	{
+		const ShaderSet* pShaders = &shaders;
+		const RenderGraph::Pass pass = m_renderGraph.add_pass(pName, [this, &systems, pShaders, source, target]()
+		{
+			draw_post_pass(systems, *pShaders, m_renderTargets.srv(source), m_renderTargets.rtv(target));
+		});
+		m_renderGraph.read(pass, source);
+		m_renderGraph.write(pass, target);
+		return target;
+	}
+
+	//=======================================================================================
+	// The Main rendering Pass
+	// Draw our scene into the off-screen render surface
+	//=======================================================================================
+	void render_scene(SystemsInterface& systems, ID3D11RenderTargetView* pTarget)
+	{
+		// Bind the render target views for colour and depth to the output merger.
+		CommandBuffer& commands = *systems.pCommands;
+		commands.set_render_target(pTarget, m_pDepthSurfaceTargetView);
+
+		// Clear colour and depth
+		f32 clearValue[] = { 0.0f, 0.0f, 0.0f, 0.f };
+		commands.clear_render_target(pTarget, clearValue);
+		commands.clear_depth_stencil(m_pDepthSurfaceTargetView, kClearDepth | kClearStencil, 1.f, 0);
 
-		constexpr f32 kGridSpacing = 1.5f;
-		constexpr u32 kNumInstances = 5;
-		constexpr u32 kNumModelTypes = 4;
+		StateCache& stateCache = *systems.pStateCache;
+		BindingTable& bindings = *systems.pBindings;
+
+		// Bind the per frame constants to both PS and VS stages, per draw
+		// constants are bound to slot 1 from the constant ring.
+		bindings.set_constant_buffer(ShaderStage::kVertex, 0, m_pPerFrameCB);
+		bindings.set_constant_buffer(ShaderStage::kPixel, 0, m_pPerFrameCB);
+		ConstantRing& constants = *systems.pConstants;
+
+		// Bind a sampler state
+		bindings.set_sampler(ShaderStage::kPixel, 0, m_pLinearMipSamplerState);
 
 		if (m_Ortho)
 		{
+			// Bind our set of shaders.
+			m_meshShader.bind(stateCache);
+
 			// Bind a mesh and texture.
-			m_meshArray[2].bind(systems.pD3DContext);
-			m_textures[m_imageToUse].bind(systems.pD3DContext, ShaderStage::kPixel, 0);
+			m_meshArray[2].bind(stateCache);
+			bindings.set_shader_resource(ShaderStage::kPixel, 0, m_textures[m_imageToUse].view());
+			bindings.flush();
 
 			m4x4 matModel = m4x4::CreateTranslation(v3(0, 0, 0));
 			m4x4 matMVP = matModel * systems.pCamera->vpMatrix;
-			m_perDrawCBData.m_matMVP = matMVP.Transpose();
-			push_constant_buffer(systems.pD3DContext, m_pPerDrawCB, m_perDrawCBData);
-			m_meshArray[2].draw(systems.pD3DContext);
-
-			// Update Per Draw Data
-			m_perDrawCBData.m_matMVP = matMVP.Transpose();
-			// Push to GPU
-			push_constant_buffer(systems.pD3DContext, m_pPerDrawCB, m_perDrawCBData);
+			PerDrawCBData perDrawCBData = {};
+			perDrawCBData.m_matMVP = matMVP.Transpose();
+			const ConstantSlice slice = constants.allocate(perDrawCBData);
+			constants.upload();
+			constants.bind(ShaderStage::kVertex, 1, slice);
+			constants.bind(ShaderStage::kPixel, 1, slice);
+
 			// Draw the mesh.
-			m_meshArray[2].draw(systems.pD3DContext);
+			m_meshArray[2].draw(commands);
+		}
+		else if (m_bInstanced) // Perspective, one draw per model
+		{
+			render_grid_instanced(systems);
+		}
+		else if (m_bRecordOnWorkers) // Perspective, draws recorded across the job pool
+		{
+			render_grid_recorded(systems);
 		}
 		else // Perspective
 		{
-			for (u32 t = 0; t < kNumModelTypes - 2; ++t)
-			{
-				// Bind a mesh and texture.
-				m_meshArray[t].bind(systems.pD3DContext);
-				m_textures[t].bind(systems.pD3DContext, ShaderStage::kPixel, 0);
+			// Bind our set of shaders.
+			m_meshShader.bind(stateCache);
 
+			constexpr u32 kNumDraws = kNumGridModels * kNumInstances * kNumInstances;
 
-				// Draw several instances
+			// Write every draw's constants first, D3D11 can't draw from a buffer
+			// that is still mapped, then send them all with one map.
+			ConstantSlice slices[kNumDraws];
+			u32 draw = 0;
+			for (u32 t = 0; t < kNumGridModels; ++t)
+			{
 				for (u32 i = 0; i < kNumInstances; ++i)
 				{
 					for (u32 j = 0; j < kNumInstances; ++j)
@@ -354,47 +726,233 @@ public:
 						m4x4 matModel = m4x4::CreateTranslation(v3(i * kGridSpacing, t * kGridSpacing, j * kGridSpacing));
 						m4x4 matMVP = matModel * systems.pCamera->vpMatrix;
 
-						// Update Per Draw Data
-						m_perDrawCBData.m_matMVP = matMVP.Transpose();
+						PerDrawCBData perDrawCBData = {};
+						perDrawCBData.m_matMVP = matMVP.Transpose();
+						slices[draw++] = constants.allocate(perDrawCBData);
+					}
+				}
+			}
+			constants.upload();
 
-						// Push to GPU
-						push_constant_buffer(systems.pD3DContext, m_pPerDrawCB, m_perDrawCBData);
+			draw = 0;
+			for (u32 t = 0; t < kNumGridModels; ++t)
+			{
+				// Bind a mesh and texture.
+				m_meshArray[t].bind(stateCache);
+				bindings.set_shader_resource(ShaderStage::kPixel, 0, m_textures[t].view());
+				bindings.flush();
 
-						// Draw the mesh.
-						m_meshArray[t].draw(systems.pD3DContext);
-					}
+				// Draw several instances
+				for (u32 instance = 0; instance < kNumInstances * kNumInstances; ++instance)
+				{
+					constants.bind(ShaderStage::kVertex, 1, slices[draw]);
+					constants.bind(ShaderStage::kPixel, 1, slices[draw]);
+					++draw;
+
+					// Draw the mesh.
+					m_meshArray[t].draw(commands);
 				}
 			}
 		}
-		//=======================================================================================
-		// The Post FX pass
-		// Draw our scene into the off-screen render surface
-		//=======================================================================================
+	}
 
-		// Bind the swap chain (back buffer) to the render target
-		// Make sure to unbind the depth buffer, so we can read from it.
-		systems.pD3DContext->OMSetRenderTargets(1, &systems.pSwapRenderTarget, NULL);
+	//=======================================================================================
+	// The instance grid as one draw per instance, recorded a row at a time on the job
+	// pool into deferred contexts. The rows are executed in order on the immediate context.
+	//=======================================================================================
+	void render_grid_recorded(SystemsInterface& systems)
+	{
+		const m4x4 matViewProjection = systems.pCamera->vpMatrix;
 
-		
+		systems.pRecorder->record(kNumGridModels * kNumInstances, [this, &matViewProjection](u32 chunk, RecordingContext& rContext)
+		{
+			const u32 t = chunk / kNumInstances;
+			const u32 i = chunk % kNumInstances;
+
+			StateCache& stateCache = *rContext.pStateCache;
+			BindingTable& bindings = *rContext.pBindings;
+			ConstantRing& constants = *rContext.pConstants;
+
+			// Contexts start empty, everything the draws need is bound again.
+			m_meshShader.bind(stateCache);
+			m_meshArray[t].bind(stateCache);
+			bindings.set_constant_buffer(ShaderStage::kVertex, 0, m_pPerFrameCB);
+			bindings.set_constant_buffer(ShaderStage::kPixel, 0, m_pPerFrameCB);
+			bindings.set_sampler(ShaderStage::kPixel, 0, m_pLinearMipSamplerState);
+			bindings.set_shader_resource(ShaderStage::kPixel, 0, m_textures[t].view());
+			bindings.flush();
+
+			ConstantSlice slices[kNumInstances];
+			for (u32 j = 0; j < kNumInstances; ++j)
+			{
+				m4x4 matModel = m4x4::CreateTranslation(v3(i * kGridSpacing, t * kGridSpacing, j * kGridSpacing));
+				m4x4 matMVP = matModel * matViewProjection;
+
+				PerDrawCBData perDrawCBData = {};
+				perDrawCBData.m_matMVP = matMVP.Transpose();
+				slices[j] = constants.allocate(perDrawCBData);
+			}
+			constants.upload();
+
+			for (u32 j = 0; j < kNumInstances; ++j)
+			{
+				constants.bind(ShaderStage::kVertex, 1, slices[j]);
+				constants.bind(ShaderStage::kPixel, 1, slices[j]);
+				m_meshArray[t].draw(*rContext.pCommands);
+			}
+		});
+	}
+
+	//=======================================================================================
+	// The instance grid with one DrawIndexedInstanced per model. The CPU only
+	// writes model transforms, the vertex shader applies the view and projection.
+	//=======================================================================================
+	void render_grid_instanced(SystemsInterface& systems)
+	{
+		StateCache& stateCache = *systems.pStateCache;
+		BindingTable& bindings = *systems.pBindings;
+		ConstantRing& constants = *systems.pConstants;
+
+		m_meshInstancedShader.bind(stateCache);
+
+		// Every model's grid goes in one buffer, one map.
+		constexpr u32 kInstancesPerModel = kNumInstances * kNumInstances;
+		CommandBuffer& commands = *systems.pCommands;
+		constexpr u32 kInstanceBytes = kNumGridModels * kInstancesPerModel * sizeof(InstanceTransform);
+		InstanceTransform* pInstances = static_cast<InstanceTransform*>(commands.map_discard(m_pInstanceBuffer, kInstanceBytes));
+		if (!pInstances)
+		{
+			return;
+		}
+		for (u32 t = 0; t < kNumGridModels; ++t)
+		{
+			const InstanceGrid grid = { kNumInstances, 1, kNumInstances, kGridSpacing, { 0.f, t * kGridSpacing, 0.f } };
+			pack_instance_grid(grid, grid.count(), pInstances + t * kInstancesPerModel, systems.pJobPool);
+		}
+		commands.unmap(m_pInstanceBuffer);
+
+		// SV_InstanceID restarts at 0 each draw, the constants say where the model's grid starts.
+		ConstantSlice slices[kNumGridModels];
+		for (u32 t = 0; t < kNumGridModels; ++t)
+		{
+			PerDrawCBData perDrawCBData = {};
+			perDrawCBData.m_instanceBase = t * kInstancesPerModel;
+			slices[t] = constants.allocate(perDrawCBData);
+		}
+		constants.upload();
+
+		for (u32 t = 0; t < kNumGridModels; ++t)
+		{
+			// Bind a mesh and texture.
+			m_meshArray[t].bind(stateCache);
+			bindings.set_shader_resource(ShaderStage::kPixel, 0, m_textures[t].view());
+			constants.bind(ShaderStage::kVertex, 1, slices[t]);
+
+			// Draw every instance of the model.
+			m_meshArray[t].draw_instanced(commands, bindings, kInstanceSlot, m_pInstanceView, kInstancesPerModel);
+		}
+	}
+
+	//=======================================================================================
+	// The Post FX pass
+	// Draw a full screen quad with the source bound as the colour surface.
+	//=======================================================================================
+	void draw_post_pass(SystemsInterface& systems, const ShaderSet& shaders, ID3D11ShaderResourceView* pSource, ID3D11RenderTargetView* pTarget)
+	{
+		BindingTable& bindings = *systems.pBindings;
+
+		// Make sure to unbind the depth buffer, so we can read from it.
+		systems.pCommands->set_render_target(pTarget, nullptr);
 
 		// Bind our Colour and Depth surfaces as inputs to the pixel shader
-		ID3D11ShaderResourceView* srvs[2]{ m_pColourSurfaceSRV, m_pDepthSurfaceSRV };
-		systems.pD3DContext->PSSetShaderResources(0, 2, srvs);
+		ID3D11ShaderResourceView* srvs[2]{ pSource, m_pDepthSurfaceSRV };
+		bindings.set_shader_resources(ShaderStage::kPixel, 0, 2, srvs);
+		bindings.flush();
 
-		// Bind the PostEffect shaders
-		m_postEffectShader.bind(systems.pD3DContext);
+		shaders.bind(*systems.pStateCache);
 
 		// Draw a full screen quad.
 		// This is the post effect
-		m_fullScreenQuad.bind(systems.pD3DContext);
-		m_fullScreenQuad.draw(systems.pD3DContext);
+		m_fullScreenQuad.bind(*systems.pStateCache);
+		m_fullScreenQuad.draw(*systems.pCommands);
 
-		// Unbind all the SRVs because we need them as targets next frame
+		// Unbind all the SRVs because a later pass may render to them
 		ID3D11ShaderResourceView* srvClear[] = { NULL, NULL };
-		systems.pD3DContext->PSSetShaderResources(0, 2, srvClear);
+		bindings.set_shader_resources(ShaderStage::kPixel, 0, 2, srvClear);
+		bindings.flush();
+	}
 
-		// re-bind depth for debugging output which is rendered after this lot.
-		systems.pD3DContext->OMSetRenderTargets(1, &systems.pSwapRenderTarget, m_pDepthSurfaceTargetView);
+	// Dither source into target with CS_PostEffect_Dither.
+	void dispatch_dither(SystemsInterface& systems, RenderGraph::Resource source, RenderGraph::Resource target)
+	{
+		BindingTable& bindings = *systems.pBindings;
+		CommandBuffer& commands = *systems.pCommands;
+
+		// Nothing may be rendering to the source.
+		commands.set_render_targets(0, nullptr, nullptr);
+
+		const u32 values[] = { static_cast<u32>(m_postEffect), m_ditherMatSize, m_ditherTileSize };
+		m_ditherComputeShaders.get(m_ditherComputeShaders.variant(values)).bind(*systems.pStateCache);
+
+		bindings.set_constant_buffer(ShaderStage::kCompute, 0, m_pPerFrameCB);
+		bindings.set_shader_resource(ShaderStage::kCompute, 0, m_renderTargets.srv(source));
+		bindings.flush();
+		ID3D11UnorderedAccessView* pOutput = m_renderTargets.uav(target);
+		commands.set_unordered_access_views(0, 1, &pOutput);
+
+		const u32 tileSize = kDitherTileSizeValues[m_ditherTileSize];
+		commands.dispatch(compute_group_count(systems.width, tileSize), compute_group_count(systems.height, tileSize), 1);
+
+		// Unbind so the output can be read by the pixel shader and the source rendered to.
+		ID3D11UnorderedAccessView* pNullUAV = nullptr;
+		commands.set_unordered_access_views(0, 1, &pNullUAV);
+		bindings.set_shader_resource(ShaderStage::kCompute, 0, nullptr);
+		bindings.flush();
+
+		if (m_bCheckDither)
+		{
+			m_bCheckDither = false;
+			check_dither(systems, m_renderTargets.texture(source), m_renderTargets.texture(target));
+		}
+	}
+
+	// Compare the compute output with the CPU emulation of the same kernel and time the tile sizes on the CPU.
+	void check_dither(SystemsInterface& systems, ID3D11Texture2D* pSource, ID3D11Texture2D* pOutput)
+	{
+		std::vector<u8> colour, gpuOutput;
+		read_back_rgba8(systems.pD3DDevice, systems.pD3DContext, pSource, colour);
+		read_back_rgba8(systems.pD3DDevice, systems.pD3DContext, pOutput, gpuOutput);
+
+		DitherParams params;
+		params.algorithm = static_cast<DitherAlgorithm>(m_postEffect);
+		params.matSize = m_matSize;
+		params.tileSize = kDitherTileSizeValues[m_ditherTileSize];
+		memcpy(params.colour1, m_perFrameCBData.colour1, sizeof(params.colour1));
+		memcpy(params.colour2, m_perFrameCBData.colour2, sizeof(params.colour2));
+
+		std::vector<u8> cpuOutput(colour.size());
+		dither_rgba8_cpu(colour.data(), systems.width, systems.height, systems.width * 4, params, cpuOutput.data(), systems.width * 4, systems.pJobPool);
+
+		// Pixels sitting on a threshold can go either way with the GPU's float maths,
+		// and its sin() is approximate so the random variant differs more.
+		m_ditherCheck.difference = compare_rgba8(gpuOutput.data(), systems.width * 4, cpuOutput.data(), systems.width * 4, systems.width, systems.height, 1);
+		benchmark_dither_tiles(colour.data(), systems.width, systems.height, systems.width * 4, params,
+			kDitherTileSizeValues, ARRAYSIZE(kDitherTileSizeValues), 3, systems.pJobPool, m_ditherCheck.timings);
+		m_ditherCheck.bValid = true;
+	}
+
+	bool on_precompile_shaders() override
+	{
+		bool bOk = shader_cache_precompile(ShaderSetDesc::Create_VS_PS("Assets/Shaders/MinimalShaders.fx", "VS_Mesh", "PS_Mesh"));
+		bOk &= shader_cache_precompile(ShaderSetDesc::Create_VS_PS("Assets/Shaders/MinimalShaders.fx", "VS_Mesh_Instanced", "PS_Mesh"));
+		bOk &= shader_cache_precompile(ShaderSetDesc::Create_VS_PS("Assets/Shaders/PostEffectShaders.fx", "VS_PostEffect", "PS_PostEffect_None"));
+		bOk &= shader_cache_precompile(ShaderSetDesc::Create_VS_PS("Assets/Shaders/PostEffectShaders.fx", "VS_PostEffect", "PS_PostEffect_Pixelate"));
+		bOk &= shader_cache_precompile(ShaderSetDesc::Create_VS_PS("Assets/Shaders/PostEffectShaders.fx", "VS_PostEffect", "PS_PostEffect_CrossStitch"));
+
+		// Every algorithm and matrix size the ImGui controls can switch to.
+		bOk &= shader_cache_precompile(dither_shader_desc());
+		bOk &= shader_cache_precompile(dither_compute_desc());
+		return bOk;
 	}
 
 	void on_resize(SystemsInterface& systems) override
@@ -409,55 +967,11 @@ public:
 		// Release all outstanding references to the swap chain's buffers.
 		pD3DContext->OMSetRenderTargets(0, 0, 0);
 
-		// Destroy old colour surfaces.
-		SAFE_RELEASE(m_pColourSurfaceTargetView);
-		SAFE_RELEASE(m_pColourSurfaceSRV);
-		SAFE_RELEASE(m_pColourSurface);
-
 		// Destroy old depth surfaces.
 		SAFE_RELEASE(m_pDepthSurfaceTargetView);
 		SAFE_RELEASE(m_pDepthSurfaceSRV);
 		SAFE_RELEASE(m_pDepthSurface);
 
-		// Create a colour surface
-		D3D11_TEXTURE2D_DESC desc;
-		desc.Width = width;
-		desc.Height = height;
-		desc.MipLevels = 1;
-		desc.ArraySize = 1;
-		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-		desc.SampleDesc.Count = 1;
-		desc.SampleDesc.Quality = 0;
-		desc.Usage = D3D11_USAGE_DEFAULT;
-		desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-		desc.CPUAccessFlags = 0;
-		desc.MiscFlags = 0;
-
-		hr = pD3DDevice->CreateTexture2D(&desc, NULL, &m_pColourSurface);
-		if (FAILED(hr))
-		{
-			panicF("Failed to create colour surface texture");
-		}
-
-		// render target views.
-		hr = pD3DDevice->CreateRenderTargetView(m_pColourSurface, NULL, &m_pColourSurfaceTargetView);
-		if (FAILED(hr))
-		{
-			panicF("Failed to create colour surface texture");
-		}
-
-		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-		srvDesc.Format = desc.Format;
-		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		srvDesc.Texture2D.MostDetailedMip = 0;
-		srvDesc.Texture2D.MipLevels = 1;
-
-		hr = pD3DDevice->CreateShaderResourceView(m_pColourSurface, &srvDesc, &m_pColourSurfaceSRV);
-		if (FAILED(hr))
-		{
-			panicF("Failed to create colour surface SRV");
-		}
-
 		// Create a depth buffer
 		{
 			D3D11_TEXTURE2D_DESC desc;
@@ -510,25 +1024,32 @@ private:
 	PerFrameCBData m_perFrameCBData;
 	ID3D11Buffer* m_pPerFrameCB = nullptr;
 
-	PerDrawCBData m_perDrawCBData;
-	ID3D11Buffer* m_pPerDrawCB = nullptr;
-
 	ShaderSet m_meshShader;
+	ShaderSet m_meshInstancedShader;
 	ShaderSet m_postEffectShader;
+	ShaderSet m_pixelateShader;
+	ShaderSet m_crossStitchShader;
+	ShaderPermutations m_ditherShaders;
+	ShaderPermutations m_ditherComputeShaders;
 
 	Mesh m_meshArray[4];
 	Texture m_textures[4];
 	ID3D11SamplerState* m_pLinearMipSamplerState = nullptr;
 
+	// Grid transforms for the instanced draws.
+	ID3D11Buffer* m_pInstanceBuffer = nullptr;
+	ID3D11ShaderResourceView* m_pInstanceView = nullptr;
+
 	ColourPreset palettes[MAX_PALETTES];
 
 	// Screen quad : for post effect pass.
 	Mesh m_fullScreenQuad;
 
 	// Post Effect Rendering Surfaces
-	ID3D11Texture2D*		m_pColourSurface = nullptr;
-	ID3D11RenderTargetView* m_pColourSurfaceTargetView = nullptr;
-	ID3D11ShaderResourceView* m_pColourSurfaceSRV = nullptr;
+	// Colour targets come from the render graph, depth is kept for the debug draw after it.
+	RenderGraph m_renderGraph;
+	RenderTargetPool m_renderTargets;
+	RenderGraph::Resource m_backBuffer = RenderGraph::kInvalid;
 
 	ID3D11Texture2D*		m_pDepthSurface = nullptr;
 	ID3D11DepthStencilView* m_pDepthSurfaceTargetView = nullptr;
@@ -542,6 +1063,25 @@ private:
 	char* m_PostEffectNames[kNumberOfAlgorithms];
 	int m_matSize = 2;
 	int m_matSizeSq = 4;
+	u32 m_ditherMatSize = 0;	// Index of m_matSize in kDitherMatSizes.
+	u32 m_ditherTileSize = 0;	// Index into kDitherTileSizes.
+	bool m_bComputeSupported = false;
+	bool m_bComputeDither = false;
+	bool m_bCheckDither = false;
+	bool m_bPixelate = false;
+	bool m_bCrossStitch = false;
+	bool m_bInstanced = true;
+	bool m_bRecordOnWorkers = false;
+	std::vector<InstancePackTiming> m_instancePackTimings;
+	FixedStepSimulation<SceneState> m_scene;
+
+	struct DitherCheck
+	{
+		bool bValid = false;
+		ImageDifference difference;
+		std::vector<DitherTileTiming> timings;
+	};
+	DitherCheck m_ditherCheck;
 	bool m_Ortho = true;
 	int m_colourPresetSelected = 0, m_imageToUse = 2, m_postEffect = 0;
 	std::string m_colourName = "Black and White";
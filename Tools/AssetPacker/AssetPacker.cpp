@@ -0,0 +1,150 @@
+// ========================================================
+// AssetPacker
+// Builds an asset pack (.pak) from a list of files.
+// Only depends on the portable core (CoreTypes, Compression, AssetPackFormat)
+// so it builds on any platform, e.g.
+//
+//   g++ -std=c++14 -O2 -I../../Framework AssetPacker.cpp ../../Framework/CoreTypes.cpp
+//       ../../Framework/Compression.cpp ../../Framework/AssetPackFormat.cpp -o AssetPacker
+//
+// Usage:
+//   AssetPacker [-lz4] [-chunk <KB>] [-root <dir>] <output.pak> <file|@listfile>...
+//
+// Files are stored under the path given on the command line with -root removed
+// from the front, so packing "Assets/Textures/a.dds" from the project directory
+// lets the runtime find it as "Assets/Textures/a.dds".
+// ========================================================
+
+#include "CoreTypes.h"
+#include "AssetPackFormat.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+static void print_usage()
+{
+	printf("Usage: AssetPacker [-lz4] [-chunk <KB>] [-root <dir>] <output.pak> <file|@listfile>...\n");
+	printf("  -lz4         Compress entries with LZ4 where it saves space.\n");
+	printf("  -chunk <KB>  Compression chunk size, default %u.\n", kPakDefaultChunkSize / 1024);
+	printf("  -root <dir>  Strip this prefix from the stored names.\n");
+	printf("  @listfile    Read file names from a text file, one per line.\n");
+}
+
+static std::string strip_root(const std::string& rPath, const std::string& rRoot)
+{
+	if (rRoot.empty())
+	{
+		return rPath;
+	}
+
+	const std::string path = pak_normalise_name(rPath.c_str());
+	std::string root = pak_normalise_name(rRoot.c_str());
+	if (root.back() != '/')
+	{
+		root += '/';
+	}
+
+	if (path.compare(0, root.size(), root) == 0)
+	{
+		return path.substr(root.size());
+	}
+	return path;
+}
+
+static bool read_list_file(const char* pListFile, std::vector<std::string>& rFilesOut)
+{
+	std::ifstream file(pListFile);
+	if (!file.good())
+	{
+		errorF("Could not open list file %s", pListFile);
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		// Trim whitespace and skip blanks and comments.
+		const size_t first = line.find_first_not_of(" \t\r\n");
+		if (first == std::string::npos || line[first] == '#')
+		{
+			continue;
+		}
+		const size_t last = line.find_last_not_of(" \t\r\n");
+		rFilesOut.push_back(line.substr(first, last - first + 1));
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	PakWriter::Options options;
+	std::string root;
+	const char* pOutput = nullptr;
+	std::vector<std::string> files;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if (arg == "-lz4")
+		{
+			options.codec = kPakCodecLZ4;
+		}
+		else if (arg == "-chunk" && i + 1 < argc)
+		{
+			const int kb = atoi(argv[++i]);
+			if (kb <= 0)
+			{
+				print_usage();
+				return 1;
+			}
+			options.chunkSize = static_cast<u32>(kb) * 1024;
+		}
+		else if (arg == "-root" && i + 1 < argc)
+		{
+			root = argv[++i];
+		}
+		else if (arg[0] == '-')
+		{
+			print_usage();
+			return 1;
+		}
+		else if (!pOutput)
+		{
+			pOutput = argv[i];
+		}
+		else if (arg[0] == '@')
+		{
+			if (!read_list_file(arg.c_str() + 1, files))
+			{
+				return 1;
+			}
+		}
+		else
+		{
+			files.push_back(arg);
+		}
+	}
+
+	if (!pOutput || files.empty())
+	{
+		print_usage();
+		return 1;
+	}
+
+	PakWriter writer;
+	for (const std::string& rFile : files)
+	{
+		writer.add_file(rFile.c_str(), strip_root(rFile, root).c_str());
+	}
+
+	if (!writer.write(pOutput, options))
+	{
+		return 1;
+	}
+
+	const PakWriter::Stats& stats = writer.stats();
+	printf("%s : %u files (%u compressed), %llu -> %llu bytes\n", pOutput, stats.numEntries, stats.numCompressed,
+		static_cast<unsigned long long>(stats.totalSize), static_cast<unsigned long long>(stats.totalStored));
+	return 0;
+}
@@ -0,0 +1,2123 @@
+// ========================================================
+// CpuBench
+// Times the CPU hot paths of the framework and the post effects, writes the
+// results as JSON and checks them against a baseline from an earlier run, so
+// a change that makes one of them slower fails.
+// The portable cases build on any platform, e.g.
+//
+//   g++ -std=c++14 -O2 -pthread -I../../Framework -I../../PostEffects CpuBench.cpp
+//       ../../Framework/CoreTypes.cpp ../../Framework/Profiler.cpp ../../Framework/FrameTimings.cpp
+//       ../../Framework/ComputeEmulation.cpp ../../Framework/DebugDrawVertices.cpp
+//       ../../Framework/BindingTable.cpp ../../Framework/StateCache.cpp ../../Framework/HotReload.cpp
+//       ../../Framework/ConstantRing.cpp ../../Framework/InstanceData.cpp ../../Framework/CommandLists.cpp
+//       ../../Framework/CommandBuffer.cpp ../../Framework/GpuTimer.cpp ../../Framework/FramePacer.cpp
+//       ../../PostEffects/DitherKernel.cpp -o CpuBench
+//
+// Mesh loading, tangents, load_file, IoService and the camera need DirectXMath
+// and the Windows file functions, so those cases are only in the Windows build,
+// which links Framework.lib.
+//
+// Usage:
+//   CpuBench [-filter <text>] [-samples <n>] [-sample-ms <ms>] [-threads <n>]
+//            [-json <file>] [-baseline <file>] [-threshold <percent>] [-allow-new] [-list] [-check]
+//
+// Each case runs in batches long enough for the clock, one sample per batch,
+// and the median time per run is what's compared. With -baseline the run
+// fails if any case is more than -threshold percent (default 10) slower, or
+// isn't in the baseline at all unless -allow-new says new cases are expected.
+// A case with a budget fails over it with or without a baseline. The budget
+// can be net of another case, profiler/marker's is what a marker costs over
+// its two profiler/clock reads, so a host with a slow clock doesn't fail it.
+//
+// -check runs the self checks instead of the timings: the stand-in devices of
+// the portable modules, driven the way a frame drives the real ones. It fails
+// if any of them sees the wrong calls.
+// ========================================================
+
+#include "CoreTypes.h"
+#include "BindingTable.h"
+#include "CommandBuffer.h"
+#include "CommandLists.h"
+#include "ConstantRing.h"
+#include "DitherKernel.h"
+#include "FramePacer.h"
+#include "FrameTimings.h"
+#include "GpuTimer.h"
+#include "HotReload.h"
+#include "InstanceData.h"
+#include "JobQueue.h"
+#include "Profiler.h"
+#include "StateCache.h"
+
+#if defined(_WIN32)
+#include "Framework.h"	// Framework.lib also has the debug_draw implementation.
+#include "IoService.h"
+#include "Mesh.h"
+#include "ShaderCache.h"
+#else
+#define DEBUG_DRAW_IMPLEMENTATION
+#endif
+#include "DebugDrawVertices.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+static void print_usage()
+{
+	printf("Usage: CpuBench [-filter <text>] [-samples <n>] [-sample-ms <ms>] [-threads <n>]\n");
+	printf("                [-json <file>] [-baseline <file>] [-threshold <percent>] [-allow-new] [-list] [-check]\n");
+	printf("  -filter <text>       Only run cases with text in their name, can be repeated.\n");
+	printf("  -samples <n>         Samples per case, default 15.\n");
+	printf("  -sample-ms <ms>      Shortest time for one sample, default 10.\n");
+	printf("  -threads <n>         Job pool workers, default one per hardware thread.\n");
+	printf("  -json <file>         Write the results, the file can be a later run's baseline.\n");
+	printf("  -baseline <file>     Compare with the results of an earlier run.\n");
+	printf("  -threshold <percent> How much slower than the baseline fails, default 10.\n");
+	printf("  -allow-new           Cases missing from the baseline don't fail the run.\n");
+	printf("  -list                Print the case names and exit.\n");
+	printf("  -check               Run the self checks instead of the timings, -filter and -list apply.\n");
+}
+
+// ========================================================
+// Cases
+// ========================================================
+
+struct BenchCase
+{
+	std::string name;
+	std::function<void()> run;	// One run, shares its state with the other runs of the case.
+	u32 itemsPerRun = 1;		// Times are per item, e.g. per marker of a run that records thousands.
+	f64 budgetNs = 0.0;			// Most a median item may take, 0 for none.
+	std::string budgetNetOf;	// Case whose median, budgetNetCount times, is taken off before the budget.
+	u32 budgetNetCount = 0;
+};
+
+struct BenchResult
+{
+	std::string name;
+	u32 runsPerSample;
+	FrameTimeSummary summary;	// Per item, in ms.
+	f64 budgetNs;
+	f64 budgetedNs;				// What the budget is checked against, the median net of budgetNetOf.
+};
+
+// Something for every case to write so the work can't be optimized away.
+static std::atomic<u64> s_sink{ 0 };
+
+static void keep(f32 value)
+{
+	s_sink += value > 0.f ? 1 : 0;
+}
+
+static void add_job_cases(std::vector<BenchCase>& rCases, JobPool& rPool)
+{
+	static const u32 kNumJobs = 1000;
+
+	rCases.push_back({ "jobs/pool push 1000", [&rPool]()
+	{
+		std::atomic<u32> done{ 0 };
+		for (u32 i = 0; i < kNumJobs; ++i)
+		{
+			rPool.pushJob([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+		}
+		rPool.waitAll();
+		s_sink += done.load();
+	} });
+
+	rCases.push_back({ "jobs/pool parallelFor 1M", [&rPool]()
+	{
+		std::atomic<u64> total{ 0 };
+		rPool.parallelFor(1u << 20, 4096, [&total](u32 begin, u32 end)
+		{
+			u64 sum = 0;
+			for (u32 i = begin; i < end; ++i)
+			{
+				sum += i * 2654435761u;
+			}
+			total.fetch_add(sum, std::memory_order_relaxed);
+		});
+		s_sink += total.load();
+	} });
+
+	// One worker, created with the case so it's launched once.
+	std::shared_ptr<JobQueue> pQueue = std::make_shared<JobQueue>();
+	pQueue->launch();
+	rCases.push_back({ "jobs/queue push 1000", [pQueue]()
+	{
+		u32 done = 0;
+		for (u32 i = 0; i < kNumJobs; ++i)
+		{
+			pQueue->pushJob([&done]() { ++done; });
+		}
+		pQueue->waitAll();
+		s_sink += done;
+	} });
+}
+
+static void add_profiler_cases(std::vector<BenchCase>& rCases)
+{
+	// The two of these in every marker are most of its cost, and vary from
+	// 15 to 55 ns with the host. First, so the marker can be netted against it.
+	static const u32 kNumReads = 1000;
+	BenchCase clock;
+	clock.name = "profiler/clock read";
+	clock.itemsPerRun = kNumReads;
+	clock.run = []()
+	{
+		u64 ticks = 0;
+		for (u32 i = 0; i < kNumReads; ++i)
+		{
+			ticks += profile_ticks();
+		}
+		s_sink += ticks;
+	};
+	rCases.push_back(clock);
+
+	// What a PROFILE_SCOPE costs with the profiler on, half a ring per run so
+	// nothing is dropped. The run's drain is in the time, about 1% of it.
+	// Budgeted over the clock reads, what the profiler itself adds.
+	static const u32 kNumMarkers = ProfileBuffer::kCapacity / 2;
+	BenchCase marker;
+	marker.name = "profiler/marker";
+	marker.itemsPerRun = kNumMarkers;
+	marker.budgetNs = kProfileMarkerOverheadBudgetNs;
+	marker.budgetNetOf = clock.name;
+	marker.budgetNetCount = 2;
+	marker.run = []()
+	{
+		s_sink += static_cast<u64>(benchmark_profile_markers(kNumMarkers));
+	};
+	rCases.push_back(marker);
+}
+
+static void add_dither_cases(std::vector<BenchCase>& rCases, JobPool& rPool)
+{
+	static const u32 kWidth = 1920;
+	static const u32 kHeight = 1080;
+
+	// Gradients so every threshold gets crossed.
+	struct Images
+	{
+		std::vector<u8> source;
+		std::vector<u8> output;
+	};
+	std::shared_ptr<Images> pImages = std::make_shared<Images>();
+	pImages->source.resize(kWidth * kHeight * 4);
+	pImages->output.resize(kWidth * kHeight * 4);
+	for (u32 y = 0; y < kHeight; ++y)
+	{
+		for (u32 x = 0; x < kWidth; ++x)
+		{
+			u8* pPixel = &pImages->source[(y * kWidth + x) * 4];
+			pPixel[0] = u8((x * 255) / kWidth);
+			pPixel[1] = u8((y * 255) / kHeight);
+			pPixel[2] = u8(((x + y) * 255) / (kWidth + kHeight));
+			pPixel[3] = 255;
+		}
+	}
+
+	static const struct { DitherAlgorithm algorithm; bool bPool; const char* pName; } s_cases[] =
+	{
+		{ kDitherBayer, false, "dither/bayer serial 1080p" },
+		{ kDitherBayer, true, "dither/bayer pool 1080p" },
+		{ kDitherBayerRandom, true, "dither/bayer random pool 1080p" },
+		{ kDitherDot, true, "dither/dot pool 1080p" },
+	};
+
+	for (const auto& rCase : s_cases)
+	{
+		DitherParams params;
+		params.algorithm = rCase.algorithm;
+		JobPool* pPool = rCase.bPool ? &rPool : nullptr;
+		rCases.push_back({ rCase.pName, [pImages, params, pPool]()
+		{
+			dither_rgba8_cpu(pImages->source.data(), kWidth, kHeight, kWidth * 4, params,
+				pImages->output.data(), kWidth * 4, pPool);
+			s_sink += pImages->output[kWidth * 2 + 8];
+		} });
+	}
+
+	// The shader's tile sizes, the same work split into 64 to 1024 pixel groups.
+	for (u32 tileSize : kDitherTileSizeValues)
+	{
+		DitherParams params;
+		params.tileSize = tileSize;
+		for (u32 pooled = 0; pooled < 2; ++pooled)
+		{
+			JobPool* pPool = pooled ? &rPool : nullptr;
+			char name[64];
+			snprintf(name, sizeof(name), "dither/bayer %s tile %u 1080p", pooled ? "pool" : "serial", tileSize);
+			rCases.push_back({ name, [pImages, params, pPool]()
+			{
+				dither_rgba8_cpu(pImages->source.data(), kWidth, kHeight, kWidth * 4, params,
+					pImages->output.data(), kWidth * 4, pPool);
+				s_sink += pImages->output[kWidth * 2 + 8];
+			} });
+		}
+	}
+}
+
+static void add_instance_cases(std::vector<BenchCase>& rCases, JobPool& rPool)
+{
+	static const struct { u32 count; const char* pName; } s_counts[] =
+	{
+		{ 10000, "10k" },
+		{ 100000, "100k" },
+		{ 1000000, "1M" },
+	};
+
+	for (const auto& rCount : s_counts)
+	{
+		// Layers of 100x100 as benchmark_instance_packing() lays them out.
+		const InstanceGrid grid = { 100, (rCount.count + 9999) / 10000, 100, 1.5f, { 0.f, 0.f, 0.f } };
+		std::shared_ptr<std::vector<InstanceTransform>> pOutput = std::make_shared<std::vector<InstanceTransform>>(rCount.count);
+		for (u32 pooled = 0; pooled < 2; ++pooled)
+		{
+			JobPool* pPool = pooled ? &rPool : nullptr;
+			const u32 count = rCount.count;
+			rCases.push_back({ std::string("instances/pack ") + rCount.pName + (pooled ? " pool" : " serial"), [grid, count, pOutput, pPool]()
+			{
+				pack_instance_grid(grid, count, pOutput->data(), pPool);
+				keep(pOutput->back().rows[0][3]);
+			} });
+		}
+	}
+}
+
+// Expands what debug_draw flushes into a buffer the way the D3D11 render
+// interface does into its mapped vertex buffers.
+class BenchDebugDrawInterface final : public dd::RenderInterface
+{
+public:
+	BenchDebugDrawInterface() : m_vertices(DEBUG_DRAW_VERTEX_BUFFER_SIZE * kDebugDrawVerticesPerPoint) {}
+
+	dd::GlyphTextureHandle createGlyphTexture(int, int, const void*) override { return &m_glyphTexture; }
+	void destroyGlyphTexture(dd::GlyphTextureHandle) override {}
+
+	void drawPointList(const dd::DrawVertex* pPoints, int count, bool) override
+	{
+		expand_debug_points(pPoints, static_cast<u32>(count), kRight, kUp, m_vertices.data());
+		m_numVertices += count * kDebugDrawVerticesPerPoint;
+	}
+
+	void drawLineList(const dd::DrawVertex* pLines, int count, bool) override
+	{
+		copy_debug_lines(pLines, static_cast<u32>(count), m_vertices.data());
+		m_numVertices += count;
+	}
+
+	void drawGlyphList(const dd::DrawVertex* pGlyphs, int count, dd::GlyphTextureHandle) override
+	{
+		copy_debug_glyphs(pGlyphs, static_cast<u32>(count), m_vertices.data());
+		m_numVertices += count;
+	}
+
+	u64 m_numVertices = 0;
+
+private:
+	static const f32 kRight[3];
+	static const f32 kUp[3];
+
+	std::vector<DebugDrawVertex> m_vertices;
+	dd::OpaqueTextureType m_glyphTexture;
+};
+
+const f32 BenchDebugDrawInterface::kRight[3] = { 1.f, 0.f, 0.f };
+const f32 BenchDebugDrawInterface::kUp[3] = { 0.f, 1.f, 0.f };
+
+static void add_debug_draw_cases(std::vector<BenchCase>& rCases)
+{
+	// What the debug draw context holds, kept alive by the cases.
+	struct DebugDraw
+	{
+		BenchDebugDrawInterface renderInterface;
+		dd::ContextHandle context = nullptr;
+		std::vector<dd::DrawVertex> points;
+		std::vector<dd::DrawVertex> lines;
+		std::vector<DebugDrawVertex> vertices;
+
+		~DebugDraw() { dd::shutdown(context); }
+	};
+	std::shared_ptr<DebugDraw> pDraw = std::make_shared<DebugDraw>();
+	dd::initialize(&pDraw->context, &pDraw->renderInterface);
+
+	// Full batches, the most the library hands the interface at once.
+	const u32 kBatch = DEBUG_DRAW_VERTEX_BUFFER_SIZE;
+	pDraw->points.resize(kBatch);
+	pDraw->lines.resize(kBatch);
+	pDraw->vertices.resize(kBatch * kDebugDrawVerticesPerPoint);
+	for (u32 i = 0; i < kBatch; ++i)
+	{
+		const f32 f = static_cast<f32>(i);
+		pDraw->points[i].point = { f, f * 0.5f, -f, 1.f, 0.5f, 0.25f, 4.f };
+		pDraw->lines[i].line = { f, -f, f * 0.25f, 0.25f, 0.5f, 1.f };
+	}
+
+	rCases.push_back({ "debug draw/expand 4096 points", [pDraw, kBatch]()
+	{
+		const f32 right[3] = { 0.8f, 0.f, 0.6f };
+		const f32 up[3] = { 0.f, 1.f, 0.f };
+		expand_debug_points(pDraw->points.data(), kBatch, right, up, pDraw->vertices.data());
+		keep(pDraw->vertices[kBatch].pos[0]);
+	} });
+
+	rCases.push_back({ "debug draw/copy 4096 line vertices", [pDraw, kBatch]()
+	{
+		copy_debug_lines(pDraw->lines.data(), kBatch, pDraw->vertices.data());
+		keep(pDraw->vertices[kBatch / 2].pos[0]);
+	} });
+
+	// A frame of what the samples draw: the grid, some shapes and labels.
+	rCases.push_back({ "debug draw/queue and flush scene", [pDraw]()
+	{
+		dd::ContextHandle ctx = pDraw->context;
+		const f32 white[3] = { 1.f, 1.f, 1.f };
+		const f32 grey[3] = { 0.5f, 0.5f, 0.5f };
+		const f32 identity[16] = { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f };
+
+		dd::xzSquareGrid(ctx, -50.f, 50.f, -1.f, 1.f, grey);
+		for (u32 i = 0; i < 64; ++i)
+		{
+			const f32 centre[3] = { static_cast<f32>(i % 8) * 4.f, 0.f, static_cast<f32>(i / 8) * 4.f };
+			if (i % 4 == 0)
+			{
+				dd::sphere(ctx, centre, white, 1.f);	// 1152 lines each.
+			}
+			dd::box(ctx, centre, white, 1.5f, 1.5f, 1.5f);
+			dd::point(ctx, centre, white, 8.f);
+			dd::projectedText(ctx, "label", centre, white, identity, 0, 0, 1920, 1080);
+		}
+		dd::flush(ctx);
+		s_sink += pDraw->renderInterface.m_numVertices;
+	} });
+}
+
+#if defined(_WIN32)
+
+static const char* kTempFileName = "CpuBench.tmp";
+static const char* kSmallFileDir = "CpuBench.tmp.d";
+static const u32 kNumSmallFiles = 1000;
+
+static std::string small_file_name(u32 index)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "%s\\%04u.tmp", kSmallFileDir, index);
+	return name;
+}
+
+static void remove_temp_files()
+{
+	remove(kTempFileName);
+	for (u32 i = 0; i < kNumSmallFiles; ++i)
+	{
+		remove(small_file_name(i).c_str());
+	}
+	RemoveDirectoryA(kSmallFileDir);
+}
+
+// A grid of quads as OBJ text, with positions, texture coordinates and normals.
+static std::string make_test_obj(u32 quads)
+{
+	std::string obj;
+	char line[128];
+	for (u32 y = 0; y <= quads; ++y)
+	{
+		for (u32 x = 0; x <= quads; ++x)
+		{
+			const f32 u = static_cast<f32>(x) / quads;
+			const f32 v = static_cast<f32>(y) / quads;
+			snprintf(line, sizeof(line), "v %f %f %f\nvt %f %f\nvn 0 1 0\n", u * 10.f, std::sin(u * 6.f) * std::cos(v * 6.f), v * 10.f, u, v);
+			obj += line;
+		}
+	}
+	for (u32 y = 0; y < quads; ++y)
+	{
+		for (u32 x = 0; x < quads; ++x)
+		{
+			const u32 i = y * (quads + 1) + x + 1;	// OBJ indices start at 1.
+			const u32 j = i + quads + 1;
+			snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\nf %u/%u/%u %u/%u/%u %u/%u/%u\n",
+				i, i, i, i + 1, i + 1, i + 1, j, j, j, j, j, j, i + 1, i + 1, i + 1, j + 1, j + 1, j + 1);
+			obj += line;
+		}
+	}
+	return obj;
+}
+
+static void add_framework_cases(std::vector<BenchCase>& rCases, JobPool& rPool)
+{
+	// 100x100 quads is 60000 vertices once unshared, inside the 16 bit indices.
+	std::shared_ptr<std::string> pObj = std::make_shared<std::string>(make_test_obj(100));
+	rCases.push_back({ "mesh/load obj 20k triangles", [pObj]()
+	{
+		std::vector<MeshData> shapes;
+		load_obj_mesh_data(reinterpret_cast<const memtype_t*>(pObj->data()), pObj->size(), "bench", 1.0f, shapes);
+		s_sink += shapes.empty() ? 0 : shapes[0].vertices.size();
+	} });
+
+	std::shared_ptr<MeshData> pMesh = std::make_shared<MeshData>();
+	{
+		std::vector<MeshData> shapes;
+		load_obj_mesh_data(reinterpret_cast<const memtype_t*>(pObj->data()), pObj->size(), "bench", 1.0f, shapes);
+		*pMesh = shapes[0];
+	}
+	rCases.push_back({ "mesh/tangents 60k vertices", [pMesh]()
+	{
+		compute_tangents_lengyel(pMesh->vertices.data(), static_cast<u32>(pMesh->vertices.size()),
+			pMesh->indices.data(), static_cast<u32>(pMesh->indices.size()));
+		keep(pMesh->vertices[0].tangent.w);
+	} });
+
+	// Written once, then read back from the file cache.
+	{
+		std::vector<char> bytes(16 * MB, 'x');
+		std::ofstream file(kTempFileName, std::ios::binary);
+		file.write(bytes.data(), bytes.size());
+	}
+	rCases.push_back({ "file/load_file 16MB", []()
+	{
+		u64 length = 0;
+		memtype_t* pData = load_file(kTempFileName, length, 16, 1);
+		s_sink += length + pData[length / 2];
+		release_loaded_file(pData);
+	} });
+
+	// Many small files, the way a level loads its materials and shaders: one
+	// at a time with load_file against one IoService batch. 1 to 8 KB each.
+	CreateDirectoryA(kSmallFileDir, nullptr);
+	{
+		std::vector<char> bytes(8 * KB);
+		for (u32 i = 0; i < kNumSmallFiles; ++i)
+		{
+			std::fill(bytes.begin(), bytes.end(), static_cast<char>('a' + i % 26));
+			std::ofstream file(small_file_name(i), std::ios::binary);
+			file.write(bytes.data(), KB + (i * 7919) % (7 * KB));
+		}
+	}
+	std::shared_ptr<std::vector<std::string>> pNames = std::make_shared<std::vector<std::string>>();
+	for (u32 i = 0; i < kNumSmallFiles; ++i)
+	{
+		pNames->push_back(small_file_name(i));
+	}
+	rCases.push_back({ "file/1000 small files serial", [pNames]()
+	{
+		for (const std::string& rName : *pNames)
+		{
+			u64 length = 0;
+			memtype_t* pData = load_file(rName.c_str(), length, 16, 0);
+			s_sink += length + (pData ? pData[0] : 0);
+			release_loaded_file(pData);
+		}
+	} });
+
+	const struct
+	{
+		IoService::Backend backend;
+		const char* pName;
+	} kBatchCases[] =
+	{
+		{ IoService::kCompletionPort, "file/1000 small files batch port" },
+		{ IoService::kThreadPool, "file/1000 small files batch threads" },
+	};
+	for (const auto& rBatch : kBatchCases)
+	{
+		std::shared_ptr<IoService> pIo = std::make_shared<IoService>();
+		pIo->init(&rPool, rBatch.backend);
+		rCases.push_back({ rBatch.pName, [pNames, pIo]()
+		{
+			for (const std::string& rName : *pNames)
+			{
+				pIo->queue_read(rName.c_str(), [](IoRequest& rRequest)
+				{
+					s_sink += rRequest.size + (rRequest.success ? rRequest.pData[0] : 0);
+				});
+			}
+			pIo->submit();
+			pIo->wait_all();
+		} });
+	}
+
+	std::shared_ptr<Camera> pCamera = std::make_shared<Camera>();
+	pCamera->resizeViewport(1920, 1080);
+	pCamera->eye = v3(3.f, 2.f, -10.f);
+	rCases.push_back({ "camera/updateMatrices", [pCamera]()
+	{
+		pCamera->updateMatrices();
+		keep(pCamera->planes[0].w);
+	} });
+}
+
+#endif
+
+// ========================================================
+// Checks
+// -check runs these instead of the timings. Each drives the stand-in device
+// of a portable module the way a frame drives the real one and fails if the
+// device sees the wrong calls.
+// ========================================================
+
+struct CheckCase
+{
+	std::string name;
+	std::function<void()> run;	// Reports what's wrong with CHECK.
+};
+
+static u32 s_checkFailures = 0;
+
+static void check_that(bool bOk, const char* pCondition, int line)
+{
+	if (!bOk)
+	{
+		errorF("  line %d: %s", line, pCondition);
+		++s_checkFailures;
+	}
+}
+
+#define CHECK(condition) check_that((condition), #condition, __LINE__)
+
+// Stands for a D3D object, the stand-in devices only compare the pointers.
+template<typename T>
+static T* fake_object(u32 id)
+{
+	return reinterpret_cast<T*>(static_cast<uintptr_t>(id) << 4);
+}
+
+static void add_binding_checks(std::vector<CheckCase>& rChecks)
+{
+	rChecks.push_back({ "bindings/duplicates filtered", []()
+	{
+		RecordingBindingDevice device;
+		BindingTable table;
+		table.init(&device);
+
+		ID3D11ShaderResourceView* pView = fake_object<ID3D11ShaderResourceView>(1);
+		table.set_shader_resource(ShaderStage::kPixel, 0, pView);
+		table.flush();
+		CHECK(device.calls().size() == 1);
+		CHECK(device.bound(RecordingBindingDevice::kShaderResource, ShaderStage::kPixel, 0) == pView);
+
+		// The same texture before every draw.
+		device.clear_calls();
+		table.reset_stats();
+		for (u32 draw = 0; draw < 10; ++draw)
+		{
+			table.set_shader_resource(ShaderStage::kPixel, 0, pView);
+			table.flush();
+		}
+		CHECK(device.calls().empty());
+		CHECK(table.stats().bindsRequested == 10);
+		CHECK(table.stats().bindsSkipped == 10);
+
+		// Changed and changed back before the flush.
+		table.set_shader_resource(ShaderStage::kPixel, 0, fake_object<ID3D11ShaderResourceView>(2));
+		table.set_shader_resource(ShaderStage::kPixel, 0, pView);
+		table.flush();
+		CHECK(device.calls().empty());
+
+		// Anything binding behind the table's back needs invalidate(), then it's sent again.
+		table.invalidate();
+		table.set_shader_resource(ShaderStage::kPixel, 0, pView);
+		table.flush();
+		CHECK(device.calls().size() == 1);
+	} });
+
+	rChecks.push_back({ "bindings/one call per stage", []()
+	{
+		RecordingBindingDevice device;
+		BindingTable table;
+		table.init(&device);
+
+		// Scattered slots in two stages, of all three kinds.
+		const u32 kPixelSlots[] = { 0, 3, 7 };
+		const u32 kVertexSlots[] = { 2, 5 };
+		for (u32 slot : kPixelSlots)
+		{
+			table.set_shader_resource(ShaderStage::kPixel, slot, fake_object<ID3D11ShaderResourceView>(100 + slot));
+			table.set_sampler(ShaderStage::kPixel, slot, fake_object<ID3D11SamplerState>(200 + slot));
+			table.set_constant_buffer(ShaderStage::kPixel, slot, fake_object<ID3D11Buffer>(300 + slot));
+		}
+		for (u32 slot : kVertexSlots)
+		{
+			table.set_shader_resource(ShaderStage::kVertex, slot, fake_object<ID3D11ShaderResourceView>(400 + slot));
+			table.set_constant_buffer(ShaderStage::kVertex, slot, fake_object<ID3D11Buffer>(500 + slot));
+		}
+		table.flush();
+
+		CHECK(device.num_calls(RecordingBindingDevice::kShaderResource) == 2);
+		CHECK(device.num_calls(RecordingBindingDevice::kSampler) == 1);
+		CHECK(device.num_calls(RecordingBindingDevice::kConstantBuffer) == 2);
+		for (const RecordingBindingDevice::Call& rCall : device.calls())
+		{
+			const bool bPixel = rCall.stage == ShaderStage::kPixel;
+			CHECK(bPixel || rCall.stage == ShaderStage::kVertex);
+			CHECK(rCall.startSlot == (bPixel ? 0u : 2u));
+			CHECK(rCall.count == (bPixel ? 8u : 4u));
+		}
+		CHECK(table.stats().calls == 5);
+		CHECK(device.bound(RecordingBindingDevice::kShaderResource, ShaderStage::kPixel, 7) == fake_object<ID3D11ShaderResourceView>(107));
+		CHECK(device.bound(RecordingBindingDevice::kSampler, ShaderStage::kPixel, 3) == fake_object<ID3D11SamplerState>(203));
+		CHECK(device.bound(RecordingBindingDevice::kConstantBuffer, ShaderStage::kVertex, 5) == fake_object<ID3D11Buffer>(505));
+		CHECK(device.bound(RecordingBindingDevice::kShaderResource, ShaderStage::kPixel, 4) == nullptr);
+
+		// Only the slots that changed go next time, the range trimmed to them.
+		device.clear_calls();
+		table.set_shader_resource(ShaderStage::kPixel, 0, fake_object<ID3D11ShaderResourceView>(100));
+		table.set_shader_resource(ShaderStage::kPixel, 3, fake_object<ID3D11ShaderResourceView>(113));
+		table.set_shader_resource(ShaderStage::kPixel, 7, fake_object<ID3D11ShaderResourceView>(107));
+		table.flush();
+		CHECK(device.calls().size() == 1);
+		CHECK(!device.calls().empty() && device.calls()[0].startSlot == 3 && device.calls()[0].count == 1);
+	} });
+}
+
+static void add_pipeline_checks(std::vector<CheckCase>& rChecks)
+{
+	rChecks.push_back({ "state cache/redundant state filtered", []()
+	{
+		RecordingPipelineDevice device;
+		StateCache cache;
+		cache.init(&device);
+
+		// A material's state set before every draw, only the first of each kind goes through.
+		ID3D11Buffer* pVertices = fake_object<ID3D11Buffer>(1);
+		const u32 stride = 32;
+		const u32 offset = 0;
+		for (u32 draw = 0; draw < 100; ++draw)
+		{
+			cache.set_vertex_shader(fake_object<ID3D11VertexShader>(2));
+			cache.set_pixel_shader(fake_object<ID3D11PixelShader>(3));
+			cache.set_input_layout(fake_object<ID3D11InputLayout>(4));
+			cache.set_topology(kTopologyTriangleList);
+			cache.set_vertex_buffers(0, 1, &pVertices, &stride, &offset);
+			cache.set_index_buffer(fake_object<ID3D11Buffer>(5), DXGI_FORMAT_R16_UINT, 0);
+			cache.set_blend_state(nullptr);
+			cache.set_rasterizer_state(fake_object<ID3D11RasterizerState>(6));
+			cache.set_depth_stencil_state(fake_object<ID3D11DepthStencilState>(7));
+		}
+		CHECK(device.total_calls() == 9);
+		CHECK(cache.stats().total_sent() == 9);
+		CHECK(cache.stats().total_skipped() == 99 * 9);
+
+		// Null blend factors are all ones, the same as passing ones.
+		device.clear_calls();
+		const f32 kOnes[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		const f32 kHalf[4] = { 0.5f, 0.5f, 0.5f, 0.5f };
+		cache.set_blend_state(nullptr, kOnes);
+		CHECK(device.calls(kStateBlend) == 0);
+		cache.set_blend_state(nullptr, kHalf);
+		CHECK(device.calls(kStateBlend) == 1);
+
+		// Two materials in turn, every change goes through.
+		device.clear_calls();
+		for (u32 draw = 0; draw < 10; ++draw)
+		{
+			cache.set_pixel_shader(fake_object<ID3D11PixelShader>(10 + (draw & 1)));
+		}
+		CHECK(device.calls(kStatePixelShader) == 10);
+
+		// After invalidate() the next call of each kind is sent even if it's the same.
+		device.clear_calls();
+		cache.invalidate();
+		cache.set_vertex_shader(fake_object<ID3D11VertexShader>(2));
+		cache.set_vertex_buffers(0, 1, &pVertices, &stride, &offset);
+		cache.set_vertex_shader(fake_object<ID3D11VertexShader>(2));
+		CHECK(device.calls(kStateVertexShader) == 1);
+		CHECK(device.calls(kStateVertexBuffers) == 1);
+	} });
+
+	rChecks.push_back({ "state cache/vertex buffer slots", []()
+	{
+		RecordingPipelineDevice device;
+		StateCache cache;
+		cache.init(&device);
+
+		ID3D11Buffer* buffers[3] = { fake_object<ID3D11Buffer>(1), fake_object<ID3D11Buffer>(2), fake_object<ID3D11Buffer>(3) };
+		const u32 strides[3] = { 12, 8, 16 };
+		u32 offsets[3] = { 0, 0, 0 };
+		cache.set_vertex_buffers(0, 3, buffers, strides, offsets);
+		cache.set_vertex_buffers(0, 3, buffers, strides, offsets);
+		CHECK(device.calls(kStateVertexBuffers) == 1);
+
+		// A different offset in one slot is a change, and only slots sent before are known.
+		offsets[1] = 64;
+		cache.set_vertex_buffers(0, 3, buffers, strides, offsets);
+		CHECK(device.calls(kStateVertexBuffers) == 2);
+		cache.set_vertex_buffers(1, 1, &buffers[1], &strides[1], &offsets[1]);
+		CHECK(device.calls(kStateVertexBuffers) == 2);
+		cache.set_vertex_buffers(3, 1, &buffers[0], &strides[0], &offsets[0]);
+		CHECK(device.calls(kStateVertexBuffers) == 3);
+	} });
+}
+
+static void add_constant_checks(std::vector<CheckCase>& rChecks)
+{
+	rChecks.push_back({ "constants/one map per frame", []()
+	{
+		struct DrawConstants
+		{
+			f32 world[16];
+			u32 id;
+		};
+
+		RecordingConstantDevice device;
+		ConstantRing ring;
+		ring.init(&device, 4 * KB);
+
+		// Frames of 10 to 10000 draws, each maps once whatever the draw count.
+		// The buffer only grows when a frame needs more than any before.
+		const u32 kDrawCounts[] = { 10, 1000, 10000, 10000, 100 };
+		for (u32 draws : kDrawCounts)
+		{
+			device.clear_calls();
+			std::vector<ConstantSlice> slices;
+			for (u32 draw = 0; draw < draws; ++draw)
+			{
+				DrawConstants constants = {};
+				constants.id = draw;
+				slices.push_back(ring.allocate(constants));
+			}
+			ring.upload();
+			for (const ConstantSlice& rSlice : slices)
+			{
+				ring.bind(ShaderStage::kVertex, 1, rSlice);
+			}
+
+			CHECK(device.num_uploads() == 1);
+			CHECK(device.num_reserves() <= 1);
+			CHECK(device.binds().size() == draws);
+			CHECK(device.capacity() >= draws * ConstantRing::kAlignment);
+
+			// Each bind points at its own draw's constants.
+			bool bAligned = true;
+			bool bMatches = true;
+			for (u32 draw = 0; draw < draws; ++draw)
+			{
+				const RecordingConstantDevice::Bind& rBind = device.binds()[draw];
+				bAligned &= rBind.offset % ConstantRing::kAlignment == 0;
+				u32 id = ~0u;
+				memcpy(&id, device.data().data() + rBind.offset + offsetof(DrawConstants, id), sizeof(id));
+				bMatches &= id == draw;
+			}
+			CHECK(bAligned);
+			CHECK(bMatches);
+		}
+		CHECK(ring.stats().uploads == 5);
+
+		// Nothing allocated, nothing mapped.
+		device.clear_calls();
+		ring.upload();
+		CHECK(device.num_uploads() == 0);
+	} });
+}
+
+static void add_command_list_checks(std::vector<CheckCase>& rChecks, JobPool& rPool)
+{
+	rChecks.push_back({ "command lists/chunk order on the pool", [&rPool]()
+	{
+		RecordingCommandListDevice device(rPool.numWorkers() + 1);
+		CommandRecorder recorder;
+		recorder.init(&device, &rPool);
+
+		// Chunks of uneven length so the workers finish them out of order.
+		static const u32 kChunks = 64;
+		const CommandRecorder::RecordFn record = [&device](u32 chunk, RecordingContext& rContext)
+		{
+			const u32 draws = 1 + (chunk * 7) % 13;
+			for (u32 draw = 0; draw < draws; ++draw)
+			{
+				u64 work = 0;
+				for (u32 i = 0; i < (13 - draws) * 500; ++i)
+				{
+					work += i * chunk;
+				}
+				s_sink += work;
+				device.record(rContext.index, chunk * 100 + draw);
+			}
+		};
+
+		std::vector<u32> expected;
+		for (u32 chunk = 0; chunk < kChunks; ++chunk)
+		{
+			const u32 draws = 1 + (chunk * 7) % 13;
+			for (u32 draw = 0; draw < draws; ++draw)
+			{
+				expected.push_back(chunk * 100 + draw);
+			}
+		}
+
+		for (u32 frame = 0; frame < 20; ++frame)
+		{
+			device.clear_calls();
+			recorder.record(kChunks, record);
+			CHECK(device.executed() == expected);
+			CHECK(device.num_overlaps() == 0);
+			CHECK(device.num_executes() == kChunks);
+		}
+		CHECK(recorder.stats().records == 20);
+		CHECK(recorder.stats().chunks == 20 * kChunks);
+	} });
+}
+
+static void add_command_buffer_checks(std::vector<CheckCase>& rChecks)
+{
+	rChecks.push_back({ "command buffer/replay round trip", []()
+	{
+		// One of every command, through the CommandBuffer front end as a frame would.
+		RecordingCommandDevice recorded;
+		CommandBuffer commands;
+		commands.init(&recorded);
+
+		ID3D11RenderTargetView* targets[2] = { fake_object<ID3D11RenderTargetView>(1), fake_object<ID3D11RenderTargetView>(2) };
+		ID3D11DepthStencilView* pDepth = fake_object<ID3D11DepthStencilView>(3);
+		ID3D11UnorderedAccessView* pView = fake_object<ID3D11UnorderedAccessView>(4);
+		ID3D11Buffer* pBuffer = fake_object<ID3D11Buffer>(5);
+		const f32 kColour[4] = { 0.1f, 0.2f, 0.3f, 1.0f };
+		const Viewport viewport = { 0.f, 0.f, 1920.f, 1080.f, 0.f, 1.f };
+		u8 constants[100];
+		for (u32 i = 0; i < sizeof(constants); ++i)
+		{
+			constants[i] = static_cast<u8>(i * 3);
+		}
+
+		commands.set_render_targets(2, targets, pDepth);
+		commands.set_viewport(viewport);
+		commands.clear_render_target(targets[0], kColour);
+		commands.clear_depth_stencil(pDepth, kClearDepth | kClearStencil, 1.0f, 7);
+		commands.update_buffer(pBuffer, constants, sizeof(constants));
+		commands.draw(3, 0);
+		commands.draw_indexed(36, 6, -2);
+		commands.draw_instanced(4, 100, 0, 10);
+		commands.draw_indexed_instanced(36, 1000, 0, 0, 5);
+		commands.set_unordered_access_views(1, 1, &pView);
+		commands.dispatch(240, 135, 1);
+		commands.set_render_target(nullptr, nullptr);
+
+		CHECK(recorded.num_calls() == 12);
+		CHECK(recorded.num_draws() == 4);
+		for (u32 kind = 0; kind < kNumCommandKinds; ++kind)
+		{
+			CHECK(recorded.num_calls(static_cast<CommandKind>(kind)) >= 1);
+		}
+
+		// Replayed into another recording device, the stream comes out byte for byte.
+		RecordingCommandDevice replayed;
+		recorded.replay(replayed);
+		CHECK(replayed.stream() == recorded.stream());
+		for (u32 kind = 0; kind < kNumCommandKinds; ++kind)
+		{
+			CHECK(replayed.num_calls(static_cast<CommandKind>(kind)) == recorded.num_calls(static_cast<CommandKind>(kind)));
+		}
+
+		// And again, replay doesn't consume the stream.
+		RecordingCommandDevice again;
+		replayed.replay(again);
+		recorded.replay(again);
+		CHECK(again.stream().size() == 2 * recorded.stream().size());
+
+		// Into a device that drops everything, as the CPU timing runs do.
+		NullCommandDevice null;
+		recorded.replay(null);
+
+		recorded.clear_calls();
+		CHECK(recorded.stream().empty());
+		CHECK(recorded.num_calls() == 0);
+	} });
+}
+
+// A frame of two nested passes, the outer one named after the frame so its
+// results can be told apart from the frames either side.
+static const char* const kGpuFrameNames[] = { "frame 0", "frame 1", "frame 2", "frame 3", "frame 4", "frame 5", "frame 6", "frame 7" };
+
+static void time_gpu_frame(GpuTimer& rTimer, u32 frame)
+{
+	rTimer.begin_frame();
+	rTimer.begin_pass(kGpuFrameNames[frame % 8]);
+	rTimer.begin_pass("inner");
+	rTimer.end_pass();
+	rTimer.end_pass();
+	rTimer.end_frame();
+}
+
+static void add_gpu_timer_checks(std::vector<CheckCase>& rChecks)
+{
+	rChecks.push_back({ "gpu timer/results arrive latency frames late", []()
+	{
+		// Latencies the ring covers, nothing is skipped.
+		for (u32 latency = 1; latency < GpuTimer::kFramesInFlight; ++latency)
+		{
+			CpuClockTimerDevice device(latency);
+			GpuTimer timer;
+			timer.init(&device);
+
+			static const u32 kFrames = 12;
+			bool bEarly = false;
+			bool bOnTime = true;
+			for (u32 frame = 1; frame <= kFrames; ++frame)
+			{
+				time_gpu_frame(timer, frame);
+				if (frame <= latency)
+				{
+					bEarly |= !timer.timings().empty() || timer.latency() != 0;
+					continue;
+				}
+
+				// The results are the frame latency before this one's.
+				const std::vector<GpuPassTiming>& rTimings = timer.timings();
+				bOnTime &= timer.latency() == latency && rTimings.size() == 2 &&
+					rTimings[0].pName == kGpuFrameNames[(frame - latency) % 8] && rTimings[0].depth == 0 && rTimings[1].depth == 1;
+			}
+			CHECK(!bEarly);
+			CHECK(bOnTime);
+			CHECK(timer.stats().frames == kFrames);
+			CHECK(timer.stats().resolved == kFrames - latency);
+			CHECK(timer.stats().skipped == 0);
+		}
+	} });
+
+	rChecks.push_back({ "gpu timer/full ring skips frames", []()
+	{
+		// The GPU is further behind than the ring has slots, so some frames
+		// find every slot waiting and go untimed instead of stalling.
+		static const u32 kLatency = GpuTimer::kFramesInFlight + 2;
+		CpuClockTimerDevice device(kLatency);
+		GpuTimer timer;
+		timer.init(&device);
+
+		static const u32 kFrames = 40;
+		bool bEarly = false;
+		for (u32 frame = 1; frame <= kFrames; ++frame)
+		{
+			time_gpu_frame(timer, frame);
+			bEarly |= !timer.timings().empty() && timer.latency() < kLatency;
+		}
+
+		const GpuTimer::Stats& rStats = timer.stats();
+		CHECK(!bEarly);
+		CHECK(rStats.frames == kFrames);
+		CHECK(rStats.skipped > 0);
+		CHECK(rStats.resolved > 0);
+		CHECK(rStats.resolved + rStats.skipped + GpuTimer::kFramesInFlight >= kFrames);
+		CHECK(device.num_not_ready() > 0);
+		CHECK(!timer.timings().empty());
+	} });
+}
+
+// How far time is from the nearest multiple of periodNs after originNs, either way.
+static u64 off_cadence_ns(u64 time, u64 originNs, u64 periodNs)
+{
+	const u64 phase = (time - originNs) % periodNs;
+	return std::min(phase, periodNs - phase);
+}
+
+static void add_pacing_checks(std::vector<CheckCase>& rChecks)
+{
+	static const u64 kMs = 1000000;
+	static const u64 kPeriodNs = 10 * kMs;
+	static const u64 kReadSlackNs = 10000;	// Clock reads move the manual clock a microsecond each.
+
+	rChecks.push_back({ "pacing/fixed rate holds its cadence", []()
+	{
+		// Every sleep wakes a millisecond late, the spin makes up for it.
+		ManualPacingClock clock(1 * kMs);
+		FramePacer pacer;
+		pacer.init(&clock);
+		pacer.set_mode(kPacingFixedRate);
+		pacer.set_target_hz(100.0);
+
+		u64 first = 0;
+		bool bOnCadence = true;
+		for (u32 frame = 0; frame < 1000; ++frame)
+		{
+			pacer.wait_for_frame();
+			first = frame ? first : clock.time();
+			bOnCadence &= off_cadence_ns(clock.time(), first, kPeriodNs) < kReadSlackNs;
+			clock.advance(3 * kMs);
+			pacer.end_frame();
+		}
+
+		const FramePacingStats stats = pacer.stats();
+		CHECK(bOnCadence);
+		CHECK(fabs(stats.interval.meanMs - 10.0) < 0.01);
+		CHECK(stats.interval.stdDevMs < 0.01);
+		CHECK(stats.late == 0);
+		CHECK(stats.skipped == 0);
+		CHECK(clock.num_sleeps() > 0);
+	} });
+
+	rChecks.push_back({ "pacing/late frame skips and keeps the phase", []()
+	{
+		ManualPacingClock clock;
+		FramePacer pacer;
+		pacer.init(&clock);
+		pacer.set_mode(kPacingFixedRate);
+		pacer.set_target_hz(100.0);
+
+		// Frame 5 takes two and a half periods. Frame 6 starts as soon as it
+		// can, frame 7 is back on the cadence and the deadline in between is skipped.
+		u64 first = 0;
+		bool bOnCadence = true;
+		for (u32 frame = 0; frame < 20; ++frame)
+		{
+			pacer.wait_for_frame();
+			first = frame ? first : clock.time();
+			bOnCadence &= frame == 6 || off_cadence_ns(clock.time(), first, kPeriodNs) < kReadSlackNs;
+			clock.advance(frame == 5 ? 25 * kMs : 2 * kMs);
+			pacer.end_frame();
+		}
+
+		const FramePacingStats stats = pacer.stats();
+		CHECK(bOnCadence);
+		CHECK(stats.late == 1);
+		CHECK(stats.skipped == 1);
+	} });
+
+	rChecks.push_back({ "pacing/low latency presents on the cadence", []()
+	{
+		ManualPacingClock clock(1 * kMs);
+		FramePacer pacer;
+		pacer.init(&clock);
+		pacer.set_mode(kPacingLowLatency);
+		pacer.set_target_hz(100.0);
+
+		// Frames of 4 ms then 6 ms. Once the prediction has caught up they
+		// start that much earlier and still present the margin before they're
+		// due, on the same cadence, except the first 6 ms frame which is late.
+		static const u32 kSettle = 10;
+		static const u32 kSlower = 40;
+		u64 firstEnd = 0;
+		bool bOnCadence = true;
+		bool bPredicted = true;
+		for (u32 frame = 0; frame < 80; ++frame)
+		{
+			const u64 workNs = frame < kSlower ? 4 * kMs : 6 * kMs;
+			pacer.wait_for_frame();
+			clock.advance(workNs);
+			if (frame == kSettle)
+			{
+				firstEnd = clock.time();
+			}
+			if (frame > kSettle && frame != kSlower)
+			{
+				bOnCadence &= off_cadence_ns(clock.time(), firstEnd, kPeriodNs) < kReadSlackNs;
+				bPredicted &= pacer.predicted_frame_ns() >= workNs && pacer.predicted_frame_ns() < workNs + kReadSlackNs;
+			}
+			pacer.end_frame();
+			if (frame == kSlower + 1)
+			{
+				pacer.reset_stats();
+			}
+		}
+
+		// The frames after the change wait the rest of the period.
+		const FramePacingStats stats = pacer.stats();
+		CHECK(bOnCadence);
+		CHECK(bPredicted);
+		CHECK(fabs(stats.interval.meanMs - 10.0) < 0.01);
+		CHECK(stats.latency.maxMs < 6.0 + kReadSlackNs * 1e-6);
+		CHECK(fabs(stats.waitMs - 4.0) < 0.1);
+		CHECK(stats.late == 0);
+	} });
+
+	rChecks.push_back({ "pacing/uncapped never waits", []()
+	{
+		ManualPacingClock clock;
+		FramePacer pacer;
+		pacer.init(&clock);
+		pacer.set_mode(kPacingUncapped);
+		for (u32 frame = 0; frame < 10; ++frame)
+		{
+			pacer.wait_for_frame();
+			clock.advance(1 * kMs);
+			pacer.end_frame();
+		}
+		CHECK(clock.num_sleeps() == 0);
+		CHECK(pacer.stats().waitMs < 0.01);
+		CHECK(pacer.sync_interval() == 0);
+	} });
+}
+
+// Stands for the shader compiler: the output is the source with its
+// "#include <file>" lines replaced by the file, and any line that says
+// "error" fails the compile.
+static bool stub_compile(const std::string& rPath, std::string& rOutput, std::vector<std::string>& rFilesOut, std::string& rErrorsOut)
+{
+	rFilesOut.push_back(rPath);
+	std::ifstream file(rPath);
+	if (!file)
+	{
+		rErrorsOut += rPath + ": can't open\n";
+		return false;
+	}
+
+	static const std::string kInclude = "#include ";
+	bool bOk = true;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.compare(0, kInclude.size(), kInclude) == 0)
+		{
+			bOk = stub_compile(line.substr(kInclude.size()), rOutput, rFilesOut, rErrorsOut) && bOk;
+		}
+		else if (line.find("error") != std::string::npos)
+		{
+			rErrorsOut += rPath + ": " + line + "\n";
+			bOk = false;
+		}
+		else
+		{
+			rOutput += line + "\n";
+		}
+	}
+	return bOk;
+}
+
+static void write_text(const char* pPath, const std::string& rText)
+{
+	std::ofstream file(pPath, std::ios::binary | std::ios::trunc);
+	file << rText;
+}
+
+// One item compiled from kReloadSource, which includes kReloadInclude. Keeps
+// the last good output the way a renderer keeps the last good shader.
+struct StubReload
+{
+	static const char* const kReloadSource;
+	static const char* const kReloadInclude;
+
+	HotReload reload;
+	HotReload::Handle handle;
+
+	std::string next;					// Written by the compile job, taken by apply.
+	std::string output;					// Last good compile.
+	std::vector<std::string> applied;	// Every output apply kept, in order.
+	u32 failures = 0;
+	std::string errors;
+
+	// A compile that finds bHold set waits after reading until bRelease.
+	std::mutex gateMutex;
+	std::condition_variable gate;
+	bool bHold = false;
+	bool bEntered = false;
+	bool bRelease = false;
+
+	explicit StubReload(JobPool& rPool, const std::string& rInclude)
+	{
+		write_text(kReloadInclude, rInclude);
+		write_text(kReloadSource, std::string("#include ") + kReloadInclude + "\nmain\n");
+
+		reload.init(&rPool, 0.0);
+		handle = reload.add([this](std::vector<std::string>& rFilesOut, std::string& rErrorsOut)
+		{
+			std::string compiled;
+			const bool bOk = stub_compile(kReloadSource, compiled, rFilesOut, rErrorsOut);
+
+			std::unique_lock<std::mutex> lock(gateMutex);
+			if (bHold)
+			{
+				bHold = false;
+				bEntered = true;
+				gate.notify_all();
+				gate.wait(lock, [this]() { return bRelease; });
+			}
+			next = compiled;
+			return bOk;
+		},
+		[this](bool bOk, const std::string& rErrors)
+		{
+			if (bOk)
+			{
+				output = next;
+				applied.push_back(next);
+			}
+			else
+			{
+				++failures;
+				errors = rErrors;
+			}
+		});
+	}
+
+	~StubReload()
+	{
+		reload.flush();
+		remove(kReloadSource);
+		remove(kReloadInclude);
+	}
+};
+
+const char* const StubReload::kReloadSource = "CpuBench.reload.tmp";
+const char* const StubReload::kReloadInclude = "CpuBench.reload.inc.tmp";
+
+static void add_hot_reload_checks(std::vector<CheckCase>& rChecks, JobPool& rPool)
+{
+	rChecks.push_back({ "hot reload/initial compile", [&rPool]()
+	{
+		StubReload stub(rPool, "first");
+		CHECK(stub.reload.busy(stub.handle));
+		stub.reload.update();
+		stub.reload.flush();
+		CHECK(!stub.reload.busy(stub.handle));
+		CHECK(stub.output == "first\nmain\n");
+		CHECK(stub.applied.size() == 1);
+
+		// Nothing changed, nothing compiles.
+		stub.reload.update();
+		stub.reload.flush();
+		const HotReload::Stats stats = stub.reload.stats();
+		CHECK(stats.compiles == 1);
+		CHECK(stats.reloads == 0);
+		CHECK(stats.applied == 1);
+	} });
+
+	rChecks.push_back({ "hot reload/include edit", [&rPool]()
+	{
+		StubReload stub(rPool, "first");
+		stub.reload.update();
+		stub.reload.flush();
+
+		// Sizes differ from one write to the next so the stamp changes within the timer resolution.
+		write_text(StubReload::kReloadInclude, "second edit\n");
+		stub.reload.update();
+		CHECK(stub.reload.busy(stub.handle));
+		stub.reload.flush();
+		CHECK(stub.output == "second edit\nmain\n");
+		CHECK(stub.applied.size() == 2);
+		CHECK(stub.reload.stats().reloads == 1);
+	} });
+
+	rChecks.push_back({ "hot reload/failed compile keeps last good", [&rPool]()
+	{
+		StubReload stub(rPool, "first");
+		stub.reload.update();
+		stub.reload.flush();
+
+		write_text(StubReload::kReloadInclude, "an error\n");
+		stub.reload.update();
+		stub.reload.flush();
+		CHECK(stub.failures == 1);
+		CHECK(stub.errors.find("an error") != std::string::npos);
+		CHECK(stub.output == "first\nmain\n");
+		CHECK(stub.reload.stats().failures == 1);
+
+		// The files of a failed compile are still watched, fixing them recovers.
+		write_text(StubReload::kReloadInclude, "fixed it\n");
+		stub.reload.update();
+		stub.reload.flush();
+		CHECK(stub.output == "fixed it\nmain\n");
+		CHECK(stub.applied.size() == 2);
+	} });
+
+	rChecks.push_back({ "hot reload/edit during compile", [&rPool]()
+	{
+		StubReload stub(rPool, "first");
+		stub.reload.update();
+		stub.reload.flush();
+
+		// The compile reads the second version, the third is saved before it finishes.
+		stub.bHold = true;
+		write_text(StubReload::kReloadInclude, "second\n");
+		stub.reload.update();
+		{
+			std::unique_lock<std::mutex> lock(stub.gateMutex);
+			stub.gate.wait(lock, [&stub]() { return stub.bEntered; });
+		}
+		write_text(StubReload::kReloadInclude, "third version\n");
+		{
+			std::lock_guard<std::mutex> lock(stub.gateMutex);
+			stub.bRelease = true;
+		}
+		stub.gate.notify_all();
+		stub.reload.flush();
+
+		// The second version is never shown.
+		CHECK(stub.applied.size() == 2);
+		CHECK(stub.applied.size() == 2 && stub.applied[1] == "third version\nmain\n");
+		CHECK(stub.output == "third version\nmain\n");
+		const HotReload::Stats stats = stub.reload.stats();
+		CHECK(stats.compiles == 3);
+		CHECK(stats.applied == 2);
+	} });
+
+#if defined(_WIN32)
+	// The same through the shader cache and the real compiler. The hook saves
+	// the include after the compiler has read it, before the entry is stored:
+	// the entry must be keyed by what was read, not by the file as it is then,
+	// or the next lookup of the new version finds the old bytecode.
+	rChecks.push_back({ "hot reload/shader edit during compile", [&rPool]()
+	{
+		static const char* const kSource = "CpuBench.shader.tmp";
+		static const char* const kInclude = "CpuBench.shader.inc.tmp";
+
+		// A nonce so no entry Cache/Shaders kept from an earlier run matches.
+		const std::string nonce = std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+		auto includeText = [&nonce](const char* pColor) { return "// " + nonce + "\nstatic const float4 kColor = " + pColor + ";\n"; };
+		write_text(kInclude, includeText("float4(1, 0, 0, 1)"));
+		write_text(kSource, std::string("#include \"") + kInclude + "\"\nfloat4 main() : SV_Target { return kColor; }\n");
+
+		std::mutex hookMutex;
+		bool bSaveOnCompile = false;
+		shader_cache_set_compiled_hook([&](const char*)
+		{
+			std::lock_guard<std::mutex> lock(hookMutex);
+			if (bSaveOnCompile)
+			{
+				bSaveOnCompile = false;
+				write_text(kInclude, includeText("float4(0, 0, 1, 1) * 0.25"));
+			}
+		});
+
+		HotReload reload;
+		reload.init(&rPool, 0.0);
+		ComPtr<ID3DBlob> pNext;
+		std::vector<ComPtr<ID3DBlob>> applied;
+		const HotReload::Handle handle = reload.add([&pNext](std::vector<std::string>& rFilesOut, std::string& rErrorsOut)
+		{
+			const bool bOk = shader_cache_compile(kSource, "main", "ps_5_0", nullptr, pNext.ReleaseAndGetAddressOf(), &rErrorsOut);
+			shader_cache_dependencies(kSource, "main", "ps_5_0", nullptr, rFilesOut);
+			return bOk;
+		},
+		[&pNext, &applied](bool bOk, const std::string&)
+		{
+			if (bOk)
+			{
+				applied.push_back(pNext);
+			}
+		});
+		reload.update();
+		reload.flush();
+		CHECK(applied.size() == 1);
+
+		// The compile reads the second version, the third is saved before the entry is stored.
+		const ShaderCacheStats before = shader_cache_stats();
+		{
+			std::lock_guard<std::mutex> lock(hookMutex);
+			bSaveOnCompile = true;
+		}
+		write_text(kInclude, includeText("float4(0, 1, 0, 1) * 0.5"));
+		reload.update();
+		reload.flush();
+		const ShaderCacheStats after = shader_cache_stats();
+
+		// The third version compiled too, rather than hitting the second's bytecode.
+		CHECK(!bSaveOnCompile);
+		CHECK(reload.stats().compiles == 3);
+		CHECK(after.compiles == before.compiles + 2);
+		CHECK(after.memoryHits == before.memoryHits);
+		CHECK(after.diskHits == before.diskHits);
+		CHECK(applied.size() == 2);
+
+		// Now it's found, and it's what was applied.
+		ComPtr<ID3DBlob> pCached;
+		CHECK(shader_cache_compile(kSource, "main", "ps_5_0", nullptr, pCached.GetAddressOf()));
+		CHECK(shader_cache_stats().memoryHits == after.memoryHits + 1);
+		CHECK(pCached && applied.size() == 2 && pCached->GetBufferSize() == applied[1]->GetBufferSize() &&
+			memcmp(pCached->GetBufferPointer(), applied[1]->GetBufferPointer(), pCached->GetBufferSize()) == 0);
+
+		reload.flush();
+		shader_cache_set_compiled_hook(nullptr);
+		remove(kSource);
+		remove(kInclude);
+	} });
+#endif
+}
+
+#if defined(_WIN32)
+static void add_io_checks(std::vector<CheckCase>& rChecks)
+{
+	rChecks.push_back({ "io service/reads finished at issue don't nest", []()
+	{
+		// Missing and empty files finish as they're issued. Without a callback
+		// pool their callbacks run on this thread, and should all run at the
+		// same stack depth rather than one call deeper per read.
+		static const char* const kDir = "CpuBench.io.d";
+		static const u32 kNumFiles = 4000;
+		CreateDirectoryA(kDir, nullptr);
+		std::vector<std::string> names;
+		for (u32 i = 0; i < kNumFiles; ++i)
+		{
+			char name[64];
+			snprintf(name, sizeof(name), "%s\\%04u.tmp", kDir, i);
+			names.push_back(name);
+			if (i % 2)
+			{
+				std::ofstream file(name, std::ios::binary | std::ios::trunc);
+			}
+		}
+
+		IoService io;
+		io.init(nullptr, IoService::kCompletionPort);
+		u32 callbacks = 0;
+		u32 succeeded = 0;
+		uintptr_t lowest = ~uintptr_t(0);
+		uintptr_t highest = 0;
+		for (const std::string& rName : names)
+		{
+			io.queue_read(rName.c_str(), [&](IoRequest& rRequest)
+			{
+				const char local = 0;
+				lowest = std::min(lowest, reinterpret_cast<uintptr_t>(&local));
+				highest = std::max(highest, reinterpret_cast<uintptr_t>(&local));
+				++callbacks;
+				succeeded += rRequest.success ? 1 : 0;
+			});
+		}
+		io.submit();
+		io.wait_all();
+
+		CHECK(callbacks == kNumFiles);
+		CHECK(succeeded == kNumFiles / 2);
+		CHECK(io.stats().failed == kNumFiles / 2);
+		CHECK(highest - lowest < 16 * KB);
+
+		io.shutdown();
+		for (const std::string& rName : names)
+		{
+			remove(rName.c_str());
+		}
+		RemoveDirectoryA(kDir);
+	} });
+}
+#endif
+
+// ========================================================
+// Measuring
+// ========================================================
+
+static f64 time_runs(const BenchCase& rCase, u32 runs)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+	for (u32 i = 0; i < runs; ++i)
+	{
+		rCase.run();
+	}
+	const auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<f64, std::milli>(end - start).count();
+}
+
+static BenchResult measure(const BenchCase& rCase, u32 samples, f64 sampleMs)
+{
+	// The first run warms caches and allocations and isn't timed, then batches
+	// double until one is long enough.
+	rCase.run();
+	u32 runs = 1;
+	f64 ms = time_runs(rCase, runs);
+	while (ms < sampleMs && runs < (1u << 24))
+	{
+		runs *= 2;
+		ms = time_runs(rCase, runs);
+	}
+
+	FrameTimings timings;
+	timings.reserve(samples);
+	for (u32 i = 0; i < samples; ++i)
+	{
+		timings.add(time_runs(rCase, runs) / (static_cast<f64>(runs) * rCase.itemsPerRun));
+	}
+	const FrameTimeSummary summary = timings.summarize();
+	return { rCase.name, runs, summary, rCase.budgetNs, summary.medianMs * 1e6 };
+}
+
+// Median of the named case, from the results if it ran, otherwise measured
+// now without being reported, e.g. when the filters leave it out.
+static f64 median_ns(const std::string& rName, const std::vector<BenchCase>& rCases, const std::vector<BenchResult>& rResults,
+	u32 samples, f64 sampleMs)
+{
+	for (const BenchResult& rResult : rResults)
+	{
+		if (rResult.name == rName)
+		{
+			return rResult.summary.medianMs * 1e6;
+		}
+	}
+	for (const BenchCase& rCase : rCases)
+	{
+		if (rCase.name == rName)
+		{
+			return measure(rCase, samples, sampleMs).summary.medianMs * 1e6;
+		}
+	}
+	panicF("No case %s to net a budget of", rName.c_str());
+	return 0.0;
+}
+
+// ========================================================
+// Results
+// ========================================================
+
+static std::string json_escape(const std::string& rText)
+{
+	std::string out;
+	for (char c : rText)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+		}
+		out += c;
+	}
+	return out;
+}
+
+// One case per line so a diff of two runs lines up, read_baseline() doesn't mind the layout.
+static bool write_json(const std::vector<BenchResult>& rResults, u32 numThreads, const char* pPath)
+{
+	FILE* pFile = fopen(pPath, "w");
+	if (!pFile)
+	{
+		return false;
+	}
+
+	fprintf(pFile, "{\n\t\"threads\": %u,\n\t\"benchmarks\": [\n", numThreads);
+	for (size_t i = 0; i < rResults.size(); ++i)
+	{
+		const BenchResult& rResult = rResults[i];
+		const FrameTimeSummary& rSummary = rResult.summary;
+		fprintf(pFile, "\t\t{ \"name\": \"%s\", \"runs_per_sample\": %u, \"samples\": %u, \"min_ns\": %.1f, \"median_ns\": %.1f, \"mean_ns\": %.1f, \"p95_ns\": %.1f, \"max_ns\": %.1f }%s\n",
+			json_escape(rResult.name).c_str(), rResult.runsPerSample, rSummary.frames,
+			rSummary.minMs * 1e6, rSummary.medianMs * 1e6, rSummary.meanMs * 1e6, rSummary.p95Ms * 1e6, rSummary.maxMs * 1e6,
+			i + 1 < rResults.size() ? "," : "");
+	}
+	fprintf(pFile, "\t]\n}\n");
+	return fclose(pFile) == 0;
+}
+
+struct BaselineEntry
+{
+	std::string name;
+	f64 medianNs;
+};
+
+// Just enough JSON to read a baseline back, whatever whitespace an editor or
+// a formatter left in it. Each function skips the whitespace before what it
+// reads and returns false on anything it doesn't expect.
+struct JsonCursor
+{
+	const char* pAt;
+	const char* pEnd;
+};
+
+static void json_space(JsonCursor& rCursor)
+{
+	while (rCursor.pAt < rCursor.pEnd && isspace(static_cast<unsigned char>(*rCursor.pAt)))
+	{
+		++rCursor.pAt;
+	}
+}
+
+static bool json_next(JsonCursor& rCursor, char c)
+{
+	json_space(rCursor);
+	if (rCursor.pAt < rCursor.pEnd && *rCursor.pAt == c)
+	{
+		++rCursor.pAt;
+		return true;
+	}
+	return false;
+}
+
+static bool json_string(JsonCursor& rCursor, std::string& rOut)
+{
+	if (!json_next(rCursor, '"'))
+	{
+		return false;
+	}
+
+	rOut.clear();
+	while (rCursor.pAt < rCursor.pEnd)
+	{
+		const char c = *rCursor.pAt++;
+		if (c == '"')
+		{
+			return true;
+		}
+		if (c != '\\')
+		{
+			rOut += c;
+			continue;
+		}
+		if (rCursor.pAt == rCursor.pEnd)
+		{
+			return false;
+		}
+
+		const char escaped = *rCursor.pAt++;
+		switch (escaped)
+		{
+		case 'b': rOut += '\b'; break;
+		case 'f': rOut += '\f'; break;
+		case 'n': rOut += '\n'; break;
+		case 'r': rOut += '\r'; break;
+		case 't': rOut += '\t'; break;
+		case 'u':
+		{
+			// Case names are ASCII, anything past that can't match one.
+			if (rCursor.pEnd - rCursor.pAt < 4)
+			{
+				return false;
+			}
+			const std::string hex(rCursor.pAt, 4);
+			char* pHexEnd = nullptr;
+			const unsigned long code = strtoul(hex.c_str(), &pHexEnd, 16);
+			if (pHexEnd != hex.c_str() + 4)
+			{
+				return false;
+			}
+			rOut += code < 0x80 ? static_cast<char>(code) : '?';
+			rCursor.pAt += 4;
+			break;
+		}
+		default: rOut += escaped; break;
+		}
+	}
+	return false;
+}
+
+static bool json_number(JsonCursor& rCursor, f64& rOut)
+{
+	json_space(rCursor);
+	const std::string text(rCursor.pAt, std::min<size_t>(rCursor.pEnd - rCursor.pAt, 64));
+	char* pNumberEnd = nullptr;
+	rOut = strtod(text.c_str(), &pNumberEnd);
+	if (pNumberEnd == text.c_str())
+	{
+		return false;
+	}
+	rCursor.pAt += pNumberEnd - text.c_str();
+	return true;
+}
+
+// Calls rMember for each member of an object, with the cursor on its value.
+// rMember must read the value.
+static bool json_object(JsonCursor& rCursor, const std::function<bool(const std::string& rKey)>& rMember)
+{
+	if (!json_next(rCursor, '{'))
+	{
+		return false;
+	}
+	if (json_next(rCursor, '}'))
+	{
+		return true;
+	}
+	std::string key;
+	do
+	{
+		if (!json_string(rCursor, key) || !json_next(rCursor, ':') || !rMember(key))
+		{
+			return false;
+		}
+	} while (json_next(rCursor, ','));
+	return json_next(rCursor, '}');
+}
+
+// Calls rElement for each element of an array, rElement must read it.
+static bool json_array(JsonCursor& rCursor, const std::function<bool()>& rElement)
+{
+	if (!json_next(rCursor, '['))
+	{
+		return false;
+	}
+	if (json_next(rCursor, ']'))
+	{
+		return true;
+	}
+	do
+	{
+		if (!rElement())
+		{
+			return false;
+		}
+	} while (json_next(rCursor, ','));
+	return json_next(rCursor, ']');
+}
+
+// Reads past a value of any type.
+static bool json_skip(JsonCursor& rCursor)
+{
+	json_space(rCursor);
+	if (rCursor.pAt == rCursor.pEnd)
+	{
+		return false;
+	}
+
+	std::string text;
+	f64 number;
+	switch (*rCursor.pAt)
+	{
+	case '"': return json_string(rCursor, text);
+	case '{': return json_object(rCursor, [&rCursor](const std::string&) { return json_skip(rCursor); });
+	case '[': return json_array(rCursor, [&rCursor]() { return json_skip(rCursor); });
+	}
+
+	static const char* const kWords[] = { "true", "false", "null" };
+	for (const char* pWord : kWords)
+	{
+		const size_t length = strlen(pWord);
+		if (static_cast<size_t>(rCursor.pEnd - rCursor.pAt) >= length && strncmp(rCursor.pAt, pWord, length) == 0)
+		{
+			rCursor.pAt += length;
+			return true;
+		}
+	}
+	return json_number(rCursor, number);
+}
+
+// Reads the name and median of each case in the "benchmarks" array of a file
+// write_json() wrote. Fails on a file with no cases, or a case without both,
+// so a baseline that doesn't parse can't pass by comparing nothing.
+static bool read_baseline(const char* pPath, std::vector<BaselineEntry>& rEntriesOut)
+{
+	std::ifstream file(pPath, std::ios::binary);
+	if (!file)
+	{
+		errorF("Can't open %s", pPath);
+		return false;
+	}
+	const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	JsonCursor cursor = { text.data(), text.data() + text.size() };
+	bool bComplete = true;
+	auto readCase = [&cursor, &bComplete, &rEntriesOut]()
+	{
+		BaselineEntry entry = { "", -1.0 };
+		bool bNamed = false;
+		const bool bOk = json_object(cursor, [&cursor, &entry, &bNamed](const std::string& rKey)
+		{
+			if (rKey == "name")
+			{
+				bNamed = true;
+				return json_string(cursor, entry.name);
+			}
+			if (rKey == "median_ns")
+			{
+				return json_number(cursor, entry.medianNs);
+			}
+			return json_skip(cursor);
+		});
+		bComplete &= bNamed && entry.medianNs > 0.0;
+		rEntriesOut.push_back(entry);
+		return bOk;
+	};
+	const bool bParsed = json_object(cursor, [&cursor, &readCase](const std::string& rKey)
+	{
+		return rKey == "benchmarks" ? json_array(cursor, readCase) : json_skip(cursor);
+	});
+
+	json_space(cursor);
+	if (!bParsed || cursor.pAt != cursor.pEnd)
+	{
+		errorF("%s isn't valid JSON, at byte %u", pPath, static_cast<u32>(cursor.pAt - text.data()));
+		return false;
+	}
+	if (!bComplete)
+	{
+		errorF("%s has a case without a name or a median_ns above 0", pPath);
+		return false;
+	}
+	if (rEntriesOut.empty())
+	{
+		errorF("%s has no cases", pPath);
+		return false;
+	}
+	return true;
+}
+
+static const BaselineEntry* find_baseline(const std::vector<BaselineEntry>& rEntries, const std::string& rName)
+{
+	for (const BaselineEntry& rEntry : rEntries)
+	{
+		if (rEntry.name == rName)
+		{
+			return &rEntry;
+		}
+	}
+	return nullptr;
+}
+
+// Time per run with a unit that keeps it readable.
+static std::string format_time(f64 ns)
+{
+	char text[32];
+	if (ns >= 1e6)
+	{
+		snprintf(text, sizeof(text), "%.2f ms", ns / 1e6);
+	}
+	else if (ns >= 1e3)
+	{
+		snprintf(text, sizeof(text), "%.2f us", ns / 1e3);
+	}
+	else
+	{
+		snprintf(text, sizeof(text), "%.1f ns", ns);
+	}
+	return text;
+}
+
+// With no filters every case is selected, otherwise those with any of them in their name.
+static bool selected(const std::string& rName, const std::vector<std::string>& rFilters)
+{
+	bool bSelected = rFilters.empty();
+	for (const std::string& rFilter : rFilters)
+	{
+		bSelected |= rName.find(rFilter) != std::string::npos;
+	}
+	return bSelected;
+}
+
+// Returns the exit code.
+static int run_checks(const std::vector<std::string>& rFilters, bool bList, JobPool& rPool)
+{
+	std::vector<CheckCase> checks;
+	add_binding_checks(checks);
+	add_pipeline_checks(checks);
+	add_constant_checks(checks);
+	add_command_list_checks(checks, rPool);
+	add_command_buffer_checks(checks);
+	add_gpu_timer_checks(checks);
+	add_pacing_checks(checks);
+	add_hot_reload_checks(checks, rPool);
+#if defined(_WIN32)
+	add_io_checks(checks);
+#endif
+
+	u32 run = 0;
+	u32 failed = 0;
+	for (const CheckCase& rCheck : checks)
+	{
+		if (!selected(rCheck.name, rFilters))
+		{
+			continue;
+		}
+		if (bList)
+		{
+			printf("%s\n", rCheck.name.c_str());
+			continue;
+		}
+
+		printf("%s\n", rCheck.name.c_str());
+		fflush(stdout);
+		const u32 failuresBefore = s_checkFailures;
+		rCheck.run();
+		++run;
+		failed += s_checkFailures != failuresBefore ? 1 : 0;
+	}
+
+	if (bList)
+	{
+		return 0;
+	}
+	if (run == 0)
+	{
+		errorF("No check matches the filter");
+		return 1;
+	}
+	if (failed)
+	{
+		errorF("%u of %u checks failed", failed, run);
+		return 1;
+	}
+	printf("All %u checks passed\n", run);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> filters;
+	u32 samples = 15;
+	f64 sampleMs = 10.0;
+	u32 numThreads = 0;
+	const char* pJsonPath = nullptr;
+	const char* pBaselinePath = nullptr;
+	f64 threshold = 10.0;
+	bool bAllowNew = false;
+	bool bList = false;
+	bool bCheck = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* pArg = argv[i];
+		if (strcmp(pArg, "-filter") == 0 && i + 1 < argc)
+		{
+			filters.push_back(argv[++i]);
+		}
+		else if (strcmp(pArg, "-samples") == 0 && i + 1 < argc)
+		{
+			samples = u32(std::max(1, atoi(argv[++i])));
+		}
+		else if (strcmp(pArg, "-sample-ms") == 0 && i + 1 < argc)
+		{
+			sampleMs = std::max(0.0, atof(argv[++i]));
+		}
+		else if (strcmp(pArg, "-threads") == 0 && i + 1 < argc)
+		{
+			numThreads = u32(std::max(1, atoi(argv[++i])));
+		}
+		else if (strcmp(pArg, "-json") == 0 && i + 1 < argc)
+		{
+			pJsonPath = argv[++i];
+		}
+		else if (strcmp(pArg, "-baseline") == 0 && i + 1 < argc)
+		{
+			pBaselinePath = argv[++i];
+		}
+		else if (strcmp(pArg, "-threshold") == 0 && i + 1 < argc)
+		{
+			threshold = std::max(0.0, atof(argv[++i]));
+		}
+		else if (strcmp(pArg, "-allow-new") == 0)
+		{
+			bAllowNew = true;
+		}
+		else if (strcmp(pArg, "-list") == 0)
+		{
+			bList = true;
+		}
+		else if (strcmp(pArg, "-check") == 0)
+		{
+			bCheck = true;
+		}
+		else
+		{
+			print_usage();
+			return 1;
+		}
+	}
+
+	// Read first so a bad path fails before the cases run.
+	std::vector<BaselineEntry> baseline;
+	if (pBaselinePath && !read_baseline(pBaselinePath, baseline))
+	{
+		errorF("Can't read the baseline %s", pBaselinePath);
+		return 1;
+	}
+
+	JobPool pool;
+	pool.launch(numThreads);
+
+	if (bCheck)
+	{
+		return run_checks(filters, bList, pool);
+	}
+
+	std::vector<BenchCase> cases;
+	add_job_cases(cases, pool);
+	add_profiler_cases(cases);
+	add_dither_cases(cases, pool);
+	add_instance_cases(cases, pool);
+	add_debug_draw_cases(cases);
+#if defined(_WIN32)
+	add_framework_cases(cases, pool);
+#endif
+
+	std::vector<BenchResult> results;
+	for (const BenchCase& rCase : cases)
+	{
+		if (!selected(rCase.name, filters))
+		{
+			continue;
+		}
+		if (bList)
+		{
+			printf("%s\n", rCase.name.c_str());
+			continue;
+		}
+
+		BenchResult result = measure(rCase, samples, sampleMs);
+		if (!rCase.budgetNetOf.empty())
+		{
+			result.budgetedNs -= rCase.budgetNetCount * median_ns(rCase.budgetNetOf, cases, results, samples, sampleMs);
+		}
+		results.push_back(result);
+		const FrameTimeSummary& rSummary = results.back().summary;
+		printf("%-36s median %10s   p95 %10s   min %10s", rCase.name.c_str(), format_time(rSummary.medianMs * 1e6).c_str(),
+			format_time(rSummary.p95Ms * 1e6).c_str(), format_time(rSummary.minMs * 1e6).c_str());
+
+		if (pBaselinePath)
+		{
+			const BaselineEntry* pEntry = find_baseline(baseline, rCase.name);
+			if (pEntry)
+			{
+				const f64 change = (rSummary.medianMs * 1e6 / pEntry->medianNs - 1.0) * 100.0;
+				printf("   baseline %10s %+7.1f%%%s", format_time(pEntry->medianNs).c_str(), change, change > threshold ? "  REGRESSED" : "");
+			}
+			else
+			{
+				printf("   not in baseline%s", bAllowNew ? "" : "  MISSING");
+			}
+		}
+		if (!rCase.budgetNetOf.empty())
+		{
+			printf("   net %10s", format_time(results.back().budgetedNs).c_str());
+		}
+		if (rCase.budgetNs > 0.0 && results.back().budgetedNs > rCase.budgetNs)
+		{
+			printf("   OVER BUDGET %s", format_time(rCase.budgetNs).c_str());
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+
+#if defined(_WIN32)
+	remove_temp_files();
+#endif
+
+	if (bList)
+	{
+		return 0;
+	}
+
+	if (pJsonPath && !write_json(results, pool.numWorkers(), pJsonPath))
+	{
+		errorF("Can't write %s", pJsonPath);
+		return 1;
+	}
+
+	// Compared after the JSON is written so a failing run can be looked at or become the new baseline.
+	u32 regressions = 0;
+	u32 missing = 0;
+	u32 overBudget = 0;
+	for (const BenchResult& rResult : results)
+	{
+		if (rResult.budgetNs > 0.0 && rResult.budgetedNs > rResult.budgetNs)
+		{
+			errorF("%s takes %s, its budget is %s", rResult.name.c_str(), format_time(rResult.budgetedNs).c_str(),
+				format_time(rResult.budgetNs).c_str());
+			++overBudget;
+		}
+
+		const BaselineEntry* pEntry = find_baseline(baseline, rResult.name);
+		if (pBaselinePath && !pEntry && !bAllowNew)
+		{
+			++missing;
+		}
+		if (pEntry && rResult.summary.medianMs * 1e6 > pEntry->medianNs * (1.0 + threshold / 100.0))
+		{
+			++regressions;
+		}
+	}
+	if (regressions)
+	{
+		errorF("%u of %u cases are more than %.1f%% slower than %s", regressions, static_cast<u32>(results.size()), threshold, pBaselinePath);
+		return 1;
+	}
+	if (missing)
+	{
+		errorF("%u of %u cases aren't in %s, run with -allow-new if they were just added", missing, static_cast<u32>(results.size()), pBaselinePath);
+		return 1;
+	}
+	if (overBudget)
+	{
+		return 1;
+	}
+
+	return 0;
+}
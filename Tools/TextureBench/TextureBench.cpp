@@ -0,0 +1,545 @@
+// ========================================================
+// TextureBench
+// Measures the CPU texture processing paths on synthetic images.
+// Only depends on the portable core so it builds on any platform, e.g.
+//
+//   g++ -std=c++14 -O2 -pthread -I../../Framework TextureBench.cpp ../../Framework/CoreTypes.cpp
+//       ../../Framework/TextureData.cpp ../../Framework/MipGenerator.cpp ../../Framework/BlockCompress.cpp
+//       ../../Framework/ImageDecode.cpp ../../Framework/TextureResidency.cpp ../../Framework/Profiler.cpp -o TextureBench
+//
+// Usage:
+//   TextureBench [-size <pixels>] [-repeat <n>] [-threads <n>] [-decode <file|@listfile>]... [-residency]
+//
+// Without -size, -decode or -residency it runs 4096 and 8192 square images.
+// -decode measures image decoding over a corpus of real files instead, and fails
+// if any image decodes differently from stb_image.
+// -residency simulates texture streaming on the CPU and fails if the budget is ever exceeded.
+// ========================================================
+
+#include "CoreTypes.h"
+#include "BlockCompress.h"
+#include "ImageDecode.h"
+#include "JobQueue.h"
+#include "MipGenerator.h"
+#include "TextureResidency.h"
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+static void print_usage()
+{
+	printf("Usage: TextureBench [-size <pixels>] [-repeat <n>] [-threads <n>] [-decode <file|@listfile>]... [-residency]\n");
+	printf("  -size <pixels>  Width and height of the test image, default 4096 and 8192.\n");
+	printf("  -repeat <n>     Runs per case, the best time is reported. Default 3.\n");
+	printf("  -threads <n>    Job pool workers, default one per hardware thread.\n");
+	printf("  -decode <file>  Add an image to the decode corpus, @listfile reads names from a file.\n");
+	printf("  -residency      Simulate streaming a field of textures past a moving camera.\n");
+}
+
+// Smooth gradients with some high frequency detail so the filters do real work.
+static void make_test_image(u32 width, u32 height, std::vector<memtype_t>& rPixels)
+{
+	rPixels.resize(u64(width) * height * 4);
+	u32 seed = 0x12345678u;
+	for (u32 y = 0; y < height; ++y)
+	{
+		memtype_t* pRow = &rPixels[u64(y) * width * 4];
+		for (u32 x = 0; x < width; ++x)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			pRow[x * 4 + 0] = memtype_t((x * 255) / width);
+			pRow[x * 4 + 1] = memtype_t((y * 255) / height);
+			pRow[x * 4 + 2] = memtype_t(((x ^ y) & 8) ? 230 : 25);
+			pRow[x * 4 + 3] = memtype_t(seed >> 24);
+		}
+	}
+}
+
+// Best of several runs, in seconds.
+template<typename Fn>
+static f64 time_best(u32 repeat, Fn fn)
+{
+	f64 best = 1e30;
+	for (u32 i = 0; i < repeat; ++i)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		fn();
+		const auto end = std::chrono::high_resolution_clock::now();
+		best = std::min(best, std::chrono::duration<f64>(end - start).count());
+	}
+	return best;
+}
+
+static void bench_mips(u32 size, u32 repeat, JobPool& rPool)
+{
+	std::vector<memtype_t> pixels;
+	make_test_image(size, size, pixels);
+
+	// Mpix/s counts the source pixels, the whole chain is ~1.33x that.
+	const f64 megaPixels = f64(size) * size / 1e6;
+
+	static const struct { MipFilter filter; bool bSrgb; const char* pName; } s_cases[] =
+	{
+		{ kMipFilterBox, false, "box linear" },
+		{ kMipFilterBox, true, "box srgb" },
+		{ kMipFilterKaiser, false, "kaiser linear" },
+		{ kMipFilterKaiser, true, "kaiser srgb" },
+	};
+
+	printf("Mip generation %ux%u\n", size, size);
+	for (const auto& rCase : s_cases)
+	{
+		MipOptions options;
+		options.filter = rCase.filter;
+		options.bSrgb = rCase.bSrgb;
+
+		const f64 serial = time_best(repeat, [&]()
+		{
+			TextureBuffer chain;
+			generate_mips(pixels.data(), size, size, size * 4, options, chain, nullptr);
+		});
+		const f64 pooled = time_best(repeat, [&]()
+		{
+			TextureBuffer chain;
+			generate_mips(pixels.data(), size, size, size * 4, options, chain, &rPool);
+		});
+
+		printf("  %-14s serial %8.1f Mpix/s   pool %8.1f Mpix/s   (%.2fx)\n",
+			rCase.pName, megaPixels / serial, megaPixels / pooled, serial / pooled);
+	}
+}
+
+static void bench_compression(u32 size, u32 repeat, JobPool& rPool)
+{
+	std::vector<memtype_t> pixels;
+	make_test_image(size, size, pixels);
+
+	TextureData source;
+	source.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	source.dimension = kTexture2D;
+	source.width = size;
+	source.height = size;
+	source.depth = 1;
+	source.mipLevels = 1;
+	source.arraySize = 1;
+	source.subresources.push_back({ pixels.data(), size, size, 1, size * 4, size * 4 * size, size });
+
+	const f64 megaPixels = f64(size) * size / 1e6;
+
+	static const struct { DXGI_FORMAT format; const char* pName; } s_cases[] =
+	{
+		{ DXGI_FORMAT_BC1_UNORM, "bc1" },
+		{ DXGI_FORMAT_BC4_UNORM, "bc4" },
+		{ DXGI_FORMAT_BC5_UNORM, "bc5" },
+		{ DXGI_FORMAT_BC7_UNORM, "bc7 mode 6" },
+	};
+
+	printf("Block compression %ux%u\n", size, size);
+	for (const auto& rCase : s_cases)
+	{
+		// Quality is measured in a separate run so the timings only cover encoding.
+		BlockCompressStats stats;
+		{
+			TextureBuffer out;
+			compress_texture(source, rCase.format, out, &rPool, &stats);
+		}
+
+		const f64 serial = time_best(repeat, [&]()
+		{
+			TextureBuffer out;
+			compress_texture(source, rCase.format, out, nullptr);
+		});
+		const f64 pooled = time_best(repeat, [&]()
+		{
+			TextureBuffer out;
+			compress_texture(source, rCase.format, out, &rPool);
+		});
+
+		printf("  %-14s PSNR %6.2f dB   serial %8.1f Mpix/s   pool %8.1f Mpix/s   (%.2fx)\n",
+			rCase.pName, stats.psnr(), megaPixels / serial, megaPixels / pooled, serial / pooled);
+	}
+}
+
+static bool read_file(const std::string& rPath, std::vector<memtype_t>& rOut)
+{
+	std::ifstream file(rPath, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		return false;
+	}
+	rOut.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(rOut.data()), rOut.size());
+	return file.good();
+}
+
+// Returns false if nothing could be decoded or any image differs from stb_image.
+static bool bench_decode(const std::vector<std::string>& rFiles, u32 repeat, JobPool& rPool)
+{
+	std::vector<std::vector<memtype_t>> files(rFiles.size());
+	std::vector<DecodedImage> reference(rFiles.size());
+	u64 totalBytes = 0;
+	u64 totalPixels = 0;
+	for (size_t i = 0; i < rFiles.size(); ++i)
+	{
+		const char* pError = nullptr;
+		if (!read_file(rFiles[i], files[i]) || !decode_image_rgba8_reference(files[i].data(), files[i].size(), reference[i], &pError))
+		{
+			errorF("Skipping %s : %s", rFiles[i].c_str(), pError ? pError : "could not read");
+			files[i].clear();
+			continue;
+		}
+		totalBytes += files[i].size();
+		totalPixels += static_cast<u64>(reference[i].width) * reference[i].height;
+	}
+	if (totalPixels == 0)
+	{
+		errorF("No image in the decode corpus could be read");
+		return false;
+	}
+
+	std::vector<ImageDecodeRequest> requests;
+	for (const std::vector<memtype_t>& rFile : files)
+	{
+		if (!rFile.empty())
+		{
+			requests.emplace_back();
+			requests.back().pData = rFile.data();
+			requests.back().size = rFile.size();
+		}
+	}
+
+	const f64 stb = time_best(repeat, [&]()
+	{
+		DecodedImage image;
+		for (const ImageDecodeRequest& rRequest : requests)
+		{
+			decode_image_rgba8_reference(rRequest.pData, rRequest.size, image);
+		}
+	});
+	const f64 serial = time_best(repeat, [&]()
+	{
+		DecodedImage image;
+		for (const ImageDecodeRequest& rRequest : requests)
+		{
+			decode_image_rgba8(rRequest.pData, rRequest.size, image);
+		}
+	});
+	const f64 pooled = time_best(repeat, [&]()
+	{
+		decode_images_rgba8(requests.data(), static_cast<u32>(requests.size()), &rPool);
+	});
+
+	// The last batch is still in the requests, it must match stb_image exactly.
+	u32 mismatches = 0;
+	u32 r = 0;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		if (!files[i].empty())
+		{
+			mismatches += requests[r].success && requests[r].image.pixels == reference[i].pixels ? 0 : 1;
+			++r;
+		}
+	}
+
+	const f64 megaBytes = totalBytes / 1e6;
+	const f64 megaPixels = totalPixels / 1e6;
+	printf("Image decode, %u files, %.1f MB, %.1f Mpix\n", static_cast<u32>(requests.size()), megaBytes, megaPixels);
+	printf("  stb_image      %8.1f MB/s %8.1f Mpix/s\n", megaBytes / stb, megaPixels / stb);
+	printf("  serial         %8.1f MB/s %8.1f Mpix/s   (%.2fx)\n", megaBytes / serial, megaPixels / serial, stb / serial);
+	printf("  pool           %8.1f MB/s %8.1f Mpix/s   (%.2fx)\n", megaBytes / pooled, megaPixels / pooled, stb / pooled);
+	if (mismatches)
+	{
+		errorF("  %u images differ from stb_image!", mismatches);
+	}
+	return mismatches == 0;
+}
+
+// A camera flies down a corridor of textured quads at 60Hz, reads are modelled
+// as a single disk with fixed latency and bandwidth. The simulation applies every
+// load and eviction to its own copy of what is resident, the way the GPU side
+// would, and checks that copy against the budget after every step.
+// Returns false if the budget was ever exceeded.
+static bool bench_residency()
+{
+	static const u32 kNumTextures = 512;
+	static const u64 kBudget = 96 * MB;
+	static const f64 kFrameTime = 1.0 / 60.0;
+	static const u32 kNumFrames = 60 * 60;
+	static const f64 kReadLatency = 0.2e-3;
+	static const f64 kReadBandwidth = 500.0 * MB;
+	static const f32 kSpeed = 40.0f;		// Units per second along the corridor.
+	static const f32 kFovY = 1.0f;
+	static const f32 kViewportHeight = 1080.0f;
+	static const u32 kTailSize = 64;
+
+	struct SimTexture
+	{
+		f32 x, z, radius;
+		u32 size;
+		std::vector<u64> mipBytes;
+		u32 tailMip;
+		u32 residentMip;	// What the "GPU" holds.
+		TextureResidency::Handle handle;
+	};
+
+	struct SimRead
+	{
+		f64 doneTime;
+		TextureResidency::Request load;
+	};
+
+	TextureResidency residency;
+	residency.set_budget(kBudget);
+	residency.set_max_loads_in_flight(8);
+
+	// 1k to 4k BC7 textures (one byte per texel) either side of the corridor.
+	std::vector<SimTexture> textures(kNumTextures);
+	u32 seed = 0x9E3779B9u;
+	for (u32 i = 0; i < kNumTextures; ++i)
+	{
+		SimTexture& rTexture = textures[i];
+		seed = seed * 1664525u + 1013904223u;
+		rTexture.size = 1024u << (seed >> 30 ? (seed >> 30) - 1 : 0);
+		rTexture.x = (i & 1) ? 6.0f : -6.0f;
+		rTexture.z = 8.0f * (i / 2);
+		rTexture.radius = 2.0f + (seed >> 8 & 3);
+
+		const u32 numMips = mip_level_count(rTexture.size, rTexture.size);
+		u32 numTail = 0;
+		for (u32 mip = 0; mip < numMips; ++mip)
+		{
+			const u32 width = std::max(rTexture.size >> mip, 1u);
+			const u32 blocks = std::max((width + 3) / 4, 1u);
+			rTexture.mipBytes.push_back(u64(blocks) * blocks * 16);
+			numTail += width <= kTailSize ? 1 : 0;
+		}
+		rTexture.tailMip = numMips - numTail;
+		rTexture.residentMip = rTexture.tailMip;
+		rTexture.handle = residency.add(rTexture.size, rTexture.size, numMips, rTexture.mipBytes.data(), numTail);
+	}
+
+	u64 simResident = 0;
+	for (const SimTexture& rTexture : textures)
+	{
+		for (u32 mip = rTexture.residentMip; mip < rTexture.mipBytes.size(); ++mip)
+		{
+			simResident += rTexture.mipBytes[mip];
+		}
+	}
+
+	std::vector<SimRead> reads;
+	std::vector<TextureResidency::Request> loads;
+	std::vector<TextureResidency::Request> evictions;
+	f64 diskFreeTime = 0.0;
+	u64 peakResident = simResident;
+	u64 bytesStreamed = 0;
+	u32 violations = 0;
+	u64 sharpFrames = 0;
+	u64 visibleFrames = 0;
+	f64 updateSeconds = 0.0;
+
+	auto check = [&](const char* pWhen, u32 frame)
+	{
+		peakResident = std::max(peakResident, simResident);
+		if (simResident != residency.resident_bytes() || residency.committed_bytes() > kBudget)
+		{
+			if (violations++ == 0)
+			{
+				errorF("  budget exceeded %s frame %u : resident %llu, tracked %llu, committed %llu, budget %llu", pWhen, frame,
+					(unsigned long long)simResident, (unsigned long long)residency.resident_bytes(),
+					(unsigned long long)residency.committed_bytes(), (unsigned long long)kBudget);
+			}
+		}
+	};
+
+	for (u32 frame = 0; frame < kNumFrames; ++frame)
+	{
+		const f64 now = frame * kFrameTime;
+
+		// Reads that finished since last frame.
+		for (size_t i = 0; i < reads.size();)
+		{
+			if (reads[i].doneTime <= now)
+			{
+				SimTexture& rTexture = textures[reads[i].load.texture];
+				ASSERT(reads[i].load.mip + 1 == rTexture.residentMip);
+				rTexture.residentMip = reads[i].load.mip;
+				simResident += rTexture.mipBytes[reads[i].load.mip];
+				bytesStreamed += rTexture.mipBytes[reads[i].load.mip];
+				residency.on_loaded(reads[i].load, true);
+				check("after a load on", frame);
+
+				reads[i] = reads.back();
+				reads.pop_back();
+			}
+			else
+			{
+				++i;
+			}
+		}
+
+		// Camera runs down the corridor and back.
+		const f32 travel = static_cast<f32>(now) * kSpeed;
+		const f32 length = 8.0f * (kNumTextures / 2);
+		const f32 lap = std::fmod(travel, 2.0f * length);
+		const f32 cameraZ = lap < length ? lap : 2.0f * length - lap;
+		const f32 direction = lap < length ? 1.0f : -1.0f;
+
+		for (SimTexture& rTexture : textures)
+		{
+			const f32 dz = (rTexture.z - cameraZ) * direction;
+			const f32 distance = std::sqrt(dz * dz + rTexture.x * rTexture.x);
+			if (dz > -rTexture.radius && distance < 200.0f)
+			{
+				const f32 pixels = TextureResidency::projected_size(rTexture.radius, distance, kFovY, kViewportHeight);
+				residency.set_screen_size(rTexture.handle, pixels, frame);
+			}
+		}
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		residency.update(frame, loads, evictions);
+		const auto end = std::chrono::high_resolution_clock::now();
+		updateSeconds += std::chrono::duration<f64>(end - start).count();
+
+		for (const TextureResidency::Request& rEviction : evictions)
+		{
+			SimTexture& rTexture = textures[rEviction.texture];
+			ASSERT(rEviction.mip > rTexture.residentMip);
+			for (u32 mip = rTexture.residentMip; mip < rEviction.mip; ++mip)
+			{
+				simResident -= rTexture.mipBytes[mip];
+			}
+			rTexture.residentMip = rEviction.mip;
+		}
+		check("after evictions on", frame);
+
+		for (const TextureResidency::Request& rLoad : loads)
+		{
+			const u64 bytes = textures[rLoad.texture].mipBytes[rLoad.mip];
+			diskFreeTime = std::max(diskFreeTime, now) + kReadLatency + bytes / kReadBandwidth;
+			reads.push_back({ diskFreeTime, rLoad });
+		}
+
+		// How often visible textures have the level they want.
+		for (const SimTexture& rTexture : textures)
+		{
+			const u32 wanted = residency.wanted_mip(rTexture.handle);
+			if (wanted < rTexture.tailMip)
+			{
+				++visibleFrames;
+				sharpFrames += rTexture.residentMip <= wanted ? 1 : 0;
+			}
+		}
+	}
+
+	const TextureResidency::Stats stats = residency.stats();
+	const f64 seconds = kNumFrames * kFrameTime;
+	printf("Texture residency, %u textures, %llu MB budget, %.0f s simulated\n", kNumTextures,
+		(unsigned long long)(kBudget / MB), seconds);
+	printf("  streamed     %8llu mips %8.1f mips/s %8.1f MB/s\n", (unsigned long long)stats.mipsLoaded,
+		stats.mipsLoaded / seconds, bytesStreamed / seconds / MB);
+	printf("  evicted      %8llu mips\n", (unsigned long long)stats.mipsEvicted);
+	printf("  peak         %8.1f MB resident, %.1f MB committed\n", peakResident / f64(MB), stats.peakCommittedBytes / f64(MB));
+	printf("  sharp        %8.1f %% of visible texture frames at the wanted mip\n", visibleFrames ? 100.0 * sharpFrames / visibleFrames : 100.0);
+	printf("  update       %8.1f us per frame\n", updateSeconds * 1e6 / kNumFrames);
+	if (violations)
+	{
+		errorF("  budget exceeded %u times!", violations);
+	}
+	return violations == 0;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<u32> sizes;
+	std::vector<std::string> decodeFiles;
+	u32 repeat = 3;
+	u32 numThreads = 0;
+	bool bResidency = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* pArg = argv[i];
+		if (strcmp(pArg, "-size") == 0 && i + 1 < argc)
+		{
+			sizes.push_back(u32(atoi(argv[++i])));
+		}
+		else if (strcmp(pArg, "-repeat") == 0 && i + 1 < argc)
+		{
+			repeat = std::max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(pArg, "-threads") == 0 && i + 1 < argc)
+		{
+			numThreads = u32(std::max(1, atoi(argv[++i])));
+		}
+		else if (strcmp(pArg, "-decode") == 0 && i + 1 < argc)
+		{
+			const char* pName = argv[++i];
+			if (pName[0] == '@')
+			{
+				std::ifstream list(pName + 1);
+				std::string line;
+				while (std::getline(list, line))
+				{
+					if (!line.empty() && line.back() == '\r')
+					{
+						line.pop_back();
+					}
+					if (!line.empty())
+					{
+						decodeFiles.push_back(line);
+					}
+				}
+			}
+			else
+			{
+				decodeFiles.push_back(pName);
+			}
+		}
+		else if (strcmp(pArg, "-residency") == 0)
+		{
+			bResidency = true;
+		}
+		else
+		{
+			print_usage();
+			return 1;
+		}
+	}
+
+	if (sizes.empty() && decodeFiles.empty() && !bResidency)
+	{
+		sizes.push_back(4096);
+		sizes.push_back(8192);
+	}
+
+	JobPool pool;
+	pool.launch(numThreads);
+
+	for (u32 size : sizes)
+	{
+		if (size == 0)
+		{
+			print_usage();
+			return 1;
+		}
+		bench_mips(size, repeat, pool);
+		bench_compression(size, repeat, pool);
+	}
+
+	bool bOk = true;
+	if (!decodeFiles.empty())
+	{
+		bOk = bench_decode(decodeFiles, repeat, pool) && bOk;
+	}
+
+	if (bResidency)
+	{
+		bOk = bench_residency() && bOk;
+	}
+
+	return bOk ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+// ========================================================
+// TextureCompressor
+// Converts PNG/JPEG/TGA images or uncompressed DDS files into block
+// compressed DDS files with a full mip chain.
+// Only depends on the portable core so it builds on any platform, e.g.
+//
+//   g++ -std=c++14 -O2 -pthread -I../../Framework TextureCompressor.cpp ../../Framework/CoreTypes.cpp
+//       ../../Framework/TextureData.cpp ../../Framework/MipGenerator.cpp ../../Framework/BlockCompress.cpp
+//       ../../Framework/ImageDecode.cpp ../../Framework/Profiler.cpp -o TextureCompressor
+//
+// Usage:
+//   TextureCompressor [-format <bc1|bc4|bc5|bc7>] [-srgb] [-mips <none|box|kaiser>] [-linear] <input> <output.dds>
+//
+// Prints the PSNR of the result, the encode speed and the size saved.
+// ========================================================
+
+#include "CoreTypes.h"
+#include "BlockCompress.h"
+#include "ImageDecode.h"
+#include "JobQueue.h"
+#include "MipGenerator.h"
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+static void print_usage()
+{
+	printf("Usage: TextureCompressor [-format <bc1|bc4|bc5|bc7>] [-srgb] [-mips <none|box|kaiser>] [-linear] <input> <output.dds>\n");
+	printf("  -format <fmt>  Block format, default bc7.\n");
+	printf("  -srgb          Mark the output as sRGB (bc1 and bc7 only).\n");
+	printf("  -mips <filter> Mip generation for single level inputs, default kaiser.\n");
+	printf("  -linear        Filter mips without sRGB conversion, e.g. for data textures.\n");
+}
+
+static bool read_file(const char* pPath, std::vector<memtype_t>& rOut)
+{
+	std::ifstream file(pPath, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		return false;
+	}
+	rOut.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(rOut.data()), rOut.size());
+	return file.good();
+}
+
+static DXGI_FORMAT parse_format(const std::string& rName, bool bSrgb)
+{
+	if (rName == "bc1") return bSrgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+	if (rName == "bc4") return DXGI_FORMAT_BC4_UNORM;
+	if (rName == "bc5") return DXGI_FORMAT_BC5_UNORM;
+	if (rName == "bc7") return bSrgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+	return DXGI_FORMAT_UNKNOWN;
+}
+
+static u64 texture_bytes(const TextureData& rTexture)
+{
+	u64 total = 0;
+	for (const TextureSubresource& rSub : rTexture.subresources)
+	{
+		u64 numBytes = 0;
+		texture_surface_info(rSub.width, rSub.height, rTexture.format, &numBytes, nullptr, nullptr);
+		total += numBytes * rSub.depth;
+	}
+	return total;
+}
+
+int main(int argc, char** argv)
+{
+	std::string formatName = "bc7";
+	std::string mipsName = "kaiser";
+	bool bSrgb = false;
+	bool bLinear = false;
+	const char* pInput = nullptr;
+	const char* pOutput = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if (arg == "-format" && i + 1 < argc)
+		{
+			formatName = argv[++i];
+		}
+		else if (arg == "-mips" && i + 1 < argc)
+		{
+			mipsName = argv[++i];
+		}
+		else if (arg == "-srgb")
+		{
+			bSrgb = true;
+		}
+		else if (arg == "-linear")
+		{
+			bLinear = true;
+		}
+		else if (!pInput)
+		{
+			pInput = argv[i];
+		}
+		else if (!pOutput)
+		{
+			pOutput = argv[i];
+		}
+		else
+		{
+			print_usage();
+			return 1;
+		}
+	}
+
+	const DXGI_FORMAT format = parse_format(formatName, bSrgb);
+	if (!pInput || !pOutput || format == DXGI_FORMAT_UNKNOWN ||
+		(mipsName != "none" && mipsName != "box" && mipsName != "kaiser"))
+	{
+		print_usage();
+		return 1;
+	}
+
+	std::vector<memtype_t> fileData;
+	if (!read_file(pInput, fileData))
+	{
+		errorF("Could not read %s", pInput);
+		return 1;
+	}
+
+	JobPool pool;
+	pool.launch();
+
+	// DDS files are used as they are, anything else goes through the image decoder.
+	TextureData source;
+	DecodedImage image;
+	const char* pError = nullptr;
+	if (!parse_dds(fileData.data(), fileData.size(), source))
+	{
+		if (!decode_image_rgba8(fileData.data(), fileData.size(), image, &pError, &pool))
+		{
+			errorF("Could not decode %s : %s", pInput, pError);
+			return 1;
+		}
+		source.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		source.dimension = kTexture2D;
+		source.width = image.width;
+		source.height = image.height;
+		source.depth = 1;
+		source.mipLevels = 1;
+		source.arraySize = 1;
+		source.subresources.push_back({ image.pixels.data(), image.width, image.height, 1, image.width * 4, image.width * 4 * image.height, image.height });
+	}
+
+	TextureBuffer mips;
+	if (mipsName != "none" && source.mipLevels == 1 && source.arraySize == 1 && source.dimension == kTexture2D
+		&& texture_format_bits_per_pixel(source.format) == 32)
+	{
+		MipOptions options;
+		options.filter = mipsName == "box" ? kMipFilterBox : kMipFilterKaiser;
+		options.bSrgb = !bLinear;
+
+		const TextureSubresource& rTop = source.subresources[0];
+		generate_mips(rTop.pData, rTop.width, rTop.height, rTop.rowPitch, options, mips, &pool);
+		mips.texture.format = source.format;
+	}
+	const TextureData& rUncompressed = mips.texture.mipLevels ? mips.texture : source;
+
+	TextureBuffer compressed;
+	BlockCompressStats stats;
+	const auto start = std::chrono::high_resolution_clock::now();
+	if (!compress_texture(rUncompressed, format, compressed, &pool, &stats, &pError))
+	{
+		errorF("Could not compress %s : %s", pInput, pError);
+		return 1;
+	}
+	const auto end = std::chrono::high_resolution_clock::now();
+
+	std::vector<memtype_t> outData;
+	write_dds(compressed.texture, outData);
+	std::ofstream outFile(pOutput, std::ios::binary);
+	outFile.write(reinterpret_cast<const char*>(outData.data()), outData.size());
+	if (!outFile)
+	{
+		errorF("Could not write %s", pOutput);
+		return 1;
+	}
+
+	u64 numPixels = 0;
+	for (const TextureSubresource& rSub : rUncompressed.subresources)
+	{
+		numPixels += static_cast<u64>(rSub.width) * rSub.height * rSub.depth;
+	}
+	const f64 seconds = std::chrono::duration<f64>(end - start).count();
+	const u64 before = texture_bytes(rUncompressed);
+	const u64 after = texture_bytes(compressed.texture);
+
+	printf("%s -> %s\n", pInput, pOutput);
+	printf("  %ux%u, %u mips, %s\n", rUncompressed.width, rUncompressed.height, rUncompressed.mipLevels, formatName.c_str());
+	printf("  PSNR %.2f dB, %.1f Mpix/s\n", stats.psnr(), numPixels / seconds / 1e6);
+	printf("  %llu KB -> %llu KB (%.1fx smaller)\n", static_cast<unsigned long long>(before / KB),
+		static_cast<unsigned long long>(after / KB), static_cast<f64>(before) / after);
+	return 0;
+}